@@ -28,6 +28,7 @@
 //
 //------------------------------------------------------------------------------
 
+#include <algorithm>
 #include "xpucontroller.h"
 
 AbstractXPUInterface::AbstractXPUInterface(SystemState* state_, QObject *parent) :
@@ -53,6 +54,8 @@ AbstractXPUInterface::AbstractXPUInterface(SystemState* state_, QObject *parent)
         channelsPerStream = 16;
     }
     sampleRate = state->sampleRate->getNumericValue();
+    setAllChannelsActive();
+    bandDemand.assign(channels, WaveformFifo::AllBands);
 }
 
 void AbstractXPUInterface::resetPrev()
@@ -101,10 +104,34 @@ void AbstractXPUInterface::updateNumStreams(int numStreams_)
     updateConstChars();
 
     updateMemory();
+
+    setAllChannelsActive();
+    updateActiveChannels();
+    bandDemand.assign(channels, WaveformFifo::AllBands);
+}
+
+// Process numBlocks consecutive data blocks.  Input and output blocks are stored back to back, in the same layout
+// processDataBlock() uses for a single block.  Filter and spike detector state is carried from each block to the
+// next just as it is between separate processDataBlock() calls.
+void AbstractXPUInterface::processDataBlocks(uint16_t* data, int numBlocks, uint16_t* lowChunk, uint16_t* wideChunk,
+                                             uint16_t* highChunk, uint32_t* spikeChunk, uint8_t* spikeIDChunk)
+{
+    for (int block = 0; block < numBlocks; ++block) {
+        processDataBlock(data, lowChunk, wideChunk, highChunk, spikeChunk, spikeIDChunk);
+        data += wordsPerBlock;
+        lowChunk += FramesPerBlock * channels;
+        wideChunk += FramesPerBlock * channels;
+        highChunk += FramesPerBlock * channels;
+        spikeChunk += SnippetsPerBlock * channels;
+        spikeIDChunk += SnippetsPerBlock * channels;
+    }
 }
 
 void AbstractXPUInterface::runDiagnostic(int XPUIndex)
 { 
+    // Time processing of every channel, regardless of which are currently enabled.
+    setAllChannelsActive();
+
     uint16_t* dataOriginal = new uint16_t[DiagnosticBlocks * wordsPerBlock];
     uint16_t* lowOriginal = new uint16_t[DiagnosticBlocks * FramesPerBlock * channels];
     uint16_t* wideOriginal = new uint16_t[DiagnosticBlocks * FramesPerBlock * channels];
@@ -139,11 +166,16 @@ void AbstractXPUInterface::runDiagnostic(int XPUIndex)
     }
     auto end = std::chrono::steady_clock::now();
 
+    // Don't leave parsedPrevHigh pointing into the buffers freed below.
+    parsedPrevHigh = parsedPrevHighOriginal;
+
     delete [] dataOriginal;
     delete [] lowOriginal;
     delete [] wideOriginal;
     delete [] highOriginal;
 
+    updateActiveChannels();
+
     float elapsedMs = (float) std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
     if (XPUIndex == 0) state->cpuInfo.diagnosticTime = elapsedMs;
     else state->gpuList[XPUIndex - 1].diagnosticTime = elapsedMs;
@@ -156,6 +188,7 @@ void AbstractXPUInterface::updateFilters()
     calculateLowConstants();
     calculateHighConstants();
     updateFilterConstArray();
+    updateFilterKernels();
     updateConstChars();
     updateConstFloats();
 }
@@ -261,6 +294,9 @@ void AbstractXPUInterface::updateFromState()
         hoops[channelIndex].threshold = thisChannel->getSpikeThreshold();
     }
 
+    // If any amplifier channels have been enabled or disabled, update the list of channels to process.
+    updateActiveChannels();
+
     // If spikeMax or suppressionEnabled have changed, update them.
     if (globalParameters.spikeMax != state->suppressionThreshold->getValue())
         globalParameters.spikeMax = state->suppressionThreshold->getValue();
@@ -274,7 +310,87 @@ void AbstractXPUInterface::updateFromState()
     updateHoopsVariables();
 }
 
-// Default implementation - do nothing (should only be reimplemented by GPUInterface)
+// Set the amplifier bands that must be computed for each channel.  Channels not covered by demand get all bands.
+void AbstractXPUInterface::setBandDemand(const std::vector<uint8_t>& demand)
+{
+    std::lock_guard<std::mutex> lockFilter(filterMutex);
+    bandDemand.assign(channels, WaveformFifo::AllBands);
+    std::copy(demand.begin(), demand.begin() + std::min((int) demand.size(), channels), bandDemand.begin());
+}
+
+// Rebuild the lists of enabled and disabled amplifier channels from SignalSources.  Filter and spike detector state
+// isn't updated while a channel is disabled, so it is cleared for channels that have just been enabled.  This includes
+// their part of the previous block's high-pass tail (parsedPrevHigh), which is copied to parsedPrevHighOriginal so
+// the previous block's output isn't modified.
+void AbstractXPUInterface::updateActiveChannels()
+{
+    std::vector<char> active(channels, 0);
+    std::vector<std::string> ampChannelNames = state->signalSources->amplifierChannelsNameList();
+    for (auto &name : ampChannelNames) {
+        int channelIndex = state->getSerialIndex(QString::fromStdString(name));
+        Channel* thisChannel = state->signalSources->channelByName(QString::fromStdString(name));
+        if (thisChannel && channelIndex >= 0 && channelIndex < channels && thisChannel->isEnabled()) {
+            active[channelIndex] = 1;
+        }
+    }
+    if (active == channelActive) return;
+
+    activeChannels.clear();
+    inactiveChannels.clear();
+    for (int c = 0; c < channels; ++c) {
+        if (active[c]) {
+            activeChannels.push_back(c);
+            bool wasActive = c < (int) channelActive.size() && channelActive[c];
+            if (allocated && !wasActive) {
+                for (int i = 0; i < 20; ++i) {
+                    prevLast2[c * 20 + i] = 0.0f;
+                }
+                if (parsedPrevHigh != parsedPrevHighOriginal) {
+                    std::copy(parsedPrevHigh, parsedPrevHigh + SnippetSize * channels, parsedPrevHighOriginal);
+                    parsedPrevHigh = parsedPrevHighOriginal;
+                }
+                for (int s = 0; s < SnippetSize; ++s) {
+                    parsedPrevHigh[s * channels + c] = 32768;
+                }
+                startSearchPos[c] = 0;
+            }
+        } else {
+            inactiveChannels.push_back(c);
+        }
+    }
+    channelActive.swap(active);
+}
+
+void AbstractXPUInterface::setAllChannelsActive()
+{
+    activeChannels.resize(channels);
+    for (int c = 0; c < channels; ++c) {
+        activeChannels[c] = c;
+    }
+    inactiveChannels.clear();
+    channelActive.assign(channels, 1);
+}
+
+// Set disabled channels' waveforms to zero (32768) and report no spikes on them, in one data block's output.
+void AbstractXPUInterface::clearInactiveOutputs(uint16_t* lowChunk, uint16_t* wideChunk, uint16_t* highChunk,
+                                                uint32_t* spikeChunk, uint8_t* spikeIDChunk) const
+{
+    for (int s = 0; s < FramesPerBlock; ++s) {
+        for (int channelIndex : inactiveChannels) {
+            lowChunk[s * channels + channelIndex] = 32768;
+            wideChunk[s * channels + channelIndex] = 32768;
+            highChunk[s * channels + channelIndex] = 32768;
+        }
+    }
+    for (int s = 0; s < SnippetsPerBlock; ++s) {
+        for (int channelIndex : inactiveChannels) {
+            spikeChunk[s * channels + channelIndex] = 0;
+            spikeIDChunk[s * channels + channelIndex] = 0;
+        }
+    }
+}
+
+// Default implementation - do nothing
 void AbstractXPUInterface::updateHoopsVariables()
 {
 }
@@ -284,6 +400,11 @@ void AbstractXPUInterface::updateFilterConstArray()
 {
 }
 
+// Default implementation - do nothing (should only be reimplemented by CPUInterface)
+void AbstractXPUInterface::updateFilterKernels()
+{
+}
+
 // Default implementation - do nothing (should only be reimplemented by GPUInterface)
 void AbstractXPUInterface::updateConstChars()
 {
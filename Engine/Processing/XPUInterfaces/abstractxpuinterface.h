@@ -39,8 +39,10 @@
     #include <CL/cl.h>
 #endif
 #include <mutex>
+#include <vector>
 #include "systemstate.h"
 #include "filter.h"
+#include "waveformfifo.h"
 
 #define MAX_SOURCE_SIZE (0x100000) // memory allocated for kernel.cl source code
 
@@ -103,8 +105,11 @@ public:
     void resetPrev();
     virtual void processDataBlock(uint16_t* data, uint16_t* lowChunk, uint16_t* wideChunk,
                                   uint16_t* highChunk, uint32_t* spikeChunk, uint8_t* spikeIDChunk) = 0;
+    virtual void processDataBlocks(uint16_t* data, int numBlocks, uint16_t* lowChunk, uint16_t* wideChunk,
+                                   uint16_t* highChunk, uint32_t* spikeChunk, uint8_t* spikeIDChunk);
     void updateNumStreams(int numStreams_);
     void updateFromState();
+    void setBandDemand(const std::vector<uint8_t>& demand);
     virtual void speedTest() = 0;
     virtual bool setupMemory() = 0;
     virtual bool cleanupMemory() = 0;
@@ -115,8 +120,13 @@ protected:
     void updateFilters();
     virtual void updateHoopsVariables();
     virtual void updateFilterConstArray();
+    virtual void updateFilterKernels();
     virtual void updateConstChars();
     virtual void updateConstFloats();
+    void updateActiveChannels();
+    void setAllChannelsActive();
+    void clearInactiveOutputs(uint16_t* lowChunk, uint16_t* wideChunk, uint16_t* highChunk, uint32_t* spikeChunk,
+                              uint8_t* spikeIDChunk) const;
     std::mutex filterMutex;
 
     bool allocated;
@@ -141,6 +151,15 @@ protected:
     uint16_t* startSearchPos;
     ChannelHoopsStruct* hoops;
 
+    // Amplifier channels enabled in SignalSources, in increasing order; only these are filtered and searched for
+    // spikes.  inactiveChannels lists the rest.
+    std::vector<int> activeChannels;
+    std::vector<int> inactiveChannels;
+    std::vector<char> channelActive;
+
+    // Amplifier bands (WaveformFifo::AmplifierBand flags) needed by some WaveformFifo reader, for each channel.
+    std::vector<uint8_t> bandDemand;
+
     uint16_t* parsedPrevHighOriginal;
     uint16_t* parsedPrevHigh;
     uint64_t* inputIndex, outputIndex, spikeIndex;
@@ -0,0 +1,349 @@
+//------------------------------------------------------------------------------
+//
+//  Intan Technologies RHX Data Acquisition Software
+//  Version 3.4.0
+//
+//  Copyright (c) 2020-2025 Intan Technologies
+//
+//  This file is part of the Intan Technologies RHX Data Acquisition Software.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published
+//  by the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//  This software is provided 'as-is', without any express or implied warranty.
+//  In no event will the authors be held liable for any damages arising from
+//  the use of this software.
+//
+//  See <http://www.intantech.com> for documentation and product information.
+//
+//------------------------------------------------------------------------------
+
+#include "simdlanes.h"
+#include "channellanefilter.h"
+
+// One biquad stage: b2 * x2 + b1 * x1 + b0 * x - a2 * y2 - a1 * y1, evaluated left to right like the scalar code.
+template <class V>
+struct LaneBiquadVector
+{
+    typename V::Type b2, b1, b0, a2, a1;
+
+    RHX_FORCE_INLINE void set(const LaneBiquad& c)
+    {
+        b2 = V::set1(c.b2);
+        b1 = V::set1(c.b1);
+        b0 = V::set1(c.b0);
+        a2 = V::set1(c.a2);
+        a1 = V::set1(c.a1);
+    }
+
+    RHX_FORCE_INLINE typename V::Type apply(const typename V::Type& x2, const typename V::Type& x1, const typename V::Type& x,
+                                            const typename V::Type& y2, const typename V::Type& y1) const
+    {
+        return V::sub(V::sub(V::add(V::add(V::mul(b2, x2), V::mul(b1, x1)), V::mul(b0, x)), V::mul(a2, y2)), V::mul(a1, y1));
+    }
+};
+
+template <class V>
+static RHX_FORCE_INLINE typename V::Type loadState(const float* prevLast2, int index)
+{
+    alignas(32) float values[V::Count];
+    for (int lane = 0; lane < V::Count; ++lane) {
+        values[lane] = prevLast2[lane * ChannelLaneFilter::StateFloatsPerChannel + index];
+    }
+    return V::load(values);
+}
+
+template <class V>
+static RHX_FORCE_INLINE void storeState(float* prevLast2, int index, const typename V::Type& x)
+{
+    alignas(32) float values[V::Count];
+    V::store(values, x);
+    for (int lane = 0; lane < V::Count; ++lane) {
+        prevLast2[lane * ChannelLaneFilter::StateFloatsPerChannel + index] = values[lane];
+    }
+}
+
+// With Notch false, the notch filter is bypassed (wide = in), which gives the same result as the pass-through
+// coefficients (b0 = 1, all others 0) used when the notch filter is disabled.
+template <class V, bool Notch, int LowStages, int HighStages>
+static RHX_FORCE_INLINE void filterKernel(const LaneBiquad& notch, const LaneBiquad* low, const LaneBiquad* high,
+                                          const uint16_t* rawBlock, int wordsPerFrame, int numFrames,
+                                          const int* rawOffsets, float* prevLast2, float* wideOut, float* lowOut,
+                                          float* highOut)
+{
+    typedef typename V::Type T;
+
+    LaneBiquadVector<V> notchFilter, lowFilter[4], highFilter[4];
+    if (Notch) notchFilter.set(notch);
+    for (int i = 0; i < LowStages; ++i) lowFilter[i].set(low[i]);
+    for (int i = 0; i < HighStages; ++i) highFilter[i].set(high[i]);
+
+    // State layout (see CPUInterface): low y2[4], low y1[4], high y2[4], high y1[4], in x2, in x1, wide y2, wide y1.
+    T low2[4], low1[4], high2[4], high1[4];
+    for (int i = 0; i < 4; ++i) {
+        low2[i] = loadState<V>(prevLast2, i);
+        low1[i] = loadState<V>(prevLast2, 4 + i);
+        high2[i] = loadState<V>(prevLast2, 8 + i);
+        high1[i] = loadState<V>(prevLast2, 12 + i);
+    }
+    T in2 = loadState<V>(prevLast2, 16);
+    T in1 = loadState<V>(prevLast2, 17);
+    T wide2 = loadState<V>(prevLast2, 18);
+    T wide1 = loadState<V>(prevLast2, 19);
+
+    const T scale = V::set1(0.195f);
+    const T offset = V::set1(32768.0f);
+    alignas(32) float inValues[V::Count];
+
+    for (int frame = 0; frame < numFrames; ++frame) {
+        // Gather one sample from each channel and convert it to microvolts.
+        const uint16_t* frameData = rawBlock + frame * wordsPerFrame;
+        for (int lane = 0; lane < V::Count; ++lane) {
+            inValues[lane] = (float) frameData[rawOffsets[lane]];
+        }
+        T in = V::mul(scale, V::sub(V::load(inValues), offset));
+
+        // (1) IIR notch filter
+        T wide = Notch ? notchFilter.apply(in2, in1, in, wide2, wide1) : in;
+
+        // (2) IIR Nth-order low-pass; each stage's input history is the previous stage's output history.
+        T x = wide, x1 = wide1, x2 = wide2;
+        for (int i = 0; i < LowStages; ++i) {
+            T y = lowFilter[i].apply(x2, x1, x, low2[i], low1[i]);
+            x2 = low2[i];
+            x1 = low1[i];
+            x = y;
+            low2[i] = low1[i];
+            low1[i] = y;
+        }
+        V::store(&lowOut[frame * V::Count], x);
+
+        // (3) IIR Nth-order high-pass
+        x = wide;
+        x1 = wide1;
+        x2 = wide2;
+        for (int i = 0; i < HighStages; ++i) {
+            T y = highFilter[i].apply(x2, x1, x, high2[i], high1[i]);
+            x2 = high2[i];
+            x1 = high1[i];
+            x = y;
+            high2[i] = high1[i];
+            high1[i] = y;
+        }
+        V::store(&highOut[frame * V::Count], x);
+
+        V::store(&wideOut[frame * V::Count], wide);
+        in2 = in1;
+        in1 = in;
+        wide2 = wide1;
+        wide1 = wide;
+    }
+
+    // Unused stages are stored as zero, as in the scalar code.
+    const T zero = V::set1(0.0f);
+    for (int i = 0; i < 4; ++i) {
+        storeState<V>(prevLast2, i, i < LowStages ? low2[i] : zero);
+        storeState<V>(prevLast2, 4 + i, i < LowStages ? low1[i] : zero);
+        storeState<V>(prevLast2, 8 + i, i < HighStages ? high2[i] : zero);
+        storeState<V>(prevLast2, 12 + i, i < HighStages ? high1[i] : zero);
+    }
+    storeState<V>(prevLast2, 16, in2);
+    storeState<V>(prevLast2, 17, in1);
+    storeState<V>(prevLast2, 18, wide2);
+    storeState<V>(prevLast2, 19, wide1);
+
+    // CPUInterface clamps its wide-band output before saving it as filter state; do the same here.
+    for (int lane = 0; lane < V::Count; ++lane) {
+        for (int index = 18; index <= 19; ++index) {
+            float& value = prevLast2[lane * ChannelLaneFilter::StateFloatsPerChannel + index];
+            if (value > ChannelLaneFilter::WideStateLimit) value = ChannelLaneFilter::WideStateLimit;
+            else if (value < -ChannelLaneFilter::WideStateLimit) value = -ChannelLaneFilter::WideStateLimit;
+        }
+    }
+}
+
+template <class V>
+static RHX_FORCE_INLINE void crossingKernel(const float* highOut, int numFrames, const float* thresholds,
+                                            uint8_t* crossingMasks)
+{
+    typedef typename V::Type T;
+
+    // Negate the signal and threshold of lanes with negative thresholds, so every lane tests 'greater than'.
+    // (Negation is exact, so this gives the same result as testing 'less than' directly.)
+    alignas(32) float signs[V::Count];
+    for (int lane = 0; lane < V::Count; ++lane) {
+        signs[lane] = thresholds[lane] >= 0.0f ? 1.0f : -1.0f;
+    }
+    const T sign = V::load(signs);
+    const T limit = V::mul(sign, V::load(thresholds));
+
+    for (int frame = 0; frame < numFrames; ++frame) {
+        crossingMasks[frame] = (uint8_t) V::greaterMask(V::mul(sign, V::load(&highOut[frame * V::Count])), limit);
+    }
+}
+
+// Instruction-set-specific entry points, one instantiation per kernel configuration.
+#if defined(RHX_SIMD_AVX2)
+struct AVX2Entry
+{
+    template <bool Notch, int LowStages, int HighStages>
+    RHX_TARGET_AVX2 RHX_FLATTEN static void filter(const LaneBiquad& notch, const LaneBiquad* low, const LaneBiquad* high,
+                                                   const uint16_t* rawBlock, int wordsPerFrame, int numFrames,
+                                                   const int* rawOffsets, float* prevLast2, float* wideOut,
+                                                   float* lowOut, float* highOut)
+    {
+        filterKernel<AVX2Lanes, Notch, LowStages, HighStages>(notch, low, high, rawBlock, wordsPerFrame, numFrames,
+                                                              rawOffsets, prevLast2, wideOut, lowOut, highOut);
+    }
+
+    RHX_TARGET_AVX2 RHX_FLATTEN static void findCrossings(const float* highOut, int numFrames, const float* thresholds,
+                                                          uint8_t* crossingMasks)
+    {
+        crossingKernel<AVX2Lanes>(highOut, numFrames, thresholds, crossingMasks);
+    }
+};
+#endif
+
+template <class V>
+struct BaselineEntry
+{
+    template <bool Notch, int LowStages, int HighStages>
+    static void filter(const LaneBiquad& notch, const LaneBiquad* low, const LaneBiquad* high,
+                       const uint16_t* rawBlock, int wordsPerFrame, int numFrames, const int* rawOffsets,
+                       float* prevLast2, float* wideOut, float* lowOut, float* highOut)
+    {
+        filterKernel<V, Notch, LowStages, HighStages>(notch, low, high, rawBlock, wordsPerFrame, numFrames,
+                                                      rawOffsets, prevLast2, wideOut, lowOut, highOut);
+    }
+
+    static void findCrossings(const float* highOut, int numFrames, const float* thresholds, uint8_t* crossingMasks)
+    {
+        crossingKernel<V>(highOut, numFrames, thresholds, crossingMasks);
+    }
+};
+
+// Map run-time filter settings onto the matching compile-time instantiation of Entry::filter.
+template <class Entry, bool Notch, int LowStages>
+static ChannelLaneFilter::Kernel selectHighStages(int numHighStages)
+{
+    switch (numHighStages) {
+    case 1: return &Entry::template filter<Notch, LowStages, 1>;
+    case 2: return &Entry::template filter<Notch, LowStages, 2>;
+    case 3: return &Entry::template filter<Notch, LowStages, 3>;
+    case 4: return &Entry::template filter<Notch, LowStages, 4>;
+    default: return nullptr;
+    }
+}
+
+template <class Entry, bool Notch>
+static ChannelLaneFilter::Kernel selectLowStages(int numLowStages, int numHighStages)
+{
+    switch (numLowStages) {
+    case 0: return selectHighStages<Entry, Notch, 0>(numHighStages);
+    case 1: return selectHighStages<Entry, Notch, 1>(numHighStages);
+    case 2: return selectHighStages<Entry, Notch, 2>(numHighStages);
+    case 3: return selectHighStages<Entry, Notch, 3>(numHighStages);
+    case 4: return selectHighStages<Entry, Notch, 4>(numHighStages);
+    default: return nullptr;
+    }
+}
+
+template <class Entry>
+static ChannelLaneFilter::Kernel selectKernel(bool notchEnabled, int numLowStages, int numHighStages)
+{
+    return notchEnabled ? selectLowStages<Entry, true>(numLowStages, numHighStages) :
+                          selectLowStages<Entry, false>(numLowStages, numHighStages);
+}
+
+bool ChannelLaneFilter::supported(InstructionSet instructionSet)
+{
+    if (instructionSet == AVX2) {
+#if defined(RHX_SIMD_AVX2)
+        return cpuSupportsAVX2();
+#else
+        return false;
+#endif
+    }
+#if defined(RHX_SIMD_SSE2) || defined(RHX_SIMD_NEON)
+    return true;
+#else
+    return false;
+#endif
+}
+
+ChannelLaneFilter::InstructionSet ChannelLaneFilter::bestInstructionSet()
+{
+    return supported(AVX2) ? AVX2 : Baseline;
+}
+
+const char* ChannelLaneFilter::instructionSetName(InstructionSet instructionSet)
+{
+    if (instructionSet == AVX2) return "AVX2";
+#if defined(RHX_SIMD_NEON)
+    return "NEON";
+#else
+    return "SSE2";
+#endif
+}
+
+int ChannelLaneFilter::lanes(InstructionSet instructionSet)
+{
+    if (!supported(instructionSet)) return 1;
+#if defined(RHX_SIMD_AVX2)
+    if (instructionSet == AVX2) return AVX2Lanes::Count;
+#endif
+#if defined(RHX_SIMD_SSE2)
+    return SSE2Lanes::Count;
+#elif defined(RHX_SIMD_NEON)
+    return NEONLanes::Count;
+#else
+    return 1;
+#endif
+}
+
+ChannelLaneFilter::Kernel ChannelLaneFilter::kernel(InstructionSet instructionSet, bool notchEnabled, int numLowStages,
+                                                    int numHighStages)
+{
+    if (!supported(instructionSet)) return nullptr;
+#if defined(RHX_SIMD_AVX2)
+    if (instructionSet == AVX2) return selectKernel<AVX2Entry>(notchEnabled, numLowStages, numHighStages);
+#endif
+#if defined(RHX_SIMD_SSE2)
+    return selectKernel<BaselineEntry<SSE2Lanes> >(notchEnabled, numLowStages, numHighStages);
+#elif defined(RHX_SIMD_NEON)
+    return selectKernel<BaselineEntry<NEONLanes> >(notchEnabled, numLowStages, numHighStages);
+#else
+    (void) notchEnabled; (void) numLowStages; (void) numHighStages;
+    return nullptr;
+#endif
+}
+
+void ChannelLaneFilter::findCrossings(InstructionSet instructionSet, const float* highOut, int numFrames,
+                                      const float* thresholds, uint8_t* crossingMasks)
+{
+#if defined(RHX_SIMD_AVX2)
+    if (instructionSet == AVX2) {
+        AVX2Entry::findCrossings(highOut, numFrames, thresholds, crossingMasks);
+        return;
+    }
+#else
+    (void) instructionSet;
+#endif
+#if defined(RHX_SIMD_SSE2)
+    BaselineEntry<SSE2Lanes>::findCrossings(highOut, numFrames, thresholds, crossingMasks);
+#elif defined(RHX_SIMD_NEON)
+    BaselineEntry<NEONLanes>::findCrossings(highOut, numFrames, thresholds, crossingMasks);
+#else
+    (void) highOut; (void) numFrames; (void) thresholds; (void) crossingMasks;
+#endif
+}
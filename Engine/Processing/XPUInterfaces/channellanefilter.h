@@ -0,0 +1,96 @@
+//------------------------------------------------------------------------------
+//
+//  Intan Technologies RHX Data Acquisition Software
+//  Version 3.4.0
+//
+//  Copyright (c) 2020-2025 Intan Technologies
+//
+//  This file is part of the Intan Technologies RHX Data Acquisition Software.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published
+//  by the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//  This software is provided 'as-is', without any express or implied warranty.
+//  In no event will the authors be held liable for any damages arising from
+//  the use of this software.
+//
+//  See <http://www.intantech.com> for documentation and product information.
+//
+//------------------------------------------------------------------------------
+
+#ifndef CHANNELLANEFILTER_H
+#define CHANNELLANEFILTER_H
+
+#include <cstdint>
+
+// Biquad coefficients, in the order used by the CPU and GPU filter kernels.
+struct LaneBiquad
+{
+    float b2;
+    float b1;
+    float b0;
+    float a2;
+    float a1;
+};
+
+// Notch filter followed by low-pass and high-pass biquad cascades, evaluated for a group of adjacent amplifier
+// channels at once, one channel per SIMD lane (8 lanes with AVX2, 4 with SSE2 or NEON).  The arithmetic is done in
+// the same order as the per-channel code in CPUInterface, so results match it exactly unless the compiler fuses
+// multiplies and adds in one of them.  CPUInterface::speedTest() checks every kernel before using any.
+class ChannelLaneFilter
+{
+public:
+    static const int MaxLanes = 8;
+    static const int StateFloatsPerChannel = 20;  // layout of AbstractXPUInterface::prevLast2
+    static constexpr float WideStateLimit = 6389.0f;  // CPUInterface output range, also applied to saved wide-band state
+
+    // Instruction sets kernels are compiled for: the processor's baseline (SSE2 or NEON) and, on x86, AVX2.
+    enum InstructionSet {
+        Baseline,
+        AVX2
+    };
+
+    // Filter numFrames frames of rawBlock for lanes() channels.  rawOffsets[lane] gives the word offset of each
+    // channel's sample within a frame.  Filter state is read from and written back to prevLast2, which holds
+    // StateFloatsPerChannel values for each channel.  Outputs are written frame-major: out[frame * lanes() + lane].
+    // Each kernel is compiled for one notch setting and one number of low-pass and high-pass stages, so its stage
+    // loops are fully unrolled and only the coefficients of the stages it uses are read from low and high.
+    typedef void (*Kernel)(const LaneBiquad& notch, const LaneBiquad* low, const LaneBiquad* high,
+                           const uint16_t* rawBlock, int wordsPerFrame, int numFrames, const int* rawOffsets,
+                           float* prevLast2, float* wideOut, float* lowOut, float* highOut);
+
+    // True if kernels for instructionSet were compiled and this processor supports them.
+    static bool supported(InstructionSet instructionSet);
+
+    // Fastest supported instruction set (Baseline if none is supported; lanes() is then 1).
+    static InstructionSet bestInstructionSet();
+
+    static const char* instructionSetName(InstructionSet instructionSet);
+
+    // Number of channels filtered together with instructionSet, or 1 if it is not supported.
+    static int lanes(InstructionSet instructionSet);
+
+    // Return the kernel for instructionSet with the notch filter enabled or bypassed, numLowStages (0 to 4; with
+    // 0, the low-pass output is the wideband signal) low-pass stages and numHighStages (1 to 4) high-pass stages.
+    // Returns nullptr if instructionSet is not supported or the number of stages is out of range.
+    static Kernel kernel(InstructionSet instructionSet, bool notchEnabled, int numLowStages, int numHighStages);
+
+    // Compare numFrames frames of a kernel's highOut against each lane's spike threshold.  Bit 'lane' of
+    // crossingMasks[frame] is set if that channel's sample is above its threshold (for thresholds >= 0) or below it
+    // (for negative thresholds), the same test as CPUInterface's spike search.  instructionSet must be the one the
+    // kernel was selected for.
+    static void findCrossings(InstructionSet instructionSet, const float* highOut, int numFrames,
+                              const float* thresholds, uint8_t* crossingMasks);
+};
+
+#endif // CHANNELLANEFILTER_H
@@ -28,10 +28,56 @@
 //
 //------------------------------------------------------------------------------
 
+#include <thread>
+#include <limits>
+#include <algorithm>
+#include <vector>
+#include <chrono>
+#include <sstream>
+#include <cstdlib>
+#include "simdsupport.h"
 #include "cpuinterface.h"
 
+// Channels are divided among worker threads in groups of this size, so threads never write to the same cache lines
+// of the output chunks.
+const int ChannelsPerWorkUnit = 32;
+
+// Spike search positions threshS run from -SnippetSize (in the previous block) to FramesPerBlock - SnippetSize - 1.
+// Positions where the threshold is surpassed are marked in a bitmask, bit threshS + SnippetSize.
+const int CrossingMaskWords = (FramesPerBlock + 31) / 32;
+
+static inline bool surpassesThreshold(float sample, float threshold)
+{
+    return (threshold >= 0) ? (sample > threshold) : (sample < threshold);
+}
+
+static inline void setCrossing(uint32_t* crossings, int threshS)
+{
+    int bit = threshS + SnippetSize;
+    crossings[bit / 32] |= 1u << (bit % 32);
+}
+
+// Return the first marked search position at or after threshS, or FramesPerBlock - SnippetSize if there is none.
+static inline int nextCrossing(const uint32_t* crossings, int threshS)
+{
+    int bit = threshS + SnippetSize;
+    int word = bit / 32;
+    if (word >= CrossingMaskWords) return FramesPerBlock - SnippetSize;
+    uint32_t bits = crossings[word] & (~0u << (bit % 32));
+    while (bits == 0) {
+        if (++word == CrossingMaskWords) return FramesPerBlock - SnippetSize;
+        bits = crossings[word];
+    }
+    return word * 32 + countTrailingZeros(bits) - SnippetSize;
+}
+
 CPUInterface::CPUInterface(SystemState *state_, QObject *parent) :
-    AbstractXPUInterface(state_, parent)
+    AbstractXPUInterface(state_, parent),
+    threadScheduler(nullptr),
+    laneInstructionSet(ChannelLaneFilter::bestInstructionSet()),
+    useLaneFilter(ChannelLaneFilter::lanes(laneInstructionSet) > 1),
+    laneKernel(nullptr),
+    laneKernelNoLowpass(nullptr)
 {
     updateFromState();
 }
@@ -45,15 +91,62 @@ CPUInterface::~CPUInterface()
 
 void CPUInterface::processDataBlock(uint16_t * data, uint16_t *lowChunk, uint16_t *wideChunk, uint16_t *highChunk,
                                     uint32_t *spikeChunk, uint8_t *spikeIDChunk)
+{
+    processDataBlocks(data, 1, lowChunk, wideChunk, highChunk, spikeChunk, spikeIDChunk);
+}
+
+void CPUInterface::processDataBlocks(uint16_t* data, int numBlocks, uint16_t* lowChunk, uint16_t* wideChunk,
+                                     uint16_t* highChunk, uint32_t* spikeChunk, uint8_t* spikeIDChunk)
 {
     std::lock_guard<std::mutex> lockFilter(filterMutex);
 
-    if (channels == 0)
+    if (channels == 0 || numBlocks < 1)
         return;
 
-    uint16_t* rawBlock = data;
+    const int samplesPerBlock = FramesPerBlock * channels;
+    const int spikesPerBlock = SnippetsPerBlock * channels;
+    const int numActiveChannels = (int) activeChannels.size();
+
+    // Per-channel filter and spike detector state is indexed by channel, so channels can be processed independently.
+    // Split the enabled channels across the worker pool; each part runs its channels through every block in turn, so
+    // the pool is only synchronized once per call.  run() returns when all channels are done.
+    const int numWorkUnits = (numActiveChannels + ChannelsPerWorkUnit - 1) / ChannelsPerWorkUnit;
+    if (numWorkUnits > 0) {
+        workerPool.run([&](int part, int numParts) {
+            int firstActive = std::min(numActiveChannels, ChannelsPerWorkUnit * ((numWorkUnits * part) / numParts));
+            int lastActive = std::min(numActiveChannels, ChannelsPerWorkUnit * ((numWorkUnits * (part + 1)) / numParts));
+            if (lastActive <= firstActive) return;
+            const uint16_t* prevHigh = parsedPrevHigh;
+            for (int block = 0; block < numBlocks; ++block) {
+                uint16_t* blockHigh = &highChunk[block * samplesPerBlock];
+                processChannels(firstActive, lastActive, &data[block * wordsPerBlock], &lowChunk[block * samplesPerBlock],
+                                &wideChunk[block * samplesPerBlock], blockHigh, &spikeChunk[block * spikesPerBlock],
+                                &spikeIDChunk[block * spikesPerBlock], prevHigh);
+                prevHigh = &blockHigh[(FramesPerBlock - SnippetSize) * channels];
+            }
+        });
+    }
 
-    float samplePeriod = 1.0f / sampleRate;
+    // Disabled channels aren't filtered; give them zero waveforms and no spikes.
+    if (!inactiveChannels.empty()) {
+        for (int block = 0; block < numBlocks; ++block) {
+            clearInactiveOutputs(&lowChunk[block * samplesPerBlock], &wideChunk[block * samplesPerBlock],
+                                 &highChunk[block * samplesPerBlock], &spikeChunk[block * spikesPerBlock],
+                                 &spikeIDChunk[block * spikesPerBlock]);
+        }
+    }
+
+    // Set the last 50 samples of high to parsedPrevHigh so that they can be used in the next data block
+//    memcpy(parsedPrevHigh, &highChunk[(FramesPerBlock - SnippetSize) * channels], SnippetSize * sizeof(uint16_t));
+    parsedPrevHigh = &highChunk[(numBlocks - 1) * samplesPerBlock + (FramesPerBlock - SnippetSize) * channels];
+}
+
+// Filter and detect spikes on amplifier channels activeChannels[firstActive] ... activeChannels[lastActive - 1].  This
+// may be called from several worker threads at once, for non-overlapping ranges.
+void CPUInterface::processChannels(int firstActive, int lastActive, uint16_t* data, uint16_t* lowChunk, uint16_t* wideChunk,
+                                   uint16_t* highChunk, uint32_t* spikeChunk, uint8_t* spikeIDChunk, const uint16_t* prevHigh)
+{
+    uint16_t* rawBlock = data;
 
     float notchB2 = filterParameters.notchParams.b2;
     float notchB1 = filterParameters.notchParams.b1;
@@ -120,9 +213,37 @@ void CPUInterface::processDataBlock(uint16_t * data, uint16_t *lowChunk, uint16_
     float high2ndToLast[4];
     float highLast[4];
 
-    for (int channelIndex = 0; channelIndex < channels; channelIndex++) {
+    int numLowFilterIterations = floor((float)(filterParameters.lowOrder - 1) / 2.0f) + 1;
+    int numHighFilterIterations = floor((float)(filterParameters.highOrder - 1) / 2.0f) + 1;
+
+    LaneBiquad notch = { notchB2, notchB1, notchB0, notchA2, notchA1 };
+    LaneBiquad low[4], high[4];
+    for (int filterIndex = 0; filterIndex < 4; ++filterIndex) {
+        low[filterIndex] = { lowB2[filterIndex], lowB1[filterIndex], lowB0[filterIndex], lowA2[filterIndex], lowA1[filterIndex] };
+        high[filterIndex] = { highB2[filterIndex], highB1[filterIndex], highB0[filterIndex], highA2[filterIndex], highA1[filterIndex] };
+    }
+
+    const int numLanes = useLaneFilter ? ChannelLaneFilter::lanes(laneInstructionSet) : 1;
+    float laneWide[FramesPerBlock * ChannelLaneFilter::MaxLanes];
+    float laneLow[FramesPerBlock * ChannelLaneFilter::MaxLanes];
+    float laneHigh[FramesPerBlock * ChannelLaneFilter::MaxLanes];
+    uint8_t laneCrossings[FramesPerBlock];
+    int laneGroupStart = 0;
+    int laneGroupEnd = 0;
+
+    for (int activeIndex = firstActive; activeIndex < lastActive; activeIndex++) {
+        const int channelIndex = activeChannels[activeIndex];
         uint32_t lastDataStart = channelIndex * 20;
 
+        // Skip the low-pass cascade and any band outputs that no WaveformFifo reader needs.  (The high-pass output
+        // is always needed for spike detection.)
+        const bool needLow = (bandDemand[channelIndex] & WaveformFifo::BandLow) != 0;
+        const bool needWide = (bandDemand[channelIndex] & WaveformFifo::BandWide) != 0;
+        if (needLow && !lowpassStateCurrent[channelIndex]) {
+            seedLowpassState(channelIndex, numLowFilterIterations);
+            lowpassStateCurrent[channelIndex] = 1;
+        }
+
         for (int i = 0; i < 4; ++i) {
             low2ndToLastIndex[i] = lastDataStart + i;
             lowLastIndex[i] = lastDataStart + 4 + i;
@@ -156,353 +277,283 @@ void CPUInterface::processDataBlock(uint16_t * data, uint16_t *lowChunk, uint16_
         }
 
         for (s = 0; s < SnippetSize; ++s) {
-            prevHighFloat[s] = (float) (0.195f * (((double)parsedPrevHigh[s * channels + channelIndex]) - 32768));
+            prevHighFloat[s] = (float) (0.195f * (((double)prevHigh[s * channels + channelIndex]) - 32768));
         }
 
-        int32_t inIndexStream, inIndexChannel;
-        if (type == ControllerRecordUSB2 || type == ControllerRecordUSB3) {
-            inIndexStream = channelIndex / 32;
-            inIndexChannel = channelIndex % 32;
-        } else {
-            inIndexStream = channelIndex / 16;
-            inIndexChannel = channelIndex % 16;
-        }
+        float filteredHigh[FramesPerBlock];
+        float filteredLow[FramesPerBlock];
 
-        // (0) Index this channel's input data from the rawBlock and convert it to float.
-        for (int frame = 0; frame < FramesPerBlock; ++frame) {
-            uint16_t acSample;
-            if (type == ControllerStimRecord) {
-                acSample = rawBlock[wordsPerFrame * frame + 6 + (numStreams * 3 * 2) +
-                        (inIndexChannel * numStreams * 2) + (2 * inIndexStream + 1)];
-            } else {
-                acSample = rawBlock[wordsPerFrame * frame + 6 + (numStreams * 3) +
-                        inIndexChannel * numStreams + inIndexStream];
+        // Filter groups of adjacent enabled channels together with the SIMD kernel where possible.
+        if (numLanes > 1 && laneKernel && channelIndex >= laneGroupEnd && activeIndex + numLanes <= lastActive &&
+                activeChannels[activeIndex + numLanes - 1] == channelIndex + numLanes - 1) {
+            int rawOffsets[ChannelLaneFilter::MaxLanes];
+            float laneThresholds[ChannelLaneFilter::MaxLanes];
+            bool groupNeedsLow = false;
+            for (int lane = 0; lane < numLanes; ++lane) {
+                rawOffsets[lane] = rawWordOffset(channelIndex + lane);
+                laneThresholds[lane] = hoops[channelIndex + lane].threshold;
+                if (bandDemand[channelIndex + lane] & WaveformFifo::BandLow) groupNeedsLow = true;
             }
-            inFloat[frame] = (float)(0.195f * (((double)acSample) - 32768));
+            // The low-pass cascade runs for the whole group or not at all.
+            for (int lane = 0; lane < numLanes; ++lane) {
+                if (groupNeedsLow && !lowpassStateCurrent[channelIndex + lane]) {
+                    seedLowpassState(channelIndex + lane, numLowFilterIterations);
+                }
+                lowpassStateCurrent[channelIndex + lane] = groupNeedsLow;
+            }
+            ChannelLaneFilter::Kernel kernel = groupNeedsLow ? laneKernel : laneKernelNoLowpass;
+            kernel(notch, low, high, rawBlock, wordsPerFrame, FramesPerBlock, rawOffsets, &prevLast2[lastDataStart],
+                   laneWide, laneLow, laneHigh);
+            ChannelLaneFilter::findCrossings(laneInstructionSet, laneHigh, FramesPerBlock - SnippetSize, laneThresholds,
+                                             laneCrossings);
+            laneGroupStart = channelIndex;
+            laneGroupEnd = channelIndex + numLanes;
         }
+        bool laneFiltered = channelIndex < laneGroupEnd;
+
+        if (laneFiltered) {
+            int lane = channelIndex - laneGroupStart;
+            for (s = 0; s < FramesPerBlock; ++s) {
+                wideFloat[s] = laneWide[s * numLanes + lane];
+                filteredLow[s] = laneLow[s * numLanes + lane];
+                filteredHigh[s] = laneHigh[s * numLanes + lane];
+            }
+        } else {
+            int32_t inIndexStream, inIndexChannel;
+            if (type == ControllerRecordUSB2 || type == ControllerRecordUSB3) {
+                inIndexStream = channelIndex / 32;
+                inIndexChannel = channelIndex % 32;
+            } else {
+                inIndexStream = channelIndex / 16;
+                inIndexChannel = channelIndex % 16;
+            }
 
-        int numLowFilterIterations = floor((float)(filterParameters.lowOrder - 1) / 2.0f) + 1;
-        int numHighFilterIterations = floor((float)(filterParameters.highOrder - 1) / 2.0f) + 1;
-
-        // s == 0 condition
-        // (1) IIR notch filter into wideFloat
-
-        wideFloat[0] = notchB2 * in2ndToLast + notchB1 * inLast + notchB0 * inFloat[0] - notchA2 * wide2ndToLast -
-                notchA1 * wideLast;
-
-        // (2) IIR Nth-order low-pass
-        // 1st iteration: use wideFloat as input
-        lowFloat[0][0] = lowB2[0] * wide2ndToLast + lowB1[0] * wideLast + lowB0[0] * wideFloat[0] -
-                lowA2[0] * low2ndToLast[0] - lowA1[0] * lowLast[0];
-
-        // All other iterations: use lowFloat[filterIndex - 1] as input.
-        for (uint8_t filterIndex = 1; filterIndex < numLowFilterIterations; ++filterIndex) {
-            lowFloat[filterIndex][0] = lowB2[filterIndex] * low2ndToLast[filterIndex - 1] +
-                    lowB1[filterIndex] * lowLast[filterIndex - 1] +
-                    lowB0[filterIndex] * lowFloat[filterIndex - 1][0] -
-                    lowA2[filterIndex] * low2ndToLast[filterIndex] -
-                    lowA1[filterIndex] * lowLast[filterIndex];
-        }
+            // (0) Index this channel's input data from the rawBlock and convert it to float.
+            for (int frame = 0; frame < FramesPerBlock; ++frame) {
+                uint16_t acSample;
+                if (type == ControllerStimRecord) {
+                    acSample = rawBlock[wordsPerFrame * frame + 6 + (numStreams * 3 * 2) +
+                            (inIndexChannel * numStreams * 2) + (2 * inIndexStream + 1)];
+                } else {
+                    acSample = rawBlock[wordsPerFrame * frame + 6 + (numStreams * 3) +
+                            inIndexChannel * numStreams + inIndexStream];
+                }
+                inFloat[frame] = (float)(0.195f * (((double)acSample) - 32768));
+            }
 
-        // (3) IIR Nth-order high-pass
-        // 1st iteration: use wideFloat as input.
+            // s == 0 condition
+            // (1) IIR notch filter into wideFloat
 
-        highFloat[0][0] = highB2[0] * wide2ndToLast + highB1[0] * wideLast + highB0[0] * wideFloat[0] -
-                highA2[0] * high2ndToLast[0] - highA1[0] * highLast[0];
+            wideFloat[0] = notchB2 * in2ndToLast + notchB1 * inLast + notchB0 * inFloat[0] - notchA2 * wide2ndToLast -
+                    notchA1 * wideLast;
 
-        // All other iterations: use highFloat[filterIndex - 1] as input.
-        for (uint8_t filterIndex = 1; filterIndex < numHighFilterIterations; ++filterIndex) {
-            highFloat[filterIndex][0] = highB2[filterIndex] * high2ndToLast[filterIndex - 1] +
-                    highB1[filterIndex] * highLast[filterIndex - 1] +
-                    highB0[filterIndex] * highFloat[filterIndex - 1][0] -
-                    highA2[filterIndex] * high2ndToLast[filterIndex] -
-                    highA1[filterIndex] * highLast[filterIndex];
-        }
+            // (2) IIR Nth-order low-pass
+            if (needLow) {
+                // 1st iteration: use wideFloat as input
+                lowFloat[0][0] = lowB2[0] * wide2ndToLast + lowB1[0] * wideLast + lowB0[0] * wideFloat[0] -
+                        lowA2[0] * low2ndToLast[0] - lowA1[0] * lowLast[0];
+
+                // All other iterations: use lowFloat[filterIndex - 1] as input.
+                for (uint8_t filterIndex = 1; filterIndex < numLowFilterIterations; ++filterIndex) {
+                    lowFloat[filterIndex][0] = lowB2[filterIndex] * low2ndToLast[filterIndex - 1] +
+                            lowB1[filterIndex] * lowLast[filterIndex - 1] +
+                            lowB0[filterIndex] * lowFloat[filterIndex - 1][0] -
+                            lowA2[filterIndex] * low2ndToLast[filterIndex] -
+                            lowA1[filterIndex] * lowLast[filterIndex];
+                }
+            }
 
-        // s == 1 condition
-        // (1) IIR notch filter into wideFloat
-        wideFloat[1] = notchB2 * inLast + notchB1 * inFloat[0] + notchB0 * inFloat[1] - notchA2 * wideLast -
-                notchA1 * wideFloat[0];
-
-        // (2) IIR Nth-order low-pass
-        // 1st iteration: use wideFloat as input.
-        lowFloat[0][1] = lowB2[0] * wideLast + lowB1[0] * wideFloat[0] + lowB0[0] * wideFloat[1] -
-                lowA2[0] * lowLast[0] - lowA1[0] * lowFloat[0][0];
-
-        // All other iterations: use lowFloat[filterIndex - 1] as input.
-        for (uint8_t filterIndex = 1; filterIndex < numLowFilterIterations; ++filterIndex) {
-            lowFloat[filterIndex][1] = lowB2[filterIndex] * lowLast[filterIndex - 1] +
-                    lowB1[filterIndex] * lowFloat[filterIndex - 1][0] +
-                    lowB0[filterIndex] * lowFloat[filterIndex - 1][1] -
-                    lowA2[filterIndex] * lowLast[filterIndex] -
-                    lowA1[filterIndex] * lowFloat[filterIndex][0];
-        }
+            // (3) IIR Nth-order high-pass
+            // 1st iteration: use wideFloat as input.
 
-        // (3) IIR Nth-order high-pass
-        // 1st iteration: use wideFloat as input.
-        highFloat[0][1] = highB2[0] * wideLast + highB1[0] * wideFloat[0] + highB0[0] * wideFloat[1] -
-                highA2[0] * highLast[0] - highA1[0] * highFloat[0][0];
-
-        // All other iterations: use highFloat[filterIndex - 1] as input.
-        for (uint8_t filterIndex = 1; filterIndex < numHighFilterIterations; ++filterIndex) {
-            highFloat[filterIndex][1] = highB2[filterIndex] * highLast[filterIndex - 1] +
-                    highB1[filterIndex] * highFloat[filterIndex - 1][0] +
-                    highB0[filterIndex] * highFloat[filterIndex - 1][1] -
-                    highA2[filterIndex] * highLast[filterIndex] -
-                    highA1[filterIndex] * highFloat[filterIndex][0];
-        }
+            highFloat[0][0] = highB2[0] * wide2ndToLast + highB1[0] * wideLast + highB0[0] * wideFloat[0] -
+                    highA2[0] * high2ndToLast[0] - highA1[0] * highLast[0];
 
-        for (s = 2; s < FramesPerBlock; ++s) {
+            // All other iterations: use highFloat[filterIndex - 1] as input.
+            for (uint8_t filterIndex = 1; filterIndex < numHighFilterIterations; ++filterIndex) {
+                highFloat[filterIndex][0] = highB2[filterIndex] * high2ndToLast[filterIndex - 1] +
+                        highB1[filterIndex] * highLast[filterIndex - 1] +
+                        highB0[filterIndex] * highFloat[filterIndex - 1][0] -
+                        highA2[filterIndex] * high2ndToLast[filterIndex] -
+                        highA1[filterIndex] * highLast[filterIndex];
+            }
 
+            // s == 1 condition
             // (1) IIR notch filter into wideFloat
-            wideFloat[s] = notchB2 * inFloat[s - 2] + notchB1 * inFloat[s - 1] + notchB0 * inFloat[s] -
-                    notchA2 * wideFloat[s - 2] - notchA1 * wideFloat[s - 1];
+            wideFloat[1] = notchB2 * inLast + notchB1 * inFloat[0] + notchB0 * inFloat[1] - notchA2 * wideLast -
+                    notchA1 * wideFloat[0];
 
             // (2) IIR Nth-order low-pass
-            // 1st iteration: use wideFloat as input.
-            lowFloat[0][s] = lowB2[0] * wideFloat[s - 2] + lowB1[0] * wideFloat[s - 1] + lowB0[0] * wideFloat[s] -
-                    lowA2[0] * lowFloat[0][s - 2] - lowA1[0] * lowFloat[0][s - 1];
-
-            // All other iterations: use lowfloat[filterIndex - 1] as input.
-            for (uint8_t filterIndex = 1; filterIndex < numLowFilterIterations; ++filterIndex) {
-                lowFloat[filterIndex][s] = lowB2[filterIndex] * lowFloat[filterIndex - 1][s - 2] +
-                        lowB1[filterIndex] * lowFloat[filterIndex - 1][s - 1] +
-                        lowB0[filterIndex] * lowFloat[filterIndex - 1][s] -
-                        lowA2[filterIndex] * lowFloat[filterIndex][s - 2] -
-                        lowA1[filterIndex] * lowFloat[filterIndex][s - 1];
+            if (needLow) {
+                // 1st iteration: use wideFloat as input.
+                lowFloat[0][1] = lowB2[0] * wideLast + lowB1[0] * wideFloat[0] + lowB0[0] * wideFloat[1] -
+                        lowA2[0] * lowLast[0] - lowA1[0] * lowFloat[0][0];
+
+                // All other iterations: use lowFloat[filterIndex - 1] as input.
+                for (uint8_t filterIndex = 1; filterIndex < numLowFilterIterations; ++filterIndex) {
+                    lowFloat[filterIndex][1] = lowB2[filterIndex] * lowLast[filterIndex - 1] +
+                            lowB1[filterIndex] * lowFloat[filterIndex - 1][0] +
+                            lowB0[filterIndex] * lowFloat[filterIndex - 1][1] -
+                            lowA2[filterIndex] * lowLast[filterIndex] -
+                            lowA1[filterIndex] * lowFloat[filterIndex][0];
+                }
             }
 
             // (3) IIR Nth-order high-pass
             // 1st iteration: use wideFloat as input.
-            highFloat[0][s] = highB2[0] * wideFloat[s - 2] + highB1[0] * wideFloat[s - 1] + highB0[0] * wideFloat[s] -
-                    highA2[0] * highFloat[0][s - 2] - highA1[0] * highFloat[0][s - 1];
+            highFloat[0][1] = highB2[0] * wideLast + highB1[0] * wideFloat[0] + highB0[0] * wideFloat[1] -
+                    highA2[0] * highLast[0] - highA1[0] * highFloat[0][0];
 
             // All other iterations: use highFloat[filterIndex - 1] as input.
             for (uint8_t filterIndex = 1; filterIndex < numHighFilterIterations; ++filterIndex) {
-                highFloat[filterIndex][s] = highB2[filterIndex] * highFloat[filterIndex - 1][s - 2] +
-                        highB1[filterIndex] * highFloat[filterIndex - 1][s - 1] +
-                        highB0[filterIndex] * highFloat[filterIndex - 1][s] -
-                        highA2[filterIndex] * highFloat[filterIndex][s - 2] -
-                        highA1[filterIndex] * highFloat[filterIndex][s - 1];
+                highFloat[filterIndex][1] = highB2[filterIndex] * highLast[filterIndex - 1] +
+                        highB1[filterIndex] * highFloat[filterIndex - 1][0] +
+                        highB0[filterIndex] * highFloat[filterIndex - 1][1] -
+                        highA2[filterIndex] * highLast[filterIndex] -
+                        highA1[filterIndex] * highFloat[filterIndex][0];
             }
-        }
 
-        float filteredHigh[FramesPerBlock];
-        float filteredLow[FramesPerBlock];
+            for (s = 2; s < FramesPerBlock; ++s) {
+
+                // (1) IIR notch filter into wideFloat
+                wideFloat[s] = notchB2 * inFloat[s - 2] + notchB1 * inFloat[s - 1] + notchB0 * inFloat[s] -
+                        notchA2 * wideFloat[s - 2] - notchA1 * wideFloat[s - 1];
+
+                // (2) IIR Nth-order low-pass
+                if (needLow) {
+                    // 1st iteration: use wideFloat as input.
+                    lowFloat[0][s] = lowB2[0] * wideFloat[s - 2] + lowB1[0] * wideFloat[s - 1] + lowB0[0] * wideFloat[s] -
+                            lowA2[0] * lowFloat[0][s - 2] - lowA1[0] * lowFloat[0][s - 1];
+
+                    // All other iterations: use lowfloat[filterIndex - 1] as input.
+                    for (uint8_t filterIndex = 1; filterIndex < numLowFilterIterations; ++filterIndex) {
+                        lowFloat[filterIndex][s] = lowB2[filterIndex] * lowFloat[filterIndex - 1][s - 2] +
+                                lowB1[filterIndex] * lowFloat[filterIndex - 1][s - 1] +
+                                lowB0[filterIndex] * lowFloat[filterIndex - 1][s] -
+                                lowA2[filterIndex] * lowFloat[filterIndex][s - 2] -
+                                lowA1[filterIndex] * lowFloat[filterIndex][s - 1];
+                    }
+                }
 
-        for (int s = 0; s < FramesPerBlock; ++s) {
-            filteredHigh[s] = highFloat[numHighFilterIterations - 1][s];
-            filteredLow[s] = lowFloat[numLowFilterIterations - 1][s];
+                // (3) IIR Nth-order high-pass
+                // 1st iteration: use wideFloat as input.
+                highFloat[0][s] = highB2[0] * wideFloat[s - 2] + highB1[0] * wideFloat[s - 1] + highB0[0] * wideFloat[s] -
+                        highA2[0] * highFloat[0][s - 2] - highA1[0] * highFloat[0][s - 1];
+
+                // All other iterations: use highFloat[filterIndex - 1] as input.
+                for (uint8_t filterIndex = 1; filterIndex < numHighFilterIterations; ++filterIndex) {
+                    highFloat[filterIndex][s] = highB2[filterIndex] * highFloat[filterIndex - 1][s - 2] +
+                            highB1[filterIndex] * highFloat[filterIndex - 1][s - 1] +
+                            highB0[filterIndex] * highFloat[filterIndex - 1][s] -
+                            highA2[filterIndex] * highFloat[filterIndex][s - 2] -
+                            highA1[filterIndex] * highFloat[filterIndex][s - 1];
+                }
+            }
+
+            for (int s = 0; s < FramesPerBlock; ++s) {
+                filteredHigh[s] = highFloat[numHighFilterIterations - 1][s];
+            }
+            if (needLow) {
+                for (int s = 0; s < FramesPerBlock; ++s) {
+                    filteredLow[s] = lowFloat[numLowFilterIterations - 1][s];
+                }
+            }
+            lowpassStateCurrent[channelIndex] = needLow;
         }
 
         // Across this block, look for any valid rectangle and look back to this block and the previous block to
         // determine valid t0. Add earliest t0 for each rectangle to 'spike' output.
         snippetIndex = 0;
 
+        // Mark each search position threshS at which the threshold was surpassed, looking to both this data block and
+        // the previous block, so the search below only visits those positions.
+        uint32_t crossings[CrossingMaskWords] = {};
+        for (s = 0; s < SnippetSize; ++s) {
+            if (surpassesThreshold(prevHighFloat[s], threshold)) setCrossing(crossings, s - SnippetSize);
+        }
+        if (laneFiltered) {
+            const uint8_t laneBit = 1u << (channelIndex - laneGroupStart);
+            for (s = 0; s < FramesPerBlock - SnippetSize; ++s) {
+                if (laneCrossings[s] & laneBit) setCrossing(crossings, s);
+            }
+        } else {
+            for (s = 0; s < FramesPerBlock - SnippetSize; ++s) {
+                if (surpassesThreshold(filteredHigh[s], threshold)) setCrossing(crossings, s);
+            }
+        }
+
         // Start with threshS = startSearchPos[channelIndex]. This is 0 unless the previous data block ended with a spike.
         // In that case, threshS is a non-zero offset to avoid double-detecting a snippet.
-        for (int threshS = startSearchPos[channelIndex] - SnippetSize; threshS < FramesPerBlock - SnippetSize; ++threshS) {
-
-            startSearchPos[channelIndex] = 0;
-
-            // Look to both this data block and the previous block to determine if the threshold was surpassed.
-            bool surpassed = false;
-
-            if (threshold >= 0) {  // If threshold was positive:
-                if (threshS >= 0) {
-                    if (filteredHigh[threshS] > threshold) surpassed = true;
+        int firstThreshS = startSearchPos[channelIndex] - SnippetSize;
+        startSearchPos[channelIndex] = 0;
+        for (int threshS = nextCrossing(crossings, firstThreshS); threshS < FramesPerBlock - SnippetSize;
+             threshS = nextCrossing(crossings, threshS + 1)) {
+
+            // Threshold was surpassed at threshS.
+            // For ease of understanding, move the samples from [threshS, threshS + SnippetSize] to [0, snippetSize].
+            float thisSnippet[FramesPerBlock];
+            for (int i = 0; i < SnippetSize; ++i) {
+                int thisS = threshS + i;
+                if (thisS < 0) {
+                    thisSnippet[i] = prevHighFloat[SnippetSize + thisS];
                 } else {
-                    if (prevHighFloat[SnippetSize + threshS] > threshold) surpassed = true;
-                }
-            } else {  // If threshold was negative:
-                if (threshS >= 0) {
-                    if (filteredHigh[threshS] < threshold) surpassed = true;
-                } else {
-                    if (prevHighFloat[SnippetSize + threshS] < threshold) surpassed = true;
+                    thisSnippet[i] = filteredHigh[thisS];
                 }
             }
 
-            // Threshold was surpassed.
-            if (surpassed) {
-                // For ease of understanding, move the samples from [threshS, threshS + SnippetSize] to [0, snippetSize].
-                float thisSnippet[FramesPerBlock];
+            // If spikeMaxEnabled is true, then see if any samples in this snippet surpass spikeMax. If they do,
+            // then mark maxSurpassed as true.
+            bool maxSurpassed = false;
+            if (globalParameters.spikeMaxEnabled) {
                 for (int i = 0; i < SnippetSize; ++i) {
-                    int thisS = threshS + i;
-                    if (thisS < 0) {
-                        thisSnippet[i] = prevHighFloat[SnippetSize + thisS];
-                    } else {
-                        thisSnippet[i] = filteredHigh[thisS];
-                    }
-                }
-
-                // Create a struct to hold this channel's hoop info.
-                ChannelDetectionStruct detection;
-                for (int unit = 0; unit < 4; ++unit) {
-                    for (int hoop = 0; hoop < 4; ++hoop) {
-                        detection.units[unit].hoops[hoop] = false;
+                    if (globalParameters.spikeMax >= 0 && thisSnippet[i] >= globalParameters.spikeMax) {
+                        maxSurpassed = true;
+                        break;
                     }
-                }
-                detection.maxSurpassed = false;
-
-                // If spikeMaxEnabled is true, then see if any samples in this snippet surpass spikeMax. If they do,
-                // then mark detetion.maxSurpassed as true and save which sample.
-                if (globalParameters.spikeMaxEnabled) {
-                    for (int i = 0; i < SnippetSize; ++i) {
-                        if (globalParameters.spikeMax >= 0 && thisSnippet[i] >= globalParameters.spikeMax) {
-                            detection.maxSurpassed = true;
-                            break;
-                        }
-                        if (globalParameters.spikeMax < 0 && thisSnippet[i] <= globalParameters.spikeMax) {
-                            detection.maxSurpassed = true;
-                            break;
-                        }
+                    if (globalParameters.spikeMax < 0 && thisSnippet[i] <= globalParameters.spikeMax) {
+                        maxSurpassed = true;
+                        break;
                     }
                 }
+            }
 
-                // If useHoops is true, then go through all units populating detection.units[unit].hoops[hoop].
-                if (useHoops) {
-                    // Go through all units.
-                    for (int unit = 0; unit < 4; ++unit) {
-
-                        // If this unit has no valid hoops (all tA values are -1.0f), then this is an inactive unit which
-                        // should be treated as having no intersect; just go on to the next unit.
-                        if (hoops[channelIndex].unitHoops[unit].hoopInfo[0].tA == -1.0f &&
-                                hoops[channelIndex].unitHoops[unit].hoopInfo[1].tA == -1.0f &&
-                                hoops[channelIndex].unitHoops[unit].hoopInfo[2].tA == -1.0f &&
-                                hoops[channelIndex].unitHoops[unit].hoopInfo[3].tA == -1.0f) {
-                            continue;
-                        }
-
-                        // Go through all hoops.
-                        for (int hoop = 0; hoop < 4; ++hoop) {
-                            HoopInfoStruct thisHoop = hoops[channelIndex].unitHoops[unit].hoopInfo[hoop];
-
-                            // If this hoop info is invalid (tA is -1.0f), then this is an inactive hoop, which by default passes.
-                            // Set true and continue. If all hoops are inactive, then we would have already passed on to the next
-                            // unit without flaggin an intersect.
-                            if (thisHoop.tA == -1.0f) {
-                                detection.units[unit].hoops[hoop] = true;
-                                continue;
-                            }
-
-                            float tA = thisHoop.tA;
-                            float yA = thisHoop.yA;
-                            float tB = thisHoop.tB;
-                            float yB = thisHoop.yB;
-
-                            // In range [tA, tB], does line segment from (t1, y1) to (t2, y2) intersect user-defined hoop?
-                            // If so, mark hoop as jumped through by setting intersect to true.
-                            bool intersect = false;
-
-                            // Round tA down and tB up to the nearest discrete sample.
-                            int sA = floor(sampleRate * tA);
-                            int sB = ceil(sampleRate * tB);
-
-                            // Special case: vertical hoop
-                            if (sA == sB) {
-                                float y1Data = thisSnippet[sA];
-                                if (yB > yA) {
-                                    intersect = (y1Data < yB && y1Data > yA);
-                                } else {
-                                    intersect = (y1Data > yB && y1Data < yA);
-                                }
-                            } else {
-                                // General case: non-vertical hoop
-                                float slope = (yB - yA) / (tB - tA);
-                                // Examine every two adjacent samples in the range [sA, sB] and determine if they intersect the hoop.
-                                for (int s1 = sA; s1 < sB - 1; ++s1) {
-                                    int s2 = s1 + 1;
-                                    float y1Data = thisSnippet[s1];
-                                    float y2Data = thisSnippet[s2];
-
-                                    // Convert s1 and s2 to the float t1 and t2 domain.
-                                    float t1 = ((float) s1) * samplePeriod;
-                                    float t2 = ((float) s2) * samplePeriod;
-
-                                    float y1Hoop = yA + slope * (t1 - tA);
-                                    float y2Hoop = yA + slope * (t2 - tA);
-
-                                    // If the data transitions from below to above the hoop (or vice versa), then an intersection
-                                    // occurred. Break the loop for checking this hoop.
-                                    if ((y1Data >= y1Hoop && y2Data <= y2Hoop) ||
-                                            (y1Data <= y1Hoop && y2Data >= y2Hoop)) {
-                                        intersect = true;
-                                        break;
-                                    }
-
-                                    // Otherwise, keep looking over the course of this hoop.
-                                }
-                            }
-
-                            if (intersect) {  // If intersect occurred, mark this hoop as jumped through.
-                                detection.units[unit].hoops[hoop] = true;
-                            } else {
-                                // If not, exit the hoop loop (default value is false, so effectively setting it false)
-                                // and move on to the next unit.
-                                break;
-                            }
-                        } // End loop across all hoops.
-                    } // End loop across all units.
-                } else {  // If useHoops is false, then just populate detection.units[unit].hoops[hoop] with true.
-                    for (int unit = 0; unit < 4; ++unit) {
-                        for (int hoop = 0; hoop < 4; ++hoop) {
-                            detection.units[unit].hoops[hoop] = true;
-                        }
-                    }
-                }
-
-                uchar ID = 0;
-                // Determine correct ID
-
-
-                if (detection.maxSurpassed) {  // If max has been detected, ID is 128 for max surpassing.
-                    ID = 128;
-                } else if (true) {
-                //} else if (!useHoops) {  // If useHoops is false, ID is 1 to signify threshold crossing.
-                    ID = 1;
-                } else {  // If useHoops is true, ID is either (a) an active unit or (b) just a threshold crossing.
-                    // (a) If a unit is active, ID is either 1, 2, 4, or 8 for the unit.
-                    for (uint8_t unit = 0; unit < 4; ++unit) {
-                        if (detection.units[unit].hoops[0] && detection.units[unit].hoops[1] &&
-                                detection.units[unit].hoops[2] && detection.units[unit].hoops[3]) {
-//                            ID = (uint8_t) pow(2.0f, (float) unit);
-                            ID = 1u << unit;  // faster implementation of 2^unit
-                            break;
-                        }
-                    }
-
-                    // (b) If no unit is active, ID is 64 to signify threshold crossing.
-                    if (ID == 0) ID = 64;
-                }
+            uchar ID;
+            // Determine correct ID
+            if (maxSurpassed) {  // If max has been detected, ID is 128 for max surpassing.
+                ID = 128;
+            } else if (!useHoops) {  // If useHoops is false, ID is 1 to signify threshold crossing.
+                ID = 1;
+            } else {  // If useHoops is true, ID is either 1, 2, 4, or 8 for an active unit, or 64 for just a threshold crossing.
+                ID = hoopClassifiers[channelIndex].classify(thisSnippet, snippetSampleTimes.data());
+            }
 
-                // Populate spike with timestamp
-                // Extract the timestamp of the first frame in this data block
-                uint32_t timestampLSW = rawBlock[4]; // Timestamp is always the bytes 8-11 of the datablock (16-bit words 4-5).
-                uint32_t timestampMSW = rawBlock[5];
-                uint32_t timestamp = (timestampMSW << 16) + timestampLSW;
+            // Populate spike with timestamp
+            // Extract the timestamp of the first frame in this data block
+            uint32_t timestampLSW = rawBlock[4]; // Timestamp is always the bytes 8-11 of the datablock (16-bit words 4-5).
+            uint32_t timestampMSW = rawBlock[5];
+            uint32_t timestamp = (timestampMSW << 16) + timestampLSW;
 
-                // Add threshS to this timestamp to index right (for positive threshS) or left (for negative threshS).
-                timestamp += threshS;
+            // Add threshS to this timestamp to index right (for positive threshS) or left (for negative threshS).
+            timestamp += threshS;
 
-                // Write spike detection at this timestamp.
-                spikeChunk[snippetIndex * channels + channelIndex] = timestamp;
+            // Write spike detection at this timestamp.
+            spikeChunk[snippetIndex * channels + channelIndex] = timestamp;
 
-                // Populate spikeID with correct ID.
-                spikeIDChunk[snippetIndex * channels + channelIndex] = ID;
+            // Populate spikeID with correct ID.
+            spikeIDChunk[snippetIndex * channels + channelIndex] = ID;
 
-                // Advance by SnippetSize samples since activity up until then will already be flagged as a spike.
-                threshS += SnippetSize;
+            // Advance by SnippetSize samples since activity up until then will already be flagged as a spike.
+            threshS += SnippetSize;
 
-                // Continue detection, preparing for another spike in this block to take the next snippetIndex;
-                ++snippetIndex;
+            // Continue detection, preparing for another spike in this block to take the next snippetIndex;
+            ++snippetIndex;
 
-                // If the end of this spike snippet is encroaching on the territory of the next data block
-                // (with SnippetSize of the next block's start), populate startSearchPos[channel] with
-                // the end position of this snippet. This allows the next block to start at a later sample,
-                // so there's no risk of double-counting a spike.
-                if (threshS > FramesPerBlock - SnippetSize) {
-                    startSearchPos[channelIndex] = threshS - (FramesPerBlock - SnippetSize);
-                }
+            // If the end of this spike snippet is encroaching on the territory of the next data block
+            // (with SnippetSize of the next block's start), populate startSearchPos[channel] with
+            // the end position of this snippet. This allows the next block to start at a later sample,
+            // so there's no risk of double-counting a spike.
+            if (threshS > FramesPerBlock - SnippetSize) {
+                startSearchPos[channelIndex] = threshS - (FramesPerBlock - SnippetSize);
             }
         }
 
@@ -511,37 +562,59 @@ void CPUInterface::processDataBlock(uint16_t * data, uint16_t *lowChunk, uint16_
             if (wideFloat[s] > 6389.0f) wideFloat[s] = 6389.0f;
             else if (wideFloat[s] < -6389.0f) wideFloat[s] = -6389.0f;
 
-            if (filteredLow[s] > 6389.0f) filteredLow[s] = 6389.0f;
-            else if (filteredLow[s] < -6389.0f) filteredLow[s] = -6389.0f;
-
             if (filteredHigh[s] > 6389.0f) filteredHigh[s] = 6389.0f;
             else if (filteredHigh[s] < -6389.0f) filteredHigh[s] = -6389.0f;
 
             // (4) Convert outputs to uint16_t.
             outIndex = s * channels + channelIndex;
 
-            lowChunk[outIndex] = (uint16_t) round((filteredLow[s] / 0.195f) + 32768);
-            wideChunk[outIndex] = (uint16_t) round((wideFloat[s] / 0.195f) + 32768);
+            if (needWide) wideChunk[outIndex] = (uint16_t) round((wideFloat[s] / 0.195f) + 32768);
             highChunk[outIndex] = (uint16_t) round((filteredHigh[s] / 0.195f) + 32768);
         }
+        if (needLow) {
+            for (s = 0; s < FramesPerBlock; ++s) {
+                if (filteredLow[s] > 6389.0f) filteredLow[s] = 6389.0f;
+                else if (filteredLow[s] < -6389.0f) filteredLow[s] = -6389.0f;
 
-        // Update 'prevLast2' array with this block's samples.
-        for (int filterIndex = 0; filterIndex < 4; ++filterIndex) {
-            prevLast2[low2ndToLastIndex[filterIndex]] = lowFloat[filterIndex][FramesPerBlock - 2];
-            prevLast2[lowLastIndex[filterIndex]] = lowFloat[filterIndex][FramesPerBlock - 1];
-            prevLast2[high2ndToLastIndex[filterIndex]] = highFloat[filterIndex][FramesPerBlock - 2];
-            prevLast2[highLastIndex[filterIndex]] = highFloat[filterIndex][FramesPerBlock - 1];
+                lowChunk[s * channels + channelIndex] = (uint16_t) round((filteredLow[s] / 0.195f) + 32768);
+            }
         }
 
-        prevLast2[in2ndToLastIndex] = inFloat[FramesPerBlock - 2];
-        prevLast2[inLastIndex] = inFloat[FramesPerBlock - 1];
-        prevLast2[wide2ndToLastIndex] = wideFloat[FramesPerBlock - 2];
-        prevLast2[wideLastIndex] = wideFloat[FramesPerBlock - 1];
+        // Update 'prevLast2' array with this block's samples.  (ChannelLaneFilter has already done this for its channels.)
+        if (!laneFiltered) {
+            for (int filterIndex = 0; filterIndex < 4; ++filterIndex) {
+                if (needLow) {
+                    prevLast2[low2ndToLastIndex[filterIndex]] = lowFloat[filterIndex][FramesPerBlock - 2];
+                    prevLast2[lowLastIndex[filterIndex]] = lowFloat[filterIndex][FramesPerBlock - 1];
+                }
+                prevLast2[high2ndToLastIndex[filterIndex]] = highFloat[filterIndex][FramesPerBlock - 2];
+                prevLast2[highLastIndex[filterIndex]] = highFloat[filterIndex][FramesPerBlock - 1];
+            }
+
+            prevLast2[in2ndToLastIndex] = inFloat[FramesPerBlock - 2];
+            prevLast2[inLastIndex] = inFloat[FramesPerBlock - 1];
+            prevLast2[wide2ndToLastIndex] = wideFloat[FramesPerBlock - 2];
+            prevLast2[wideLastIndex] = wideFloat[FramesPerBlock - 1];
+        }
     }
+}
 
-    // Set the last 50 samples of high to parsedPrevHigh so that they can be used in the next data block
-//    memcpy(parsedPrevHigh, &highChunk[(FramesPerBlock - SnippetSize) * channels], SnippetSize * sizeof(uint16_t));
-    parsedPrevHigh = &highChunk[(FramesPerBlock - SnippetSize) * channels];
+// Word offset of an amplifier channel's sample within each frame of a raw data block.
+int CPUInterface::rawWordOffset(int channelIndex) const
+{
+    int inIndexStream, inIndexChannel;
+    if (type == ControllerRecordUSB2 || type == ControllerRecordUSB3) {
+        inIndexStream = channelIndex / 32;
+        inIndexChannel = channelIndex % 32;
+    } else {
+        inIndexStream = channelIndex / 16;
+        inIndexChannel = channelIndex % 16;
+    }
+    if (type == ControllerStimRecord) {
+        return 6 + (numStreams * 3 * 2) + (inIndexChannel * numStreams * 2) + (2 * inIndexStream + 1);
+    } else {
+        return 6 + (numStreams * 3) + inIndexChannel * numStreams + inIndexStream;
+    }
 }
 
 void CPUInterface::freeMemory()
@@ -556,6 +629,9 @@ void CPUInterface::freeMemory()
     allocated = false;
 }
 
+// Benchmark CPU processing with 1, 2, 4, ... threads (up to the number of hardware threads).  The time for each is
+// recorded in state->cpuThreadDiagnosticTimes (see ControllerInterface::cpuThreadCountReport()), the fastest thread
+// count in state->cpuBestThreadCount, and its time in state->cpuInfo.
 void CPUInterface::speedTest()
 {
     state->cpuInfo.diagnosticTime = -1.0f;
@@ -563,12 +639,207 @@ void CPUInterface::speedTest()
     state->cpuInfo.rank = -1;
     state->cpuInfo.used = false;
 
+    int maxThreads = std::max(1, std::min((int) std::thread::hardware_concurrency(), MaxCPUThreads));
+    std::vector<int> threadCounts;
+    for (int numThreads = 1; numThreads < maxThreads; numThreads *= 2) {
+        threadCounts.push_back(numThreads);
+    }
+    threadCounts.push_back(maxThreads);
+
+    state->cpuThreadDiagnosticTimes.fill(-1.0f, maxThreads);
+    int previousNumThreads = workerPool.numThreads();
+
     setupMemory();
-    runDiagnostic(0);
 
+    // Use the fastest SIMD filter whose results are identical to the per-channel filter, if any.
+    useLaneFilter = false;
+    const ChannelLaneFilter::InstructionSet instructionSets[2] = { ChannelLaneFilter::AVX2, ChannelLaneFilter::Baseline };
+    for (ChannelLaneFilter::InstructionSet instructionSet : instructionSets) {
+        if (ChannelLaneFilter::lanes(instructionSet) > 1 && laneFilterMatchesScalar(instructionSet)) {
+            laneInstructionSet = instructionSet;
+            useLaneFilter = true;
+            break;
+        }
+    }
+    updateFilterKernels();
+
+    float bestTime = std::numeric_limits<float>::max();
+    for (int numThreads : threadCounts) {
+        workerPool.setNumThreads(numThreads, threadScheduler);
+        resetPrev();
+        runDiagnostic(0);
+        state->cpuThreadDiagnosticTimes[numThreads - 1] = state->cpuInfo.diagnosticTime;
+        if (state->cpuInfo.diagnosticTime < bestTime) {
+            bestTime = state->cpuInfo.diagnosticTime;
+            state->cpuBestThreadCount = numThreads;
+        }
+    }
+    state->cpuInfo.diagnosticTime = bestTime;
+    QStringList features;
+    if (useLaneFilter) features.append(ChannelLaneFilter::instructionSetName(laneInstructionSet));
+    if (state->cpuBestThreadCount > 1) features.append(QString::number(state->cpuBestThreadCount) + " threads");
+    if (!features.isEmpty()) {
+        state->cpuInfo.name = "CPU (" + features.join(", ") + ")";
+    }
+
+    workerPool.setNumThreads(previousNumThreads, threadScheduler);
     cleanupMemory();
 }
 
+// Precompute the sample ranges and line parameters of each channel's hoops for spike classification.
+void CPUInterface::updateHoopsVariables()
+{
+    if (!allocated) return;
+
+    float samplePeriod = 1.0f / sampleRate;
+    snippetSampleTimes.resize(SnippetSize);
+    for (int s = 0; s < SnippetSize; ++s) {
+        snippetSampleTimes[s] = ((float) s) * samplePeriod;
+    }
+    for (int c = 0; c < channels; ++c) {
+        hoopClassifiers[c].set(hoops[c], sampleRate);
+    }
+}
+
+// Select the SIMD filter kernels compiled for the current notch setting and filter orders.
+void CPUInterface::updateFilterKernels()
+{
+    int numLowFilterIterations = floor((float)(filterParameters.lowOrder - 1) / 2.0f) + 1;
+    int numHighFilterIterations = floor((float)(filterParameters.highOrder - 1) / 2.0f) + 1;
+
+    // calculateNotchConstants() disables the notch filter by making it pass its input through unchanged.
+    const FilterIterationParamStruct& notch = filterParameters.notchParams;
+    bool notchEnabled = !(notch.b0 == 1.0f && notch.b1 == 0.0f && notch.b2 == 0.0f && notch.a1 == 0.0f &&
+                          notch.a2 == 0.0f);
+
+    laneKernel = ChannelLaneFilter::kernel(laneInstructionSet, notchEnabled, numLowFilterIterations,
+                                           numHighFilterIterations);
+    laneKernelNoLowpass = ChannelLaneFilter::kernel(laneInstructionSet, notchEnabled, 0, numHighFilterIterations);
+}
+
+// Set one channel's low-pass filter state to the cascade's steady-state response to its most recent wideband sample.
+// The cascade isn't run in blocks where no reader needs low-pass data, so this lets it restart without the transient
+// that its stale (or zero) state would otherwise cause.
+void CPUInterface::seedLowpassState(int channelIndex, int numLowFilterIterations)
+{
+    float* channelState = &prevLast2[channelIndex * 20];
+    float level = channelState[19];  // most recent wideband sample
+    for (int filterIndex = 0; filterIndex < 4; ++filterIndex) {
+        float value = 0.0f;  // unused stages are stored as zero
+        if (filterIndex < numLowFilterIterations) {
+            const FilterIterationParamStruct& stage = filterParameters.lowParams[filterIndex];
+            float denominator = 1.0f + stage.a1 + stage.a2;
+            if (denominator != 0.0f) level *= (stage.b0 + stage.b1 + stage.b2) / denominator;  // DC gain
+            value = level;
+        }
+        channelState[filterIndex] = value;      // low 2nd-to-last output
+        channelState[4 + filterIndex] = value;  // low last output
+    }
+}
+
+static void setFilterIterationParams(FilterIterationParamStruct& params, const BiquadFilter& filter)
+{
+    params.b0 = filter.getB0();
+    params.b1 = filter.getB1();
+    params.b2 = filter.getB2();
+    params.a1 = filter.getA1();
+    params.a2 = filter.getA2();
+}
+
+// Run a few blocks of synthetic data through both the SIMD (ChannelLaneFilter) and the per-channel filter code, using
+// every instructionSet kernel updateFilterKernels() can select: notch filter enabled and bypassed, 1 to 4 low-pass
+// stages or none (when no reader needs low-pass data), and 1 to 4 high-pass stages.  Return true if every output
+// sample is identical.  The kernels do the same single-precision operations in the same order as the per-channel
+// code, so no tolerance is allowed: a difference means the compiler evaluated one of them differently (e.g., by
+// fusing a multiply and an add), and the per-channel filter should be used instead.
+bool CPUInterface::laneFilterMatchesScalar(ChannelLaneFilter::InstructionSet instructionSet)
+{
+    const int NumTestBlocks = 2;
+    const int samplesPerBlock = FramesPerBlock * channels;
+    std::vector<uint16_t> data(NumTestBlocks * wordsPerBlock);
+    uint32_t seed = 1;
+    for (int i = 0; i < (int) data.size(); ++i) {
+        seed = seed * 1664525u + 1013904223u;  // simple LCG: +/- 200 uV of noise
+        data[i] = (uint16_t) (32768 - 1024 + (seed >> 21));
+    }
+
+    // Test filters with the current cutoff frequencies, and a 60 Hz notch filter.
+    double sampleRate = state->sampleRate->getNumericValue();
+    ButterworthLowpassFilter lowFilter(8, state->lowSWCutoffFreq->getValue(), sampleRate);
+    ButterworthHighpassFilter highFilter(8, state->highSWCutoffFreq->getValue(), sampleRate);
+    SecondOrderNotchFilter notchFilter(60.0, NotchBandwidth, sampleRate);
+    std::vector<BiquadFilter> lowStages = lowFilter.getFilters();
+    std::vector<BiquadFilter> highStages = highFilter.getFilters();
+
+    const FilterParamStruct originalFilterParameters = filterParameters;
+    const std::vector<uint8_t> originalBandDemand = bandDemand;
+    const ChannelLaneFilter::InstructionSet originalInstructionSet = laneInstructionSet;
+    const bool originalUseLaneFilter = useLaneFilter;
+    laneInstructionSet = instructionSet;
+    setAllChannelsActive();
+
+    std::vector<uint16_t> output[2][3];
+    bool match = true;
+    for (int config = 0; config < 2 * 5 * 4 && match; ++config) {
+        bool notchEnabled = (config / 20) == 1;
+        int numLowStages = (config / 4) % 5;
+        int numHighStages = config % 4 + 1;
+
+        if (notchEnabled) {
+            setFilterIterationParams(filterParameters.notchParams, notchFilter);
+        } else {
+            filterParameters.notchParams.b0 = 1.0f;
+            filterParameters.notchParams.b1 = 0.0f;
+            filterParameters.notchParams.b2 = 0.0f;
+            filterParameters.notchParams.a1 = 0.0f;
+            filterParameters.notchParams.a2 = 0.0f;
+        }
+        // With no low-pass stages, test the kernel used when no reader needs low-pass data.
+        filterParameters.lowOrder = 2 * std::max(numLowStages, 1);
+        filterParameters.highOrder = 2 * numHighStages;
+        for (int i = 0; i < 4; ++i) {
+            setFilterIterationParams(filterParameters.lowParams[i], lowStages[i]);
+            setFilterIterationParams(filterParameters.highParams[i], highStages[i]);
+        }
+        updateFilterKernels();
+        bandDemand.assign(channels, (uint8_t) (numLowStages == 0 ? (WaveformFifo::AllBands & ~WaveformFifo::BandLow) :
+                                                                   WaveformFifo::AllBands));
+
+        for (int pass = 0; pass < 2; ++pass) {
+            useLaneFilter = (pass == 1);
+            resetPrev();
+            for (int c = 0; c < channels; ++c) startSearchPos[c] = 0;
+            parsedPrevHigh = parsedPrevHighOriginal;
+            for (int band = 0; band < 3; ++band) output[pass][band].assign(NumTestBlocks * samplesPerBlock, 0);
+            processDataBlocks(data.data(), NumTestBlocks, output[pass][0].data(), output[pass][1].data(),
+                              output[pass][2].data(), spike, spikeIDs);
+        }
+        for (int band = 0; band < 3; ++band) {
+            if (output[0][band] != output[1][band]) match = false;
+        }
+    }
+
+    filterParameters = originalFilterParameters;
+    bandDemand = originalBandDemand;
+    laneInstructionSet = originalInstructionSet;
+    useLaneFilter = originalUseLaneFilter;
+    updateFilterKernels();
+    resetPrev();
+    for (int c = 0; c < channels; ++c) startSearchPos[c] = 0;
+    parsedPrevHigh = parsedPrevHighOriginal;
+    updateActiveChannels();
+
+    return match;
+}
+
+// Set the number of threads used to process each data block, or 0 to use the fastest number found by speedTest().
+void CPUInterface::setNumThreads(int numThreads)
+{
+    if (numThreads <= 0) numThreads = state->cpuBestThreadCount;
+    std::lock_guard<std::mutex> lockFilter(filterMutex);
+    workerPool.setNumThreads(std::min(numThreads, MaxCPUThreads), threadScheduler);
+}
+
 bool CPUInterface::setupMemory()
 {
     if (!allocated) initializeMemory();
@@ -600,6 +871,8 @@ void CPUInterface::initializeMemory()
         startSearchPos[c] = 0;
     }
 
+    lowpassStateCurrent.assign(channels, 1);
+
     hoops = new ChannelHoopsStruct[channels];
 
     // Simple spike detection initialization w/o using hoops
@@ -615,6 +888,7 @@ void CPUInterface::initializeMemory()
         hoops[c].threshold = -70.0F;
         hoops[c].useHoops = 0; // 1 = true, 0 = false
     }
+    hoopClassifiers.assign(channels, HoopClassifier());
 
     // Prep before loop.
     parsedPrevHighOriginal = new uint16_t[SnippetSize * channels];
@@ -628,4 +902,62 @@ void CPUInterface::initializeMemory()
     spikeIndex = 0;
 
     allocated = true;
+    updateHoopsVariables();
+}
+
+// Compare ChannelLaneFilter::findCrossings() with the per-channel threshold test on synthetic high-pass data, for
+// each supported SIMD instruction set, and time both.  Thresholds of both signs (including zero) are tested, and some
+// samples equal their channel's threshold exactly, so the strictness of the comparison is checked too.
+std::string CPUInterface::crossingBenchmarkReport()
+{
+    const int NumFrames = 64 * FramesPerBlock;
+    const int Repetitions = 20;
+    const float LaneThresholds[ChannelLaneFilter::MaxLanes] = { -70.0f, 50.0f, 0.0f, -0.0f, -5.0f, 120.0f, -200.0f,
+                                                                10.0f };
+
+    std::ostringstream out;
+    out << "Spike threshold crossing search over " << NumFrames << " frames: ";
+    const char* separator = "";
+    const ChannelLaneFilter::InstructionSet instructionSets[2] = { ChannelLaneFilter::AVX2, ChannelLaneFilter::Baseline };
+    for (ChannelLaneFilter::InstructionSet instructionSet : instructionSets) {
+        const int lanes = ChannelLaneFilter::lanes(instructionSet);
+        if (lanes <= 1) continue;
+
+        std::vector<float> highOut(NumFrames * lanes);
+        uint32_t seed = 1;
+        for (int i = 0; i < (int) highOut.size(); ++i) {
+            seed = 1664525 * seed + 1013904223;
+            // About one sample in 16 equals the threshold; the rest are spread over +/- 204.8.
+            highOut[i] = ((seed >> 8) % 16 == 0) ? LaneThresholds[i % lanes] : 0.1f * (float) ((int) (seed >> 20) - 2048);
+        }
+
+        std::vector<uint8_t> simdMasks(NumFrames);
+        std::vector<uint8_t> scalarMasks(NumFrames);
+        auto start = std::chrono::steady_clock::now();
+        for (int rep = 0; rep < Repetitions; ++rep) {
+            ChannelLaneFilter::findCrossings(instructionSet, highOut.data(), NumFrames, LaneThresholds, simdMasks.data());
+        }
+        auto middle = std::chrono::steady_clock::now();
+        for (int rep = 0; rep < Repetitions; ++rep) {
+            for (int frame = 0; frame < NumFrames; ++frame) {
+                uint8_t mask = 0;
+                for (int lane = 0; lane < lanes; ++lane) {
+                    if (surpassesThreshold(highOut[frame * lanes + lane], LaneThresholds[lane])) {
+                        mask |= (uint8_t) (1u << lane);
+                    }
+                }
+                scalarMasks[frame] = mask;
+            }
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        double simdNs = std::chrono::duration<double, std::nano>(middle - start).count() / Repetitions / NumFrames;
+        double scalarNs = std::chrono::duration<double, std::nano>(end - middle).count() / Repetitions / NumFrames;
+        out << separator << ChannelLaneFilter::instructionSetName(instructionSet) << " (" << lanes << " channels) " <<
+               simdNs << " ns per frame, per-channel test " << scalarNs << " ns per frame, crossings " <<
+               (simdMasks == scalarMasks ? "match" : "DIFFER");
+        separator = "; ";
+    }
+    if (*separator == '\0') out << "no SIMD instruction set is supported";
+    return out.str();
 }
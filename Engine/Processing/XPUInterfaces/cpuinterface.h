@@ -31,18 +31,11 @@
 #ifndef CPUINTERFACE_H
 #define CPUINTERFACE_H
 
+#include <string>
 #include "abstractxpuinterface.h"
-
-typedef struct _UnitDetection
-{
-    bool hoops[4];
-} HoopDetectionStruct;
-
-typedef struct _ChannelDetection
-{
-    HoopDetectionStruct units[4];
-    bool maxSurpassed;
-} ChannelDetectionStruct;
+#include "channellanefilter.h"
+#include "cpuworkerpool.h"
+#include "hoopclassifier.h"
 
 class CPUInterface : public AbstractXPUInterface
 {
@@ -53,13 +46,43 @@ public:
 
     void processDataBlock(uint16_t* data, uint16_t* lowChunk, uint16_t* wideChunk,
                           uint16_t* highChunk, uint32_t* spikeChunk, uint8_t* spikeIDChunk) override;
+    void processDataBlocks(uint16_t* data, int numBlocks, uint16_t* lowChunk, uint16_t* wideChunk,
+                           uint16_t* highChunk, uint32_t* spikeChunk, uint8_t* spikeIDChunk) override;
     void speedTest() override;
     bool setupMemory() override;
     bool cleanupMemory() override;
 
+    void setNumThreads(int numThreads);
+    void setThreadScheduler(ThreadScheduler* threadScheduler_) { threadScheduler = threadScheduler_; }
+
+    static std::string crossingBenchmarkReport();
+
 private:
+    void processChannels(int firstActive, int lastActive, uint16_t* data, uint16_t* lowChunk, uint16_t* wideChunk,
+                         uint16_t* highChunk, uint32_t* spikeChunk, uint8_t* spikeIDChunk, const uint16_t* prevHigh);
+    int rawWordOffset(int channelIndex) const;
+    void updateHoopsVariables() override;
+    void updateFilterKernels() override;
+    void seedLowpassState(int channelIndex, int numLowFilterIterations);
+    bool laneFilterMatchesScalar(ChannelLaneFilter::InstructionSet instructionSet);
     void initializeMemory();
     void freeMemory();
+
+    CPUWorkerPool workerPool;
+    ThreadScheduler* threadScheduler;
+    ChannelLaneFilter::InstructionSet laneInstructionSet;
+    bool useLaneFilter;
+
+    // SIMD filter kernels for the current filter settings, with and without the low-pass cascade.
+    ChannelLaneFilter::Kernel laneKernel;
+    ChannelLaneFilter::Kernel laneKernelNoLowpass;
+
+    // Spike classification by each channel's hoops, and the time of each snippet sample relative to its start.
+    std::vector<HoopClassifier> hoopClassifiers;
+    std::vector<float> snippetSampleTimes;
+
+    // For each channel, true if its low-pass filter state in prevLast2 was updated with the last block processed.
+    std::vector<char> lowpassStateCurrent;
 };
 
 #endif // CPUINTERFACE_H
@@ -0,0 +1,138 @@
+//------------------------------------------------------------------------------
+//
+//  Intan Technologies RHX Data Acquisition Software
+//  Version 3.4.0
+//
+//  Copyright (c) 2020-2025 Intan Technologies
+//
+//  This file is part of the Intan Technologies RHX Data Acquisition Software.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published
+//  by the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//  This software is provided 'as-is', without any express or implied warranty.
+//  In no event will the authors be held liable for any damages arising from
+//  the use of this software.
+//
+//  See <http://www.intantech.com> for documentation and product information.
+//
+//------------------------------------------------------------------------------
+
+#include <chrono>
+#include "cpuworkerpool.h"
+
+// Time a worker spins waiting for the next data block before going to sleep.
+const int WorkerSpinMicroseconds = 200;
+
+CPUWorkerPool::CPUWorkerPool() :
+    currentTask(nullptr),
+    currentNumParts(1),
+    generation(0),
+    partsRemaining(0),
+    quit(false)
+{
+}
+
+CPUWorkerPool::~CPUWorkerPool()
+{
+    stopWorkers();
+}
+
+// Use numThreads_ threads in total (including the thread calling run()).  Worker threads apply the current
+// ThreadScheduler profile (if any) as ThreadScheduler::ThreadWorker when they are created.
+void CPUWorkerPool::setNumThreads(int numThreads_, ThreadScheduler* threadScheduler)
+{
+    if (numThreads_ < 1) numThreads_ = 1;
+    if (numThreads_ == numThreads()) return;
+
+    stopWorkers();
+    quit = false;
+    uint64_t startGeneration = generation.load(std::memory_order_relaxed);
+    for (int i = 1; i < numThreads_; ++i) {
+        workers.emplace_back(&CPUWorkerPool::workerLoop, this, i, startGeneration, threadScheduler);
+    }
+}
+
+void CPUWorkerPool::stopWorkers()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        quit = true;
+        generation.fetch_add(1, std::memory_order_release);
+    }
+    startCondition.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+}
+
+void CPUWorkerPool::run(const std::function<void(int, int)>& task)
+{
+    const int numParts = numThreads();
+    if (numParts == 1) {
+        task(0, 1);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        currentTask = &task;
+        currentNumParts = numParts;
+        partsRemaining.store(numParts - 1, std::memory_order_relaxed);
+        generation.fetch_add(1, std::memory_order_release);
+    }
+    startCondition.notify_all();
+
+    task(0, numParts);
+
+    // Barrier: wait for all workers to finish their parts.
+    if (partsRemaining.load(std::memory_order_acquire) > 0) {
+        std::unique_lock<std::mutex> lock(mtx);
+        doneCondition.wait(lock, [this]() { return partsRemaining.load(std::memory_order_acquire) == 0; });
+    }
+}
+
+void CPUWorkerPool::workerLoop(int workerIndex, uint64_t startGeneration, ThreadScheduler* threadScheduler)
+{
+    if (threadScheduler) threadScheduler->applyToCurrentThread(ThreadScheduler::ThreadWorker, workerIndex - 1);
+
+    uint64_t lastGeneration = startGeneration;
+
+    while (true) {
+        // Spin briefly, since data blocks usually arrive in quick succession, then sleep until notified.
+        auto spinStart = std::chrono::steady_clock::now();
+        while (generation.load(std::memory_order_acquire) == lastGeneration &&
+               std::chrono::steady_clock::now() - spinStart < std::chrono::microseconds(WorkerSpinMicroseconds)) {
+            std::this_thread::yield();
+        }
+
+        const std::function<void(int, int)>* task;
+        int numParts;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            startCondition.wait(lock, [this, lastGeneration]() { return generation.load(std::memory_order_relaxed) != lastGeneration; });
+            if (quit) return;
+            lastGeneration = generation.load(std::memory_order_relaxed);
+            task = currentTask;
+            numParts = currentNumParts;
+        }
+
+        (*task)(workerIndex, numParts);
+
+        if (partsRemaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            std::lock_guard<std::mutex> lock(mtx);
+            doneCondition.notify_one();
+        }
+    }
+}
@@ -0,0 +1,74 @@
+//------------------------------------------------------------------------------
+//
+//  Intan Technologies RHX Data Acquisition Software
+//  Version 3.4.0
+//
+//  Copyright (c) 2020-2025 Intan Technologies
+//
+//  This file is part of the Intan Technologies RHX Data Acquisition Software.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published
+//  by the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//  This software is provided 'as-is', without any express or implied warranty.
+//  In no event will the authors be held liable for any damages arising from
+//  the use of this software.
+//
+//  See <http://www.intantech.com> for documentation and product information.
+//
+//------------------------------------------------------------------------------
+
+#ifndef CPUWORKERPOOL_H
+#define CPUWORKERPOOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include "threadscheduling.h"
+
+// Persistent pool of worker threads used to split CPU processing of each data block across several cores.  The
+// thread calling run() takes part 0 of the work itself, and run() acts as a barrier: it returns only once every
+// part is complete.  Workers are created once (not per data block), spin briefly after each block in case the
+// next one arrives soon, and otherwise sleep until run() is called again.
+class CPUWorkerPool
+{
+public:
+    CPUWorkerPool();
+    ~CPUWorkerPool();
+
+    void setNumThreads(int numThreads_, ThreadScheduler* threadScheduler = nullptr);
+    int numThreads() const { return (int) workers.size() + 1; }
+
+    // Call task(part, numParts) once for each part = 0 ... numParts - 1, in parallel, and wait for all to finish.
+    void run(const std::function<void(int, int)>& task);
+
+private:
+    void workerLoop(int workerIndex, uint64_t startGeneration, ThreadScheduler* threadScheduler);
+    void stopWorkers();
+
+    std::vector<std::thread> workers;
+
+    std::mutex mtx;
+    std::condition_variable startCondition;
+    std::condition_variable doneCondition;
+    const std::function<void(int, int)>* currentTask;
+    int currentNumParts;
+    std::atomic<uint64_t> generation;
+    std::atomic_int partsRemaining;
+    bool quit;
+};
+
+#endif // CPUWORKERPOOL_H
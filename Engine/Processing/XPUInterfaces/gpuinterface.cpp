@@ -72,10 +72,17 @@ void GPUInterface::processDataBlock(uint16_t *data, uint16_t *lowChunk, uint16_t
     ret = clEnqueueWriteBuffer(commandQueue, gpuStartSearchPosHandle, CL_TRUE, 0, channels * sizeof(uint16_t), startSearchPos, 0, nullptr, nullptr);
     if (ret != CL_SUCCESS) qDebug() << "Error A7";
 
-    // Execute kernel
-    size_t globalItemSize = channels;
-    ret = clEnqueueNDRangeKernel(commandQueue, kernel, 1, nullptr, &globalItemSize, nullptr, 0, nullptr, nullptr);
-    if (ret != CL_SUCCESS) qDebug() << "clEnqueueNDRangeKernel() failed. Ret: " << ret;
+    // Only enabled amplifier channels are processed, one work item each.
+    gpuActiveChannels.assign(activeChannels.begin(), activeChannels.end());
+    if (!gpuActiveChannels.empty()) {
+        ret = clEnqueueWriteBuffer(commandQueue, gpuActiveChannelsHandle, CL_TRUE, 0, gpuActiveChannels.size() * sizeof(cl_ushort), gpuActiveChannels.data(), 0, nullptr, nullptr);
+        if (ret != CL_SUCCESS) qDebug() << "Error A8";
+
+        // Execute kernel
+        size_t globalItemSize = gpuActiveChannels.size();
+        ret = clEnqueueNDRangeKernel(commandQueue, kernel, 1, nullptr, &globalItemSize, nullptr, 0, nullptr, nullptr);
+        if (ret != CL_SUCCESS) qDebug() << "clEnqueueNDRangeKernel() failed. Ret: " << ret;
+    }
 
     // Read all outputs
     ret = clEnqueueReadBuffer(commandQueue, gpuPrevLast2BuffHandle, CL_TRUE, 0, channels * 20 * sizeof(float), prevLast2, 0, nullptr, nullptr);
@@ -99,6 +106,9 @@ void GPUInterface::processDataBlock(uint16_t *data, uint16_t *lowChunk, uint16_t
     ret = clEnqueueReadBuffer(commandQueue, gpuSpikeIDsHandle, CL_TRUE, 0, channels * SnippetsPerBlock * sizeof(uint8_t), spikeIDChunk, 0, nullptr, nullptr);
     if (ret != CL_SUCCESS) qDebug() << "Error C6";
 
+    // The kernel doesn't touch disabled channels, so clear any stale waveforms and spikes read back for them.
+    clearInactiveOutputs(lowChunk, wideChunk, highChunk, spikeChunk, spikeIDChunk);
+
     // Set the last 50 samples of high to parsedPrevHigh so that they can be used in the next data block.
     parsedPrevHigh = &highChunk[(FramesPerBlock - SnippetSize) * channels];
 }
@@ -166,6 +176,9 @@ void GPUInterface::initializeKernelMemory()
     gpuStartSearchPosHandle = clCreateBuffer(context, CL_MEM_READ_WRITE, channels * sizeof(uint16_t), nullptr, &ret);
     if (ret != CL_SUCCESS) qDebug() << "Error I11";
 
+    gpuActiveChannelsHandle = clCreateBuffer(context, CL_MEM_READ_ONLY, channels * sizeof(cl_ushort), nullptr, &ret);
+    if (ret != CL_SUCCESS) qDebug() << "Error I12";
+
     // Initialize sources and sinks.
     spike = new uint32_t[totalSnippetsPerBlock * DiagnosticBlocks];
     spikeIDs = new uint8_t[totalSnippetsPerBlock * DiagnosticBlocks];
@@ -262,6 +275,13 @@ void GPUInterface::initializeKernelMemory()
     ret = clSetKernelArg(kernel, 11, sizeof(cl_mem), (void*)&gpuStartSearchPosHandle);
     if (ret != CL_SUCCESS) qDebug() << "J11";
 
+    ret = clSetKernelArg(kernel, 12, sizeof(cl_mem), (void*)&gpuActiveChannelsHandle);
+    if (ret != CL_SUCCESS) qDebug() << "J12";
+
+    cl_uint numChannels = channels;
+    ret = clSetKernelArg(kernel, 13, sizeof(cl_uint), (void*)&numChannels);
+    if (ret != CL_SUCCESS) qDebug() << "J13";
+
     // Populate global parameters.
     globalParameters.wordsPerFrame = wordsPerFrame;
     if (type == ControllerRecordUSB2) globalParameters.type = 0;
@@ -350,6 +370,7 @@ void GPUInterface::freeKernelMemory()
     clReleaseMemObject(gpuSpikeBuffHandle);
     clReleaseMemObject(gpuSpikeIDsHandle);
     clReleaseMemObject(gpuStartSearchPosHandle);
+    clReleaseMemObject(gpuActiveChannelsHandle);
 
     clReleaseCommandQueue(commandQueue);
     clReleaseContext(context);
@@ -32,6 +32,7 @@
 #define GPUINTERFACE_H
 
 #include <QMessageBox>
+#include <vector>
 
 #include "abstractxpuinterface.h"
 
@@ -80,6 +81,9 @@ private:
     cl_mem gpuSpikeBuffHandle;
     cl_mem gpuSpikeIDsHandle;
     cl_mem gpuStartSearchPosHandle;
+    cl_mem gpuActiveChannelsHandle;
+
+    std::vector<cl_ushort> gpuActiveChannels;
 };
 
 #endif // GPUINTERFACE_H
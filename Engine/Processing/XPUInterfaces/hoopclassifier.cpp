@@ -0,0 +1,195 @@
+//------------------------------------------------------------------------------
+//
+//  Intan Technologies RHX Data Acquisition Software
+//  Version 3.4.0
+//
+//  Copyright (c) 2020-2025 Intan Technologies
+//
+//  This file is part of the Intan Technologies RHX Data Acquisition Software.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published
+//  by the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//  This software is provided 'as-is', without any express or implied warranty.
+//  In no event will the authors be held liable for any damages arising from
+//  the use of this software.
+//
+//  See <http://www.intantech.com> for documentation and product information.
+//
+//------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cmath>
+#include "simdlanes.h"
+#include "hoopclassifier.h"
+
+struct HoopKernel
+{
+    // Return a bitmask of the hoops (bit 4 * unit + hoop) that the snippet passes through, evaluating V::Count hoops at
+    // a time.  The comparisons are the same as those of the per-hoop loop in kernel.cl.
+    template <class V>
+    static RHX_FORCE_INLINE uint32_t passedHoops(const HoopClassifier& c, const float* snippet, const float* sampleTimes)
+    {
+        typedef typename V::Type T;
+
+        uint32_t passed = c.inactiveHoops;
+        alignas(32) float data1[V::Count], data2[V::Count], t1[V::Count], t2[V::Count];
+        const uint32_t laneBits = (1u << V::Count) - 1;
+
+        for (int first = 0; first < HoopClassifier::NumHoops; first += V::Count) {
+            // Vertical hoops: the data must lie strictly between the ends of the hoop.
+            if ((c.verticalHoops >> first) & laneBits) {
+                for (int lane = 0; lane < V::Count; ++lane) {
+                    data1[lane] = snippet[c.firstSample[first + lane]];
+                }
+                T y = V::load(data1);
+                uint32_t inside = V::greaterMask(y, V::load(&c.lower[first])) & V::greaterMask(V::load(&c.upper[first]), y);
+                passed |= (inside << first) & c.verticalHoops;
+            }
+
+            // Sloped hoops: some pair of adjacent samples must transition from below to above the hoop, or vice versa.
+            uint32_t pending = (c.slopedHoops >> first) & laneBits;
+            if (pending == 0) continue;
+            int maxSegments = 0;
+            for (int lane = 0; lane < V::Count; ++lane) {
+                maxSegments = std::max(maxSegments, c.numSegments[first + lane]);
+            }
+            const T yA = V::load(&c.yA[first]);
+            const T tA = V::load(&c.tA[first]);
+            const T slope = V::load(&c.slope[first]);
+            for (int segment = 0; segment < maxSegments && pending != 0; ++segment) {
+                uint32_t valid = 0;
+                for (int lane = 0; lane < V::Count; ++lane) {
+                    int s = 0;  // placeholder for lanes with no segment to test
+                    if (segment < c.numSegments[first + lane]) {
+                        s = c.firstSample[first + lane] + segment;
+                        valid |= 1u << lane;
+                    }
+                    data1[lane] = snippet[s];
+                    data2[lane] = snippet[s + 1];
+                    t1[lane] = sampleTimes[s];
+                    t2[lane] = sampleTimes[s + 1];
+                }
+                T hoop1 = V::add(yA, V::mul(slope, V::sub(V::load(t1), tA)));
+                T hoop2 = V::add(yA, V::mul(slope, V::sub(V::load(t2), tA)));
+                T y1 = V::load(data1);
+                T y2 = V::load(data2);
+                uint32_t crossed = (V::greaterEqualMask(y1, hoop1) & V::greaterEqualMask(hoop2, y2)) |
+                        (V::greaterEqualMask(hoop1, y1) & V::greaterEqualMask(y2, hoop2));
+                crossed &= valid & pending;
+                pending &= ~crossed;
+                passed |= crossed << first;
+            }
+        }
+        return passed;
+    }
+};
+
+#if defined(RHX_SIMD_AVX2)
+RHX_TARGET_AVX2 RHX_FLATTEN static uint32_t passedHoopsAVX2(const HoopClassifier& c, const float* snippet,
+                                                            const float* sampleTimes)
+{
+    return HoopKernel::passedHoops<AVX2Lanes>(c, snippet, sampleTimes);
+}
+#endif
+
+HoopClassifier::HoopClassifier() :
+    inactiveHoops((1u << NumHoops) - 1),
+    verticalHoops(0),
+    slopedHoops(0),
+    activeUnits(0)
+{
+    for (int i = 0; i < NumHoops; ++i) {
+        lower[i] = 0.0f;
+        upper[i] = 0.0f;
+        yA[i] = 0.0f;
+        tA[i] = 0.0f;
+        slope[i] = 0.0f;
+        firstSample[i] = 0;
+        numSegments[i] = 0;
+    }
+}
+
+void HoopClassifier::set(const ChannelHoopsStruct& channelHoops, double sampleRate)
+{
+    *this = HoopClassifier();
+    inactiveHoops = 0;
+    for (int unit = 0; unit < 4; ++unit) {
+        for (int hoop = 0; hoop < 4; ++hoop) {
+            const HoopInfoStruct& thisHoop = channelHoops.unitHoops[unit].hoopInfo[hoop];
+            const int i = 4 * unit + hoop;
+
+            // If this hoop info is invalid (tA is -1.0f), then this is an inactive hoop, which by default passes.
+            if (thisHoop.tA == -1.0f) {
+                inactiveHoops |= 1u << i;
+                continue;
+            }
+            activeUnits |= 1u << unit;
+
+            // Round tA down and tB up to the nearest discrete sample.
+            int sA = floor(sampleRate * thisHoop.tA);
+            int sB = ceil(sampleRate * thisHoop.tB);
+
+            if (sA == sB) {
+                // Special case: vertical hoop.  (If it lies outside the snippet, lower == upper and it never passes.)
+                verticalHoops |= 1u << i;
+                if (sA >= 0 && sA < SnippetSize) {
+                    firstSample[i] = sA;
+                    lower[i] = std::min(thisHoop.yA, thisHoop.yB);
+                    upper[i] = std::max(thisHoop.yA, thisHoop.yB);
+                }
+            } else {
+                // General case: examine every two adjacent samples (s, s + 1) for s in [sA, sB - 2], within the snippet.
+                slopedHoops |= 1u << i;
+                yA[i] = thisHoop.yA;
+                tA[i] = thisHoop.tA;
+                slope[i] = (thisHoop.yB - thisHoop.yA) / (thisHoop.tB - thisHoop.tA);
+                int start = std::max(sA, 0);
+                int end = std::min(sB - 1, SnippetSize - 1);
+                if (end > start) {
+                    firstSample[i] = start;
+                    numSegments[i] = end - start;
+                }
+            }
+        }
+    }
+}
+
+uint8_t HoopClassifier::classify(const float* snippet, const float* sampleTimes) const
+{
+    if (activeUnits == 0) return SpikeIdUnclassifiedSpike;
+
+    uint32_t passed;
+#if defined(RHX_SIMD_AVX2)
+    if (cpuSupportsAVX2()) {
+        passed = passedHoopsAVX2(*this, snippet, sampleTimes);
+    } else
+#endif
+    {
+#if defined(RHX_SIMD_SSE2)
+        passed = HoopKernel::passedHoops<SSE2Lanes>(*this, snippet, sampleTimes);
+#elif defined(RHX_SIMD_NEON)
+        passed = HoopKernel::passedHoops<NEONLanes>(*this, snippet, sampleTimes);
+#else
+        passed = HoopKernel::passedHoops<ScalarLanes>(*this, snippet, sampleTimes);
+#endif
+    }
+
+    // A unit matches if its snippet passed through all four of its hoops (inactive hoops pass by default).
+    for (int unit = 0; unit < 4; ++unit) {
+        if (((activeUnits >> unit) & 1) && ((passed >> (4 * unit)) & 0xf) == 0xf) {
+            return SpikeIdSpikeType1 << unit;
+        }
+    }
+    return SpikeIdUnclassifiedSpike;
+}
@@ -0,0 +1,78 @@
+//------------------------------------------------------------------------------
+//
+//  Intan Technologies RHX Data Acquisition Software
+//  Version 3.4.0
+//
+//  Copyright (c) 2020-2025 Intan Technologies
+//
+//  This file is part of the Intan Technologies RHX Data Acquisition Software.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published
+//  by the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//  This software is provided 'as-is', without any express or implied warranty.
+//  In no event will the authors be held liable for any damages arising from
+//  the use of this software.
+//
+//  See <http://www.intantech.com> for documentation and product information.
+//
+//------------------------------------------------------------------------------
+#ifndef HOOPCLASSIFIER_H
+#define HOOPCLASSIFIER_H
+
+#include <cstdint>
+#include "abstractxpuinterface.h"
+
+// Hoop-based classification of one amplifier channel's spikes.  Each of the channel's four units has up to four
+// hoops (line segments in the time-voltage plane of a spike snippet), and a spike belongs to the first unit whose
+// snippet passes through all of that unit's active hoops.  Each hoop's sample range and line parameters are computed
+// once, when the hoops change, and the hoops are then tested together, one hoop per SIMD lane.
+class HoopClassifier
+{
+public:
+    static const int NumHoops = 16;  // hoop index = 4 * unit + hoop
+
+    HoopClassifier();
+
+    // Precompute the hoops of channelHoops for snippets sampled at sampleRate.
+    void set(const ChannelHoopsStruct& channelHoops, double sampleRate);
+
+    // Return the spike ID (SpikeIdSpikeType1 to SpikeIdSpikeType4 for units 1-4, or SpikeIdUnclassifiedSpike if no unit
+    // matches) of a snippet of SnippetSize high-pass samples starting at its threshold crossing.  sampleTimes[s] is the
+    // time of sample s relative to the start of the snippet.
+    uint8_t classify(const float* snippet, const float* sampleTimes) const;
+
+private:
+    friend struct HoopKernel;
+
+    // Hoops (bit 4 * unit + hoop) that are inactive and pass by default, vertical (contained within one sample) and
+    // sloped.  Units with no active hoops never match.
+    uint32_t inactiveHoops;
+    uint32_t verticalHoops;
+    uint32_t slopedHoops;
+    uint8_t activeUnits;
+
+    // Vertical hoops: the sample at firstSample must lie strictly between lower and upper.
+    float lower[NumHoops];
+    float upper[NumHoops];
+
+    // Sloped hoops: the line y = yA + slope * (t - tA) is compared with numSegments pairs of adjacent samples, starting
+    // with (firstSample, firstSample + 1).
+    float yA[NumHoops];
+    float tA[NumHoops];
+    float slope[NumHoops];
+    int firstSample[NumHoops];
+    int numSegments[NumHoops];
+};
+
+#endif // HOOPCLASSIFIER_H
@@ -0,0 +1,118 @@
+//------------------------------------------------------------------------------
+//
+//  Intan Technologies RHX Data Acquisition Software
+//  Version 3.4.0
+//
+//  Copyright (c) 2020-2025 Intan Technologies
+//
+//  This file is part of the Intan Technologies RHX Data Acquisition Software.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published
+//  by the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//  This software is provided 'as-is', without any express or implied warranty.
+//  In no event will the authors be held liable for any damages arising from
+//  the use of this software.
+//
+//  See <http://www.intantech.com> for documentation and product information.
+//
+//------------------------------------------------------------------------------
+#ifndef SIMDLANES_H
+#define SIMDLANES_H
+
+#include "simdsupport.h"
+
+// SIMD kernels are written once, as templates over one of the vector types below, and must be inlined into each
+// instruction-set-specific entry point so that they are compiled for that instruction set.  (GCC and Clang refuse to
+// force-inline AVX2 code into functions not marked RHX_TARGET_AVX2, so AVX2 entry points are 'flattened' instead.)
+#if defined(_MSC_VER)
+#define RHX_FORCE_INLINE __forceinline
+#define RHX_FLATTEN
+#else
+#define RHX_FORCE_INLINE inline __attribute__((always_inline))
+#define RHX_FLATTEN __attribute__((flatten))
+// AVX2 instantiations of (always inlined) kernels pass __m256 values between functions compiled without AVX.
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+#if defined(RHX_SIMD_SSE2)
+struct SSE2Lanes
+{
+    typedef __m128 Type;
+    static const int Count = 4;
+    static RHX_FORCE_INLINE Type set1(float x) { return _mm_set1_ps(x); }
+    static RHX_FORCE_INLINE Type load(const float* p) { return _mm_loadu_ps(p); }
+    static RHX_FORCE_INLINE void store(float* p, Type x) { _mm_storeu_ps(p, x); }
+    static RHX_FORCE_INLINE Type add(Type a, Type b) { return _mm_add_ps(a, b); }
+    static RHX_FORCE_INLINE Type sub(Type a, Type b) { return _mm_sub_ps(a, b); }
+    static RHX_FORCE_INLINE Type mul(Type a, Type b) { return _mm_mul_ps(a, b); }
+    static RHX_FORCE_INLINE int greaterMask(Type a, Type b) { return _mm_movemask_ps(_mm_cmpgt_ps(a, b)); }
+    static RHX_FORCE_INLINE int greaterEqualMask(Type a, Type b) { return _mm_movemask_ps(_mm_cmpge_ps(a, b)); }
+};
+#endif
+
+#if defined(RHX_SIMD_AVX2)
+struct AVX2Lanes
+{
+    typedef __m256 Type;
+    static const int Count = 8;
+    static RHX_TARGET_AVX2 Type set1(float x) { return _mm256_set1_ps(x); }
+    static RHX_TARGET_AVX2 Type load(const float* p) { return _mm256_loadu_ps(p); }
+    static RHX_TARGET_AVX2 void store(float* p, Type x) { _mm256_storeu_ps(p, x); }
+    static RHX_TARGET_AVX2 Type add(Type a, Type b) { return _mm256_add_ps(a, b); }
+    static RHX_TARGET_AVX2 Type sub(Type a, Type b) { return _mm256_sub_ps(a, b); }
+    static RHX_TARGET_AVX2 Type mul(Type a, Type b) { return _mm256_mul_ps(a, b); }
+    static RHX_TARGET_AVX2 int greaterMask(Type a, Type b) { return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_GT_OQ)); }
+    static RHX_TARGET_AVX2 int greaterEqualMask(Type a, Type b) { return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_GE_OQ)); }
+};
+#endif
+
+#if defined(RHX_SIMD_NEON)
+struct NEONLanes
+{
+    typedef float32x4_t Type;
+    static const int Count = 4;
+    static RHX_FORCE_INLINE Type set1(float x) { return vdupq_n_f32(x); }
+    static RHX_FORCE_INLINE Type load(const float* p) { return vld1q_f32(p); }
+    static RHX_FORCE_INLINE void store(float* p, Type x) { vst1q_f32(p, x); }
+    static RHX_FORCE_INLINE Type add(Type a, Type b) { return vaddq_f32(a, b); }
+    static RHX_FORCE_INLINE Type sub(Type a, Type b) { return vsubq_f32(a, b); }
+    static RHX_FORCE_INLINE Type mul(Type a, Type b) { return vmulq_f32(a, b); }
+    static RHX_FORCE_INLINE int greaterMask(Type a, Type b) { return laneMask(vcgtq_f32(a, b)); }
+    static RHX_FORCE_INLINE int greaterEqualMask(Type a, Type b) { return laneMask(vcgeq_f32(a, b)); }
+
+    static RHX_FORCE_INLINE int laneMask(uint32x4_t comparison)
+    {
+        uint32_t lanes[4];
+        vst1q_u32(lanes, comparison);
+        return (int) ((lanes[0] & 1) | (lanes[1] & 2) | (lanes[2] & 4) | (lanes[3] & 8));
+    }
+};
+#endif
+
+// Portable version of the above, for processors without SIMD support.
+struct ScalarLanes
+{
+    typedef float Type;
+    static const int Count = 1;
+    static RHX_FORCE_INLINE Type set1(float x) { return x; }
+    static RHX_FORCE_INLINE Type load(const float* p) { return *p; }
+    static RHX_FORCE_INLINE void store(float* p, Type x) { *p = x; }
+    static RHX_FORCE_INLINE Type add(Type a, Type b) { return a + b; }
+    static RHX_FORCE_INLINE Type sub(Type a, Type b) { return a - b; }
+    static RHX_FORCE_INLINE Type mul(Type a, Type b) { return a * b; }
+    static RHX_FORCE_INLINE int greaterMask(Type a, Type b) { return a > b ? 1 : 0; }
+    static RHX_FORCE_INLINE int greaterEqualMask(Type a, Type b) { return a >= b ? 1 : 0; }
+};
+
+#endif // SIMDLANES_H
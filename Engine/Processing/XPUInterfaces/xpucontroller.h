@@ -47,8 +47,12 @@ public:
     void resetPrev();
     void processDataBlock(uint16_t* data, uint16_t* lowChunk, uint16_t* wideChunk,
                           uint16_t* highChunk, uint32_t* spikeChunk, uint8_t* spikeIDChunk);
+    void processDataBlocks(uint16_t* data, int numBlocks, uint16_t* lowChunk, uint16_t* wideChunk,
+                           uint16_t* highChunk, uint32_t* spikeChunk, uint8_t* spikeIDChunk);
     void updateNumStreams(int numStreams);
     void runDiagnostic();
+    void setThreadScheduler(ThreadScheduler* threadScheduler) { cpuInterface->setThreadScheduler(threadScheduler); }
+    void setBandDemand(const std::vector<uint8_t>& demand) { cpuInterface->setBandDemand(demand); gpuInterface->setBandDemand(demand); }
 
 private slots:
     void updateFromState();
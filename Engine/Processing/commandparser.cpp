@@ -180,6 +180,46 @@ void CommandParser::getCommandSlot(QString parameter)
         getCurrentTimestampCommand();
     else if (parameterLower == "currenttimeseconds")
         getCurrentTimeSecondsCommand();
+    else if (parameterLower == "usbresynccount")
+        getUSBResyncCountCommand();
+    else if (parameterLower == "usbbytesskipped")
+        getUSBBytesSkippedCommand();
+    else if (parameterLower == "usbframesdropped")
+        getUSBFramesDroppedCommand();
+    else if (parameterLower == "pipelinelatency")
+        getPipelineLatencyCommand();
+    else if (parameterLower == "usbblocksperread")
+        getUSBBlocksPerReadCommand();
+    else if (parameterLower == "usbreadlatencymilliseconds")
+        getUSBReadLatencyMillisecondsCommand();
+    else if (parameterLower == "usblowlatencytargetmisses")
+        getUSBLowLatencyTargetMissesCommand();
+    else if (parameterLower == "threadscheduling")
+        getThreadSchedulingCommand();
+    else if (parameterLower == "softwarereferencecpuload")
+        getSoftwareReferenceCPULoadCommand();
+    else if (parameterLower == "softwarereferencebenchmark")
+        getSoftwareReferenceBenchmarkCommand();
+    else if (parameterLower == "datastreamfifobenchmark")
+        getDataStreamFifoBenchmarkCommand();
+    else if (parameterLower == "dataeventbenchmark")
+        getDataEventBenchmarkCommand();
+    else if (parameterLower == "streamingmemorybenchmark")
+        getStreamingMemoryBenchmarkCommand();
+    else if (parameterLower == "mirroredmemorybenchmark")
+        getMirroredMemoryBenchmarkCommand();
+    else if (parameterLower == "demultiplexerbenchmark")
+        getDemultiplexerBenchmarkCommand();
+    else if (parameterLower == "spikecrossingbenchmark")
+        getSpikeCrossingBenchmarkCommand();
+    else if (parameterLower == "waveformlookupbenchmark")
+        getWaveformLookupBenchmarkCommand();
+    else if (parameterLower == "cursorpaddingbenchmark")
+        getCursorPaddingBenchmarkCommand();
+    else if (parameterLower == "cputhreadcountbenchmark")
+        getCPUThreadCountBenchmarkCommand();
+    else if (parameterLower == "waveformreaderstatus")
+        getWaveformReaderStatusCommand();
 
     // If parameter doesn't match an acceptable command, return an error.
    else emit TCPErrorSignal("Unrecognized parameter");
@@ -655,6 +695,130 @@ void CommandParser::getCurrentTimeSecondsCommand()
     }
 }
 
+// USB frame statistics describe the current run (or the most recent run, if the controller is stopped).  They are
+// only collected when USB data error checking is enabled (i.e., not in playback mode).
+void CommandParser::getUSBResyncCountCommand()
+{
+    returnTCP("USBResyncCount", QString::number(controllerInterface->usbFrameStatistics().resyncs));
+}
+
+void CommandParser::getUSBBytesSkippedCommand()
+{
+    returnTCP("USBBytesSkipped", QString::number(controllerInterface->usbFrameStatistics().bytesSkipped));
+}
+
+void CommandParser::getUSBFramesDroppedCommand()
+{
+    returnTCP("USBFramesDropped", QString::number(controllerInterface->usbFrameStatistics().framesDropped));
+}
+
+// Latency percentiles (in microseconds) from the USB read to each later stage of the pipeline, for the current run
+// (or the most recent run, if the controller is stopped).
+void CommandParser::getPipelineLatencyCommand()
+{
+    returnTCP("PipelineLatency", QString::fromStdString(controllerInterface->pipelineLatencyReport()));
+}
+
+// Most recent USB read size and resulting latency (see LowLatencyMode).
+void CommandParser::getUSBBlocksPerReadCommand()
+{
+    returnTCP("USBBlocksPerRead", QString::number(controllerInterface->latestUsbBlocksPerRead()));
+}
+
+void CommandParser::getUSBReadLatencyMillisecondsCommand()
+{
+    returnTCP("USBReadLatencyMilliseconds", QString::number(controllerInterface->latestUsbReadLatencyMsec()));
+}
+
+// Number of USB reads in the current or most recent run that exceeded the low-latency target (see LowLatencyMode).
+void CommandParser::getUSBLowLatencyTargetMissesCommand()
+{
+    returnTCP("USBLowLatencyTargetMisses", QString::number(controllerInterface->usbLowLatencyTargetMisses()));
+}
+
+// Scheduling policy and CPU affinity actually obtained by each pipeline thread, with wakeup jitter percentiles
+// (in microseconds) for the current or most recent run.
+void CommandParser::getThreadSchedulingCommand()
+{
+    returnTCP("ThreadScheduling", QString::fromStdString(controllerInterface->threadSchedulingReport()));
+}
+
+// Percentage of waveform processor thread time spent on software referencing (included in its total CPU load).
+void CommandParser::getSoftwareReferenceCPULoadCommand()
+{
+    returnTCP("SoftwareReferenceCPULoad", QString::number(controllerInterface->latestSoftwareReferenceCpuLoad()));
+}
+
+// Time per data block of average and median software referencing of all amplifier channels (on synthetic data).
+void CommandParser::getSoftwareReferenceBenchmarkCommand()
+{
+    returnTCP("SoftwareReferenceBenchmark", QString::fromStdString(controllerInterface->softwareReferenceBenchmarkReport()));
+}
+
+// Throughput of a separate DataStreamFifo streaming synthetic USB data between two threads, and whether it arrived intact.
+void CommandParser::getDataStreamFifoBenchmarkCommand()
+{
+    returnTCP("DataStreamFifoBenchmark", QString::fromStdString(controllerInterface->dataStreamFifoBenchmarkReport()));
+}
+
+// Wakeup latency of a thread blocked on a DataEvent, compared with the 100 us polling it replaced.
+void CommandParser::getDataEventBenchmarkCommand()
+{
+    returnTCP("DataEventBenchmark", QString::fromStdString(controllerInterface->dataEventBenchmarkReport()));
+}
+
+// First-touch and random-read times of a streaming memory buffer (pre-faulted, huge pages, optionally locked),
+// compared with ordinary heap memory.
+void CommandParser::getStreamingMemoryBenchmarkCommand()
+{
+    returnTCP("StreamingMemoryBenchmark", QString::fromStdString(controllerInterface->streamingMemoryBenchmarkReport()));
+}
+
+// Whether data streamed through a mirrored ring buffer reads back correctly across the wraparound, and its throughput
+// compared with an ordinary buffer and overhang copy.
+void CommandParser::getMirroredMemoryBenchmarkCommand()
+{
+    returnTCP("MirroredMemoryBenchmark", QString::fromStdString(controllerInterface->mirroredMemoryBenchmarkReport()));
+}
+
+// Whether single-pass demultiplexing of synthetic USB data matches per-signal reads for every routed signal, and the
+// time of each.
+void CommandParser::getDemultiplexerBenchmarkCommand()
+{
+    returnTCP("DemultiplexerBenchmark", QString::fromStdString(controllerInterface->demultiplexerBenchmarkReport()));
+}
+
+// Whether the SIMD spike threshold crossing search agrees with the per-channel test, and the time of each.
+void CommandParser::getSpikeCrossingBenchmarkCommand()
+{
+    returnTCP("SpikeCrossingBenchmark", QString::fromStdString(controllerInterface->spikeCrossingBenchmarkReport()));
+}
+
+// Time to resolve every amplifier band (WIDE, LOW, HIGH, SPK) in WaveformFifo by name and by handle.
+void CommandParser::getWaveformLookupBenchmarkCommand()
+{
+    returnTCP("WaveformLookupBenchmark", QString::fromStdString(controllerInterface->waveformLookupBenchmarkReport()));
+}
+
+// Cost of publishing WaveformFifo reader and writer cursors on separate cache lines and packed onto one line.
+void CommandParser::getCursorPaddingBenchmarkCommand()
+{
+    returnTCP("CursorPaddingBenchmark", QString::fromStdString(controllerInterface->cursorPaddingBenchmarkReport()));
+}
+
+// CPU processing time of the startup diagnostic with each number of threads tried, fastest first.
+void CommandParser::getCPUThreadCountBenchmarkCommand()
+{
+    returnTCP("CPUThreadCountBenchmark", QString::fromStdString(controllerInterface->cpuThreadCountReport()));
+}
+
+// Registration, slow-reader policy, current and peak lag, time spent as the slowest reader, and drop counts of each
+// WaveformFifo reader.
+void CommandParser::getWaveformReaderStatusCommand()
+{
+    returnTCP("WaveformReaderStatus", QString::fromStdString(controllerInterface->waveformReaderStatusReport()));
+}
+
 void CommandParser::measureImpedanceCommand()
 {
     controllerInterface->measureImpedances();
@@ -126,6 +126,27 @@ private:
     void getCurrentTimestampCommand();
     void getCurrentTimeSecondsCommand();
 
+    void getUSBResyncCountCommand();
+    void getUSBBytesSkippedCommand();
+    void getUSBFramesDroppedCommand();
+    void getPipelineLatencyCommand();
+    void getUSBBlocksPerReadCommand();
+    void getUSBReadLatencyMillisecondsCommand();
+    void getUSBLowLatencyTargetMissesCommand();
+    void getThreadSchedulingCommand();
+    void getSoftwareReferenceCPULoadCommand();
+    void getSoftwareReferenceBenchmarkCommand();
+    void getDataStreamFifoBenchmarkCommand();
+    void getDataEventBenchmarkCommand();
+    void getStreamingMemoryBenchmarkCommand();
+    void getMirroredMemoryBenchmarkCommand();
+    void getDemultiplexerBenchmarkCommand();
+    void getSpikeCrossingBenchmarkCommand();
+    void getWaveformLookupBenchmarkCommand();
+    void getCursorPaddingBenchmarkCommand();
+    void getCPUThreadCountBenchmarkCommand();
+    void getWaveformReaderStatusCommand();
+
     void measureImpedanceCommand();
     void saveImpedanceCommand();
     void rescanPortsCommand();
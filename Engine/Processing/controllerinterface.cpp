@@ -32,8 +32,13 @@
 #include <QtGlobal>
 #include <QElapsedTimer>
 #include <iostream>
+#include <sstream>
+#include <algorithm>
 #include "controlpanel.h"
 #include "impedancereader.h"
+#include "streamingmemory.h"
+#include "softwarereferenceprocessor.h"
+#include "rhxdatademultiplexer.h"
 #include "controllerinterface.h"
 
 ControllerInterface::ControllerInterface(SystemState* state_, AbstractRHXController* rhxController_, const QString& boardSerialNumber, bool useOpenCL,
@@ -48,6 +53,8 @@ ControllerInterface::ControllerInterface(SystemState* state_, AbstractRHXControl
     usbDataThread(nullptr),
     waveformFifo(nullptr),
     waveformProcessorThread(nullptr),
+    latencyTracer(nullptr),
+    threadScheduler(nullptr),
     display(nullptr),
     controlPanel(nullptr),
     isiDialog(nullptr),
@@ -79,20 +86,32 @@ ControllerInterface::ControllerInterface(SystemState* state_, AbstractRHXControl
     }
 
     hardwareFifoPercentFull = 0.0;
+    usbBlocksPerRead = 0;
+    usbReadLatencyMsec = 0.0;
     waveformProcessorCpuLoad = 0.0;
+    softwareReferenceCpuLoad = 0.0;
 
     usbDataThread = new USBDataThread(rhxController, usbStreamFifo, this);
     if (!usbDataThread->memoryWasAllocated(memoryRequired)) {
         outOfMemoryError(memoryRequired);
     }
 
+    latencyTracer = new LatencyTracer(RHXDataBlock::samplesPerDataBlock(state->getControllerTypeEnum()));
+    usbDataThread->setLatencyTracer(latencyTracer);
+
+    threadScheduler = new ThreadScheduler();
+    threadScheduler->setProfile((ThreadScheduler::Policy) state->threadSchedulingPolicy->getIndex(),
+                                state->threadAffinity->getValueString().toStdString());
+    usbDataThread->setThreadScheduler(threadScheduler);
+
     usbDataThread->setNumUsbBlocksToRead(state->playback->getValue() ? 1 : RHXDataBlock::blocksFor30Hz(state->getSampleRateEnum()));
     connect(usbDataThread, SIGNAL(finished()), usbDataThread, SLOT(deleteLater()));
-    connect(usbDataThread, SIGNAL(hardwareFifoReport(double)), this, SLOT(updateHardwareFifo(double)));
+    connect(usbDataThread, SIGNAL(hardwareFifoReport(double,int,double)), this, SLOT(updateHardwareFifo(double,int,double)));
 
     initializeController();
 
     xpuController = new XPUController(state, useOpenCL, this);
+    xpuController->setThreadScheduler(threadScheduler);
 
     rescanPorts();
 
@@ -107,17 +126,25 @@ ControllerInterface::ControllerInterface(SystemState* state_, AbstractRHXControl
     double samplesPerDataBlock = (double) RHXDataBlock::samplesPerDataBlock(state->getControllerTypeEnum());
     int waveformFifoMemoryDataBlocks = ceil(waveformMemoryInSeconds * sampleRate / samplesPerDataBlock);
     int waveformFifoBufferDataBlocks = ceil((waveformMemoryInSeconds + waveformExtraBufferInSeconds) * sampleRate / samplesPerDataBlock);
-    waveformFifo = new WaveformFifo(state->signalSources, waveformFifoBufferDataBlocks, waveformFifoMemoryDataBlocks, 1, state);
+    waveformFifo = new WaveformFifo(state->signalSources, waveformFifoBufferDataBlocks, waveformFifoMemoryDataBlocks,
+                                    WaveformProcessorThread::MaxBlocksPerPass, state);
     if (!waveformFifo->memoryWasAllocated(memoryRequired)) {
         outOfMemoryError(memoryRequired);
     }
+    waveformFifo->setLatencyTracer(latencyTracer);
+    // Audio and TCP readers are registered when their threads are created.
+    waveformFifo->unregisterReader(WaveformFifo::ReaderAudio);
+    waveformFifo->unregisterReader(WaveformFifo::ReaderTCP);
 
     waveformProcessorThread = new WaveformProcessorThread(state, rhxController->getNumEnabledDataStreams(), rhxController->getSampleRate(), usbStreamFifo, waveformFifo, xpuController, this);
     connect(waveformProcessorThread, SIGNAL(finished()), waveformProcessorThread, SLOT(deleteLater()));
     connect(waveformProcessorThread, SIGNAL(cpuLoadPercent(double)), this, SLOT(updateWaveformProcessorCpuLoad(double)));
+    connect(waveformProcessorThread, SIGNAL(softwareReferenceLoadPercent(double)), this, SLOT(updateSoftwareReferenceCpuLoad(double)));
+    waveformProcessorThread->setThreadScheduler(threadScheduler);
 
     saveToDiskThread = new SaveToDiskThread(waveformFifo, state, this);
     connect(saveToDiskThread, SIGNAL(finished()), saveToDiskThread, SLOT(deleteLater()));
+    saveToDiskThread->setThreadScheduler(threadScheduler);
     if (dataFileReader) {
         // Establish connections so that stimulation amplitudes read from playback file can be re-saved.
         connect(dataFileReader, SIGNAL(setPosStimAmplitude(int,int,int)),
@@ -163,6 +190,8 @@ ControllerInterface::~ControllerInterface()
 
     delete usbStreamFifo;
     delete waveformFifo;
+    delete latencyTracer;
+    delete threadScheduler;
     delete xpuController;
 }
 
@@ -184,19 +213,91 @@ void ControllerInterface::updateFromState()
     if (!tcpDataOutputEnabled && state->running && state->getTCPDataOutputChannels().length() > 0) {
         runTCPDataOutputThread();
     }
+
+    if (state->lockBufferMemory->getValue() != StreamingMemory::lockPages()) {
+        StreamingMemory::setLockPages(state->lockBufferMemory->getValue());
+    }
+
+    if (usbDataThread) {
+        usbDataThread->setLowLatencyMode(state->lowLatencyMode->getValue(), state->lowLatencyTargetMilliseconds->getValue());
+    }
+
+    if (waveformFifo && !state->running) {
+        waveformFifo->setReaderPolicy(WaveformFifo::ReaderDisplay, readerPolicy(WaveformFifo::ReaderDisplay));
+        waveformFifo->setReaderPolicy(WaveformFifo::ReaderAudio, readerPolicy(WaveformFifo::ReaderAudio));
+    }
+
+    updateDisplayBandDemand();
+    if (!state->running) updateDiskBandDemand();
+
+    if (threadScheduler) {
+        threadScheduler->setProfile((ThreadScheduler::Policy) state->threadSchedulingPolicy->getIndex(),
+                                    state->threadAffinity->getValueString().toStdString());
+    }
+}
+
+// Register the amplifier bands read from WaveformFifo by the display.  Wideband data is always needed (waveforms,
+// spectrogram), as is high-pass data (spike scope, RMS measurements); low-pass data is only needed if it is one of
+// the displayed filter bands.
+void ControllerInterface::updateDisplayBandDemand()
+{
+    if (!waveformFifo) return;
+
+    uint8_t bands = WaveformFifo::BandWide | WaveformFifo::BandHigh;
+    DiscreteItemList* filterDisplays[4] = { state->filterDisplay1, state->filterDisplay2, state->filterDisplay3,
+                                            state->filterDisplay4 };
+    for (DiscreteItemList* filterDisplay : filterDisplays) {
+        if (filterDisplay->getValue() == "Low") bands |= WaveformFifo::BandLow;
+    }
+    waveformFifo->setBandDemand(WaveformFifo::ReaderDisplay, bands);
+}
+
+// Register the amplifier bands that a recording could save, from the save settings (which can't change while
+// running).  This must be done before running starts, not when save files are opened: data that is already in
+// WaveformFifo when a trigger arrives, including the pre-trigger buffer, must contain every saved band.  Wideband
+// data is always saved in the traditional Intan file format; spike snapshots are taken from high-pass data.
+void ControllerInterface::updateDiskBandDemand()
+{
+    if (!waveformFifo) return;
+
+    std::vector<std::string> savedBands;
+    if (state->recording || state->triggerSet) {
+        SignalList saveList = state->signalSources->getSaveSignalList();
+        for (int i = 0; i < (int) saveList.amplifier.size(); ++i) {
+            savedBands.push_back(saveList.amplifier[i] + "|WIDE");
+            if (state->saveLowpassAmplifierWaveforms->getValue()) {
+                savedBands.push_back(saveList.amplifier[i] + "|LOW");
+            }
+            if (state->saveHighpassAmplifierWaveforms->getValue() || state->saveSpikeSnapshots->getValue()) {
+                savedBands.push_back(saveList.amplifier[i] + "|HIGH");
+            }
+        }
+    }
+    waveformFifo->setBandDemand(WaveformFifo::ReaderDisk, savedBands);
+}
+
+void ControllerInterface::updateHardwareFifo(double percentFull, int numBlocksPerRead, double readLatencyMsec)
+{
+    usbBlocksPerRead = numBlocksPerRead;
+    usbReadLatencyMsec = readLatencyMsec;
+    emit setHardwareFifoStatus(percentFull);
 }
 
 void ControllerInterface::toggleAudioThread(bool enabled)
 {
     if (enabled) {
         audioEnabled = true;
+        waveformFifo->registerReader(WaveformFifo::ReaderAudio, readerPolicy(WaveformFifo::ReaderAudio));
         audioThread = new AudioThread(state, waveformFifo, rhxController->getSampleRate());
         connect(audioThread, SIGNAL(finished()), audioThread, SLOT(deleteLater()));
         connect(audioThread, SIGNAL(newChannel(QString)), this, SLOT(updateCurrentAudioChannel(QString)));
+        audioThread->setThreadScheduler(threadScheduler);
 
         // This starts the thread running, ideally on its own CPU core.
         audioThread->start();
-        audioThread->setPriority(QThread::HighestPriority);
+        if (threadScheduler->requestedPolicy() == ThreadScheduler::PolicyDefault) {
+            audioThread->setPriority(QThread::HighestPriority);  // Otherwise, the thread sets its own scheduling policy.
+        }
 
         // This activates the thread so it can do useful activity.
         audioThread->startRunning();
@@ -208,6 +309,7 @@ void ControllerInterface::toggleAudioThread(bool enabled)
             delete audioThread;
             audioThread = nullptr;
         }
+        waveformFifo->unregisterReader(WaveformFifo::ReaderAudio);
     }
 }
 
@@ -221,7 +323,9 @@ void ControllerInterface::runTCPDataOutputThread()
 {
         tcpDataOutputEnabled = true;
         if (!tcpDataOutputThread) {
+            waveformFifo->registerReader(WaveformFifo::ReaderTCP, WaveformFifo::defaultReaderPolicy(WaveformFifo::ReaderTCP));
             tcpDataOutputThread = new TCPDataOutputThread(waveformFifo, rhxController->getSampleRate(), state, this);
+            tcpDataOutputThread->setThreadScheduler(threadScheduler);
         }
 
         state->tcpWaveformDataCommunicator->moveToThread(tcpDataOutputThread);
@@ -231,7 +335,9 @@ void ControllerInterface::runTCPDataOutputThread()
 
         // This starts the thread running, ideally on its own CPU core.
         tcpDataOutputThread->start();
-        tcpDataOutputThread->setPriority(QThread::HighestPriority);
+        if (threadScheduler->requestedPolicy() == ThreadScheduler::PolicyDefault) {
+            tcpDataOutputThread->setPriority(QThread::HighestPriority);  // Otherwise, the thread sets its own scheduling policy.
+        }
 
         // This activates the thread so it can do useful activity.
         tcpDataOutputThread->startRunning();
@@ -750,6 +856,13 @@ void ControllerInterface::runController()
         return;
     }
 
+    latencyTracer->reset();
+    threadScheduler->resetJitter();
+
+    // Register band demand before any data is processed, so that the first blocks contain every band read.
+    updateDisplayBandDemand();
+    updateDiskBandDemand();
+
     usbDataThread->start();
     waveformProcessorThread->start();
     saveToDiskThread->start();
@@ -882,18 +995,6 @@ void ControllerInterface::runController()
 
 //            double plotTime = (double) plotTimer.nsecsElapsed();
 
-            if (!audioThread) {
-                if (waveformFifo->requestReadNewData(WaveformFifo::ReaderAudio, numSamples)) {
-                    waveformFifo->freeOldData(WaveformFifo::ReaderAudio);
-                }
-            }
-
-            if (!tcpDataOutputThread) {
-                if (waveformFifo->requestReadNewData(WaveformFifo::ReaderTCP, numSamples)) {
-                    waveformFifo->freeOldData(WaveformFifo::ReaderTCP);
-                }
-            }
-
             for (int i = 0; i < numSamples; ++i) {
                 currentTimeStamp = (int) timeStamps[i];
                 if (currentTimeStamp - lastTimeStamp != 1 && lastTimeStamp != -1) {
@@ -972,6 +1073,11 @@ void ControllerInterface::runController()
 
     usbStreamFifo->resetBuffer();
 
+    QString latencyReportFilename = state->latencyReportFilename->getValueString();
+    if (!latencyReportFilename.isEmpty()) {
+        latencyTracer->writeCsv(latencyReportFilename.toStdString());
+    }
+
     delete [] timeStamps;
     fill(cpuLoadHistory.begin(), cpuLoadHistory.end(), 0.0);
     emit cpuLoadPercent(0.0);
@@ -1781,6 +1887,75 @@ double ControllerInterface::swBufferPercentFull() const
     return (std::max)(waveformFifo->percentFull(), usbStreamFifo->percentFull());
 }
 
+// Time average and median software referencing of every amplifier channel on synthetic data, so the cost of each
+// can be compared against real time on this computer.
+std::string ControllerInterface::softwareReferenceBenchmarkReport() const
+{
+    return SoftwareReferenceProcessor::benchmarkReport(state->getControllerTypeEnum(), rhxController->getNumEnabledDataStreams(),
+                                                       state->sampleRate->getNumericValue());
+}
+
+// Time streaming synthetic USB data blocks (for the current number of data streams) through a separate DataStreamFifo,
+// so its throughput can be compared against the USB data rate on this computer.
+std::string ControllerInterface::dataStreamFifoBenchmarkReport() const
+{
+    ControllerType type = state->getControllerTypeEnum();
+    return DataStreamFifo::benchmarkReport(RHXDataBlock::dataBlockSizeInWords(type, rhxController->getNumEnabledDataStreams()),
+                                           RHXDataBlock::samplesPerDataBlock(type), state->sampleRate->getNumericValue());
+}
+
+// Compare the first touch and random reads of a streaming memory buffer with ordinary heap memory, so the effect of
+// pre-faulting, huge pages, and memory locking can be seen on this computer.
+std::string ControllerInterface::streamingMemoryBenchmarkReport() const
+{
+    return StreamingMemory::benchmarkReport();
+}
+
+// Check that mirrored ring buffers wrap around correctly, and compare their throughput with the overhang copy that
+// WaveformFifo needs without them.
+std::string ControllerInterface::mirroredMemoryBenchmarkReport() const
+{
+    return StreamingMemory::mirroredBenchmarkReport();
+}
+
+// Check single-pass demultiplexing of synthetic USB data (for the current number of data streams) against per-signal
+// RHXDataReader reads, and time both.
+std::string ControllerInterface::demultiplexerBenchmarkReport() const
+{
+    return RHXDataDemultiplexer::benchmarkReport(state->getControllerTypeEnum(), rhxController->getNumEnabledDataStreams(),
+                                                 state->sampleRate->getNumericValue());
+}
+
+// Slow-reader policy for a WaveformFifo reader: the default, unless display and audio data may be dropped.
+WaveformFifo::ReaderPolicy ControllerInterface::readerPolicy(WaveformFifo::Reader reader) const
+{
+    if ((reader == WaveformFifo::ReaderDisplay || reader == WaveformFifo::ReaderAudio) &&
+            state->dropDisplayAudioDataWhenBehind->getValue()) {
+        return WaveformFifo::PolicyDropOldest;
+    }
+    return WaveformFifo::defaultReaderPolicy(reader);
+}
+
+// Rank the CPU thread counts tried by the CPU diagnostic (run at startup) from fastest to slowest.
+std::string ControllerInterface::cpuThreadCountReport() const
+{
+    std::vector<int> threadCounts;
+    for (int i = 0; i < state->cpuThreadDiagnosticTimes.size(); ++i) {
+        if (state->cpuThreadDiagnosticTimes[i] >= 0.0f) threadCounts.push_back(i + 1);
+    }
+    if (threadCounts.empty()) return "CPU diagnostic has not been run";
+
+    std::stable_sort(threadCounts.begin(), threadCounts.end(), [this](int a, int b)
+        { return state->cpuThreadDiagnosticTimes[a - 1] < state->cpuThreadDiagnosticTimes[b - 1]; });
+    std::ostringstream out;
+    out << state->cpuInfo.name.toStdString() << " diagnostic time by thread count, fastest first:";
+    for (int rank = 0; rank < (int) threadCounts.size(); ++rank) {
+        out << (rank == 0 ? " " : "; ") << threadCounts[rank] << " threads " <<
+               state->cpuThreadDiagnosticTimes[threadCounts[rank] - 1] << " ms";
+    }
+    return out.str();
+}
+
 void ControllerInterface::uploadAmpSettleSettings()
 {
     if (state->uploadInProgress->getValue()) {
@@ -37,6 +37,8 @@
 #include "datafilereader.h"
 #include "rhxglobals.h"
 #include "datastreamfifo.h"
+#include "latencytracer.h"
+#include "threadscheduling.h"
 #include "usbdatathread.h"
 #include "waveformprocessorthread.h"
 #include "rhxregisters.h"
@@ -136,6 +138,27 @@ public:
 
     double swBufferPercentFull() const;
     double latestWaveformProcessorCpuLoad() const { return waveformProcessorCpuLoad; }
+    double latestSoftwareReferenceCpuLoad() const { return softwareReferenceCpuLoad; }
+    USBFrameStatistics usbFrameStatistics() const { return usbDataThread->frameStatistics(); }
+    std::string pipelineLatencyReport() const { return latencyTracer->report(); }
+    std::string threadSchedulingReport() const { return threadScheduler->report(); }
+    std::string softwareReferenceBenchmarkReport() const;
+    std::string dataStreamFifoBenchmarkReport() const;
+    std::string dataEventBenchmarkReport() const { return DataEvent::benchmarkReport(); }
+    std::string streamingMemoryBenchmarkReport() const;
+    std::string mirroredMemoryBenchmarkReport() const;
+    std::string demultiplexerBenchmarkReport() const;
+    std::string spikeCrossingBenchmarkReport() const { return CPUInterface::crossingBenchmarkReport(); }
+    std::string cpuThreadCountReport() const;
+    WaveformFifo::ReaderPolicy readerPolicy(WaveformFifo::Reader reader) const;
+    std::string waveformLookupBenchmarkReport() const { return waveformFifo->lookupBenchmarkReport(); }
+    std::string cursorPaddingBenchmarkReport() const { return WaveformFifo::cursorPaddingBenchmarkReport(); }
+    std::string waveformReaderStatusReport() const { return waveformFifo->readerStatusReport(state->sampleRate->getNumericValue()); }
+    WaveformFifo::ReaderStatistics waveformReaderStatistics(WaveformFifo::Reader reader) const { return waveformFifo->readerStatistics(reader); }
+    int slowestWaveformReader() const { return waveformFifo->slowestReader(); }
+    int latestUsbBlocksPerRead() const { return usbBlocksPerRead; }
+    double latestUsbReadLatencyMsec() const { return usbReadLatencyMsec; }
+    int usbLowLatencyTargetMisses() const { return usbDataThread->lowLatencyTargetMissCount(); }
 
     void uploadAmpSettleSettings();
     void uploadChargeRecoverySettings();
@@ -161,8 +184,9 @@ public slots:
     void manualStimTriggerPulse(QString keyName);
 
 private slots:
-    void updateHardwareFifo(double percentFull) { emit setHardwareFifoStatus(percentFull); }
+    void updateHardwareFifo(double percentFull, int numBlocksPerRead, double readLatencyMsec);
     void updateWaveformProcessorCpuLoad(double percentLoad) { waveformProcessorCpuLoad = percentLoad; }
+    void updateSoftwareReferenceCpuLoad(double percentLoad) { softwareReferenceCpuLoad = percentLoad; }
 
 private:
     void openController(const QString& boardSerialNumber);
@@ -176,6 +200,8 @@ private:
 
     void sendTCPError(QString errorMessage);
     void pipeReadErrorMessage(int errorID);
+    void updateDisplayBandDemand();
+    void updateDiskBandDemand();
 
     SystemState* state;
     AbstractRHXController* rhxController;
@@ -188,6 +214,8 @@ private:
     USBDataThread* usbDataThread;
     WaveformFifo* waveformFifo;
     WaveformProcessorThread* waveformProcessorThread;
+    LatencyTracer* latencyTracer;
+    ThreadScheduler* threadScheduler;
 
     MultiColumnDisplay* display;
     AbstractPanel* controlPanel;
@@ -207,7 +235,10 @@ private:
     QString currentAudioChannel;
 
     double hardwareFifoPercentFull;
+    int usbBlocksPerRead;
+    double usbReadLatencyMsec;
     double waveformProcessorCpuLoad;
+    double softwareReferenceCpuLoad;  // portion of waveformProcessorCpuLoad spent on software referencing
     std::vector<double> cpuLoadHistory;
 
     bool is7310;
@@ -0,0 +1,94 @@
+//------------------------------------------------------------------------------
+//
+//  Intan Technologies RHX Data Acquisition Software
+//  Version 3.4.0
+//
+//  Copyright (c) 2020-2025 Intan Technologies
+//
+//  This file is part of the Intan Technologies RHX Data Acquisition Software.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published
+//  by the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//  This software is provided 'as-is', without any express or implied warranty.
+//  In no event will the authors be held liable for any damages arising from
+//  the use of this software.
+//
+//  See <http://www.intantech.com> for documentation and product information.
+//
+//------------------------------------------------------------------------------
+
+#include <sstream>
+#include <thread>
+#include "dataevent.h"
+
+// Measure how long a blocked thread takes to wake after notify(), and compare this with the usleep(100) polling loops
+// that pipeline threads used before.  A second thread waits for each of a series of notifications sent at irregular
+// intervals, so that it is always asleep when the notification arrives.
+std::string DataEvent::benchmarkReport()
+{
+    const int Repetitions = 1000;
+    const int PollMicroseconds = 100;
+
+    DataEvent event;
+    std::atomic<int> sent(0);
+    std::atomic<int> received(0);
+    std::atomic<int64_t> sendTimeNs(0);
+    LatencyHistogram eventLatency;
+    LatencyHistogram pollLatency;
+
+    auto nowNs = []() {
+        return (int64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+    };
+
+    for (int polling = 0; polling < 2; ++polling) {
+        sent.store(0);
+        received.store(0);
+        std::thread waiter([&]() {
+            for (int i = 1; i <= Repetitions; ++i) {
+                if (polling) {
+                    while (sent.load(std::memory_order_acquire) < i) {
+                        std::this_thread::sleep_for(std::chrono::microseconds(PollMicroseconds));
+                    }
+                    pollLatency.record((nowNs() - sendTimeNs.load(std::memory_order_relaxed)) / 1000);
+                } else {
+                    while (!event.waitFor([&]() { return sent.load(std::memory_order_acquire) >= i; },
+                                          IdleWaitMicroseconds, &eventLatency)) {}
+                }
+                received.store(i, std::memory_order_release);
+            }
+        });
+        uint32_t seed = 1;
+        for (int i = 1; i <= Repetitions; ++i) {
+            seed = 1664525 * seed + 1013904223;
+            std::this_thread::sleep_for(std::chrono::microseconds(200 + (seed >> 24)));
+            sendTimeNs.store(nowNs(), std::memory_order_relaxed);
+            sent.store(i, std::memory_order_release);
+            event.notify();
+            while (received.load(std::memory_order_acquire) < i) std::this_thread::yield();
+        }
+        waiter.join();
+    }
+
+    std::ostringstream out;
+    out << "Wakeup latency over " << Repetitions << " notifications: DataEvent mean " << eventLatency.meanMicroseconds() <<
+           " us, 99th percentile " << eventLatency.percentileMicroseconds(99.0) << " us, max " <<
+           eventLatency.maxMicroseconds() << " us; " << PollMicroseconds << " us polling mean " <<
+           pollLatency.meanMicroseconds() << " us, 99th percentile " << pollLatency.percentileMicroseconds(99.0) <<
+           " us, max " << pollLatency.maxMicroseconds() << " us";
+    if (eventLatency.count() < (uint64_t) Repetitions) {
+        out << " (" << Repetitions - eventLatency.count() << " notifications arrived before the thread slept)";
+    }
+    return out.str();
+}
@@ -0,0 +1,99 @@
+//------------------------------------------------------------------------------
+//
+//  Intan Technologies RHX Data Acquisition Software
+//  Version 3.4.0
+//
+//  Copyright (c) 2020-2025 Intan Technologies
+//
+//  This file is part of the Intan Technologies RHX Data Acquisition Software.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published
+//  by the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//  This software is provided 'as-is', without any express or implied warranty.
+//  In no event will the authors be held liable for any damages arising from
+//  the use of this software.
+//
+//  See <http://www.intantech.com> for documentation and product information.
+//
+//------------------------------------------------------------------------------
+#ifndef DATAEVENT_H
+#define DATAEVENT_H
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <string>
+#include "latencytracer.h"
+
+// Upper limits on how long pipeline threads block waiting for data or for a start/stop request.  Waits normally end as
+// soon as the event is notified; these limits only bound the delay if a condition changes without a notification
+// (e.g., a stop request while waiting for data).  Threads that also service a Qt event loop use the shorter limit.
+const int DataWaitMicroseconds = 5000;
+const int IdleWaitMicroseconds = 100000;
+const int EventLoopWaitMicroseconds = 1000;
+
+// Cache line size assumed for padding shared atomic variables onto separate lines.
+const int CacheLineSize = 64;
+
+// Notification used by a producer thread to wake consumer threads that are waiting for some condition (e.g., enough
+// data in a FIFO) to become true, so consumers can block instead of polling with usleep().  notify() is cheap if no
+// thread is waiting: the mutex is only locked if a waiter has registered itself.  Optionally, a waiting thread can
+// record its wakeup latency (the time from the notification that satisfied it until it was running again).
+class DataEvent
+{
+public:
+    DataEvent() :
+        numWaiters(0),
+        notifyTime(std::chrono::steady_clock::time_point()) {}
+
+    // Call after making the change that waiting threads may be looking for.
+    inline void notify()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);  // Pairs with fence in waitFor().
+        if (numWaiters.load(std::memory_order_relaxed) > 0) {
+            std::lock_guard<std::mutex> lock(mtx);
+            notifyTime = std::chrono::steady_clock::now();
+            cv.notify_all();
+        }
+    }
+
+    // Block until ready() returns true, or until timeoutMicroseconds have elapsed.  Return the final value of ready().
+    template <typename Predicate>
+    inline bool waitFor(Predicate ready, int timeoutMicroseconds, LatencyHistogram* wakeupLatency = nullptr)
+    {
+        if (ready()) return true;
+        std::unique_lock<std::mutex> lock(mtx);
+        numWaiters.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);  // Registration must be visible before ready() is checked again.
+        std::chrono::steady_clock::time_point waitStart = std::chrono::steady_clock::now();
+        bool result = cv.wait_for(lock, std::chrono::microseconds(timeoutMicroseconds), ready);
+        numWaiters.fetch_sub(1);
+        if (wakeupLatency && result && notifyTime > waitStart) {
+            wakeupLatency->record(std::chrono::duration_cast<std::chrono::microseconds>(
+                                      std::chrono::steady_clock::now() - notifyTime).count());
+        }
+        return result;
+    }
+
+    static std::string benchmarkReport();
+
+private:
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::atomic<int> numWaiters;
+    std::chrono::steady_clock::time_point notifyTime;  // Protected by mtx.
+};
+
+#endif // DATAEVENT_H
@@ -29,14 +29,21 @@
 //------------------------------------------------------------------------------
 
 #include <iostream>
+#include <sstream>
 #include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
 #include "rhxglobals.h"
+#include "streamingmemory.h"
 #include "datastreamfifo.h"
 
 // Create a circular buffer for USB data.  If data will be read using a pointer returned from
-// pointerToData(), then a maxReadLength must be defined to allocate extra space beyond the 'end'
-// of the circular buffer to maintain contiguous data arrays during these reads.  If data will only
-// be read using readFromBuffer(), then maxReadLength can be omitted.
+// pointerToData() or written using a pointer returned from reserveWriteSpace(), then a maxReadLength
+// must be defined to allocate extra space beyond the 'end' of the circular buffer to maintain contiguous
+// data arrays during these reads and writes.  If data will only be accessed using readFromBuffer() and
+// writeToBuffer(), then maxReadLength can be omitted.
 DataStreamFifo::DataStreamFifo(int bufferSize_, int maxReadLength_) :
     bufferSize(bufferSize_),
     maxReadLength(maxReadLength_)
@@ -44,73 +51,143 @@ DataStreamFifo::DataStreamFifo(int bufferSize_, int maxReadLength_) :
     int bufferSizeWithExtra = bufferSize + maxReadLength;
     memoryNeededGB = sizeof(uint16_t) * bufferSizeWithExtra / (1024.0 * 1024.0 * 1024.0);
     std::cout << "DataStreamFifo: Allocating " << 2 * bufferSizeWithExtra / 1.0e6 << " MBytes for FIFO buffer." << std::endl;
-    buffer = nullptr;
-
-    memoryAllocated = true;
-    try {
-        buffer = new uint16_t [bufferSizeWithExtra];
-    } catch (std::bad_alloc&) {
-        memoryAllocated = false;
-        std::cerr << "Error: DataStreamFifo constructor could not allocate " << memoryNeededGB << " GB of memory." << std::endl;
-    }
-
+    buffer = StreamingMemory::allocateArray<uint16_t>(bufferSizeWithExtra);
+    memoryAllocated = buffer != nullptr;
     if (!buffer) {
-        std::cerr << "Error: DataStreamFifo constructor could not allocate " << 2 * bufferSizeWithExtra << " bytes of memory." << std::endl;
+        std::cerr << "Error: DataStreamFifo constructor could not allocate " << memoryNeededGB << " GB of memory." << std::endl;
     }
     resetBuffer();
 }
 
 DataStreamFifo::~DataStreamFifo()
 {
-    delete [] buffer;
+    StreamingMemory::release(buffer);
 }
 
+// Write numWords of data (stored as little-endian byte pairs at dataSource) to the circular buffer.  This function
+// must only be called from the producer thread.
 bool DataStreamFifo::writeToBuffer(const uint8_t* dataSource, int numWords)
 {
+    int64_t wordsWritten = totalWordsWritten.load(std::memory_order_relaxed);
+    if (bufferSize - (wordsWritten - cachedTotalWordsRead) < numWords) {
+        cachedTotalWordsRead = totalWordsRead.load(std::memory_order_acquire);
+        if (bufferSize - (wordsWritten - cachedTotalWordsRead) < numWords) {
+            std::cerr << "DataStreamFifo: Buffer overrun on request of " << numWords << " words." << '\n';
+            std::cerr << "   ...only " << bufferSize - (wordsWritten - cachedTotalWordsRead) << " words are available." << '\n';
+            return false;  // Buffer overrun error
+        }
+    }
+
+    // Copy in at most two contiguous segments so the inner loop doesn't need to check for wraparound.
     const uint8_t* pRead = dataSource;
-    uint16_t highByte, lowByte;
-
-    if (freeWords.tryAcquire(numWords)) {
-        for (int i = 0; i < numWords; ++i) {
-            // TODO: Try using bitfields or unions to speed up 2 x byte --> uint16.
-            lowByte = (uint16_t) (*pRead);
-            pRead++;
-            highByte = (uint16_t) (*pRead);
-            pRead++;
-            buffer[bufferWriteIndex++] = lowByte | (highByte << 8);
-            if (bufferWriteIndex >= bufferSize) {
-                bufferWriteIndex = 0;
-            }
+    int wordsRemaining = numWords;
+    while (wordsRemaining > 0) {
+        int segmentLength = std::min(wordsRemaining, bufferSize - bufferWriteIndex);
+        uint16_t* pWrite = &buffer[bufferWriteIndex];
+        for (int i = 0; i < segmentLength; ++i) {
+            pWrite[i] = (uint16_t) pRead[0] | ((uint16_t) pRead[1] << 8);
+            pRead += 2;
         }
-        usedWords.release(numWords);
-        return true;
-    } else {
-        std::cerr << "DataStreamFifo: Buffer overrun on request of " << numWords << " words." << '\n';
-        std::cerr << "   ...only " << freeWords.available() << " words are available." << '\n';
-        return false;  // Buffer overrun error
+        bufferWriteIndex += segmentLength;
+        if (bufferWriteIndex >= bufferSize) {
+            bufferWriteIndex = 0;
+        }
+        wordsRemaining -= segmentLength;
     }
+
+    // Publish the new data to the consumer.
+    totalWordsWritten.store(wordsWritten + numWords, std::memory_order_release);
+    dataWrittenEvent.notify();
+    return true;
+}
+
+// Alternate method of writing data: Return a pointer to contiguous space for numWords of data in the circular
+// buffer, extending beyond the 'end' of the buffer if necessary.  Data written there (as little-endian byte pairs,
+// see zeroCopyWritesSupported()) is not visible to the consumer until commitWriteSpace() is called.  Reserving
+// space again without committing simply discards the previous reservation.  This method returns nullptr if there
+// is insufficient free space in the circular buffer.  This function must only be called from the producer thread.
+uint16_t* DataStreamFifo::reserveWriteSpace(int numWords)
+{
+    numWordsReserved = 0;
+    if (numWords > maxReadLength) {
+        return nullptr;  // no room beyond the 'end' of the buffer for a contiguous write this long
+    }
+    int64_t wordsWritten = totalWordsWritten.load(std::memory_order_relaxed);
+    if (bufferSize - (wordsWritten - cachedTotalWordsRead) < numWords) {
+        cachedTotalWordsRead = totalWordsRead.load(std::memory_order_acquire);
+        if (bufferSize - (wordsWritten - cachedTotalWordsRead) < numWords) {
+            return nullptr;  // not enough free space
+        }
+    }
+    numWordsReserved = numWords;
+    return &buffer[bufferWriteIndex];
+}
+
+// Make the first numWords of the space returned by the last reserveWriteSpace() call available to the consumer.
+// The reserved space and the consumer's data can never both straddle the 'end' of the buffer, so the extra space
+// there is never in use by pointerToData() while we copy out of it here.
+void DataStreamFifo::commitWriteSpace(int numWords)
+{
+    if (numWords > numWordsReserved) {
+        std::cerr << "DataStreamFifo::commitWriteSpace: numWords exceeds reserved space." << '\n';
+        numWords = numWordsReserved;
+    }
+    if (numWords <= 0) {
+        numWordsReserved = 0;
+        return;
+    }
+    if (bufferWriteIndex + numWords > bufferSize) {
+        // Data was written past the 'end' of the buffer; move it to the beginning where the consumer expects it.
+        int extraWords = bufferWriteIndex + numWords - bufferSize;
+        std::memcpy(&buffer[0], &buffer[bufferSize], BytesPerWord * extraWords);
+    }
+    bufferWriteIndex = (bufferWriteIndex + numWords) % bufferSize;
+    numWordsReserved = 0;
+
+    // Publish the new data to the consumer.
+    totalWordsWritten.store(totalWordsWritten.load(std::memory_order_relaxed) + numWords, std::memory_order_release);
+    dataWrittenEvent.notify();
+}
+
+int64_t DataStreamFifo::wordsUsed() const
+{
+    // Load the read counter first: it can only increase, so the difference can never exceed bufferSize.
+    int64_t wordsRead = totalWordsRead.load(std::memory_order_acquire);
+    return totalWordsWritten.load(std::memory_order_acquire) - wordsRead;
 }
 
 bool DataStreamFifo::dataAvailable(unsigned int numWords) const
 {
-    return ((unsigned int)(usedWords.available()) >= numWords);
+    return ((unsigned int)(wordsUsed()) >= numWords);
+}
+
+// Block the consumer thread until at least numWords of data are available, or until timeoutMicroseconds have elapsed.
+// Return true if the data is available.
+bool DataStreamFifo::waitForData(int numWords, int timeoutMicroseconds, LatencyHistogram* wakeupLatency)
+{
+    return dataWrittenEvent.waitFor([this, numWords]() { return wordsUsed() >= numWords; }, timeoutMicroseconds, wakeupLatency);
 }
 
 int DataStreamFifo::wordsAvailable() const
 {
-    return usedWords.available();
+    return (int) wordsUsed();
 }
 
 double DataStreamFifo::percentFull() const
 {
-    return 100.0 * ((double)usedWords.available() / (double)bufferSize);
+    return 100.0 * ((double)wordsUsed() / (double)bufferSize);
 }
 
-// Copy numWords of data from the circular buffer to memory location dataSink.
+// Copy numWords of data from the circular buffer to memory location dataSink.  This function must only be
+// called from the consumer thread.
 bool DataStreamFifo::readFromBuffer(uint16_t *dataSink, int numWords)
 {
-    if (!usedWords.tryAcquire(numWords)) {
-        return false;  // Not enough data available in buffer
+    int64_t wordsRead = totalWordsRead.load(std::memory_order_relaxed);
+    if (cachedTotalWordsWritten - wordsRead < numWords) {
+        cachedTotalWordsWritten = totalWordsWritten.load(std::memory_order_acquire);
+        if (cachedTotalWordsWritten - wordsRead < numWords) {
+            return false;  // Not enough data available in buffer
+        }
     }
 
     if (bufferReadIndex + numWords <= bufferSize) {
@@ -122,12 +199,13 @@ bool DataStreamFifo::readFromBuffer(uint16_t *dataSink, int numWords)
     } else {
         int numWordsFirstPart = bufferSize - bufferReadIndex;
         std::memcpy(dataSink, &buffer[bufferReadIndex], BytesPerWord * numWordsFirstPart);
-        bufferReadIndex = 0;
         int numWordsSecondPart = numWords - numWordsFirstPart;
         std::memcpy(&dataSink[numWordsFirstPart], buffer, BytesPerWord * numWordsSecondPart);
         bufferReadIndex = numWordsSecondPart;
     }
-    freeWords.release(numWords);
+
+    // Return the space to the producer.
+    totalWordsRead.store(wordsRead + numWords, std::memory_order_release);
     return true;
 }
 
@@ -142,8 +220,12 @@ uint16_t* DataStreamFifo::pointerToData(int numWordsBeToRead_)
         std::cerr << "DataStreamFifo::pointerToData: numWordsToBeRead exceeds maxReadLength." << '\n';
         return nullptr;
     }
-    if (!usedWords.tryAcquire(numWordsToBeRead)) {
-        return nullptr;  // not enough data available to read
+    int64_t wordsRead = totalWordsRead.load(std::memory_order_relaxed);
+    if (cachedTotalWordsWritten - wordsRead < numWordsToBeRead) {
+        cachedTotalWordsWritten = totalWordsWritten.load(std::memory_order_acquire);
+        if (cachedTotalWordsWritten - wordsRead < numWordsToBeRead) {
+            return nullptr;  // not enough data available to read
+        }
     }
     if (bufferReadIndex + numWordsToBeRead > bufferSize) {
         // Our read will overrun the end of the buffer; copy data to the extra space allocated after the
@@ -163,16 +245,78 @@ uint16_t* DataStreamFifo::pointerToData(int numWordsBeToRead_)
 void DataStreamFifo::freeData()
 {
     bufferReadIndex = (bufferReadIndex + numWordsToBeRead) % bufferSize; // okay to use % operator since first quantity must be positive
-    freeWords.release(numWordsToBeRead);
+    totalWordsRead.store(totalWordsRead.load(std::memory_order_relaxed) + numWordsToBeRead, std::memory_order_release);
 }
 
+// Empty the buffer.  This function must not be called while either the producer or consumer thread is active.
 void DataStreamFifo::resetBuffer()
 {
-    freeWords.acquire(freeWords.available());
-    usedWords.acquire(usedWords.available());
     bufferWriteIndex = 0;
     bufferReadIndex = 0;
-    freeWords.release(bufferSize);
+    numWordsReserved = 0;
     numWordsToBeRead = 0;
+    cachedTotalWordsRead = 0;
+    cachedTotalWordsWritten = 0;
+    totalWordsRead.store(0, std::memory_order_relaxed);
+    totalWordsWritten.store(0, std::memory_order_release);
 }
 
+// Stream synthetic data blocks through a separate buffer, with a producer thread writing the way USBDataThread does
+// and a consumer thread reading the way WaveformProcessorThread does, and report the throughput and whether every
+// word arrived intact and in order.
+std::string DataStreamFifo::benchmarkReport(int wordsPerBlock, int samplesPerBlock, double sampleRate)
+{
+    const int BlocksPerTransfer = 4;
+    const int TransfersInBuffer = 64;
+    const int64_t TotalWords = 32 * 1024 * 1024;
+
+    const int transferWords = BlocksPerTransfer * wordsPerBlock;
+    const int64_t numTransfers = TotalWords / transferWords;
+    DataStreamFifo fifo(TransfersInBuffer * transferWords, transferWords);
+    if (!fifo.memoryAllocated) return "DataStreamFifo benchmark: could not allocate memory";
+
+    std::vector<uint8_t> sourceBytes(BytesPerWord * transferWords);
+    bool zeroCopy = zeroCopyWritesSupported();
+    bool dataIntact = true;
+
+    auto start = std::chrono::steady_clock::now();
+    std::thread producer([&]() {
+        uint16_t value = 0;
+        for (int64_t transfer = 0; transfer < numTransfers; ++transfer) {
+            uint16_t* space = nullptr;
+            while (zeroCopy && !(space = fifo.reserveWriteSpace(transferWords))) std::this_thread::yield();
+            if (zeroCopy) {
+                for (int i = 0; i < transferWords; ++i) space[i] = value++;
+                fifo.commitWriteSpace(transferWords);
+            } else {
+                for (int i = 0; i < transferWords; ++i) {
+                    sourceBytes[2 * i] = (uint8_t) (value & 0xff);
+                    sourceBytes[2 * i + 1] = (uint8_t) (value >> 8);
+                    ++value;
+                }
+                while (fifo.wordsAvailable() > fifo.bufferSize - transferWords) std::this_thread::yield();
+                fifo.writeToBuffer(sourceBytes.data(), transferWords);
+            }
+        }
+    });
+    uint16_t expected = 0;
+    for (int64_t transfer = 0; transfer < numTransfers; ++transfer) {
+        while (!fifo.waitForData(transferWords, DataWaitMicroseconds)) {}
+        const uint16_t* data = fifo.pointerToData(transferWords);
+        for (int i = 0; i < transferWords; ++i) {
+            if (data[i] != expected++) dataIntact = false;
+        }
+        fifo.freeData();
+    }
+    producer.join();
+    auto end = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    double wordsPerSecond = (double) (numTransfers * transferWords) / seconds;
+    double realTimeWordsPerSecond = sampleRate / samplesPerBlock * wordsPerBlock;
+    std::ostringstream out;
+    out << "DataStreamFifo throughput with " << transferWords << "-word transfers: " <<
+           BytesPerWord * wordsPerSecond / 1.0e6 << " MB/s (" << wordsPerSecond / realTimeWordsPerSecond <<
+           " times real time), data " << (dataIntact ? "intact" : "CORRUPTED");
+    return out.str();
+}
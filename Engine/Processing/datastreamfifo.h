@@ -30,8 +30,16 @@
 #ifndef DATASTREAMFIFO_H
 #define DATASTREAMFIFO_H
 
-#include "semaphore.h"
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include "dataevent.h"
 
+// Single-producer, single-consumer circular buffer for raw USB data.  One thread (USBDataThread) writes
+// to the buffer, and one thread (WaveformProcessorThread) reads from it, so the two threads coordinate
+// through a pair of atomic word counters instead of a mutex and condition variable.  Each side only
+// writes its own counter, and keeps a cached copy of the other side's counter that is only refreshed
+// when the cached value indicates insufficient space or data.
 class DataStreamFifo
 {
 public:
@@ -39,7 +47,10 @@ public:
     ~DataStreamFifo();
 
     bool writeToBuffer(const uint8_t* dataSource, int numWords);
+    uint16_t* reserveWriteSpace(int numWords);
+    void commitWriteSpace(int numWords);
     bool dataAvailable(unsigned int numWords) const;
+    bool waitForData(int numWords, int timeoutMicroseconds, LatencyHistogram* wakeupLatency = nullptr);
 
     bool readFromBuffer(uint16_t *dataSink, int numWords);
     uint16_t* pointerToData(int numWordsToBeRead_);
@@ -51,17 +62,34 @@ public:
 
     bool memoryWasAllocated(double& memoryRequestedGB) const { memoryRequestedGB += memoryNeededGB; return memoryAllocated; }
 
+    // Raw USB data may only be read directly into space returned by reserveWriteSpace() if the host stores
+    // uint16_t values as little-endian byte pairs, the same order used by the USB data stream.
+    static bool zeroCopyWritesSupported() { const uint16_t test = 1; return *((const uint8_t*) &test) == 1; }
+
+    static std::string benchmarkReport(int wordsPerBlock, int samplesPerBlock, double sampleRate);
+
 private:
+    int64_t wordsUsed() const;
+
     uint16_t* buffer;
     int bufferSize;
     int maxReadLength;
-    int numWordsToBeRead;
-    Semaphore freeWords;
-    Semaphore usedWords;
+
+    // Written only by the producer thread.
+    alignas(CacheLineSize) std::atomic<int64_t> totalWordsWritten;
     int bufferWriteIndex;
+    int numWordsReserved;
+    int64_t cachedTotalWordsRead;
+
+    // Written only by the consumer thread.
+    alignas(CacheLineSize) std::atomic<int64_t> totalWordsRead;
     int bufferReadIndex;
+    int numWordsToBeRead;
+    int64_t cachedTotalWordsWritten;
+
+    DataEvent dataWrittenEvent;
 
-    bool memoryAllocated;
+    alignas(CacheLineSize) bool memoryAllocated;
     double memoryNeededGB;
 };
 
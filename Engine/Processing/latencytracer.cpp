@@ -0,0 +1,249 @@
+//------------------------------------------------------------------------------
+//
+//  Intan Technologies RHX Data Acquisition Software
+//  Version 3.4.0
+//
+//  Copyright (c) 2020-2025 Intan Technologies
+//
+//  This file is part of the Intan Technologies RHX Data Acquisition Software.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published
+//  by the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//  This software is provided 'as-is', without any express or implied warranty.
+//  In no event will the authors be held liable for any damages arising from
+//  the use of this software.
+//
+//  See <http://www.intantech.com> for documentation and product information.
+//
+//------------------------------------------------------------------------------
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include "simdsupport.h"
+#include "latencytracer.h"
+
+LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+void LatencyHistogram::reset()
+{
+    for (int i = 0; i < HistogramNumBuckets; ++i) {
+        counts[i].store(0, std::memory_order_relaxed);
+    }
+    totalCount.store(0, std::memory_order_relaxed);
+    totalMicroseconds.store(0, std::memory_order_relaxed);
+    maxValue.store(0, std::memory_order_relaxed);
+}
+
+// Values below 2 * HistogramSubBuckets get a bucket of their own.  Above that, each power-of-two range
+// [2^n, 2^(n+1)) is split into HistogramSubBuckets buckets of equal width.
+int LatencyHistogram::bucketIndex(uint32_t value)
+{
+    if (value < 2 * HistogramSubBuckets) return (int) value;
+    int shift = mostSignificantBit(value) - HistogramSubBucketBits;
+    return 2 * HistogramSubBuckets + (shift - 1) * HistogramSubBuckets + (int) (value >> shift) - HistogramSubBuckets;
+}
+
+int64_t LatencyHistogram::bucketUpperBound(int index)
+{
+    if (index < 2 * HistogramSubBuckets) return index;
+    int shift = (index - 2 * HistogramSubBuckets) / HistogramSubBuckets + 1;
+    int64_t subBucket = (index - 2 * HistogramSubBuckets) % HistogramSubBuckets + HistogramSubBuckets;
+    return ((subBucket + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(int64_t microseconds)
+{
+    if (microseconds < 0) microseconds = 0;
+    if (microseconds > (int64_t) UINT32_MAX) microseconds = (int64_t) UINT32_MAX;
+    counts[bucketIndex((uint32_t) microseconds)].fetch_add(1, std::memory_order_relaxed);
+    totalCount.fetch_add(1, std::memory_order_relaxed);
+    totalMicroseconds.fetch_add(microseconds, std::memory_order_relaxed);
+    int64_t previousMax = maxValue.load(std::memory_order_relaxed);
+    while (microseconds > previousMax &&
+           !maxValue.compare_exchange_weak(previousMax, microseconds, std::memory_order_relaxed)) {}
+}
+
+double LatencyHistogram::meanMicroseconds() const
+{
+    uint64_t n = count();
+    if (n == 0) return 0.0;
+    return (double) totalMicroseconds.load(std::memory_order_relaxed) / (double) n;
+}
+
+// Return the smallest bucket upper bound that is greater than or equal to the given percentage of recorded values.
+int64_t LatencyHistogram::percentileMicroseconds(double percentile) const
+{
+    uint64_t n = count();
+    if (n == 0) return 0;
+    uint64_t target = (uint64_t) std::ceil(percentile / 100.0 * (double) n);
+    if (target < 1) target = 1;
+    uint64_t cumulativeCount = 0;
+    for (int i = 0; i < HistogramNumBuckets; ++i) {
+        cumulativeCount += counts[i].load(std::memory_order_relaxed);
+        if (cumulativeCount >= target) {
+            return (std::min)(bucketUpperBound(i), maxMicroseconds());
+        }
+    }
+    return maxMicroseconds();
+}
+
+LatencyTracer::LatencyTracer(int samplesPerDataBlock_) :
+    samplesPerDataBlock(samplesPerDataBlock_)
+{
+    reset();
+}
+
+// Clear all stamps and histograms.  This function must not be called while the pipeline threads are running.
+void LatencyTracer::reset()
+{
+    for (int i = 0; i < RingSizeInBlocks; ++i) {
+        ring[i].blockNumber.store(-1, std::memory_order_relaxed);
+        ring[i].timeNsec.store(0, std::memory_order_relaxed);
+    }
+    lastBlockAcquired = -1;
+    for (int stage = 0; stage < NumberOfStages; ++stage) {
+        lastBlockStamped[stage].store(-1, std::memory_order_relaxed);
+        histograms[stage].reset();
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+int64_t LatencyTracer::nowNsec()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int64_t LatencyTracer::lastCompleteBlock(uint32_t lastTimeStamp) const
+{
+    return ((int64_t) lastTimeStamp + 1) / samplesPerDataBlock - 1;
+}
+
+// Record the current time as the acquisition time of every block completed since the last call, given the timestamp
+// of the most recent sample read from the USB interface.  If timestamps jump backwards (e.g., a new run) or too far
+// ahead, only the newest block is stamped.
+void LatencyTracer::stampAcquired(uint32_t lastTimeStamp)
+{
+    int64_t block = lastCompleteBlock(lastTimeStamp);
+    if (block < 0 || block == lastBlockAcquired) return;
+    int64_t firstBlock = lastBlockAcquired + 1;
+    if (lastBlockAcquired < 0 || block < lastBlockAcquired || block - lastBlockAcquired > RingSizeInBlocks) {
+        firstBlock = block;
+    }
+
+    int64_t now = nowNsec();
+    for (int64_t b = firstBlock; b <= block; ++b) {
+        BlockStamp& stamp = ring[b & (RingSizeInBlocks - 1)];
+        // Invalidate the entry first, so a reader can't pair the old block number with the new time.
+        stamp.blockNumber.store(-1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        stamp.timeNsec.store(now, std::memory_order_relaxed);
+        stamp.blockNumber.store(b, std::memory_order_release);
+    }
+    lastBlockAcquired = block;
+}
+
+bool LatencyTracer::acquisitionTime(int64_t blockNumber, int64_t &timeNsec) const
+{
+    const BlockStamp& stamp = ring[blockNumber & (RingSizeInBlocks - 1)];
+    if (stamp.blockNumber.load(std::memory_order_acquire) != blockNumber) return false;
+    timeNsec = stamp.timeNsec.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return stamp.blockNumber.load(std::memory_order_relaxed) == blockNumber;
+}
+
+// Record the latency of every block completed at this stage since the last call, given the timestamp of the most
+// recent sample to pass through the stage.  Blocks whose acquisition stamp has already been overwritten (or was
+// never recorded) are skipped.
+void LatencyTracer::stampStage(Stage stage, uint32_t lastTimeStamp)
+{
+    int64_t block = lastCompleteBlock(lastTimeStamp);
+    int64_t lastBlock = lastBlockStamped[stage].load(std::memory_order_relaxed);
+    if (block < 0 || block == lastBlock) return;
+    int64_t firstBlock = lastBlock + 1;
+    if (lastBlock < 0 || block < lastBlock || block - lastBlock > RingSizeInBlocks) {
+        firstBlock = block;
+    }
+
+    int64_t now = nowNsec();
+    int64_t acquiredNsec;
+    for (int64_t b = firstBlock; b <= block; ++b) {
+        if (acquisitionTime(b, acquiredNsec)) {
+            histograms[stage].record((now - acquiredNsec) / 1000);
+        }
+    }
+    lastBlockStamped[stage].store(block, std::memory_order_relaxed);
+}
+
+std::string LatencyTracer::stageName(Stage stage)
+{
+    switch (stage) {
+    case StageProcessed:
+        return "Processed";
+    case StageDisplayRead:
+        return "Display";
+    case StageDiskRead:
+        return "Disk";
+    case StageAudioRead:
+        return "Audio";
+    case StageTCPRead:
+        return "TCP";
+    default:
+        return "Unknown";
+    }
+}
+
+// Return a one-line summary of latency percentiles (in microseconds) for each stage, e.g.,
+// "Processed: n=1200 p50=850us p90=990us p99=1400us p99.9=2100us max=2300us; Display: n=0; ..."
+std::string LatencyTracer::report() const
+{
+    std::ostringstream out;
+    for (int stage = 0; stage < NumberOfStages; ++stage) {
+        const LatencyHistogram& h = histograms[stage];
+        if (stage > 0) out << "; ";
+        out << stageName((Stage) stage) << ": n=" << h.count();
+        if (h.count() > 0) {
+            out << " p50=" << h.percentileMicroseconds(50.0) << "us" <<
+                   " p90=" << h.percentileMicroseconds(90.0) << "us" <<
+                   " p99=" << h.percentileMicroseconds(99.0) << "us" <<
+                   " p99.9=" << h.percentileMicroseconds(99.9) << "us" <<
+                   " max=" << h.maxMicroseconds() << "us";
+        }
+    }
+    return out.str();
+}
+
+bool LatencyTracer::writeCsv(const std::string& filename) const
+{
+    std::ofstream out(filename);
+    if (!out) {
+        std::cerr << "Error: LatencyTracer::writeCsv: could not open " << filename << " for writing." << '\n';
+        return false;
+    }
+    out << "Stage,Blocks,MeanMicroseconds,P50Microseconds,P90Microseconds,P99Microseconds,P99.9Microseconds,MaxMicroseconds\n";
+    for (int stage = 0; stage < NumberOfStages; ++stage) {
+        const LatencyHistogram& h = histograms[stage];
+        out << stageName((Stage) stage) << ',' << h.count() << ',' << h.meanMicroseconds() << ',' <<
+               h.percentileMicroseconds(50.0) << ',' << h.percentileMicroseconds(90.0) << ',' <<
+               h.percentileMicroseconds(99.0) << ',' << h.percentileMicroseconds(99.9) << ',' <<
+               h.maxMicroseconds() << '\n';
+    }
+    return true;
+}
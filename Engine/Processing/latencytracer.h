@@ -0,0 +1,117 @@
+//------------------------------------------------------------------------------
+//
+//  Intan Technologies RHX Data Acquisition Software
+//  Version 3.4.0
+//
+//  Copyright (c) 2020-2025 Intan Technologies
+//
+//  This file is part of the Intan Technologies RHX Data Acquisition Software.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published
+//  by the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//  This software is provided 'as-is', without any express or implied warranty.
+//  In no event will the authors be held liable for any damages arising from
+//  the use of this software.
+//
+//  See <http://www.intantech.com> for documentation and product information.
+//
+//------------------------------------------------------------------------------
+#ifndef LATENCYTRACER_H
+#define LATENCYTRACER_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Lock-free log-linear ("HDR-style") histogram of latencies in microseconds.  Each power-of-two range is divided
+// into HistogramSubBuckets linear buckets, so any recorded value is known to within about 6%.  record() may be
+// called from any thread; readers see a consistent-enough snapshot for reporting.
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    void reset();
+    void record(int64_t microseconds);
+
+    uint64_t count() const { return totalCount.load(std::memory_order_relaxed); }
+    double meanMicroseconds() const;
+    int64_t maxMicroseconds() const { return maxValue.load(std::memory_order_relaxed); }
+    int64_t percentileMicroseconds(double percentile) const;
+
+private:
+    static const int HistogramSubBucketBits = 4;
+    static const int HistogramSubBuckets = 1 << HistogramSubBucketBits;
+    static const int HistogramNumBuckets = 2 * HistogramSubBuckets + (32 - HistogramSubBucketBits - 1) * HistogramSubBuckets;
+
+    static int bucketIndex(uint32_t value);
+    static int64_t bucketUpperBound(int index);
+
+    std::atomic<uint64_t> counts[HistogramNumBuckets];
+    std::atomic<uint64_t> totalCount;
+    std::atomic<int64_t> totalMicroseconds;
+    std::atomic<int64_t> maxValue;
+};
+
+// Measures how long each data block takes to travel from the USB read to later points in the acquisition pipeline.
+// Blocks are identified by the controller timestamps of the samples they contain (block n holds timestamps
+// n * samplesPerDataBlock through (n + 1) * samplesPerDataBlock - 1), so the stages don't need to agree on how many
+// blocks have passed since the start of the run.  USBDataThread is the only caller of stampAcquired(); each stage
+// must only be stamped from one thread at a time.
+class LatencyTracer
+{
+public:
+    enum Stage : int {
+        StageProcessed = 0,     // WaveformProcessorThread committed the block to WaveformFifo.
+        StageDisplayRead,       // The next four stages are in the same order as WaveformFifo::Reader; a reader
+        StageDiskRead,          // reaches its stage when it calls WaveformFifo::freeOldData().
+        StageAudioRead,
+        StageTCPRead,
+        NumberOfStages
+    };
+
+    explicit LatencyTracer(int samplesPerDataBlock_);
+
+    void reset();
+
+    void stampAcquired(uint32_t lastTimeStamp);
+    void stampStage(Stage stage, uint32_t lastTimeStamp);
+
+    static std::string stageName(Stage stage);
+    const LatencyHistogram& histogram(Stage stage) const { return histograms[stage]; }
+    std::string report() const;
+    bool writeCsv(const std::string& filename) const;
+
+private:
+    static const int RingSizeInBlocks = 8192;  // Must be a power of two.
+
+    struct BlockStamp {
+        std::atomic<int64_t> blockNumber;
+        std::atomic<int64_t> timeNsec;
+    };
+
+    int samplesPerDataBlock;
+
+    // Returns the number of the last block completed by a sample with the given timestamp, or -1 if none.
+    int64_t lastCompleteBlock(uint32_t lastTimeStamp) const;
+    bool acquisitionTime(int64_t blockNumber, int64_t &timeNsec) const;
+    static int64_t nowNsec();
+
+    BlockStamp ring[RingSizeInBlocks];
+    int64_t lastBlockAcquired;  // Only used by USBDataThread.
+    std::atomic<int64_t> lastBlockStamped[NumberOfStages];
+    LatencyHistogram histograms[NumberOfStages];
+};
+
+#endif // LATENCYTRACER_H
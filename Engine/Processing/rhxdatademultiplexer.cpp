@@ -0,0 +1,393 @@
+//------------------------------------------------------------------------------
+//
+//  Intan Technologies RHX Data Acquisition Software
+//  Version 3.4.0
+//
+//  Copyright (c) 2020-2025 Intan Technologies
+//
+//  This file is part of the Intan Technologies RHX Data Acquisition Software.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published
+//  by the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//  This software is provided 'as-is', without any express or implied warranty.
+//  In no event will the authors be held liable for any damages arising from
+//  the use of this software.
+//
+//  See <http://www.intantech.com> for documentation and product information.
+//
+//------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <sstream>
+#include "simdsupport.h"
+#include "rhxdatareader.h"
+#include "rhxdatademultiplexer.h"
+
+RHXDataDemultiplexer::RHXDataDemultiplexer(ControllerType type_, int numDataStreams_) :
+    type(type_),
+    numDataStreams(numDataStreams_)
+{
+    setNumDataStreams(numDataStreams_);
+}
+
+// Remove all destinations.  Must be called again after the number of data streams changes, since frame word
+// offsets depend on it.
+void RHXDataDemultiplexer::clear()
+{
+    routes.clear();
+    chunkStarts.clear();
+    useWord(4);  // Timestamps are always read (from words 4 and 5).
+    useWord(5);
+}
+
+void RHXDataDemultiplexer::setNumDataStreams(int numDataStreams_)
+{
+    numDataStreams = numDataStreams_;
+    dataFrameSizeInWords = RHXDataBlock::dataBlockSizeInWords(type, numDataStreams) /
+            RHXDataBlock::samplesPerDataBlock(type);
+    tile.assign(dataFrameSizeInWords * TileFrames, 0);
+    clear();
+}
+
+// DC amplifier data, converted to volts (ControllerStimRecord only).
+void RHXDataDemultiplexer::addDcAmplifier(float* buffer, int stream, int channel)
+{
+    addRoute(DcAmplifier, 6 + 2 * (numDataStreams * 3) + 2 * ((numDataStreams * channel) + stream), buffer, nullptr);
+}
+
+// All five stimulation parameters for an individual RHS channel, in the format of RHXDataReader::readStimParamData().
+void RHXDataDemultiplexer::addStimParam(uint16_t* buffer, int stream, int channel)
+{
+    int complianceWord = 6 + 2 * ((numDataStreams * 1) + stream);
+    int stimWord = dataFrameSizeInWords - 18 - (numDataStreams * 4) + stream;
+    addRoute(StimParam, complianceWord, nullptr, buffer, 1U << channel, stimWord, channel);
+    useWord(complianceWord + 1);
+    for (int i = 1; i < 4; ++i) {
+        useWord(stimWord + i * numDataStreams);
+    }
+}
+
+void RHXDataDemultiplexer::addBoardAdc(float* buffer, int channel)
+{
+    addRoute(type == ControllerRecordUSB2 ? BoardAdcUSB2 : BoardAdc, dataFrameSizeInWords - 10 + channel, buffer, nullptr);
+}
+
+// ControllerStimRecord only
+void RHXDataDemultiplexer::addBoardDac(float* buffer, int channel)
+{
+    addRoute(BoardDac, dataFrameSizeInWords - 18 + channel, buffer, nullptr);
+}
+
+void RHXDataDemultiplexer::addDigIn(float* buffer, int channel)
+{
+    addRoute(DigitalBit, dataFrameSizeInWords - 2, buffer, nullptr, 1U << channel);
+}
+
+void RHXDataDemultiplexer::addDigOut(float* buffer, int channel)
+{
+    addRoute(DigitalBit, dataFrameSizeInWords - 1, buffer, nullptr, 1U << channel);
+}
+
+void RHXDataDemultiplexer::addDigInWord(uint16_t* buffer)
+{
+    addRoute(DigitalWord, dataFrameSizeInWords - 2, nullptr, buffer);
+}
+
+void RHXDataDemultiplexer::addDigOutWord(uint16_t* buffer)
+{
+    addRoute(DigitalWord, dataFrameSizeInWords - 1, nullptr, buffer);
+}
+
+void RHXDataDemultiplexer::addRoute(Kind kind, int word, float* analogBuffer, uint16_t* digitalBuffer, uint16_t mask,
+                                    int stimWord, int channel)
+{
+    if ((!analogBuffer && !digitalBuffer) || word < 0 || word >= dataFrameSizeInWords) return;
+
+    Route route;
+    route.kind = kind;
+    route.word = word;
+    route.stimWord = stimWord;
+    route.mask = mask;
+    route.channel = channel;
+    route.analogBuffer = analogBuffer;
+    route.digitalBuffer = digitalBuffer;
+    routes.push_back(route);
+    useWord(word);
+    if (kind == StimParam) useWord(stimWord);
+}
+
+// Make sure the group of eight frame words containing word is transposed into each tile.  Groups are aligned to
+// multiples of eight words, except that the last group ends at the end of the frame so it never reads past the
+// last frame of the data.
+void RHXDataDemultiplexer::useWord(int word)
+{
+    int chunkStart = std::max(0, std::min(word & ~7, dataFrameSizeInWords - 8));
+    std::vector<int>::iterator i = std::lower_bound(chunkStarts.begin(), chunkStarts.end(), chunkStart);
+    if (i == chunkStarts.end() || *i != chunkStart) {
+        chunkStarts.insert(i, chunkStart);
+    }
+}
+
+// Transpose numFrames (at most TileFrames) frames starting at tileStart into tile, for the frame words in use.
+void RHXDataDemultiplexer::loadTile(const uint16_t* tileStart, int numFrames)
+{
+    const int frameWords = dataFrameSizeInWords;
+    int frame = 0;
+#if defined(RHX_SIMD_SSE2)
+    if (frameWords >= 8) {
+        for (; frame + 8 <= numFrames; frame += 8) {
+            const uint16_t* rows = tileStart + frame * frameWords;
+            for (int chunkStart : chunkStarts) {
+                const uint16_t* p = rows + chunkStart;
+                __m128i r0 = _mm_loadu_si128((const __m128i*) (p + 0 * frameWords));
+                __m128i r1 = _mm_loadu_si128((const __m128i*) (p + 1 * frameWords));
+                __m128i r2 = _mm_loadu_si128((const __m128i*) (p + 2 * frameWords));
+                __m128i r3 = _mm_loadu_si128((const __m128i*) (p + 3 * frameWords));
+                __m128i r4 = _mm_loadu_si128((const __m128i*) (p + 4 * frameWords));
+                __m128i r5 = _mm_loadu_si128((const __m128i*) (p + 5 * frameWords));
+                __m128i r6 = _mm_loadu_si128((const __m128i*) (p + 6 * frameWords));
+                __m128i r7 = _mm_loadu_si128((const __m128i*) (p + 7 * frameWords));
+
+                // 8 x 8 transpose of 16-bit words: interleave pairs of rows at 16, 32, then 64 bits.
+                __m128i t0 = _mm_unpacklo_epi16(r0, r1);
+                __m128i t1 = _mm_unpackhi_epi16(r0, r1);
+                __m128i t2 = _mm_unpacklo_epi16(r2, r3);
+                __m128i t3 = _mm_unpackhi_epi16(r2, r3);
+                __m128i t4 = _mm_unpacklo_epi16(r4, r5);
+                __m128i t5 = _mm_unpackhi_epi16(r4, r5);
+                __m128i t6 = _mm_unpacklo_epi16(r6, r7);
+                __m128i t7 = _mm_unpackhi_epi16(r6, r7);
+
+                __m128i u0 = _mm_unpacklo_epi32(t0, t2);
+                __m128i u1 = _mm_unpackhi_epi32(t0, t2);
+                __m128i u2 = _mm_unpacklo_epi32(t1, t3);
+                __m128i u3 = _mm_unpackhi_epi32(t1, t3);
+                __m128i u4 = _mm_unpacklo_epi32(t4, t6);
+                __m128i u5 = _mm_unpackhi_epi32(t4, t6);
+                __m128i u6 = _mm_unpacklo_epi32(t5, t7);
+                __m128i u7 = _mm_unpackhi_epi32(t5, t7);
+
+                uint16_t* q = &tile[chunkStart * TileFrames + frame];
+                _mm_storeu_si128((__m128i*) (q + 0 * TileFrames), _mm_unpacklo_epi64(u0, u4));
+                _mm_storeu_si128((__m128i*) (q + 1 * TileFrames), _mm_unpackhi_epi64(u0, u4));
+                _mm_storeu_si128((__m128i*) (q + 2 * TileFrames), _mm_unpacklo_epi64(u1, u5));
+                _mm_storeu_si128((__m128i*) (q + 3 * TileFrames), _mm_unpackhi_epi64(u1, u5));
+                _mm_storeu_si128((__m128i*) (q + 4 * TileFrames), _mm_unpacklo_epi64(u2, u6));
+                _mm_storeu_si128((__m128i*) (q + 5 * TileFrames), _mm_unpackhi_epi64(u2, u6));
+                _mm_storeu_si128((__m128i*) (q + 6 * TileFrames), _mm_unpacklo_epi64(u3, u7));
+                _mm_storeu_si128((__m128i*) (q + 7 * TileFrames), _mm_unpackhi_epi64(u3, u7));
+            }
+        }
+    }
+#endif
+    for (int chunkStart : chunkStarts) {
+        int chunkEnd = std::min(chunkStart + 8, frameWords);
+        for (int f = frame; f < numFrames; ++f) {
+            const uint16_t* p = tileStart + f * frameWords;
+            for (int word = chunkStart; word < chunkEnd; ++word) {
+                tile[word * TileFrames + f] = p[word];
+            }
+        }
+    }
+}
+
+uint32_t RHXDataDemultiplexer::demultiplex(const uint16_t* start, int numSamples, uint32_t* timeStamps, int writeIndex)
+{
+    for (int firstFrame = 0; firstFrame < numSamples; firstFrame += TileFrames) {
+        const int numFrames = std::min(TileFrames, numSamples - firstFrame);
+        loadTile(start + firstFrame * dataFrameSizeInWords, numFrames);
+        // Blocks are a multiple of TileFrames long, so full tiles are the rule; giving the compiler a constant frame
+        // count lets it vectorize the conversion loops.
+        if (numFrames == TileFrames) {
+            writeTile<TileFrames>(&timeStamps[firstFrame], writeIndex + firstFrame, numFrames);
+        } else {
+            writeTile<0>(&timeStamps[firstFrame], writeIndex + firstFrame, numFrames);
+        }
+    }
+    if (numSamples <= 0) return 0;
+    const int lastFrame = (numSamples - 1) % TileFrames;
+    return (((uint32_t) column(5)[lastFrame]) << 16) | (uint32_t) column(4)[lastFrame];
+}
+
+// Write numFrames frames (Frames, if nonzero) of the current tile to timeStamps and to all other destinations,
+// starting at index out.
+template <int Frames>
+void RHXDataDemultiplexer::writeTile(uint32_t* timeStamps, int out, int numFrames)
+{
+    const int n = Frames > 0 ? Frames : numFrames;
+
+    const uint16_t* timeLow = column(4);
+    const uint16_t* timeHigh = column(5);
+    for (int i = 0; i < n; ++i) timeStamps[i] = (((uint32_t) timeHigh[i]) << 16) | (uint32_t) timeLow[i];
+
+    for (const Route& route : routes) {
+        const uint16_t* c = column(route.word);
+        float* analog = route.analogBuffer ? route.analogBuffer + out : nullptr;
+        uint16_t* digital = route.digitalBuffer ? route.digitalBuffer + out : nullptr;
+        switch (route.kind) {
+        case DcAmplifier:
+            for (int i = 0; i < n; ++i) analog[i] = -0.01923F * (float)((int) c[i] - 512);     // volts
+            break;
+        case BoardAdcUSB2:
+            for (int i = 0; i < n; ++i) analog[i] = 50.354e-6F * (int) c[i];  // volts
+            break;
+        case BoardAdc:
+        case BoardDac:
+            for (int i = 0; i < n; ++i) analog[i] = 312.5e-6F * ((int) c[i] - 32768);  // volts
+            break;
+        case DigitalBit:
+            for (int i = 0; i < n; ++i) analog[i] = (c[i] & route.mask) ? 1.0F : 0.0F;
+            break;
+        case DigitalWord:
+            for (int i = 0; i < n; ++i) digital[i] = c[i];
+            break;
+        case StimParam:
+        {
+            // See RHXDataReader::readStimParamData() for the format, and for why polarity is inverted.
+            const uint16_t* complianceHigh = column(route.word + 1);
+            const uint16_t* stimOn = column(route.stimWord);
+            const uint16_t* stimPol = column(route.stimWord + 1 * numDataStreams);
+            const uint16_t* ampSettle = column(route.stimWord + 2 * numDataStreams);
+            const uint16_t* chargeRecov = column(route.stimWord + 3 * numDataStreams);
+            // Shift each flag down to bit 0 rather than testing it against the mask, and build the result in a local
+            // array (which can't overlap the tile), so that this loop can be vectorized.
+            const int shift = route.channel;
+            uint16_t flags[TileFrames];
+            for (int i = 0; i < n; ++i) {
+                uint16_t compliance = (uint16_t) (((c[i] >> shift) & (complianceHigh[i] == 0)) << 15);
+                flags[i] = compliance | (uint16_t) ((stimOn[i] >> shift) & 1)                  // StimOnFlag
+                                        | (uint16_t) ((((~stimPol[i]) >> shift) & 1) << 8)       // StimPolFlag
+                                        | (uint16_t) (((ampSettle[i] >> shift) & 1) << 13)      // AmpSettleFlag
+                                        | (uint16_t) (((chargeRecov[i] >> shift) & 1) << 14);   // ChargeRecoveryFlag
+            }
+            std::copy(flags, flags + n, digital);
+            break;
+        }
+        }
+    }
+}
+
+// Route every once-per-frame signal of synthetic raw data both through a demultiplexer and through the equivalent
+// RHXDataReader routines, check that every destination matches, and time both.
+std::string RHXDataDemultiplexer::benchmarkReport(ControllerType type, int numDataStreams, double sampleRate)
+{
+    const int NumBlocks = 8;
+    const int Repetitions = 20;
+    const int NumBoardAdcs = 8;
+    const int NumBoardDacs = 8;
+    const int NumDigitalBits = 16;
+    const int numSamples = NumBlocks * RHXDataBlock::samplesPerDataBlock(type);
+    const int channelsPerStream = RHXDataBlock::channelsPerStream(type);
+    const bool stimRecord = type == ControllerStimRecord;
+
+    std::vector<uint16_t> raw(NumBlocks * RHXDataBlock::dataBlockSizeInWords(type, numDataStreams));
+    uint32_t seed = 1;
+    for (int i = 0; i < (int) raw.size(); ++i) {
+        seed = 1664525 * seed + 1013904223;
+        raw[i] = (uint16_t) (seed >> 16);
+    }
+
+    // Destinations [0] are filled by the demultiplexer, [1] by RHXDataReader.
+    int numAnalog = NumBoardAdcs + 2 * NumDigitalBits;
+    if (stimRecord) numAnalog += numDataStreams * channelsPerStream + NumBoardDacs;
+    int numDigital = 2 + (stimRecord ? numDataStreams * channelsPerStream : 0);
+    std::vector<std::vector<float> > analog[2];
+    std::vector<std::vector<uint16_t> > digital[2];
+    std::vector<uint32_t> timeStamps[2];
+    for (int i = 0; i < 2; ++i) {
+        analog[i].assign(numAnalog, std::vector<float>(numSamples, 0.0F));
+        digital[i].assign(numDigital, std::vector<uint16_t>(numSamples, 0));
+        timeStamps[i].assign(numSamples, 0);
+    }
+
+    RHXDataDemultiplexer demultiplexer(type, numDataStreams);
+    RHXDataReader reader(type, numDataStreams, raw.data(), numSamples);
+    std::vector<std::function<void()> > readerCalls;
+    int a = 0;
+    int d = 0;
+    if (stimRecord) {
+        for (int stream = 0; stream < numDataStreams; ++stream) {
+            for (int channel = 0; channel < channelsPerStream; ++channel) {
+                demultiplexer.addDcAmplifier(analog[0][a].data(), stream, channel);
+                float* dcAmplifier = analog[1][a++].data();
+                readerCalls.push_back([&reader, dcAmplifier, stream, channel]() {
+                    reader.readDcAmplifierData(dcAmplifier, stream, channel);
+                });
+                demultiplexer.addStimParam(digital[0][d].data(), stream, channel);
+                uint16_t* stimParam = digital[1][d++].data();
+                readerCalls.push_back([&reader, stimParam, stream, channel]() {
+                    reader.readStimParamData(stimParam, stream, channel);
+                });
+            }
+        }
+        for (int channel = 0; channel < NumBoardDacs; ++channel) {
+            demultiplexer.addBoardDac(analog[0][a].data(), channel);
+            float* boardDac = analog[1][a++].data();
+            readerCalls.push_back([&reader, boardDac, channel]() { reader.readBoardDacData(boardDac, channel); });
+        }
+    }
+    for (int channel = 0; channel < NumBoardAdcs; ++channel) {
+        demultiplexer.addBoardAdc(analog[0][a].data(), channel);
+        float* boardAdc = analog[1][a++].data();
+        readerCalls.push_back([&reader, boardAdc, channel]() { reader.readBoardAdcData(boardAdc, channel); });
+    }
+    for (int channel = 0; channel < NumDigitalBits; ++channel) {
+        demultiplexer.addDigIn(analog[0][a].data(), channel);
+        float* digIn = analog[1][a++].data();
+        readerCalls.push_back([&reader, digIn, channel]() { reader.readDigInData(digIn, channel); });
+        demultiplexer.addDigOut(analog[0][a].data(), channel);
+        float* digOut = analog[1][a++].data();
+        readerCalls.push_back([&reader, digOut, channel]() { reader.readDigOutData(digOut, channel); });
+    }
+    demultiplexer.addDigInWord(digital[0][d].data());
+    uint16_t* digInWord = digital[1][d++].data();
+    readerCalls.push_back([&reader, digInWord]() { reader.readDigInData(digInWord); });
+    demultiplexer.addDigOutWord(digital[0][d].data());
+    uint16_t* digOutWord = digital[1][d++].data();
+    readerCalls.push_back([&reader, digOutWord]() { reader.readDigOutData(digOutWord); });
+
+    auto start = std::chrono::steady_clock::now();
+    for (int rep = 0; rep < Repetitions; ++rep) {
+        demultiplexer.demultiplex(raw.data(), numSamples, timeStamps[0].data(), 0);
+    }
+    auto middle = std::chrono::steady_clock::now();
+    for (int rep = 0; rep < Repetitions; ++rep) {
+        reader.readTimeStampData(timeStamps[1].data());
+        for (const std::function<void()>& readerCall : readerCalls) readerCall();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    int numMismatches = timeStamps[0] == timeStamps[1] ? 0 : 1;
+    for (int i = 0; i < numAnalog; ++i) {
+        if (analog[0][i] != analog[1][i]) ++numMismatches;
+    }
+    for (int i = 0; i < numDigital; ++i) {
+        if (digital[0][i] != digital[1][i]) ++numMismatches;
+    }
+
+    double singlePassMs = std::chrono::duration<double, std::milli>(middle - start).count() / Repetitions;
+    double perSignalMs = std::chrono::duration<double, std::milli>(end - middle).count() / Repetitions;
+    std::ostringstream out;
+    out << "USB data demultiplexing of " << 1 + numAnalog + numDigital << " signals from " << numDataStreams <<
+           " data streams, " << numSamples << " samples (" << 1000.0 * numSamples / sampleRate << " ms real time): " <<
+           "single pass " << singlePassMs << " ms, one pass per signal " << perSignalMs << " ms; ";
+    if (numMismatches == 0) {
+        out << "all signals match";
+    } else {
+        out << numMismatches << " signals DIFFER";
+    }
+    return out.str();
+}
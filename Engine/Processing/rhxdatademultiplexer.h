@@ -0,0 +1,109 @@
+//------------------------------------------------------------------------------
+//
+//  Intan Technologies RHX Data Acquisition Software
+//  Version 3.4.0
+//
+//  Copyright (c) 2020-2025 Intan Technologies
+//
+//  This file is part of the Intan Technologies RHX Data Acquisition Software.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published
+//  by the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//  This software is provided 'as-is', without any express or implied warranty.
+//  In no event will the authors be held liable for any damages arising from
+//  the use of this software.
+//
+//  See <http://www.intantech.com> for documentation and product information.
+//
+//------------------------------------------------------------------------------
+#ifndef RHXDATADEMULTIPLEXER_H
+#define RHXDATADEMULTIPLEXER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "rhxdatablock.h"
+
+// Copies the per-frame signals that WaveformProcessorThread stores (timestamps, DC amplifier and stimulation data,
+// board ADCs, DACs and digital I/O) out of raw USB data in a single pass.  RHXDataReader's routines each walk the whole
+// raw data block with a stride of one frame, so a block is read from memory once per waveform; here the block is read
+// in tiles of TileFrames frames, each tile is transposed so that each frame word's samples lie next to each other,
+// and every destination is then filled from the transposed tile.  Results are identical to RHXDataReader's.
+//
+// Destinations are given as the base addresses of WaveformFifo buffers; demultiplex() writes to the same index in all
+// of them, so the list only needs to be rebuilt when those buffers or the data stream configuration change.
+class RHXDataDemultiplexer
+{
+public:
+    RHXDataDemultiplexer(ControllerType type_, int numDataStreams_);
+
+    static const int TileFrames = 32;
+
+    void clear();
+    void setNumDataStreams(int numDataStreams_);
+    void addDcAmplifier(float* buffer, int stream, int channel);
+    void addStimParam(uint16_t* buffer, int stream, int channel);
+    void addBoardAdc(float* buffer, int channel);
+    void addBoardDac(float* buffer, int channel);
+    void addDigIn(float* buffer, int channel);
+    void addDigOut(float* buffer, int channel);
+    void addDigInWord(uint16_t* buffer);
+    void addDigOutWord(uint16_t* buffer);
+
+    // Demultiplex numSamples frames starting at start, writing timestamps to timeStamps and other signals to index
+    // writeIndex onward of each destination.  Returns the last timestamp read.
+    uint32_t demultiplex(const uint16_t* start, int numSamples, uint32_t* timeStamps, int writeIndex);
+
+    static std::string benchmarkReport(ControllerType type, int numDataStreams, double sampleRate);
+
+private:
+    enum Kind {
+        DcAmplifier,
+        StimParam,
+        BoardAdcUSB2,
+        BoardAdc,
+        BoardDac,
+        DigitalBit,
+        DigitalWord
+    };
+
+    struct Route
+    {
+        Kind kind;
+        int word;           // Frame word read (compliance limit word for StimParam)
+        int stimWord;       // First stimulation flag word (StimParam only)
+        uint16_t mask;
+        int channel;        // Chip channel (StimParam only)
+        float* analogBuffer;
+        uint16_t* digitalBuffer;
+    };
+
+    void addRoute(Kind kind, int word, float* analogBuffer, uint16_t* digitalBuffer, uint16_t mask = 0, int stimWord = 0,
+                  int channel = 0);
+    void useWord(int word);
+    void loadTile(const uint16_t* tileStart, int numFrames);
+    template <int Frames> void writeTile(uint32_t* timeStamps, int out, int numFrames);
+    inline const uint16_t* column(int word) const { return &tile[word * TileFrames]; }
+
+    ControllerType type;
+    int numDataStreams;
+    int dataFrameSizeInWords;
+
+    std::vector<Route> routes;
+
+    std::vector<int> chunkStarts;  // First word of each group of 8 frame words that must be transposed
+    std::vector<uint16_t> tile;    // Transposed tile: tile[word * TileFrames + frame]
+};
+
+#endif // RHXDATADEMULTIPLEXER_H
@@ -236,10 +236,14 @@ void RHXDataReader::readSupplyVoltageData(float* buffer, int stream) const
     pRead += 6; // Skip header and timestamp.
     pRead += (numDataStreams * 1) + stream;     // Align with selected stream and AuxIn data slot.
     pRead += dataFrameSizeInWords * 124;        // Align with "read from Vdd" command.
-    float vdd = 0.0000748F * ((float) *pRead);
-    for (int i = 0; i < RHXDataBlock::samplesPerDataBlock(type); ++i) { // Write same value 128 times since Vdd is sampled at fs/128.
-        *pWrite = vdd;
-        pWrite++;
+    const int samplesPerDataBlock = RHXDataBlock::samplesPerDataBlock(type);
+    for (int block = 0; block < numSamples / samplesPerDataBlock; ++block) {
+        float vdd = 0.0000748F * ((float) *pRead);
+        for (int i = 0; i < samplesPerDataBlock; ++i) { // Write same value 128 times since Vdd is sampled at fs/128.
+            *pWrite = vdd;
+            pWrite++;
+        }
+        pRead += dataFrameSizeInWords * samplesPerDataBlock;
     }
 }
 
@@ -0,0 +1,89 @@
+//------------------------------------------------------------------------------
+//
+//  Intan Technologies RHX Data Acquisition Software
+//  Version 3.4.0
+//
+//  Copyright (c) 2020-2025 Intan Technologies
+//
+//  This file is part of the Intan Technologies RHX Data Acquisition Software.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published
+//  by the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//  This software is provided 'as-is', without any express or implied warranty.
+//  In no event will the authors be held liable for any damages arising from
+//  the use of this software.
+//
+//  See <http://www.intantech.com> for documentation and product information.
+//
+//------------------------------------------------------------------------------
+#ifndef SIMDSUPPORT_H
+#define SIMDSUPPORT_H
+
+#include <cstdint>
+
+// SSE2 is part of the x86-64 baseline, so it may be used unconditionally on 64-bit Intel/AMD builds.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RHX_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+
+// NEON is part of the ARM64 baseline (e.g., Apple silicon).
+#if defined(__ARM_NEON) || defined(_M_ARM64)
+#define RHX_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+// AVX2 code paths are compiled alongside the baseline code, marked with RHX_TARGET_AVX2, and only called
+// after checking cpuSupportsAVX2() at run time.
+#if defined(RHX_SIMD_SSE2) && (defined(__GNUC__) || defined(_MSC_VER))
+#define RHX_SIMD_AVX2
+#include <immintrin.h>
+#if defined(__GNUC__)
+#define RHX_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define RHX_TARGET_AVX2
+#endif
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+bool cpuSupportsAVX2();
+
+// Return the index of the least significant set bit of x, which must be nonzero.
+inline int countTrailingZeros(uint32_t x)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, x);
+    return (int) index;
+#else
+    return __builtin_ctz(x);
+#endif
+}
+
+// Return the index of the most significant set bit of x, which must be nonzero.
+inline int mostSignificantBit(uint32_t x)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse(&index, x);
+    return (int) index;
+#else
+    return 31 - __builtin_clz(x);
+#endif
+}
+
+#endif // SIMDSUPPORT_H
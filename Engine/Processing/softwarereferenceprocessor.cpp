@@ -29,32 +29,30 @@
 //------------------------------------------------------------------------------
 
 #include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <thread>
+#include "simdsupport.h"
 #include "softwarereferenceprocessor.h"
 
 SoftwareReferenceProcessor::SoftwareReferenceProcessor(ControllerType type_, int numDataStreams_, int numSamples_, SystemState* state_) :
     type(type_),
     numDataStreams(numDataStreams_),
     numSamples(numSamples_),
-    state(state_)
+    state(state_),
+    threadScheduler(nullptr)
 {
     dataFrameSizeInWords = RHXDataBlock::dataBlockSizeInWords(type, numDataStreams) /
             RHXDataBlock::samplesPerDataBlock(type);
     misoWordSize = ((type == ControllerStimRecord) ? 2 : 1);
+    medianScratch.resize(1);
 }
 
 SoftwareReferenceProcessor::~SoftwareReferenceProcessor()
 {
-    deleteDataArrays();
-}
-
-void SoftwareReferenceProcessor::deleteDataArrays()
-{
-    for (int i = 0; i < (int) singleReferenceData.size(); ++i) {
-        delete [] singleReferenceData[i];
-    }
-    for (int i = 0; i < (int) multiReferenceData.size(); ++i) {
-        delete [] multiReferenceData[i];
-    }
 }
 
 void SoftwareReferenceProcessor::updateReferenceInfo(const SignalSources* signalSources)
@@ -68,17 +66,15 @@ void SoftwareReferenceProcessor::updateReferenceInfo(const SignalSources* signal
         multiReferenceList[i].clear();
     }
     multiReferenceList.clear();
-
-    deleteDataArrays();
-    singleReferenceData.clear();
-    multiReferenceData.clear();
-
+    multiReferenceMedian.clear();
+    referenceSets.clear();
 
     // Once ALL or PORT X reference list has been created, remember it and just use the index quickly the next time
     // it is encountered.  This saves the time of recreating it and comparing it.  A value of -1 indicates the
     // particular list has not yet been created, otherwise the value holds the index.
-    int allRefIndexShortcut = -1;
-    std::vector<int> portRefIndexShortcut(AbstractRHXController::maxNumSPIPorts(type), -1);
+    // Average and median references are remembered separately ([0] and [1], respectively).
+    int allRefIndexShortcut[2] = { -1, -1 };
+    std::vector<std::vector<int> > portRefIndexShortcut(2, std::vector<int>(AbstractRHXController::maxNumSPIPorts(type), -1));
 
     // Populate with new reference info.
     for (int port = 0; port < signalSources->numPortGroups(); ++port) {
@@ -92,7 +88,15 @@ void SoftwareReferenceProcessor::updateReferenceInfo(const SignalSources* signal
                 signalWithRef.address.channel = channel->getChipChannel();
 
                 // Now, parse reference string from SignalSources.  Examples of reference strings:
-                // "A-001", "A-001,A-002,A-003", "PORT A", "ALL"
+                // "A-001", "A-001,A-002,A-003", "PORT A", "ALL", "MEDIAN", "MEDIAN PORT A", "MEDIAN A-001,A-002,A-003"
+
+                // A "MEDIAN" prefix selects the median of the reference channels instead of their average.  "MEDIAN"
+                // alone is the median of all enabled channels on all SPI ports.
+                bool medianRef = refString.left(6) == "MEDIAN";
+                if (medianRef) {
+                    refString = refString.mid(6).trimmed();
+                    if (refString.isEmpty()) refString = "ALL";
+                }
 
                 bool allRef = refString == "ALL";
                 bool portRef = refString.left(4) == "PORT";
@@ -102,15 +106,15 @@ void SoftwareReferenceProcessor::updateReferenceInfo(const SignalSources* signal
                 }
                 int numRefs = refString.count(QChar(',')) + 1;
 
-                if ((numRefs > 1) || allRef || portRef) {
+                if ((numRefs > 1) || allRef || portRef || medianRef) {
                     // Multi-channel average reference
                     std::vector<StreamChannelPair> refList;
                     bool shortcutFound = false;
 
                     if (allRef) {
                         // "ALL" (All enabled channels on all SPI ports.)
-                        if (allRefIndexShortcut > -1) {
-                            signalWithRef.referenceIndex = allRefIndexShortcut;
+                        if (allRefIndexShortcut[medianRef] > -1) {
+                            signalWithRef.referenceIndex = allRefIndexShortcut[medianRef];
                             shortcutFound = true;
                         } else {
                             char maxPort = (type == ControllerRecordUSB3) ? 'H' : 'D';
@@ -133,8 +137,8 @@ void SoftwareReferenceProcessor::updateReferenceInfo(const SignalSources* signal
                         }
                     } else if (portRef) {
                         // "PORT X" (All enabled channels on SPI port X.)
-                        if (portRefIndexShortcut[portNumber] > -1) {
-                            signalWithRef.referenceIndex = portRefIndexShortcut[portNumber];
+                        if (portRefIndexShortcut[medianRef][portNumber] > -1) {
+                            signalWithRef.referenceIndex = portRefIndexShortcut[medianRef][portNumber];
                             shortcutFound = true;
                         } else {
                             QString portPrefix = refString.right(1) + "-";
@@ -170,15 +174,15 @@ void SoftwareReferenceProcessor::updateReferenceInfo(const SignalSources* signal
                     if (!shortcutFound) {
                         std::sort(refList.begin(), refList.end());  // Sort list to facilitate quick comparison.
 
-                        int foundIndex = findMultiReference(refList, multiReferenceList);
+                        int foundIndex = findMultiReference(refList, medianRef, multiReferenceList);
                         if (foundIndex == -1) {  // New multi-channel reference is not present in reference list.
                             signalWithRef.referenceIndex = (int) multiReferenceList.size();
                             multiReferenceList.push_back(refList);
-                            multiReferenceData.push_back(new int [numSamples]);
+                            multiReferenceMedian.push_back(medianRef);
                             if (allRef) {
-                                allRefIndexShortcut = signalWithRef.referenceIndex;
+                                allRefIndexShortcut[medianRef] = signalWithRef.referenceIndex;
                             } else if (portRef) {
-                                portRefIndexShortcut[portNumber] = signalWithRef.referenceIndex;
+                                portRefIndexShortcut[medianRef][portNumber] = signalWithRef.referenceIndex;
                             }
                         } else {  // New multi-channel reference is already in reference list.
                             signalWithRef.referenceIndex = foundIndex;
@@ -200,7 +204,6 @@ void SoftwareReferenceProcessor::updateReferenceInfo(const SignalSources* signal
                     if (foundIndex == -1) {  // New reference is not present in reference list.
                         signalWithRef.referenceIndex = (int) singleReferenceList.size();
                         singleReferenceList.push_back(refAddress);
-                        singleReferenceData.push_back(new int [numSamples]);
                     } else {  // New reference is already in reference list.
                         signalWithRef.referenceIndex = foundIndex;
                     }
@@ -209,6 +212,15 @@ void SoftwareReferenceProcessor::updateReferenceInfo(const SignalSources* signal
             }
         }
     }
+
+    buildReferenceSets();
+
+    // Use additional threads only when there are enough re-referenced channels to repay the synchronization cost.
+    int numTargets = (int) (signalListSingleReference.size() + signalListMultiReference.size());
+    int numThreads = std::min(MaxReferenceThreads, 1 + numTargets / ChannelsPerReferenceThread);
+    numThreads = std::max(1, std::min(numThreads, (int) std::thread::hardware_concurrency()));
+    workerPool.setNumThreads(numThreads, threadScheduler);
+    medianScratch.resize(numThreads);
 }
 
 int SoftwareReferenceProcessor::findSingleReference(StreamChannelPair singleRef,
@@ -220,12 +232,12 @@ int SoftwareReferenceProcessor::findSingleReference(StreamChannelPair singleRef,
     return -1;  // Reference not found in list.
 }
 
-int SoftwareReferenceProcessor::findMultiReference(const std::vector<StreamChannelPair>& multiRef,
+int SoftwareReferenceProcessor::findMultiReference(const std::vector<StreamChannelPair>& multiRef, bool median,
                                                    const std::vector<std::vector<StreamChannelPair> >& multiRefList) const
 {
     int length = (int) multiRef.size();
     for (int i = 0; i < (int) multiRefList.size(); ++i) {
-        if (length == (int) multiRefList[i].size()) {
+        if (length == (int) multiRefList[i].size() && median == multiReferenceMedian[i]) {
             bool identical = true;
             for (int j = 0; j < length; ++j) {
                 if (multiRef[j] != multiRefList[i][j]) {
@@ -239,129 +251,287 @@ int SoftwareReferenceProcessor::findMultiReference(const std::vector<StreamChann
     return -1;  // Reference not found in list.
 }
 
-void SoftwareReferenceProcessor::applySoftwareReferences(uint16_t* start)
+// Build the list of distinct reference signals from the single-channel and multi-channel reference lists, with the
+// amplifier words each is calculated from and subtracted from, grouped into runs of adjacent channels.
+void SoftwareReferenceProcessor::buildReferenceSets()
 {
-    calculateReferenceSignals(start);
+    referenceSets.clear();
 
+    std::vector<std::vector<int> > targetOffsets(singleReferenceList.size() + multiReferenceList.size());
     for (int i = 0; i < (int) signalListSingleReference.size(); ++i) {
-        const int* refSignal = singleReferenceData[signalListSingleReference[i].referenceIndex];
-        subtractReferenceSignal(signalListSingleReference[i].address, refSignal, start);
+        targetOffsets[signalListSingleReference[i].referenceIndex].push_back(amplifierWordOffset(signalListSingleReference[i].address));
     }
-
     for (int i = 0; i < (int) signalListMultiReference.size(); ++i) {
-        const int* refSignal = multiReferenceData[signalListMultiReference[i].referenceIndex];
-        subtractReferenceSignal(signalListMultiReference[i].address, refSignal, start);
+        targetOffsets[singleReferenceList.size() + signalListMultiReference[i].referenceIndex].push_back(
+                    amplifierWordOffset(signalListMultiReference[i].address));
+    }
+
+    for (int i = 0; i < (int) targetOffsets.size(); ++i) {
+        std::vector<int> sourceOffsets;
+        bool median = false;
+        if (i < (int) singleReferenceList.size()) {
+            sourceOffsets.push_back(amplifierWordOffset(singleReferenceList[i]));
+        } else {
+            median = multiReferenceMedian[i - singleReferenceList.size()];
+            const std::vector<StreamChannelPair>& refList = multiReferenceList[i - singleReferenceList.size()];
+            for (int j = 0; j < (int) refList.size(); ++j) {
+                sourceOffsets.push_back(amplifierWordOffset(refList[j]));
+            }
+        }
+        if (sourceOffsets.empty() || targetOffsets[i].empty()) continue;
+
+        SoftwareReferenceSet refSet;
+        refSet.numSources = (int) sourceOffsets.size();
+        refSet.oneOverN = 1.0 / (double) refSet.numSources;
+        refSet.median = median;
+        refSet.sources = amplifierWordRuns(sourceOffsets);
+        refSet.targets = amplifierWordRuns(targetOffsets[i]);
+        referenceSets.push_back(refSet);
     }
+    referenceValues.resize(referenceSets.size() * numSamples);
 }
 
-void SoftwareReferenceProcessor::calculateReferenceSignals(const uint16_t* start)
+// Return the offset of an amplifier channel's word within each frame of a data block.
+int SoftwareReferenceProcessor::amplifierWordOffset(StreamChannelPair address) const
 {
-    for (int i = 0; i < (int) singleReferenceList.size(); ++i) {
-        readReferenceSignal(singleReferenceList[i], singleReferenceData[i], start);
-    }
+    int offset = 6;  // Skip header and timestamp.
+    offset += misoWordSize * (numDataStreams * 3);  // Skip auxiliary channels.
+    offset += misoWordSize * ((numDataStreams * address.channel) + address.stream);   // Align with selected stream and channel.
+    if (type == ControllerStimRecord) offset++;  // Skip top 16 bits of 32-bit MISO word from RHS system.
+    return offset;
+}
 
-    if (!state->useMedianReference->getValue()) {
-        // Use average (mean)
-        for (int i = 0; i < (int) multiReferenceList.size(); ++i) {
-            readReferenceSignal(multiReferenceList[i][0], multiReferenceData[i], start);
-            for (int j = 1; j < (int) multiReferenceList[i].size(); ++j) {
-                addReferenceSignal(multiReferenceList[i][j], multiReferenceData[i], start);
-            }
-            double oneOverN = 1.0 / (double) multiReferenceList[i].size();
-            for (int t = 0; t < numSamples; ++t) {
-                multiReferenceData[i][t] = round(((double) multiReferenceData[i][t]) * oneOverN);  // Calculate average.
-            }
-        }
-    } else {
-        // Use median
-        for (int i = 0; i < (int) multiReferenceList.size(); ++i) {
-            std::vector<int> samples;
-            samples.resize(multiReferenceList[i].size());
-            for (int t = 0; t < numSamples; ++t) {
-                readReferenceSamples(multiReferenceList[i], t, samples, start);
-                multiReferenceData[i][t] = calculateMedian(samples);
+// Sort a list of amplifier word offsets and merge adjacent channels into runs.  Repeated offsets are kept (in
+// separate runs), so a channel listed twice in a reference is still counted twice.
+std::vector<AmplifierWordRun> SoftwareReferenceProcessor::amplifierWordRuns(std::vector<int> offsets) const
+{
+    std::sort(offsets.begin(), offsets.end());
+    std::vector<AmplifierWordRun> runs;
+    std::vector<bool> used(offsets.size(), false);
+    for (int i = 0; i < (int) offsets.size(); ++i) {
+        if (used[i]) continue;
+        AmplifierWordRun run = { offsets[i], 1 };
+        used[i] = true;
+        for (int j = i + 1; j < (int) offsets.size(); ++j) {
+            if (used[j]) continue;
+            if (offsets[j] > run.firstOffset + run.length * misoWordSize) break;
+            if (offsets[j] == run.firstOffset + run.length * misoWordSize) {
+                run.length++;
+                used[j] = true;
             }
         }
+        runs.push_back(run);
     }
+    return runs;
 }
 
-void SoftwareReferenceProcessor::readReferenceSignal(StreamChannelPair address, int* destination, const uint16_t* start)
+// Return the sum of (word - 32768) over count words spaced stride (1 or 2) words apart.
+static int sumWordRun(const uint16_t* p, int count, int stride)
 {
-    const uint16_t* pRead = start;
-    int* pWrite = destination;
-
-    pRead += 6; // Skip header and timestamp.
-    pRead += misoWordSize * (numDataStreams * 3);  // Skip auxiliary channels.
-    pRead += misoWordSize * ((numDataStreams * address.channel) + address.stream);   // Align with selected stream and channel.
-    if (type == ControllerStimRecord) pRead++;  // Skip top 16 bits of 32-bit MISO word from RHS system.
-    for (int i = 0; i < numSamples; ++i) {
-        *pWrite = (((int) *pRead) - 32768);
-        pWrite++;
-        pRead += dataFrameSizeInWords;
+    int sum = 0;
+    int i = 0;
+    const int lastWord = (count - 1) * stride;
+#if defined(RHX_SIMD_SSE2)
+    // Flip the sign bit to convert each word to (word - 32768) as a signed 16-bit value, then add pairs of words
+    // into 32-bit lanes (using zero weights for the words between channels when stride is 2).
+    const __m128i signBit = _mm_set1_epi16((short) 0x8000);
+    const __m128i weights = (stride == 1) ? _mm_set1_epi16(1) : _mm_set1_epi32(1);
+    __m128i acc = _mm_setzero_si128();
+    for (; i * stride + 8 <= lastWord + 1; i += 8 / stride) {
+        __m128i x = _mm_xor_si128(_mm_loadu_si128((const __m128i*) &p[i * stride]), signBit);
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(x, weights));
     }
+    int32_t lanes[4];
+    _mm_storeu_si128((__m128i*) lanes, acc);
+    sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#elif defined(RHX_SIMD_NEON)
+    // Add raw words into 32-bit lanes, then remove the 32768 offset once at the end.
+    uint32x4_t acc = vdupq_n_u32(0);
+    if (stride == 1) {
+        for (; i + 8 <= count; i += 8) {
+            acc = vpadalq_u16(acc, vld1q_u16(&p[i]));
+        }
+    } else {
+        for (; i * 2 + 16 <= lastWord + 1; i += 8) {
+            acc = vpadalq_u16(acc, vld2q_u16(&p[i * 2]).val[0]);
+        }
+    }
+    uint32_t lanes[4];
+    vst1q_u32(lanes, acc);
+    sum = (int) ((int64_t) lanes[0] + lanes[1] + lanes[2] + lanes[3] - 32768 * (int64_t) i);
+#else
+    (void) lastWord;
+#endif
+    for (; i < count; ++i) {
+        sum += ((int) p[i * stride]) - 32768;
+    }
+    return sum;
 }
 
-void SoftwareReferenceProcessor::addReferenceSignal(StreamChannelPair address, int* destination, const uint16_t* start)
+// Subtract ref from count words spaced stride (1 or 2) words apart, clamping the results to [0, 65535].
+static void subtractFromWordRun(uint16_t* p, int count, int stride, int ref)
 {
-    const uint16_t* pRead = start;
-    int* pWrite = destination;
-
-    pRead += 6; // Skip header and timestamp.
-    pRead += misoWordSize * (numDataStreams * 3);  // Skip auxillary channels.
-    pRead += misoWordSize * ((numDataStreams * address.channel) + address.stream);   // Align with selected stream and channel.
-    if (type == ControllerStimRecord) pRead++;  // Skip top 16 bits of 32-bit MISO word from RHS system.
-    for (int i = 0; i < numSamples; ++i) {
-        *pWrite += (((int) *pRead) - 32768);  // Only difference between this function and readReferenceSignal() is this line.
-        pWrite++;
-        pRead += dataFrameSizeInWords;
+    int i = 0;
+#if defined(RHX_SIMD_SSE2)
+    // Unsigned saturating arithmetic clamps the results; words between channels (stride 2) have zero subtracted.
+    const int lastWord = (count - 1) * stride;
+    const uint16_t magnitude = (uint16_t) std::abs(ref);
+    const __m128i amount = (stride == 1) ? _mm_set1_epi16((short) magnitude) : _mm_set1_epi32(magnitude);
+    for (; i * stride + 8 <= lastWord + 1; i += 8 / stride) {
+        __m128i* pWrite = (__m128i*) &p[i * stride];
+        __m128i x = _mm_loadu_si128(pWrite);
+        x = (ref >= 0) ? _mm_subs_epu16(x, amount) : _mm_adds_epu16(x, amount);
+        _mm_storeu_si128(pWrite, x);
+    }
+#elif defined(RHX_SIMD_NEON)
+    const uint16x8_t amount = vdupq_n_u16((uint16_t) std::abs(ref));
+    if (stride == 1) {
+        for (; i + 8 <= count; i += 8) {
+            uint16x8_t x = vld1q_u16(&p[i]);
+            vst1q_u16(&p[i], (ref >= 0) ? vqsubq_u16(x, amount) : vqaddq_u16(x, amount));
+        }
+    } else {
+        for (; i * 2 + 16 <= (count - 1) * 2 + 1; i += 8) {
+            uint16x8x2_t x = vld2q_u16(&p[i * 2]);
+            x.val[0] = (ref >= 0) ? vqsubq_u16(x.val[0], amount) : vqaddq_u16(x.val[0], amount);
+            vst2q_u16(&p[i * 2], x);
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        int newVal = ((int) p[i * stride]) - ref;
+        newVal = std::max(newVal, 0);
+        newVal = std::min(newVal, 65535);
+        p[i * stride] = (uint16_t) newVal;
     }
 }
 
-void SoftwareReferenceProcessor::subtractReferenceSignal(StreamChannelPair address, const int* refSignal, uint16_t* start)
+void SoftwareReferenceProcessor::applySoftwareReferences(uint16_t* start)
 {
-    uint16_t* pSignal = start;
-
-    pSignal += 6; // Skip header and timestamp.
-    pSignal += misoWordSize * (numDataStreams * 3);  // Skip auxillary channels.
-    pSignal += misoWordSize * ((numDataStreams * address.channel) + address.stream);   // Align with selected stream and channel.
-    if (type == ControllerStimRecord) pSignal++;  // Skip top 16 bits of 32-bit MISO word from RHS system.
-    for (int i = 0; i < numSamples; ++i) {
-        int newVal = ((int) *pSignal) - *refSignal;
-        newVal = std::max(newVal, 0);
-        newVal = std::min(newVal, 65535);
-        *pSignal = (uint16_t) newVal;
-        pSignal += dataFrameSizeInWords;
-        refSignal++;
+    if (referenceSets.empty()) return;
+
+    // Every reference signal is calculated for a frame before any channel in that frame is re-referenced, so frames
+    // are independent and may be divided among worker threads.
+    if (workerPool.numThreads() > 1) {
+        workerPool.run([&](int part, int numParts) {
+            processFrames(start, (numSamples * part) / numParts, (numSamples * (part + 1)) / numParts, medianScratch[part]);
+        });
+    } else {
+        processFrames(start, 0, numSamples, medianScratch[0]);
     }
 }
 
-void SoftwareReferenceProcessor::readReferenceSamples(std::vector<StreamChannelPair> &addresses, int t, std::vector<int> &destination,
-                                                      const uint16_t* start)
+// Calculate each distinct reference signal once per frame from firstFrame up to (but not including) lastFrame, then
+// subtract it from every channel that uses it.
+void SoftwareReferenceProcessor::processFrames(uint16_t* start, int firstFrame, int lastFrame, std::vector<int>& scratch)
 {
-    const uint16_t* pRead;
-
-    for (uint i = 0; i < addresses.size(); ++i) {
-        pRead = start;
-        pRead += 6; // Skip header and timestamp.
-        pRead += misoWordSize * (numDataStreams * 3);  // Skip auxiliary channels.
-        pRead += misoWordSize * ((numDataStreams * addresses[i].channel) + addresses[i].stream);   // Align with selected stream and channel.
-        if (type == ControllerStimRecord) pRead++;  // Skip top 16 bits of 32-bit MISO word from RHS system.
-        pRead += t * dataFrameSizeInWords;  // Jump to requested time index.
-        destination[i] = (((int) *pRead) - 32768);
+    // Use median for all multi-channel references?  (A processor without a SystemState uses each set's own setting.)
+    const bool useMedian = state && state->useMedianReference->getValue();
+    const int numSets = (int) referenceSets.size();
+
+    for (int set = 0; set < numSets; ++set) {
+        const SoftwareReferenceSet& refSet = referenceSets[set];
+        int* refValues = &referenceValues[set * numSamples];
+        if ((useMedian || refSet.median) && refSet.numSources > 1) {
+            scratch.resize(refSet.numSources);
+            for (int t = firstFrame; t < lastFrame; ++t) {
+                const uint16_t* frame = start + t * dataFrameSizeInWords;
+                int n = 0;
+                for (const AmplifierWordRun& run : refSet.sources) {
+                    for (int j = 0; j < run.length; ++j) {
+                        scratch[n++] = ((int) frame[run.firstOffset + j * misoWordSize]) - 32768;
+                    }
+                }
+                refValues[t] = calculateMedian(scratch);
+            }
+        } else {
+            for (int t = firstFrame; t < lastFrame; ++t) {
+                const uint16_t* frame = start + t * dataFrameSizeInWords;
+                int sum = 0;
+                for (const AmplifierWordRun& run : refSet.sources) {
+                    sum += sumWordRun(&frame[run.firstOffset], run.length, misoWordSize);
+                }
+                refValues[t] = (refSet.numSources == 1) ? sum : (int) round(((double) sum) * refSet.oneOverN);  // Calculate average.
+            }
+        }
+    }
+
+    for (int t = firstFrame; t < lastFrame; ++t) {
+        uint16_t* frame = start + t * dataFrameSizeInWords;
+        for (int set = 0; set < numSets; ++set) {
+            int ref = referenceValues[set * numSamples + t];
+            for (const AmplifierWordRun& run : referenceSets[set].targets) {
+                subtractFromWordRun(&frame[run.firstOffset], run.length, misoWordSize, ref);
+            }
+        }
     }
 }
 
+// Return the median of data, using a linear-time selection rather than a full sort.
 int SoftwareReferenceProcessor::calculateMedian(std::vector<int> &data)
 {
-    int median;
-    std::sort(data.begin(), data.end());    // Warning: This function reorders the input vector!
-
     int length = (int) data.size();
+    std::vector<int>::iterator middle = data.begin() + length / 2;
+    std::nth_element(data.begin(), middle, data.end());    // Warning: This function reorders the input vector!
+
+    int median = *middle;
     bool isOdd = length % 2;
-    if (isOdd) {
-        median = data[length / 2];
-    } else {
-        median = (data[length / 2 - 1] + data[length / 2]) / 2;
+    if (!isOdd) {
+        // All values before the middle are now no greater than it, so the largest of them is the other middle value.
+        median = (*std::max_element(data.begin(), middle) + median) / 2;
     }
     return median;
 }
+
+// Measure the time per data block to calculate and subtract a common reference (average, then median) of all
+// amplifier channels on synthetic data, and report it alongside the real-time duration of one data block.
+std::string SoftwareReferenceProcessor::benchmarkReport(ControllerType type, int numDataStreams, double sampleRate)
+{
+    const int BenchmarkBlocks = 100;
+    const int numSamples = RHXDataBlock::samplesPerDataBlock(type);
+    const int wordsPerBlock = RHXDataBlock::dataBlockSizeInWords(type, numDataStreams);
+    const int numChannels = numDataStreams * RHXDataBlock::channelsPerStream(type);
+
+    SoftwareReferenceProcessor processor(type, numDataStreams, numSamples, nullptr);
+    std::vector<int> offsets;
+    for (int stream = 0; stream < numDataStreams; ++stream) {
+        for (int channel = 0; channel < RHXDataBlock::channelsPerStream(type); ++channel) {
+            StreamChannelPair address;
+            address.stream = stream;
+            address.channel = channel;
+            offsets.push_back(processor.amplifierWordOffset(address));
+        }
+    }
+    SoftwareReferenceSet refSet;
+    refSet.numSources = numChannels;
+    refSet.oneOverN = 1.0 / (double) numChannels;
+    refSet.median = false;
+    refSet.sources = processor.amplifierWordRuns(offsets);
+    refSet.targets = refSet.sources;
+    processor.referenceSets.push_back(refSet);
+    processor.referenceValues.resize(numSamples);
+
+    // Fill the data blocks with low-amplitude noise around the ADC midpoint.
+    std::vector<uint16_t> dataOriginal(BenchmarkBlocks * wordsPerBlock);
+    uint32_t seed = 1;
+    for (int i = 0; i < (int) dataOriginal.size(); ++i) {
+        seed = 1664525 * seed + 1013904223;
+        dataOriginal[i] = (uint16_t) (32768 - 512 + ((seed >> 16) & 0x3ff));
+    }
+
+    std::ostringstream out;
+    out << "Software reference cost for " << numChannels << " channels, " << numSamples << " samples per block (" <<
+           1000.0 * numSamples / sampleRate << " ms real time): ";
+    for (int median = 0; median < 2; ++median) {
+        processor.referenceSets[0].median = median == 1;
+        std::vector<uint16_t> data = dataOriginal;
+        auto start = std::chrono::steady_clock::now();
+        for (int block = 0; block < BenchmarkBlocks; ++block) {
+            processor.processFrames(&data[block * wordsPerBlock], 0, numSamples, processor.medianScratch[0]);
+        }
+        auto end = std::chrono::steady_clock::now();
+        double msPerBlock = std::chrono::duration<double, std::milli>(end - start).count() / BenchmarkBlocks;
+        out << (median ? "; median " : "average ") << msPerBlock << " ms per block";
+    }
+    return out.str();
+}
@@ -32,10 +32,12 @@
 #define SOFTWAREREFERENCEPROCESSOR_H
 
 #include <cstdint>
+#include <string>
 #include <vector>
 #include "signalsources.h"
 #include "abstractrhxcontroller.h"
 #include "rhxdatablock.h"
+#include "cpuworkerpool.h"
 
 struct SignalWithSoftwareReference
 {
@@ -43,6 +45,29 @@ struct SignalWithSoftwareReference
     int referenceIndex;
 };
 
+// Amplifier words at evenly spaced offsets (misoWordSize words apart) within each frame of a data block, so that
+// adjacent channels can be read or re-referenced together.
+struct AmplifierWordRun
+{
+    int firstOffset;
+    int length;
+};
+
+// One distinct reference signal (a single channel, or the average or median of several), with the amplifier words
+// it is calculated from and the amplifier words it is subtracted from.
+struct SoftwareReferenceSet
+{
+    std::vector<AmplifierWordRun> sources;
+    std::vector<AmplifierWordRun> targets;
+    int numSources;
+    double oneOverN;
+    bool median;
+};
+
+// Software referencing is divided among at most MaxReferenceThreads threads, adding one thread for every
+// ChannelsPerReferenceThread re-referenced channels.
+const int MaxReferenceThreads = 4;
+const int ChannelsPerReferenceThread = 512;
 
 class SoftwareReferenceProcessor
 {
@@ -52,6 +77,9 @@ public:
 
     void updateReferenceInfo(const SignalSources* signalSources);
     void applySoftwareReferences(uint16_t* start);
+    void setThreadScheduler(ThreadScheduler* threadScheduler_) { threadScheduler = threadScheduler_; }
+
+    static std::string benchmarkReport(ControllerType type, int numDataStreams, double sampleRate);
 
 private:
     ControllerType type;
@@ -65,22 +93,30 @@ private:
     // Reference signals consisting of a single channel.
     std::vector<SignalWithSoftwareReference> signalListSingleReference;
     std::vector<StreamChannelPair> singleReferenceList;
-    std::vector<int*> singleReferenceData;
 
-    // Reference signals consisting of an average of multiple channels.
+    // Reference signals consisting of an average (or median) of multiple channels.
     std::vector<SignalWithSoftwareReference> signalListMultiReference;
     std::vector<std::vector<StreamChannelPair> > multiReferenceList;
-    std::vector<int*> multiReferenceData;
+    std::vector<bool> multiReferenceMedian;
+
+    // Distinct reference signals, built from the lists above, and their values for the current data block
+    // (referenceValues[set * numSamples + frame]).
+    std::vector<SoftwareReferenceSet> referenceSets;
+    std::vector<int> referenceValues;
+
+    // Frames of each data block are divided among worker threads when there are enough channels to reference.
+    CPUWorkerPool workerPool;
+    ThreadScheduler* threadScheduler;
+    std::vector<std::vector<int> > medianScratch;  // one per worker thread
 
     int findSingleReference(StreamChannelPair singleRef, const std::vector<StreamChannelPair>& singleRefList) const;
-    int findMultiReference(const std::vector<StreamChannelPair>& multiRef, const std::vector<std::vector<StreamChannelPair> >& multiRefList) const;
-    void calculateReferenceSignals(const uint16_t* start);
-    void readReferenceSignal(StreamChannelPair address, int* destination, const uint16_t* start);
-    void addReferenceSignal(StreamChannelPair address, int* destination, const uint16_t* start);
-    void subtractReferenceSignal(StreamChannelPair address, const int* refSignal, uint16_t* start);
-    void readReferenceSamples(std::vector<StreamChannelPair> &addresses, int t, std::vector<int> &destination, const uint16_t* start);
+    int findMultiReference(const std::vector<StreamChannelPair>& multiRef, bool median,
+                           const std::vector<std::vector<StreamChannelPair> >& multiRefList) const;
+    void buildReferenceSets();
+    int amplifierWordOffset(StreamChannelPair address) const;
+    std::vector<AmplifierWordRun> amplifierWordRuns(std::vector<int> offsets) const;
+    void processFrames(uint16_t* start, int firstFrame, int lastFrame, std::vector<int>& scratch);
     int calculateMedian(std::vector<int> &data);
-    void deleteDataArrays();
 
 };
 
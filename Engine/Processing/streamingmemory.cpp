@@ -0,0 +1,494 @@
+//------------------------------------------------------------------------------
+//
+//  Intan Technologies RHX Data Acquisition Software
+//  Version 3.4.0
+//
+//  Copyright (c) 2020-2025 Intan Technologies
+//
+//  This file is part of the Intan Technologies RHX Data Acquisition Software.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published
+//  by the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//  This software is provided 'as-is', without any express or implied warranty.
+//  In no event will the authors be held liable for any damages arising from
+//  the use of this software.
+//
+//  See <http://www.intantech.com> for documentation and product information.
+//
+//------------------------------------------------------------------------------
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include "streamingmemory.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// Mirrored mappings need an anonymous file whose pages can be mapped twice (memfd_create(), Linux 3.17 and later).
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+#define RHX_MIRRORED_MEMORY
+#endif
+
+std::mutex StreamingMemory::allocationMutex;
+std::map<void*, StreamingMemory::Allocation> StreamingMemory::allocations;
+bool StreamingMemory::lockNewAllocations = false;
+
+const std::size_t HugePageSize = 2 * 1024 * 1024;
+
+std::size_t StreamingMemory::pageSize()
+{
+#ifdef _WIN32
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo(&systemInfo);
+    return (std::size_t) systemInfo.dwPageSize;
+#else
+    return (std::size_t) sysconf(_SC_PAGESIZE);
+#endif
+}
+
+// Allocate at least size bytes directly from the operating system, and update size to the amount actually allocated.
+// Explicit huge pages are only used if they are available without wasting more than 1/8 of the allocation to
+// rounding; otherwise, on Linux, transparent huge pages are requested for the ordinary mapping.
+void* StreamingMemory::osAllocate(std::size_t &size, bool &hugePages)
+{
+    hugePages = false;
+    std::size_t hugeSize = (size + HugePageSize - 1) / HugePageSize * HugePageSize;
+    bool tryHugePages = size >= HugePageSize && hugeSize - size <= size / 8;
+    std::size_t normalSize = (size + pageSize() - 1) / pageSize() * pageSize();
+    void* memory = nullptr;
+
+#ifdef _WIN32
+    // Large pages require the 'Lock pages in memory' privilege, so this usually falls through to normal pages.
+    std::size_t largePageMinimum = GetLargePageMinimum();
+    if (tryHugePages && largePageMinimum == HugePageSize) {
+        memory = VirtualAlloc(nullptr, hugeSize, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+        if (memory) {
+            size = hugeSize;
+            hugePages = true;
+            return memory;
+        }
+    }
+    memory = VirtualAlloc(nullptr, normalSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (memory) size = normalSize;
+    return memory;
+#else
+#ifdef MAP_HUGETLB
+    // Succeeds only if the administrator has reserved huge pages (e.g., /proc/sys/vm/nr_hugepages).
+    if (tryHugePages) {
+        memory = mmap(nullptr, hugeSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (memory != MAP_FAILED) {
+            size = hugeSize;
+            hugePages = true;
+            return memory;
+        }
+    }
+#endif
+    memory = mmap(nullptr, normalSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) return nullptr;
+    size = normalSize;
+#ifdef MADV_HUGEPAGE
+    if (tryHugePages) {
+        hugePages = madvise(memory, normalSize, MADV_HUGEPAGE) == 0;
+    }
+#endif
+    return memory;
+#endif
+}
+
+#ifdef RHX_MIRRORED_MEMORY
+// Map size bytes of the memory file fd twice, back to back, starting at a multiple of alignment, and return the start
+// of the first mapping.  The address range is reserved first so that nothing else can be mapped between the two
+// halves.
+static void* mapMirrored(int fd, std::size_t size, std::size_t alignment)
+{
+    std::size_t reservedSize = 2 * size + alignment;
+    void* reserved = mmap(nullptr, reservedSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (reserved == MAP_FAILED) return nullptr;
+
+    // Trim the reservation to 2 * size bytes at an aligned address.
+    char* start = static_cast<char*>(reserved);
+    std::uintptr_t alignedAddress = (reinterpret_cast<std::uintptr_t>(start) + alignment - 1) / alignment * alignment;
+    char* base = reinterpret_cast<char*>(alignedAddress);
+    if (base > start) munmap(start, base - start);
+    if (start + reservedSize > base + 2 * size) munmap(base + 2 * size, start + reservedSize - (base + 2 * size));
+
+    void* first = mmap(base, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+    void* second = mmap(base + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+    if (first != base || second != base + size) {
+        munmap(base, 2 * size);
+        return nullptr;
+    }
+    return base;
+}
+#endif
+
+// Map size bytes of shared memory twice, back to back, and return the start of the first mapping.  Explicit huge
+// pages (MFD_HUGETLB) are tried first if size is a multiple of the huge page size; otherwise, transparent huge pages
+// are requested for the shared memory, which takes effect if the kernel allows them for shared memory (see
+// /sys/kernel/mm/transparent_hugepage/shmem_enabled).
+void* StreamingMemory::osAllocateMirrored(std::size_t size, bool &hugePages)
+{
+    hugePages = false;
+#ifdef RHX_MIRRORED_MEMORY
+#ifdef MFD_HUGETLB
+    // Succeeds only if the administrator has reserved huge pages (e.g., /proc/sys/vm/nr_hugepages).
+    if (size % HugePageSize == 0) {
+        int hugeFd = memfd_create("rhx-ring-buffer", MFD_CLOEXEC | MFD_HUGETLB);
+        if (hugeFd >= 0) {
+            void* memory = nullptr;
+            if (ftruncate(hugeFd, (off_t) size) == 0) {
+                memory = mapMirrored(hugeFd, size, HugePageSize);
+            }
+            close(hugeFd);  // The mappings keep the memory alive.
+            if (memory) {
+                hugePages = true;
+                return memory;
+            }
+        }
+    }
+#endif
+    int fd = memfd_create("rhx-ring-buffer", MFD_CLOEXEC);
+    if (fd < 0) return nullptr;
+    if (ftruncate(fd, (off_t) size) != 0) {
+        close(fd);
+        return nullptr;
+    }
+    // Align the first view to a huge page boundary, so it can be mapped with huge pages.
+    bool tryHugePages = size >= HugePageSize;
+    void* memory = mapMirrored(fd, size, tryHugePages ? HugePageSize : pageSize());
+    close(fd);  // The mappings keep the memory alive.
+#ifdef MADV_HUGEPAGE
+    if (memory && tryHugePages) {
+        hugePages = madvise(memory, 2 * size, MADV_HUGEPAGE) == 0;
+    }
+#endif
+    return memory;
+#else
+    (void) size;
+    return nullptr;
+#endif
+}
+
+void StreamingMemory::osRelease(void* memory, std::size_t size)
+{
+#ifdef _WIN32
+    (void) size;
+    VirtualFree(memory, 0, MEM_RELEASE);
+#else
+    munmap(memory, size);
+#endif
+}
+
+bool StreamingMemory::osLock(void* memory, std::size_t size)
+{
+#ifdef _WIN32
+    return VirtualLock(memory, size) != 0;
+#else
+    return mlock(memory, size) == 0;
+#endif
+}
+
+void StreamingMemory::osUnlock(void* memory, std::size_t size)
+{
+#ifdef _WIN32
+    VirtualUnlock(memory, size);
+#else
+    munlock(memory, size);
+#endif
+}
+
+// Return a pointer to numBytes of zeroed memory whose pages are already resident, or nullptr if the memory could
+// not be allocated.
+void* StreamingMemory::allocate(std::size_t numBytes)
+{
+    std::size_t size = numBytes > 0 ? numBytes : 1;
+    bool hugePages = false;
+    void* memory = osAllocate(size, hugePages);
+    if (!memory) {
+        std::cerr << "StreamingMemory::allocate: unable to allocate " << numBytes << " bytes." << '\n';
+        return nullptr;
+    }
+
+    // Pre-fault the memory by writing to each page (the operating system supplies zeroed pages, so writing
+    // zeros leaves the contents unchanged).
+    volatile char* bytes = static_cast<volatile char*>(memory);
+    std::size_t step = pageSize();
+    for (std::size_t i = 0; i < size; i += step) {
+        bytes[i] = 0;
+    }
+
+    std::lock_guard<std::mutex> lock(allocationMutex);
+    bool locked = false;
+    if (lockNewAllocations) {
+        locked = osLock(memory, size);
+        if (!locked) {
+            std::cerr << "StreamingMemory::allocate: unable to lock " << size << " bytes in memory "
+                         "(the locked memory limit may be too low)." << '\n';
+        }
+    }
+    allocations[memory] = { size, hugePages, locked, false };
+    return memory;
+}
+
+std::size_t StreamingMemory::mirrorGranularity()
+{
+#ifdef RHX_MIRRORED_MEMORY
+    return pageSize();
+#else
+    return 0;
+#endif
+}
+
+// Return a pointer to numBytes of zeroed, pre-faulted memory followed immediately by a second view of the same
+// memory, or nullptr if such a mapping is unavailable or numBytes is not a multiple of mirrorGranularity().
+void* StreamingMemory::allocateMirrored(std::size_t numBytes)
+{
+    std::size_t granularity = mirrorGranularity();
+    if (granularity == 0 || numBytes == 0 || numBytes % granularity != 0) {
+        return nullptr;
+    }
+    bool hugePages = false;
+    void* memory = osAllocateMirrored(numBytes, hugePages);
+    if (!memory) {
+        std::cerr << "StreamingMemory::allocateMirrored: unable to map " << numBytes << " bytes twice." << '\n';
+        return nullptr;
+    }
+
+    // Pre-fault the memory through the second view, and check that every page reads back through the first.
+    volatile char* bytes = static_cast<volatile char*>(memory);
+    std::size_t step = pageSize();
+    bool mirrorValid = true;
+    for (std::size_t i = 0; i < numBytes; i += step) {
+        bytes[numBytes + i] = 1;
+        if (bytes[i] != 1) mirrorValid = false;
+        bytes[numBytes + i] = 0;
+    }
+    if (!mirrorValid) {
+        std::cerr << "StreamingMemory::allocateMirrored: mirrored mapping is not consistent." << '\n';
+        osRelease(memory, 2 * numBytes);
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(allocationMutex);
+    bool locked = false;
+    if (lockNewAllocations) {
+        locked = osLock(memory, 2 * numBytes);
+        if (!locked) {
+            std::cerr << "StreamingMemory::allocateMirrored: unable to lock " << numBytes << " bytes in memory "
+                         "(the locked memory limit may be too low)." << '\n';
+        }
+    }
+    allocations[memory] = { 2 * numBytes, hugePages, locked, true };
+    return memory;
+}
+
+void StreamingMemory::release(void* memory)
+{
+    if (!memory) return;
+    std::lock_guard<std::mutex> lock(allocationMutex);
+    std::map<void*, Allocation>::iterator i = allocations.find(memory);
+    if (i == allocations.end()) {
+        std::cerr << "StreamingMemory::release: pointer was not allocated by StreamingMemory." << '\n';
+        return;
+    }
+    if (i->second.locked) {
+        osUnlock(memory, i->second.size);
+    }
+    osRelease(memory, i->second.size);
+    allocations.erase(i);
+}
+
+// Lock (or unlock) all existing allocations in physical memory, and do the same for future allocations.
+void StreamingMemory::setLockPages(bool lock)
+{
+    std::lock_guard<std::mutex> guard(allocationMutex);
+    lockNewAllocations = lock;
+    int numFailures = 0;
+    for (std::map<void*, Allocation>::iterator i = allocations.begin(); i != allocations.end(); ++i) {
+        if (lock && !i->second.locked) {
+            i->second.locked = osLock(i->first, i->second.size);
+            if (!i->second.locked) ++numFailures;
+        } else if (!lock && i->second.locked) {
+            osUnlock(i->first, i->second.size);
+            i->second.locked = false;
+        }
+    }
+    if (numFailures > 0) {
+        std::cerr << "StreamingMemory::setLockPages: unable to lock " << numFailures << " buffers in memory "
+                     "(the locked memory limit may be too low)." << '\n';
+    }
+}
+
+bool StreamingMemory::lockPages()
+{
+    std::lock_guard<std::mutex> lock(allocationMutex);
+    return lockNewAllocations;
+}
+
+StreamingMemoryStats StreamingMemory::stats()
+{
+    std::lock_guard<std::mutex> lock(allocationMutex);
+    StreamingMemoryStats result = { 0, 0, 0, 0, 0 };
+    for (std::map<void*, Allocation>::const_iterator i = allocations.begin(); i != allocations.end(); ++i) {
+        std::size_t physicalSize = i->second.mirrored ? i->second.size / 2 : i->second.size;
+        ++result.numAllocations;
+        result.bytesAllocated += physicalSize;
+        if (i->second.hugePages) result.bytesOnHugePages += physicalSize;
+        if (i->second.locked) result.bytesLocked += physicalSize;
+        if (i->second.mirrored) result.bytesMirrored += physicalSize;
+    }
+    return result;
+}
+
+// Return a summary such as "1.93 GB in 412 buffers (1.90 GB on huge pages, 0 GB locked, 0 GB mirrored)".
+std::string StreamingMemory::statsDescription()
+{
+    const double BytesPerGB = 1024.0 * 1024.0 * 1024.0;
+    StreamingMemoryStats s = stats();
+    std::ostringstream out;
+    out.precision(3);
+    out << s.bytesAllocated / BytesPerGB << " GB in " << s.numAllocations << " buffers (" <<
+           s.bytesOnHugePages / BytesPerGB << " GB on huge pages, " << s.bytesLocked / BytesPerGB << " GB locked, " <<
+           s.bytesMirrored / BytesPerGB << " GB mirrored)";
+    return out.str();
+}
+
+// Compare a streaming buffer with ordinary heap memory of the same size: the time of the first pass over every page
+// (which takes the page faults that allocate() moves to startup), and the time of random reads (which depends on TLB
+// misses, so on huge pages).
+std::string StreamingMemory::benchmarkReport()
+{
+    const std::size_t NumBytes = 64 * 1024 * 1024;
+    const int NumReads = 4 * 1024 * 1024;
+
+    char* ordinary = new (std::nothrow) char[NumBytes];
+    auto allocateStart = std::chrono::steady_clock::now();
+    char* streaming = static_cast<char*>(allocate(NumBytes));
+    auto allocateEnd = std::chrono::steady_clock::now();
+    if (!ordinary || !streaming) {
+        delete [] ordinary;
+        release(streaming);
+        return "Streaming memory benchmark: could not allocate memory";
+    }
+    Allocation allocation;
+    {
+        std::lock_guard<std::mutex> lock(allocationMutex);
+        allocation = allocations[streaming];
+    }
+
+    const std::size_t step = pageSize();
+    double firstPassMs[2];
+    double readNs[2];
+    for (int buffer = 0; buffer < 2; ++buffer) {
+        volatile char* bytes = buffer == 0 ? ordinary : streaming;
+        auto start = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < NumBytes; i += step) {
+            bytes[i] = 1;
+        }
+        auto middle = std::chrono::steady_clock::now();
+        uint32_t seed = 1;
+        for (int i = 0; i < NumReads; ++i) {
+            seed = 1664525 * seed + 1013904223;
+            (void) bytes[seed & (NumBytes - 1)];  // volatile, so the read isn't optimized away
+        }
+        auto end = std::chrono::steady_clock::now();
+        firstPassMs[buffer] = std::chrono::duration<double, std::milli>(middle - start).count();
+        readNs[buffer] = std::chrono::duration<double, std::nano>(end - middle).count() / NumReads;
+    }
+    delete [] ordinary;
+    release(streaming);
+
+    std::ostringstream out;
+    out << "Memory cost for a " << NumBytes / (1024 * 1024) << " MB buffer: first write to every page " <<
+           firstPassMs[0] << " ms for heap memory, " << firstPassMs[1] << " ms for streaming memory (" <<
+           std::chrono::duration<double, std::milli>(allocateEnd - allocateStart).count() <<
+           " ms spent pre-faulting at allocation); random read " << readNs[0] << " ns for heap memory, " <<
+           readNs[1] << " ns for streaming memory (" << (allocation.hugePages ? "huge pages" : "no huge pages") <<
+           ", " << (allocation.locked ? "locked" : "not locked") << ")";
+    return out.str();
+}
+
+// Stream data through a ring buffer in chunks that straddle its end, once with a mirrored allocation (writes and reads
+// simply continue into the second view) and once with an ordinary allocation plus overhang space (the part written
+// past the end is copied back to the start, as WaveformFifo does when mirroring is unavailable).  Report the time of
+// each, and whether every word read back through the wraparound was the one written.
+std::string StreamingMemory::mirroredBenchmarkReport()
+{
+    const std::size_t RingWords = 2 * 1024 * 1024;  // 4 MB of uint16_t, a whole number of huge pages
+    const int ChunkWords = 3000;  // not a divisor of RingWords, so chunks straddle the end at varying offsets
+    const int NumChunks = 40000;
+
+    std::size_t granularity = mirrorGranularity();
+    if (granularity == 0 || (sizeof(uint16_t) * RingWords) % granularity != 0) {
+        return "Mirrored ring buffer benchmark: mirrored memory is not supported on this system";
+    }
+    uint16_t* mirrored = allocateMirroredArray<uint16_t>(RingWords);
+    uint16_t* ordinary = allocateArray<uint16_t>(RingWords + ChunkWords);
+    if (!mirrored || !ordinary) {
+        release(mirrored);
+        release(ordinary);
+        return "Mirrored ring buffer benchmark: could not allocate memory";
+    }
+    bool hugePages;
+    {
+        std::lock_guard<std::mutex> lock(allocationMutex);
+        hugePages = allocations[mirrored].hugePages;
+    }
+
+    double megabytesPerSecond[2];
+    bool readsCorrect = true;
+    for (int pass = 0; pass < 2; ++pass) {
+        uint16_t* ring = pass == 0 ? mirrored : ordinary;
+        std::size_t index = 0;
+        uint16_t value = 0;
+        uint16_t expected = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int chunk = 0; chunk < NumChunks; ++chunk) {
+            uint16_t* p = &ring[index];
+            for (int i = 0; i < ChunkWords; ++i) p[i] = value++;
+            std::size_t overhang = index + ChunkWords > RingWords ? index + ChunkWords - RingWords : 0;
+            if (pass == 1 && overhang > 0) {
+                std::memcpy(ring, &ring[RingWords], sizeof(uint16_t) * overhang);
+            }
+            // Read the chunk back in two parts, the way a reader that wraps around to the start of the ring sees it.
+            for (std::size_t i = index; i < index + ChunkWords - overhang; ++i) {
+                if (ring[i] != expected++) readsCorrect = false;
+            }
+            for (std::size_t i = 0; i < overhang; ++i) {
+                if (ring[i] != expected++) readsCorrect = false;
+            }
+            index = (index + ChunkWords) % RingWords;
+        }
+        auto end = std::chrono::steady_clock::now();
+        megabytesPerSecond[pass] = 2.0 * sizeof(uint16_t) * ChunkWords * NumChunks / 1.0e6 /
+                std::chrono::duration<double>(end - start).count();
+    }
+    release(mirrored);
+    release(ordinary);
+
+    std::ostringstream out;
+    out << "Ring buffer of " << sizeof(uint16_t) * RingWords / (1024 * 1024) << " MB written and read in " <<
+           ChunkWords << "-word chunks: mirrored " << megabytesPerSecond[0] << " MB/s (" <<
+           (hugePages ? "huge pages" : "no huge pages") << "), with overhang copy " << megabytesPerSecond[1] <<
+           " MB/s; wraparound reads " << (readsCorrect ? "correct" : "INCORRECT");
+    return out.str();
+}
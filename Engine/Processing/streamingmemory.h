@@ -0,0 +1,103 @@
+//------------------------------------------------------------------------------
+//
+//  Intan Technologies RHX Data Acquisition Software
+//  Version 3.4.0
+//
+//  Copyright (c) 2020-2025 Intan Technologies
+//
+//  This file is part of the Intan Technologies RHX Data Acquisition Software.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published
+//  by the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//  This software is provided 'as-is', without any express or implied warranty.
+//  In no event will the authors be held liable for any damages arising from
+//  the use of this software.
+//
+//  See <http://www.intantech.com> for documentation and product information.
+//
+//------------------------------------------------------------------------------
+#ifndef STREAMINGMEMORY_H
+#define STREAMINGMEMORY_H
+
+#include <cstddef>
+#include <string>
+#include <map>
+#include <mutex>
+
+struct StreamingMemoryStats
+{
+    std::size_t numAllocations;
+    std::size_t bytesAllocated;    // total size of live allocations, rounded up to whole pages
+    std::size_t bytesOnHugePages;  // bytes explicitly backed by (or advised to use) 2 MB huge pages
+    std::size_t bytesLocked;       // bytes locked into physical memory
+    std::size_t bytesMirrored;     // bytes in mirrored allocations (counted once, not twice)
+};
+
+// Allocator for the large buffers that data streams through during acquisition (DataStreamFifo, the USBDataThread
+// buffer, and WaveformFifo waveform buffers).  Memory is requested directly from the operating system, backed by
+// 2 MB huge pages where available (to reduce TLB misses), and pre-faulted by touching every page before it is
+// returned, so page faults don't occur during the first seconds of a run.  Optionally, memory is also locked so it
+// can't be paged out.  Allocation failures return nullptr (like new (std::nothrow)).  Memory must be freed with
+// release(), not delete.
+class StreamingMemory
+{
+public:
+    static void* allocate(std::size_t numBytes);
+    static void release(void* memory);
+
+    template <typename T>
+    static T* allocateArray(std::size_t numElements) { return static_cast<T*>(allocate(sizeof(T) * numElements)); }
+
+    // Circular buffers: return 2 * numBytes of address space in which the second half maps the same physical memory
+    // as the first, so data written or read past the end of the buffer wraps around to its start automatically.
+    // numBytes must be a multiple of mirrorGranularity(), which is zero where mirroring is unsupported (anywhere
+    // but Linux).  Huge pages are used as for allocate(): explicit huge pages if numBytes is a multiple of 2 MB and
+    // they are available, otherwise transparent huge pages for shared memory.  Returns nullptr if the mirrored
+    // mapping could not be created; callers should fall back to allocate().  Release with release().
+    static void* allocateMirrored(std::size_t numBytes);
+    static std::size_t mirrorGranularity();
+
+    template <typename T>
+    static T* allocateMirroredArray(std::size_t numElements) { return static_cast<T*>(allocateMirrored(sizeof(T) * numElements)); }
+
+    static void setLockPages(bool lock);  // Applies to existing and future allocations.
+    static bool lockPages();
+
+    static StreamingMemoryStats stats();
+    static std::string statsDescription();
+    static std::string benchmarkReport();
+    static std::string mirroredBenchmarkReport();
+
+private:
+    struct Allocation {
+        std::size_t size;  // size of the address range (for mirrored allocations, twice the physical memory)
+        bool hugePages;
+        bool locked;
+        bool mirrored;
+    };
+
+    // Registry of live allocations, so they can be released, locked, or unlocked later.
+    static std::mutex allocationMutex;
+    static std::map<void*, Allocation> allocations;
+    static bool lockNewAllocations;
+
+    static std::size_t pageSize();
+    static void* osAllocate(std::size_t &size, bool &hugePages);
+    static void* osAllocateMirrored(std::size_t size, bool &hugePages);
+    static void osRelease(void* memory, std::size_t size);
+    static bool osLock(void* memory, std::size_t size);
+    static void osUnlock(void* memory, std::size_t size);
+};
+
+#endif // STREAMINGMEMORY_H
@@ -50,6 +50,7 @@ bool RestrictIfStimControllerOrRunning(const SystemState* state)
 SystemState::SystemState(const AbstractRHXController* controller_, StimStepSize stimStepSize_, int numSPIPorts_,
                          bool expanderConnected_, bool testMode_, DataFileReader* dataFileReader_) :
     numSPIPorts(numSPIPorts_),
+    cpuBestThreadCount(1),
     logErrors(false),
     reportSpikes(false),
     decayTime(1.0),
@@ -246,6 +247,45 @@ SystemState::SystemState(const AbstractRHXController* controller_, StimStepSize
 
     writeToLog("Created TCP variables");
 
+    // Latency
+    // In low-latency mode, USB data is read in the smallest batches that keep up with the controller, instead of in
+    // fixed batches of about 33 ms.  Batches are limited to the target latency unless the host cannot keep up at that
+    // size (see the USBLowLatencyTargetMisses TCP command).
+    lowLatencyMode = new BooleanItem("LowLatencyMode", globalItems, this, false);
+    lowLatencyMode->setRestricted(RestrictIfRunning, RunningErrorMessage);
+    lowLatencyTargetMilliseconds = new DoubleRangeItem("LowLatencyTargetMilliseconds", globalItems, this, 1.0, 33.0, 5.0);
+    lowLatencyTargetMilliseconds->setRestricted(RestrictIfRunning, RunningErrorMessage);
+
+    // Lock streaming buffers (FIFOs) in physical memory so they can never be paged out.
+    lockBufferMemory = new BooleanItem("LockBufferMemory", globalItems, this, false);
+
+    // Let the display and audio outputs skip ahead to the newest data when they fall behind, instead of making
+    // processing wait for them.  A display or audio stall then can't delay acquisition or recording, but skipped
+    // data is never shown or played, and data being read during the stall may be partly overwritten.
+    dropDisplayAudioDataWhenBehind = new BooleanItem("DropDisplayAudioDataWhenBehind", globalItems, this, false);
+    dropDisplayAudioDataWhenBehind->setRestricted(RestrictIfRunning, RunningErrorMessage);
+
+    // Scheduling policy applied to each pipeline thread as it starts running, and the processor cores each thread may
+    // run on, e.g. "USB=2;Processor=3;Disk=4,5;Audio=6-7".  Threads not listed may run on any core.
+    threadSchedulingPolicy = new DiscreteItemList("ThreadSchedulingPolicy", globalItems, this);
+    threadSchedulingPolicy->addItem("Default", "Default", 0);
+    threadSchedulingPolicy->addItem("HighPriority", "High Priority", 1);
+    threadSchedulingPolicy->addItem("RoundRobin", "Round Robin", 2);
+    threadSchedulingPolicy->addItem("FIFO", "FIFO", 3);
+    threadSchedulingPolicy->setValue("Default");
+    threadSchedulingPolicy->setRestricted(RestrictIfRunning, RunningErrorMessage);
+    threadAffinity = new StringItem("ThreadAffinity", globalItems, this, "");
+    threadAffinity->setRestricted(RestrictIfRunning, RunningErrorMessage);
+
+    // Number of threads used for CPU filtering and spike detection, or 0 to use the fastest number found by the
+    // diagnostic run at startup.
+    cpuProcessingThreads = new IntRangeItem("CPUProcessingThreads", globalItems, this, 0, MaxCPUThreads, 0);
+
+    // If not empty, pipeline latency statistics are written to this CSV file each time the controller stops running.
+    latencyReportFilename = new StringItem("LatencyReportFilename", globalItems, this, "", XMLGroupNone);
+
+    writeToLog("Created latency variables");
+
     // Audio
     audioEnabled = new BooleanItem("AudioEnabled", globalItems, this, false);
     audioFilter = new DiscreteItemList("AudioFilter", globalItems, this);
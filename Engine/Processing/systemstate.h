@@ -74,6 +74,7 @@ struct GPUInfo : public CPUInfo {
 const int SnippetSize = 50;
 const int FramesPerBlock = 128;
 const int NotchBandwidth = 10;
+const int MaxCPUThreads = 64;
 
 bool RestrictAlways(const SystemState*);
 bool RestrictIfRunning(const SystemState* state);
@@ -154,6 +155,8 @@ public:
 
     CPUInfo cpuInfo;
     QVector<GPUInfo> gpuList;
+    QVector<float> cpuThreadDiagnosticTimes;  // CPU diagnostic time with (index + 1) threads, or -1 if not tested
+    int cpuBestThreadCount;
 
     bool logErrors;
     QString logFileName;
@@ -198,6 +201,16 @@ public:
     TCPCommunicator *tcpWaveformDataCommunicator;
     TCPCommunicator *tcpSpikeDataCommunicator;
 
+    // Latency
+    BooleanItem* lowLatencyMode;
+    DoubleRangeItem* lowLatencyTargetMilliseconds;
+    BooleanItem* lockBufferMemory;
+    BooleanItem* dropDisplayAudioDataWhenBehind;
+    DiscreteItemList* threadSchedulingPolicy;
+    StringItem* threadAffinity;
+    IntRangeItem* cpuProcessingThreads;
+    StringItem *latencyReportFilename;
+
     // XML
     ProbeMapSettings probeMapSettings;
 
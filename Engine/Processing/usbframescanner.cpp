@@ -0,0 +1,225 @@
+//------------------------------------------------------------------------------
+//
+//  Intan Technologies RHX Data Acquisition Software
+//  Version 3.4.0
+//
+//  Copyright (c) 2020-2025 Intan Technologies
+//
+//  This file is part of the Intan Technologies RHX Data Acquisition Software.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published
+//  by the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//  This software is provided 'as-is', without any express or implied warranty.
+//  In no event will the authors be held liable for any damages arising from
+//  the use of this software.
+//
+//  See <http://www.intantech.com> for documentation and product information.
+//
+//------------------------------------------------------------------------------
+
+#include <algorithm>
+#include "simdsupport.h"
+#include "usbframescanner.h"
+
+USBFrameScanner::USBFrameScanner(ControllerType type_) :
+    type(type_),
+    numBytesPerDataFrame(0),
+    synchronized(false),
+    haveLastTimeStamp(false),
+    lastTimeStamp(0),
+    resyncs(0),
+    bytesSkipped(0),
+    framesDropped(0)
+{
+    header = RHXDataBlock::headerMagicNumber(type);
+    headerFirstWord = (uint16_t) (header & 0xffffU);
+}
+
+// Prepare to scan a new run of data.  Statistics are cleared so they always describe the current (or most recent) run.
+void USBFrameScanner::reset(int numBytesPerDataFrame_)
+{
+    numBytesPerDataFrame = numBytesPerDataFrame_;
+    synchronized = false;
+    haveLastTimeStamp = false;
+    lastTimeStamp = 0;
+    resyncs = 0;
+    bytesSkipped = 0;
+    framesDropped = 0;
+}
+
+// Return the largest buffer index at which frameIsValid() has enough data to make a decision.
+int USBFrameScanner::lastCheckableIndex(int numBytesInBuffer) const
+{
+    int lastIndex = numBytesInBuffer - numBytesPerDataFrame - USBHeaderSizeInBytes;
+    if (!synchronized) lastIndex -= USBTimeStampSizeInBytes;
+    return lastIndex;
+}
+
+bool USBFrameScanner::frameIsValid(const uint8_t* buffer, int index) const
+{
+    if (!headerMatches(buffer, index) || !headerMatches(buffer, index + numBytesPerDataFrame)) return false;
+    if (synchronized) return true;
+    return timeStamp(buffer, index + numBytesPerDataFrame) == timeStamp(buffer, index) + 1U;
+}
+
+// Record that the frame at index has been accepted, and count any frames missing between it and the previously
+// accepted frame.
+void USBFrameScanner::frameAccepted(const uint8_t* buffer, int index)
+{
+    uint32_t t = timeStamp(buffer, index);
+    if (haveLastTimeStamp) {
+        uint32_t gap = t - lastTimeStamp - 1U;  // unsigned arithmetic handles timestamp rollover
+        if (gap != 0 && gap < 0x80000000U) {
+            framesDropped += gap;
+        }
+    }
+    lastTimeStamp = t;
+    haveLastTimeStamp = true;
+    synchronized = true;
+}
+
+// Called when the frame at index is not valid.  Return the index of the next candidate header (or, if none is found,
+// the first index that couldn't be checked yet), and count the bytes skipped on the way.
+int USBFrameScanner::skipToNextHeader(const uint8_t* buffer, int index, int numBytesInBuffer)
+{
+    if (synchronized) {
+        synchronized = false;
+        resyncs++;
+    }
+    int lastIndex = lastCheckableIndex(numBytesInBuffer);
+    int nextIndex = findHeader(buffer, index + 2, lastIndex);
+    if (nextIndex < 0) {
+        nextIndex = (std::max)(lastIndex + 2, index + 2);
+        nextIndex -= (nextIndex - index) % 2;
+    }
+    bytesSkipped += nextIndex - index;
+    return nextIndex;
+}
+
+USBFrameStatistics USBFrameScanner::statistics() const
+{
+    USBFrameStatistics stats;
+    stats.resyncs = resyncs;
+    stats.bytesSkipped = bytesSkipped;
+    stats.framesDropped = framesDropped;
+    return stats;
+}
+
+uint32_t USBFrameScanner::timeStamp(const uint8_t* buffer, int index)
+{
+    const uint8_t* p = &buffer[index + USBHeaderSizeInBytes];
+    return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+bool USBFrameScanner::headerMatches(const uint8_t* buffer, int index) const
+{
+    // Just check first byte initially to speed up cases where header doesn't match.
+    if (buffer[index] != (uint8_t) (header & 0xffU)) return false;
+    for (int i = 1; i < USBHeaderSizeInBytes; ++i) {
+        if (buffer[index + i] != (uint8_t) ((header >> (8 * i)) & 0xffU)) return false;
+    }
+    return true;
+}
+
+int USBFrameScanner::findHeaderScalar(const uint8_t* buffer, int startIndex, int lastIndex) const
+{
+    for (int index = startIndex; index <= lastIndex; index += 2) {
+        if (headerMatches(buffer, index)) return index;
+    }
+    return -1;
+}
+
+#ifdef RHX_SIMD_AVX2
+// Compare 16 words (at even offsets from index) at a time against the first two header bytes.  Return the offset of
+// the first match, or -1 if there is none.  On return, index is the first offset not yet checked.
+RHX_TARGET_AVX2 static int findHeaderFirstWordAVX2(const uint8_t* buffer, int& index, int endIndex, uint16_t word)
+{
+    const __m256i target = _mm256_set1_epi16((short) word);
+    for (; index + 32 <= endIndex; index += 32) {
+        __m256i data = _mm256_loadu_si256((const __m256i*) &buffer[index]);
+        uint32_t mask = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi16(data, target));
+        if (mask) return index + countTrailingZeros(mask);
+    }
+    return -1;
+}
+#endif
+
+#ifdef RHX_SIMD_NEON
+// True if any lane of a comparison result is set.  (vmaxvq_u16 is only available on AArch64.)
+static inline bool anyLaneSet(uint16x8_t matches)
+{
+#if defined(__aarch64__) || defined(_M_ARM64)
+    return vmaxvq_u16(matches) != 0;
+#else
+    uint16x4_t folded = vorr_u16(vget_low_u16(matches), vget_high_u16(matches));
+    return vget_lane_u64(vreinterpret_u64_u16(folded), 0) != 0;
+#endif
+}
+#endif
+
+// Return the first index (stepping by 2 bytes from startIndex, and no greater than lastIndex) at which the buffer
+// holds a header magic number, or -1 if there is none.  Candidates are found by comparing the first header word at
+// many offsets in parallel, then confirmed by comparing the full header.
+int USBFrameScanner::findHeader(const uint8_t* buffer, int startIndex, int lastIndex) const
+{
+    int index = startIndex;
+    const int endIndex = lastIndex + 2;  // end of region in which candidate first words may lie
+
+    while (index <= lastIndex) {
+        int candidate = -1;
+#if defined(RHX_SIMD_AVX2)
+        if (cpuSupportsAVX2()) {
+            candidate = findHeaderFirstWordAVX2(buffer, index, endIndex, headerFirstWord);
+        }
+#endif
+#if defined(RHX_SIMD_SSE2)
+        if (candidate < 0) {
+            const __m128i target = _mm_set1_epi16((short) headerFirstWord);
+            for (; index + 16 <= endIndex; index += 16) {
+                __m128i data = _mm_loadu_si128((const __m128i*) &buffer[index]);
+                uint32_t mask = (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi16(data, target));
+                if (mask) {
+                    candidate = index + countTrailingZeros(mask);
+                    break;
+                }
+            }
+        }
+#elif defined(RHX_SIMD_NEON)
+        if (candidate < 0) {
+            const uint16x8_t target = vdupq_n_u16(headerFirstWord);
+            for (; index + 16 <= endIndex; index += 16) {
+                uint16x8_t data = vreinterpretq_u16_u8(vld1q_u8(&buffer[index]));
+                uint16x8_t matches = vceqq_u16(data, target);
+                if (anyLaneSet(matches)) {
+                    for (int lane = 0; lane < 8; ++lane) {
+                        if (buffer[index + 2 * lane] == (uint8_t) (headerFirstWord & 0xffU) &&
+                            buffer[index + 2 * lane + 1] == (uint8_t) (headerFirstWord >> 8)) {
+                            candidate = index + 2 * lane;
+                            break;
+                        }
+                    }
+                    break;
+                }
+            }
+        }
+#endif
+        if (candidate < 0) {
+            // Check the remaining few offsets (or all offsets, if no vector instructions are available).
+            return findHeaderScalar(buffer, index, lastIndex);
+        }
+        if (headerMatches(buffer, candidate)) return candidate;
+        index = candidate + 2;
+    }
+    return -1;
+}
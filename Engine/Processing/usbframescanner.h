@@ -0,0 +1,87 @@
+//------------------------------------------------------------------------------
+//
+//  Intan Technologies RHX Data Acquisition Software
+//  Version 3.4.0
+//
+//  Copyright (c) 2020-2025 Intan Technologies
+//
+//  This file is part of the Intan Technologies RHX Data Acquisition Software.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published
+//  by the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//  This software is provided 'as-is', without any express or implied warranty.
+//  In no event will the authors be held liable for any damages arising from
+//  the use of this software.
+//
+//  See <http://www.intantech.com> for documentation and product information.
+//
+//------------------------------------------------------------------------------
+#ifndef USBFRAMESCANNER_H
+#define USBFRAMESCANNER_H
+
+#include <atomic>
+#include <cstdint>
+#include "rhxdatablock.h"
+
+const int USBTimeStampSizeInBytes = 4;
+
+struct USBFrameStatistics
+{
+    uint64_t resyncs;         // number of times synchronization with the USB frame headers was lost
+    uint64_t bytesSkipped;    // bytes discarded while searching for the next valid frame
+    uint64_t framesDropped;   // frames missing from the timestamp sequence of accepted frames
+};
+
+// Locates and validates data frames (one sample of all channels, preceded by an 8-byte magic number header and
+// a 32-bit timestamp) in the raw byte stream read from the controller.  While synchronized, a frame is accepted
+// if its header and the header of the following frame are both valid.  After a glitch, the next frame is only
+// accepted if, in addition, the following frame's timestamp is consecutive, so we can't lock on to a stray copy
+// of the header magic number.  Statistics may be read from any thread.
+class USBFrameScanner
+{
+public:
+    explicit USBFrameScanner(ControllerType type_);
+
+    void reset(int numBytesPerDataFrame_);
+
+    bool isSynchronized() const { return synchronized; }
+    int lastCheckableIndex(int numBytesInBuffer) const;
+    bool frameIsValid(const uint8_t* buffer, int index) const;
+    void frameAccepted(const uint8_t* buffer, int index);
+    int skipToNextHeader(const uint8_t* buffer, int index, int numBytesInBuffer);
+
+    int findHeader(const uint8_t* buffer, int startIndex, int lastIndex) const;
+    static uint32_t timeStamp(const uint8_t* buffer, int index);
+
+    USBFrameStatistics statistics() const;
+
+private:
+    ControllerType type;
+    int numBytesPerDataFrame;
+    uint64_t header;
+    uint16_t headerFirstWord;
+
+    bool synchronized;
+    bool haveLastTimeStamp;
+    uint32_t lastTimeStamp;
+
+    std::atomic<uint64_t> resyncs;
+    std::atomic<uint64_t> bytesSkipped;
+    std::atomic<uint64_t> framesDropped;
+
+    bool headerMatches(const uint8_t* buffer, int index) const;
+    int findHeaderScalar(const uint8_t* buffer, int startIndex, int lastIndex) const;
+};
+
+#endif // USBFRAMESCANNER_H
@@ -28,10 +28,17 @@
 //
 //------------------------------------------------------------------------------
 
+#include <algorithm>
 #include <cmath>
 #include <cstring>
+#include <chrono>
+#include <iomanip>
+#include <numeric>
+#include <sstream>
+#include <thread>
 #include "rhxglobals.h"
 #include "rhxdatablock.h"
+#include "streamingmemory.h"
 #include "waveformfifo.h"
 
 WaveformFifo::WaveformFifo(SignalSources *signalSources_, int bufferSizeInDataBlocks_, int memorySizeInDataBlocks_, int maxWriteSizeInDataBlocks_, SystemState* state_) :
@@ -40,13 +47,26 @@ WaveformFifo::WaveformFifo(SignalSources *signalSources_, int bufferSizeInDataBl
     bufferSizeInDataBlocks(bufferSizeInDataBlocks_),
     memorySizeInDataBlocks(memorySizeInDataBlocks_),
     maxWriteSizeInDataBlocks(maxWriteSizeInDataBlocks_),
-    numReaders(NumberOfReaders)
+    numReaders(NumberOfReaders),
+    latencyTracer(nullptr),
+    bandDemandGeneration(1),
+    appliedBandDemandGeneration(0),
+    appliedBandDemandWord(0)
 {
     if (numReaders < 1) {
         std::cerr << "WaveformFifo constructor: numReaders must be one or greater." << '\n';
         numReaders = 1;
     }
     samplesPerDataBlock = RHXDataBlock::samplesPerDataBlock(signalSources->getControllerType());
+
+    // Mirrored buffers must be whole pages long, so round the buffer up to a multiple of the page size (in the
+    // smallest sample size used, uint16_t).
+    std::size_t mirrorGranularity = StreamingMemory::mirrorGranularity();
+    if (mirrorGranularity > 0) {
+        std::size_t bytesPerDataBlock = samplesPerDataBlock * sizeof(uint16_t);
+        int blocksPerPageMultiple = (int) (std::lcm(mirrorGranularity, bytesPerDataBlock) / bytesPerDataBlock);
+        bufferSizeInDataBlocks = (bufferSizeInDataBlocks + blocksPerPageMultiple - 1) / blocksPerPageMultiple * blocksPerPageMultiple;
+    }
     bufferSize = bufferSizeInDataBlocks * samplesPerDataBlock;
     memorySize = memorySizeInDataBlocks * samplesPerDataBlock;
     if (memorySizeInDataBlocks > bufferSizeInDataBlocks) {
@@ -64,10 +84,14 @@ WaveformFifo::WaveformFifo(SignalSources *signalSources_, int bufferSizeInDataBl
     bufferAllocateSize = bufferSize + maxWriteSizeInSamples;
     bufferAllocateSizeInBlocks = bufferSizeInDataBlocks + maxWriteSizeInDataBlocks;
 
-    usedWordsNewData = new Semaphore[numReaders];
-    bufferReadIndex.resize(numReaders);
-    bufferMemoryIndex.resize(numReaders);
-    numWordsToBeRead.resize(numReaders);
+    cursors = new ReaderCursor[numReaders];
+    lagStatistics = new ReaderLagStatistics[numReaders];
+    newDataEvents = new DataEvent[numReaders];
+    totalWordsWritten.store(0, std::memory_order_relaxed);
+    for (int reader = 0; reader < numReaders; ++reader) {
+        cursors[reader].status.store(ReaderUnregistered, std::memory_order_relaxed);
+        registerReader((Reader) reader, defaultReaderPolicy((Reader) reader));
+    }
     if (bufferSize < memorySize + 2 * maxWriteSizeInSamples) {
         std::cerr << "WaveformFifo: bufferSize too small to support requested memorySize and maxWriteSizeInBlocks." << '\n';
     }
@@ -77,40 +101,75 @@ WaveformFifo::WaveformFifo(SignalSources *signalSources_, int bufferSizeInDataBl
 WaveformFifo::~WaveformFifo()
 {
     freeMemory();
-    delete [] usedWordsNewData;
+    delete [] cursors;
+    delete [] lagStatistics;
+    delete [] newDataEvents;
+}
+
+// Allocate a circular buffer of ringSize elements with space for allocateSize elements in all.  If possible, the space
+// past ringSize is a mirror of the start of the buffer, so it needs no copy to the start after writing; mirrored
+// reports whether this is the case.  After one failure, plain buffers are used for the rest of the allocation.
+template <typename T>
+T* WaveformFifo::allocateRingBuffer(std::size_t ringSize, std::size_t allocateSize, bool& mirrored)
+{
+    mirrored = false;
+    if (tryMirroredBuffers && ringSize > 0 && allocateSize - ringSize <= ringSize) {
+        T* buffer = StreamingMemory::allocateMirroredArray<T>(ringSize);
+        if (buffer) {
+            mirrored = true;
+            return buffer;
+        }
+        tryMirroredBuffers = false;
+    }
+    return StreamingMemory::allocateArray<T>(allocateSize);
+}
+
+// Return the handle of a waveform name, adding a new (empty) entry for it if it has not been seen before.
+WaveformHandle WaveformFifo::addWaveform(const std::string& waveName)
+{
+    std::map<std::string, WaveformHandle>::const_iterator p = waveformHandles.find(waveName);
+    if (p != waveformHandles.end()) {
+        return p->second;
+    }
+    WaveformHandle handle = (WaveformHandle) waveforms.size();
+    waveforms.push_back({ nullptr, nullptr, GpuWaveformAddress{ GpuWaveformWideband, -1 }, false });
+    waveformHandles[waveName] = handle;
+    return handle;
 }
 
 void WaveformFifo::allocateAnalogBuffer(std::vector<float*> &bufferArray, const std::string& waveName)
 {
     memoryNeededGB += sizeof(float) * bufferAllocateSize / (1024.0 * 1024.0 * 1024.0);
-    float* buffer = nullptr;
-    try {
-        buffer = new float [bufferAllocateSize];
-    } catch (std::bad_alloc&) {
+    bool mirrored;
+    float* buffer = allocateRingBuffer<float>(bufferSize, bufferAllocateSize, mirrored);
+    if (!buffer) {
         memoryAllocated = false;
         std::cerr << "WaveformFifo::allocateAnalogBuffer(): unable to allocate memory." << '\n';
     }
     bufferArray.push_back(buffer);
-    analogWaveformIndices[waveName] = buffer;
+    WaveformEntry& waveform = waveforms[addWaveform(waveName)];
+    waveform.analog = buffer;
+    waveform.mirrored = mirrored;
 }
 
 void WaveformFifo::allocateDigitalBuffer(std::vector<uint16_t*> &bufferArray, const std::string& waveName)
 {
     memoryNeededGB += sizeof(uint16_t) * bufferAllocateSize / (1024.0 * 1024.0 * 1024.0);
-    uint16_t* buffer = nullptr;
-    try {
-        buffer = new (std::nothrow) uint16_t [bufferAllocateSize];
-    } catch (std::bad_alloc&) {
+    bool mirrored;
+    uint16_t* buffer = allocateRingBuffer<uint16_t>(bufferSize, bufferAllocateSize, mirrored);
+    if (!buffer) {
         memoryAllocated = false;
         std::cerr << "WaveformFifo::allocateDigitalBuffer(): unable to allocate memory." << '\n';
     }
     bufferArray.push_back(buffer);
-    digitalWaveformIndices[waveName] = buffer;
+    WaveformEntry& waveform = waveforms[addWaveform(waveName)];
+    waveform.digital = buffer;
+    waveform.mirrored = mirrored;
 }
 
 void WaveformFifo::allocateMemory()
 {
-    if (!analogWaveformIndices.empty() || !digitalWaveformIndices.empty()) {
+    if (!waveforms.empty()) {
         freeMemory();
     }
 
@@ -126,16 +185,20 @@ void WaveformFifo::allocateMemory()
                       (sizeof(uint32_t) + sizeof(uint8_t)) * bufferAllocateSizeInBlocks * numAmplifierChannels * maxSpikesPerDataBlock) /
                      (1024.0 * 1024.0 * 1024.0);
 
-    memoryAllocated = true;
-    try {
-        timeStampBuffer = new uint32_t [bufferAllocateSize];
-        gpuAmplifierWidebandBuffer = new uint16_t [bufferAllocateSize * numAmplifierChannels];
-        gpuAmplifierLowpassBuffer = new uint16_t [bufferAllocateSize * numAmplifierChannels];
-        gpuAmplifierHighpassBuffer = new uint16_t [bufferAllocateSize * numAmplifierChannels];
-        gpuSpikeTimestamps = new uint32_t [bufferAllocateSizeInBlocks * numAmplifierChannels * maxSpikesPerDataBlock];
-        gpuSpikeIds = new uint8_t [bufferAllocateSizeInBlocks * numAmplifierChannels * maxSpikesPerDataBlock];
-    } catch (std::bad_alloc&) {
-        memoryAllocated = false;
+    tryMirroredBuffers = StreamingMemory::mirrorGranularity() > 0;
+    timeStampBuffer = allocateRingBuffer<uint32_t>(bufferSize, bufferAllocateSize, timeStampBufferMirrored);
+    gpuAmplifierWidebandBuffer = allocateRingBuffer<uint16_t>((size_t) bufferSize * numAmplifierChannels,
+                                                              (size_t) bufferAllocateSize * numAmplifierChannels, gpuAmplifierBufferMirrored[0]);
+    gpuAmplifierLowpassBuffer = allocateRingBuffer<uint16_t>((size_t) bufferSize * numAmplifierChannels,
+                                                             (size_t) bufferAllocateSize * numAmplifierChannels, gpuAmplifierBufferMirrored[1]);
+    gpuAmplifierHighpassBuffer = allocateRingBuffer<uint16_t>((size_t) bufferSize * numAmplifierChannels,
+                                                              (size_t) bufferAllocateSize * numAmplifierChannels, gpuAmplifierBufferMirrored[2]);
+    gpuSpikeTimestamps = StreamingMemory::allocateArray<uint32_t>((size_t) bufferAllocateSizeInBlocks * numAmplifierChannels * maxSpikesPerDataBlock);
+    gpuSpikeIds = StreamingMemory::allocateArray<uint8_t>((size_t) bufferAllocateSizeInBlocks * numAmplifierChannels * maxSpikesPerDataBlock);
+
+    memoryAllocated = timeStampBuffer && gpuAmplifierWidebandBuffer && gpuAmplifierLowpassBuffer && gpuAmplifierHighpassBuffer &&
+            gpuSpikeTimestamps && gpuSpikeIds;
+    if (!memoryAllocated) {
         std::cerr << "WaveformFifo::allocateMemory(): unable to allocate " << memoryNeededGB << " GB of memory." << '\n';
     }
 
@@ -160,10 +223,10 @@ void WaveformFifo::allocateMemory()
             switch (signalChannel->getSignalType()) {
             case AmplifierSignal:
                 gpuWaveformIndex = signalChannel->getBoardStream() * channelsPerStream + signalChannel->getChipChannel();
-                gpuWaveformAddresses[waveName + "|WIDE"] = { GpuWaveformWideband, gpuWaveformIndex };
-                gpuWaveformAddresses[waveName + "|LOW"] = { GpuWaveformLowpass, gpuWaveformIndex };
-                gpuWaveformAddresses[waveName + "|HIGH"] = { GpuWaveformHighpass, gpuWaveformIndex };
-                gpuWaveformAddresses[waveName + "|SPK"] = { GpuWaveformSpike, gpuWaveformIndex };
+                waveforms[addWaveform(waveName + "|WIDE")].gpuAddress = { GpuWaveformWideband, gpuWaveformIndex };
+                waveforms[addWaveform(waveName + "|LOW")].gpuAddress = { GpuWaveformLowpass, gpuWaveformIndex };
+                waveforms[addWaveform(waveName + "|HIGH")].gpuAddress = { GpuWaveformHighpass, gpuWaveformIndex };
+                waveforms[addWaveform(waveName + "|SPK")].gpuAddress = { GpuWaveformSpike, gpuWaveformIndex };
                 allocateDigitalBuffer(amplifierSpikeBuffer, waveName + "|SPK");
                 if (signalSources->getControllerType() == ControllerStimRecord) {
                     allocateAnalogBuffer(dcAmplifierBuffer, waveName + "|DC");
@@ -193,124 +256,248 @@ void WaveformFifo::allocateMemory()
     }
 
     std::cout << "WaveformFifo: Allocated " << memoryNeededGB << " GBytes for waveform buffers." << '\n';
+    std::cout << "Streaming buffers: " << StreamingMemory::statsDescription() << '.' << '\n';
 }
 
 void WaveformFifo::freeMemory()
 {
     // Free all allocated buffer memory.
-    delete [] timeStampBuffer;
+    StreamingMemory::release(timeStampBuffer);
+
+    StreamingMemory::release(gpuAmplifierWidebandBuffer);
+    StreamingMemory::release(gpuAmplifierLowpassBuffer);
+    StreamingMemory::release(gpuAmplifierHighpassBuffer);
 
-    delete [] gpuAmplifierWidebandBuffer;
-    delete [] gpuAmplifierLowpassBuffer;
-    delete [] gpuAmplifierHighpassBuffer;
+    StreamingMemory::release(gpuSpikeTimestamps);
+    StreamingMemory::release(gpuSpikeIds);
 
-    delete [] gpuSpikeTimestamps;
-    delete [] gpuSpikeIds;
+    for (WaveformEntry& waveform : waveforms) {
+        StreamingMemory::release(waveform.analog);
+        StreamingMemory::release(waveform.digital);
+    }
+    waveforms.clear();
+    waveformHandles.clear();
+}
 
-    for (std::map<std::string, float*>::const_iterator i = analogWaveformIndices.begin(); i != analogWaveformIndices.end(); ++i) {
-        delete [] i->second;
+// Return the lowest count of words freed by any registered reader the writer must not overwrite (i.e., the oldest
+// word that must be kept), and optionally which reader that is (-1 if there is none).
+int64_t WaveformFifo::minTotalWordsFreed(int* slowestReader) const
+{
+    int64_t minWordsFreed = 0;
+    int minIndex = -1;
+    for (int r = 0; r < numReaders; ++r) {
+        if (cursors[r].status.load(std::memory_order_acquire) != ReaderRegistered ||
+                cursors[r].policy.load(std::memory_order_relaxed) == PolicyDropOldest) {
+            continue;
+        }
+        int64_t wordsFreed = cursors[r].totalWordsFreed.load(std::memory_order_acquire);
+        if (minIndex < 0 || wordsFreed < minWordsFreed) {
+            minWordsFreed = wordsFreed;
+            minIndex = r;
+        }
     }
-    analogWaveformIndices.clear();
-    for (std::map<std::string, uint16_t*>::const_iterator i = digitalWaveformIndices.begin(); i != digitalWaveformIndices.end(); ++i) {
-        delete [] i->second;
+    if (minIndex < 0) {
+        minWordsFreed = totalWordsWritten.load(std::memory_order_acquire);  // Nothing to keep.
     }
-    digitalWaveformIndices.clear();
+    if (slowestReader) *slowestReader = minIndex;
+    return minWordsFreed;
 }
 
-bool WaveformFifo::requestWriteSpace(int numDataBlocks)
+// Detach every PolicyDetach reader that has freed fewer than minWordsFreedNeeded words.  Return true if any reader
+// was detached.  This function must only be called from the writer thread.
+bool WaveformFifo::detachSlowReaders(int64_t minWordsFreedNeeded)
+{
+    bool readerDetached = false;
+    for (int r = 0; r < numReaders; ++r) {
+        ReaderCursor& cursor = cursors[r];
+        if (cursor.policy.load(std::memory_order_relaxed) != PolicyDetach ||
+                cursor.totalWordsFreed.load(std::memory_order_acquire) >= minWordsFreedNeeded) {
+            continue;
+        }
+        int status = ReaderRegistered;
+        if (cursor.status.compare_exchange_strong(status, ReaderDetached, std::memory_order_acq_rel)) {
+            cursor.timesDetached.fetch_add(1, std::memory_order_relaxed);
+            std::cerr << "WaveformFifo: Detached " << readerName((Reader) r) << " reader, which is not reading data quickly enough." << '\n';
+            readerDetached = true;
+        }
+    }
+    return readerDetached;
+}
+
+// Return the number of words written but not yet released by freeOldData() for this reader.
+int64_t WaveformFifo::newWordsAvailable(Reader reader) const
 {
-    std::lock_guard<std::mutex> lock(mtx);
+    return totalWordsWritten.load(std::memory_order_acquire) - cursors[reader].totalWordsRead.load(std::memory_order_relaxed);
+}
 
+// This function must only be called from the writer thread.
+bool WaveformFifo::requestWriteSpace(int numDataBlocks)
+{
     if (numDataBlocks > maxWriteSizeInDataBlocks) {
         std::cerr << "Waveform::requestWriteSpace: numDataBlocks exceeds maxWriteSizeInDataBlocks." << '\n';
         return false;
     }
     int numWords = numDataBlocks * samplesPerDataBlock;
-    if (freeWords.tryAcquire(numWords)) {
-        numWordsToBeWritten = numWords;
-        return true;
-    } else {
-        return false;   // insufficient free space available in buffer
+    int64_t wordsWritten = totalWordsWritten.load(std::memory_order_relaxed);
+    if (bufferSize - (wordsWritten - cachedMinTotalWordsFreed) < numWords) {
+        cachedMinTotalWordsFreed = minTotalWordsFreed();
+        if (bufferSize - (wordsWritten - cachedMinTotalWordsFreed) < numWords) {
+            if (!detachSlowReaders(wordsWritten + numWords - bufferSize)) {
+                return false;   // insufficient free space available in buffer
+            }
+            cachedMinTotalWordsFreed = minTotalWordsFreed();
+            if (bufferSize - (wordsWritten - cachedMinTotalWordsFreed) < numWords) {
+                return false;
+            }
+        }
     }
+    numWordsToBeWritten = numWords;
+    return true;
+}
+
+// Block the writing thread until requestWriteSpace(numDataBlocks) would succeed, or until timeoutMicroseconds have elapsed.
+bool WaveformFifo::waitForWriteSpace(int numDataBlocks, int timeoutMicroseconds, LatencyHistogram* wakeupLatency)
+{
+    int numWords = numDataBlocks * samplesPerDataBlock;
+    return freeSpaceEvent.waitFor([this, numWords]() {
+            int64_t minWordsFreed = minTotalWordsFreed();
+            return bufferSize - (totalWordsWritten.load(std::memory_order_relaxed) - minWordsFreed) >= numWords;
+        }, timeoutMicroseconds, wakeupLatency);
 }
 
+// This function must only be called from the writer thread.
 void WaveformFifo::commitNewData()
 {
-    std::lock_guard<std::mutex> lock(mtx);
+    if (latencyTracer && numWordsToBeWritten > 0) {
+        latencyTracer->stampStage(LatencyTracer::StageProcessed, timeStampBuffer[bufferWriteIndex + numWordsToBeWritten - 1]);
+    }
 
     bufferWriteIndex += numWordsToBeWritten;
     if (bufferWriteIndex == bufferSize) {
         bufferWriteIndex = 0;
     } else if (bufferWriteIndex > bufferSize) {
-        // Copy 'overhanging' data to beginning of buffer.
+        // Copy 'overhanging' data to beginning of buffer.  (Mirrored buffers already hold it there.)
         // Note: You can avoid this potentially time-consuming memory copy by always writing the same
         // number of samples, and making the buffer size an integer multiple of this number.
 
         //cout << "WaveformFifo::commitNewData: copying 'overhanging' data to beginning of buffer." << EndOfLine;
 
-        std::memcpy(timeStampBuffer, &timeStampBuffer[bufferSize], sizeof(uint32_t) * (bufferWriteIndex - bufferSize));
-
-        float* analogWaveformBuffer = nullptr;
-        for (std::map<std::string, float*>::const_iterator i = analogWaveformIndices.begin(); i != analogWaveformIndices.end(); ++i) {
-            analogWaveformBuffer = i->second;
-            std::memcpy(analogWaveformBuffer, &analogWaveformBuffer[bufferSize], sizeof(float) * (bufferWriteIndex - bufferSize));
+        if (!timeStampBufferMirrored) {
+            std::memcpy(timeStampBuffer, &timeStampBuffer[bufferSize], sizeof(uint32_t) * (bufferWriteIndex - bufferSize));
         }
 
-        uint16_t* digitalWaveformBuffer = nullptr;
-        for (std::map<std::string, uint16_t*>::const_iterator i = digitalWaveformIndices.begin(); i != digitalWaveformIndices.end(); ++i) {
-            digitalWaveformBuffer = i->second;
-            std::memcpy(digitalWaveformBuffer, &digitalWaveformBuffer[bufferSize], sizeof(float) * (bufferWriteIndex - bufferSize));
+        for (const WaveformEntry& waveform : waveforms) {
+            if (waveform.mirrored) continue;
+            if (waveform.analog) {
+                std::memcpy(waveform.analog, &waveform.analog[bufferSize], sizeof(float) * (bufferWriteIndex - bufferSize));
+            }
+            if (waveform.digital) {
+                std::memcpy(waveform.digital, &waveform.digital[bufferSize], sizeof(uint16_t) * (bufferWriteIndex - bufferSize));
+            }
         }
 
-        std::memcpy(gpuAmplifierWidebandBuffer, &gpuAmplifierWidebandBuffer[bufferSize * numAmplifierChannels],
-                sizeof(uint16_t) * (bufferWriteIndex - bufferSize) * numAmplifierChannels);
-        std::memcpy(gpuAmplifierLowpassBuffer, &gpuAmplifierLowpassBuffer[bufferSize * numAmplifierChannels],
-                sizeof(uint16_t) * (bufferWriteIndex - bufferSize) * numAmplifierChannels);
-        std::memcpy(gpuAmplifierHighpassBuffer, &gpuAmplifierHighpassBuffer[bufferSize * numAmplifierChannels],
-                sizeof(uint16_t) * (bufferWriteIndex - bufferSize) * numAmplifierChannels);
+        uint16_t* gpuAmplifierBuffers[3] = { gpuAmplifierWidebandBuffer, gpuAmplifierLowpassBuffer, gpuAmplifierHighpassBuffer };
+        for (int i = 0; i < 3; ++i) {
+            if (gpuAmplifierBufferMirrored[i]) continue;
+            std::memcpy(gpuAmplifierBuffers[i], &gpuAmplifierBuffers[i][bufferSize * numAmplifierChannels],
+                    sizeof(uint16_t) * (bufferWriteIndex - bufferSize) * numAmplifierChannels);
+        }
 
         bufferWriteIndex -= bufferSize;
     }
+
+    // Publish the new data to the readers.
+    int64_t wordsWritten = totalWordsWritten.load(std::memory_order_relaxed) + numWordsToBeWritten;
+    totalWordsWritten.store(wordsWritten, std::memory_order_release);
     for (int reader = 0; reader < numReaders; ++reader) {
-        usedWordsNewData[reader].release(numWordsToBeWritten);
+        newDataEvents[reader].notify();
+    }
+
+    updateLagStatistics(wordsWritten, numWordsToBeWritten);
+}
+
+// Record each registered reader's peak lag, and charge the words just written to whichever reader is furthest behind
+// (if any reader is behind at all).  This function must only be called from the writer thread.
+void WaveformFifo::updateLagStatistics(int64_t wordsWritten, int numWordsWritten)
+{
+    int slowest = -1;
+    int64_t maxLag = 0;
+    for (int r = 0; r < numReaders; ++r) {
+        if (cursors[r].status.load(std::memory_order_relaxed) != ReaderRegistered) continue;
+        int64_t lag = wordsWritten - cursors[r].totalWordsRead.load(std::memory_order_relaxed);
+        if (lag > lagStatistics[r].peakLagWords.load(std::memory_order_relaxed)) {
+            lagStatistics[r].peakLagWords.store(lag, std::memory_order_relaxed);
+        }
+        if (lag > maxLag) {
+            maxLag = lag;
+            slowest = r;
+        }
+    }
+    if (slowest >= 0) {
+        lagStatistics[slowest].wordsAsSlowest.store(lagStatistics[slowest].wordsAsSlowest.load(std::memory_order_relaxed) +
+                                                    numWordsWritten, std::memory_order_relaxed);
     }
+    currentSlowestReader.store(slowest, std::memory_order_relaxed);
 }
 
+// This function must only be called from the reader's own thread.
 bool WaveformFifo::requestReadNewData(Reader reader, int numWords, bool lastRead)
 {
-    std::lock_guard<std::mutex> lock(mtx);
-
+    ReaderCursor& cursor = cursors[reader];
+    if (cursor.status.load(std::memory_order_acquire) != ReaderRegistered) {
+        return false;
+    }
     int necessaryData = lastRead ? numWords : numWords + samplesPerDataBlock; // Add one data block to allow spike detection
                                                                               // pipeline to complete (as long as this isn't the
                                                                               // last data block in a playback recording session).
-    if (usedWordsNewData[reader].available() >= necessaryData) {
-        if (usedWordsNewData[reader].tryAcquire(numWords)) {
-            numWordsToBeRead[reader] = numWords;
-            return true;
-        } else {
+    if (cursor.policy.load(std::memory_order_relaxed) == PolicyDropOldest) {
+        // The writer doesn't wait for this reader, and may be writing up to maxWriteSizeInDataBlocks past the last
+        // word written, so if any of our memory could have been overwritten, skip ahead to the newest data.
+        int64_t wordsWritten = totalWordsWritten.load(std::memory_order_acquire);
+        if (cursor.totalWordsFreed.load(std::memory_order_relaxed) <
+                wordsWritten + maxWriteSizeInDataBlocks * samplesPerDataBlock - bufferSize) {
+            cursor.wordsDropped.fetch_add(wordsWritten - cursor.totalWordsRead.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            cursor.bufferReadIndex = (int) (wordsWritten % bufferSize);
+            cursor.totalWordsRead.store(wordsWritten, std::memory_order_release);
+            cursor.totalWordsFreed.store(std::max(wordsWritten - memorySize, (int64_t) 0), std::memory_order_release);
+        }
+    }
+    int64_t wordsRead = cursor.totalWordsRead.load(std::memory_order_relaxed);
+    if (cursor.cachedTotalWordsWritten - wordsRead < necessaryData) {
+        cursor.cachedTotalWordsWritten = totalWordsWritten.load(std::memory_order_acquire);
+        if (cursor.cachedTotalWordsWritten - wordsRead < necessaryData) {
             if (reader == ReaderDisplay) {
-                state->writeToLog("Failed to acquire words. numWords: " + QString::number(numWords));
+                state->writeToLog("Insufficient data available in buffer. Available: " +
+                                  QString::number(cursor.cachedTotalWordsWritten - wordsRead) + " ... requested: " + QString::number(numWords));
             }
-            return false;
-        }
-    } else {
-        if (reader == ReaderDisplay) {
-            state->writeToLog("Insufficient data available in buffer. Available: " + QString::number(numWords) + " ... requested: " + QString::number(usedWordsNewData[reader].available()));
+            return false;   // insufficient data available in buffer
         }
-        return false;   // insufficient data available in buffer
     }
+    cursor.numWordsToBeRead = numWords;
+    return true;
+}
+
+// Block a reading thread until requestReadNewData(reader, numWords, lastRead) would succeed, or until timeoutMicroseconds
+// have elapsed.
+bool WaveformFifo::waitForNewData(Reader reader, int numWords, bool lastRead, int timeoutMicroseconds, LatencyHistogram* wakeupLatency)
+{
+    int necessaryData = lastRead ? numWords : numWords + samplesPerDataBlock;
+    return newDataEvents[reader].waitFor([this, reader, necessaryData]() {
+            return cursors[reader].status.load(std::memory_order_acquire) == ReaderRegistered && newWordsAvailable(reader) >= necessaryData;
+        },
+                                         timeoutMicroseconds, wakeupLatency);
 }
 
 MinMax<float> WaveformFifo::getMinMaxData(Reader reader, const float* waveform, int timeIndex, int numSamples) const
 {
     MinMax<float> result;
 
-    if (timeIndex + numSamples > numWordsToBeRead[reader] || timeIndex < -numWordsInMemory(reader)) {
+    if (timeIndex + numSamples > cursors[reader].numWordsToBeRead || timeIndex < -numWordsInMemory(reader)) {
         std::cerr << "Error: WaveformFifo::getMinMaxData: timeIndex out of range." << '\n';
         return result;
     }
 
-    int index = bufferReadIndex[reader] + timeIndex;
+    int index = cursors[reader].bufferReadIndex + timeIndex;
     if (index < 0) index += bufferSize;
     else if (index >= bufferSize) index -= bufferSize;
     for (int i = 0; i < numSamples; ++i) {
@@ -322,13 +509,13 @@ MinMax<float> WaveformFifo::getMinMaxData(Reader reader, const float* waveform,
 
 void WaveformFifo::getMinMaxGpuAmplifierData(MinMax<float> &init, Reader reader, GpuWaveformAddress waveformAddress, int timeIndex, int numSamples) const
 {
-    if (timeIndex + numSamples > numWordsToBeRead[reader] || timeIndex < -numWordsInMemory(reader)) {
+    if (timeIndex + numSamples > cursors[reader].numWordsToBeRead || timeIndex < -numWordsInMemory(reader)) {
         std::cerr << "Error: WaveformFifo::getMinMaxGpuAmplifierData: timeIndex out of range.  timeIndex = " << timeIndex <<
              "; numSamples = " << numSamples << '\n';
         return;
     }
 
-    int index = bufferReadIndex[reader] + timeIndex;
+    int index = cursors[reader].bufferReadIndex + timeIndex;
     if (index < 0) index += bufferSize;
     else if (index >= bufferSize) index -= bufferSize;
     int channelIndex = waveformAddress.waveformIndex;
@@ -352,13 +539,13 @@ void WaveformFifo::getMinMaxGpuAmplifierData(MinMax<float> &init, Reader reader,
 
 void WaveformFifo::getMinMaxData(MinMax<float> &init, Reader reader, const float* waveform, int timeIndex, int numSamples) const
 {
-    if (timeIndex + numSamples > numWordsToBeRead[reader] || timeIndex < -numWordsInMemory(reader)) {
+    if (timeIndex + numSamples > cursors[reader].numWordsToBeRead || timeIndex < -numWordsInMemory(reader)) {
         std::cerr << "Error: WaveformFifo::getMinMaxData: timeIndex out of range.  timeIndex = " << timeIndex <<
              "; numSamples = " << numSamples << "; numWordsInMemory = " << numWordsInMemory(reader) << '\n';
         return;
     }
 
-    int index = bufferReadIndex[reader] + timeIndex;
+    int index = cursors[reader].bufferReadIndex + timeIndex;
     if (index < 0) index += bufferSize;
     else if (index >= bufferSize) index -= bufferSize;
     for (int i = 0; i < numSamples; ++i) {
@@ -369,13 +556,13 @@ void WaveformFifo::getMinMaxData(MinMax<float> &init, Reader reader, const float
 
 uint16_t WaveformFifo::getStimData(Reader reader, const uint16_t* stimFlags, int timeIndex, int numSamples) const
 {
-    if (timeIndex + numSamples > numWordsToBeRead[reader] || timeIndex < -numWordsInMemory(reader)) {
+    if (timeIndex + numSamples > cursors[reader].numWordsToBeRead || timeIndex < -numWordsInMemory(reader)) {
         std::cerr << "Error: WaveformFifo::getStimData: timeIndex out of range.  timeIndex = " << timeIndex <<
              "; numSamples = " << numSamples << '\n';
         return 0;
     }
 
-    int index = bufferReadIndex[reader] + timeIndex;
+    int index = cursors[reader].bufferReadIndex + timeIndex;
     if (index < 0) index += bufferSize;
     else if (index >= bufferSize) index -= bufferSize;
     uint16_t result = 0;
@@ -389,13 +576,13 @@ uint16_t WaveformFifo::getStimData(Reader reader, const uint16_t* stimFlags, int
 // Count the number of spikes in a given time period, assuming all spikes are represented as ones.
 uint16_t WaveformFifo::getRasterData(Reader reader, const uint16_t* rasterData, int timeIndex, int numSamples) const
 {
-    if (timeIndex + numSamples > numWordsToBeRead[reader] || timeIndex < -numWordsInMemory(reader)) {
+    if (timeIndex + numSamples > cursors[reader].numWordsToBeRead || timeIndex < -numWordsInMemory(reader)) {
         std::cerr << "Error: WaveformFifo::getRasterData: timeIndex out of range.  timeIndex = " << timeIndex <<
              "; numSamples = " << numSamples << '\n';
         return 0;
     }
 
-    int index = bufferReadIndex[reader] + timeIndex;
+    int index = cursors[reader].bufferReadIndex + timeIndex;
     if (index < 0) index += bufferSize;
     else if (index >= bufferSize) index -= bufferSize;
     uint16_t result = 0;
@@ -406,69 +593,84 @@ uint16_t WaveformFifo::getRasterData(Reader reader, const uint16_t* rasterData,
     return result;
 }
 
-bool WaveformFifo::extractGpuSpikeDataOneDataBlock(uint16_t* waveform, GpuWaveformAddress waveformAddress, bool firstTime) const
+// Convert GPU spike detector output for the numDataBlocks data blocks currently being written into a spike waveform.
+// A spike may be reported in the data block after the one containing its timestamp, so each block also searches
+// the block before it (which, for all but the first block, is part of this same write).
+bool WaveformFifo::extractGpuSpikeData(uint16_t* waveform, GpuWaveformAddress waveformAddress, int numDataBlocks, bool firstTime) const
 {
     bool spikeFound = false;
     if (waveformAddress.waveformType != GpuWaveformSpike) {
-        std::cerr << "Error: WaveformFifo::extractGpuSpikeDataOneDataBlock: waveform is not GpuWaveformSpike type." << '\n';
+        std::cerr << "Error: WaveformFifo::extractGpuSpikeData: waveform is not GpuWaveformSpike type." << '\n';
         return spikeFound;
     }
     if (bufferWriteIndex % samplesPerDataBlock != 0) {
-        std::cerr << "Error: WaveformFifo::extractGpuSpikeDataOneDataBlock: bufferWriteIndex is not an integer multiple of samplesPerDataBlock." << '\n';
+        std::cerr << "Error: WaveformFifo::extractGpuSpikeData: bufferWriteIndex is not an integer multiple of samplesPerDataBlock." << '\n';
+        return spikeFound;
+    }
+    if (numDataBlocks * samplesPerDataBlock > numWordsToBeWritten) {
+        std::cerr << "Error: WaveformFifo::extractGpuSpikeData: numDataBlocks exceeds requested write space." << '\n';
         return spikeFound;
     }
-
-    int bufferWriteIndexPrev = bufferWriteIndex - samplesPerDataBlock;
-    if (bufferWriteIndexPrev < 0) bufferWriteIndexPrev += bufferSize;
 
     // Read GPU spike detector output data and create lists of spike IDs along with corresponding timestamps.
     std::vector<uint32_t> spikeTimeStampList;
     std::vector<uint16_t> spikeIdList;
     uint32_t spikeTimeStamp;
     uint8_t spikeId;
-    int bufferWriteIndexBlock = bufferWriteIndex / samplesPerDataBlock;
-    int index = bufferWriteIndexBlock * numAmplifierChannels * maxSpikesPerDataBlock + waveformAddress.waveformIndex;
-    for (int k = 0; k < maxSpikesPerDataBlock; ++k) {
-        spikeId = gpuSpikeIds[index];
-        if (spikeId != SpikeIdNoSpike) {
-            spikeTimeStamp = gpuSpikeTimestamps[index];
-            spikeFound = true;
-            // cout << "found spike " << (int) spikeId << " at timestamp " << spikeTimeStamp << " in channel " << waveformAddress.waveformIndex << EndOfLine;
-            spikeTimeStampList.push_back(spikeTimeStamp);
-            spikeIdList.push_back((uint16_t) spikeId);
-        }
-        index += numAmplifierChannels;
-        if (index >= bufferAllocateSizeInBlocks * numAmplifierChannels * maxSpikesPerDataBlock) {
-            std::cerr << "Error!  Indexing outside of GPU spike timestamp allocated memory."  << '\n';
-        }
-    }
-
-    // Initialize spike output to all zeros (i.e., no spikes)
-    for (int i = bufferWriteIndex; i < bufferWriteIndex + samplesPerDataBlock; ++i) {
-        waveform[i]= 0;
-    }
-
-    for (int j = 0; j < (int) spikeTimeStampList.size(); ++j) {
-        bool found = false;
-        // First, search for spike timestamp in current datablock.
-        for (int i = bufferWriteIndex; i < bufferWriteIndex + samplesPerDataBlock; ++i) {
-            if (timeStampBuffer[i] == spikeTimeStampList[j]) {
-                found = true;
-                waveform[i] = spikeIdList[j];
+
+    for (int block = 0; block < numDataBlocks; ++block) {
+        // Blocks after the first may run past the 'end' of the buffer; commitNewData() copies them back to the start.
+        int blockWriteIndex = bufferWriteIndex + block * samplesPerDataBlock;
+        int blockWriteIndexPrev = blockWriteIndex - samplesPerDataBlock;
+        if (blockWriteIndexPrev < 0) blockWriteIndexPrev += bufferSize;
+        bool searchPrevious = block > 0 || !firstTime;
+
+        spikeTimeStampList.clear();
+        spikeIdList.clear();
+        int index = (blockWriteIndex / samplesPerDataBlock) * numAmplifierChannels * maxSpikesPerDataBlock + waveformAddress.waveformIndex;
+        for (int k = 0; k < maxSpikesPerDataBlock; ++k) {
+            if (index >= bufferAllocateSizeInBlocks * numAmplifierChannels * maxSpikesPerDataBlock) {
+                std::cerr << "Error!  Indexing outside of GPU spike timestamp allocated memory."  << '\n';
                 break;
             }
+            spikeId = gpuSpikeIds[index];
+            if (spikeId != SpikeIdNoSpike) {
+                spikeTimeStamp = gpuSpikeTimestamps[index];
+                spikeFound = true;
+                // cout << "found spike " << (int) spikeId << " at timestamp " << spikeTimeStamp << " in channel " << waveformAddress.waveformIndex << EndOfLine;
+                spikeTimeStampList.push_back(spikeTimeStamp);
+                spikeIdList.push_back((uint16_t) spikeId);
+            }
+            index += numAmplifierChannels;
         }
-        if (!found && !firstTime) {   // If we don't find timestamp in current datablock, search previous datablock.
-            for (int i = bufferWriteIndexPrev + samplesPerDataBlock - 1; i >= bufferWriteIndexPrev; --i) {
+
+        // Initialize spike output to all zeros (i.e., no spikes)
+        for (int i = blockWriteIndex; i < blockWriteIndex + samplesPerDataBlock; ++i) {
+            waveform[i]= 0;
+        }
+
+        for (int j = 0; j < (int) spikeTimeStampList.size(); ++j) {
+            bool found = false;
+            // First, search for spike timestamp in current datablock.
+            for (int i = blockWriteIndex; i < blockWriteIndex + samplesPerDataBlock; ++i) {
                 if (timeStampBuffer[i] == spikeTimeStampList[j]) {
                     found = true;
                     waveform[i] = spikeIdList[j];
                     break;
                 }
             }
-        }
-        if (!found && !firstTime) {
-            std::cout << "Error:: WaveformFifo::extractGpuSpikeDataOneDataBlock: timestamp " << spikeTimeStampList[j] << " not found!" << '\n';
+            if (!found && searchPrevious) {   // If we don't find timestamp in current datablock, search previous datablock.
+                for (int i = blockWriteIndexPrev + samplesPerDataBlock - 1; i >= blockWriteIndexPrev; --i) {
+                    if (timeStampBuffer[i] == spikeTimeStampList[j]) {
+                        found = true;
+                        waveform[i] = spikeIdList[j];
+                        break;
+                    }
+                }
+            }
+            if (!found && searchPrevious) {
+                std::cout << "Error:: WaveformFifo::extractGpuSpikeData: timestamp " << spikeTimeStampList[j] << " not found!" << '\n';
+            }
         }
     }
     return spikeFound;
@@ -476,12 +678,12 @@ bool WaveformFifo::extractGpuSpikeDataOneDataBlock(uint16_t* waveform, GpuWavefo
 
 float WaveformFifo::getGpuAmplifierData(Reader reader, GpuWaveformAddress waveformAddress, int timeIndex) const
 {
-    if (timeIndex >= numWordsToBeRead[reader] || timeIndex < -numWordsInMemory(reader)) {
+    if (timeIndex >= cursors[reader].numWordsToBeRead || timeIndex < -numWordsInMemory(reader)) {
         std::cerr << "Error: WaveformFifo::getGpuAmplifierData: timeIndex out of range: " << timeIndex << '\n';
         return 0.0F;
     }
 
-    int index = bufferReadIndex[reader] + timeIndex;
+    int index = cursors[reader].bufferReadIndex + timeIndex;
     if (index < 0) index += bufferSize;
     else if (index >= bufferSize) index -= bufferSize;
     int channelIndex = waveformAddress.waveformIndex;
@@ -499,12 +701,12 @@ float WaveformFifo::getGpuAmplifierData(Reader reader, GpuWaveformAddress wavefo
 uint16_t WaveformFifo::getGpuAmplifierDataRaw(Reader reader, GpuWaveformAddress waveformAddress, int timeIndex) const
 {
     // Return 'zero' if time index is not present in buffer.
-    if (timeIndex >= numWordsToBeRead[reader] || timeIndex < -numWordsInMemory(reader)) {
+    if (timeIndex >= cursors[reader].numWordsToBeRead || timeIndex < -numWordsInMemory(reader)) {
         std::cerr << "WaveformFifo::getGpuAmplifierDataRaw: time index " << timeIndex << " not present in buffer." << '\n';
         return 32768U;
     }
 
-    int index = bufferReadIndex[reader] + timeIndex;
+    int index = cursors[reader].bufferReadIndex + timeIndex;
     if (index < 0) index += bufferSize;
     else if (index >= bufferSize) index -= bufferSize;
     int channelIndex = waveformAddress.waveformIndex;
@@ -521,13 +723,13 @@ uint16_t WaveformFifo::getGpuAmplifierDataRaw(Reader reader, GpuWaveformAddress
 
 void WaveformFifo::copyGpuAmplifierData(Reader reader, float* dest, GpuWaveformAddress waveformAddress, int timeIndex, int numSamples) const
 {
-    if (timeIndex + numSamples > numWordsToBeRead[reader] || timeIndex < -numWordsInMemory(reader)) {
+    if (timeIndex + numSamples > cursors[reader].numWordsToBeRead || timeIndex < -numWordsInMemory(reader)) {
         std::cerr << "Error: WaveformFifo::copyGpuAmplifierData: timeIndex out of range." << '\n';
         return;
     }
 
     float* pWrite = dest;
-    int index = bufferReadIndex[reader] + timeIndex;
+    int index = cursors[reader].bufferReadIndex + timeIndex;
     if (index < 0) index += bufferSize;
     else if (index >= bufferSize) index -= bufferSize;
     int channelIndex = waveformAddress.waveformIndex;
@@ -555,13 +757,13 @@ void WaveformFifo::copyGpuAmplifierData(Reader reader, float* dest, GpuWaveformA
 void WaveformFifo::copyGpuAmplifierDataRaw(Reader reader, uint16_t* dest, GpuWaveformAddress waveformAddress, int timeIndex,
                                            int numSamples, int downsampleFactor) const
 {
-    if (timeIndex + numSamples > numWordsToBeRead[reader] || timeIndex < -numWordsInMemory(reader)) {
+    if (timeIndex + numSamples > cursors[reader].numWordsToBeRead || timeIndex < -numWordsInMemory(reader)) {
         std::cerr << "Error: WaveformFifo::copyGpuAmplifierDataRaw: timeIndex out of range." << '\n';
         return;
     }
 
     uint16_t* pWrite = dest;
-    int index = bufferReadIndex[reader] + timeIndex;
+    int index = cursors[reader].bufferReadIndex + timeIndex;
     if (index < 0) index += bufferSize;
     else if (index >= bufferSize) index -= bufferSize;
     int channelIndex = waveformAddress.waveformIndex;
@@ -592,13 +794,13 @@ void WaveformFifo::copyGpuAmplifierDataRaw(Reader reader, uint16_t* dest, GpuWav
 void WaveformFifo::copyGpuAmplifierDataArrayRaw(Reader reader, uint16_t* dest, const std::vector<GpuWaveformAddress>& waveformAddresses,
                                                 int timeIndex, int numSamples, int downsampleFactor) const
 {
-    if (timeIndex + numSamples > numWordsToBeRead[reader] || timeIndex < -numWordsInMemory(reader)) {
+    if (timeIndex + numSamples > cursors[reader].numWordsToBeRead || timeIndex < -numWordsInMemory(reader)) {
         std::cerr << "Error: WaveformFifo::copyGpuAmplifierDataArrayRaw: timeIndex out of range." << '\n';
         return;
     }
 
     uint16_t* pWrite = dest;
-    int index = bufferReadIndex[reader] + timeIndex;
+    int index = cursors[reader].bufferReadIndex + timeIndex;
     if (index < 0) index += bufferSize;
     else if (index >= bufferSize) index -= bufferSize;
     std::vector<int> channelIndex(waveformAddresses.size());
@@ -637,13 +839,13 @@ void WaveformFifo::copyGpuAmplifierDataArrayRaw(Reader reader, uint16_t* dest, c
 
 void WaveformFifo::copyAnalogData(Reader reader, float* dest, const float* waveform, int timeIndex, int numSamples) const
 {
-    if (timeIndex + numSamples > numWordsToBeRead[reader] || timeIndex < -numWordsInMemory(reader)) {
+    if (timeIndex + numSamples > cursors[reader].numWordsToBeRead || timeIndex < -numWordsInMemory(reader)) {
         std::cerr << "Error: WaveformFifo::copyAnalogData: timeIndex out of range." << '\n';
         return;
     }
 
     float* pWrite = dest;
-    int index = bufferReadIndex[reader] + timeIndex;
+    int index = cursors[reader].bufferReadIndex + timeIndex;
     if (index < 0) index += bufferSize;
     else if (index >= bufferSize) index -= bufferSize;
     for (int i = 0; i < numSamples; ++i) {
@@ -656,13 +858,13 @@ void WaveformFifo::copyAnalogData(Reader reader, float* dest, const float* wavef
 void WaveformFifo::copyAnalogDataArray(Reader reader, float* dest, const std::vector<float*>& waveforms, int timeIndex,
                                        int numSamples) const
 {
-    if (timeIndex + numSamples > numWordsToBeRead[reader] || timeIndex < -numWordsInMemory(reader)) {
+    if (timeIndex + numSamples > cursors[reader].numWordsToBeRead || timeIndex < -numWordsInMemory(reader)) {
         std::cerr << "Error: WaveformFifo::copyAnalogArrayData: timeIndex out of range." << '\n';
         return;
     }
 
     float* pWrite = dest;
-    int index = bufferReadIndex[reader] + timeIndex;
+    int index = cursors[reader].bufferReadIndex + timeIndex;
     if (index < 0) index += bufferSize;
     else if (index >= bufferSize) index -= bufferSize;
     for (int i = 0; i < numSamples; ++i) {
@@ -676,13 +878,13 @@ void WaveformFifo::copyAnalogDataArray(Reader reader, float* dest, const std::ve
 
 void WaveformFifo::copyDigitalData(Reader reader, uint16_t* dest, const uint16_t* waveform, int timeIndex, int numSamples) const
 {
-    if (timeIndex + numSamples > numWordsToBeRead[reader] || timeIndex < -numWordsInMemory(reader)) {
+    if (timeIndex + numSamples > cursors[reader].numWordsToBeRead || timeIndex < -numWordsInMemory(reader)) {
         std::cerr << "Error: WaveformFifo::copyDigitalData: timeIndex out of range." << '\n';
         return;
     }
 
     uint16_t* pWrite = dest;
-    int index = bufferReadIndex[reader] + timeIndex;
+    int index = cursors[reader].bufferReadIndex + timeIndex;
     if (index < 0) index += bufferSize;
     else if (index >= bufferSize) index -= bufferSize;
     for (int i = 0; i < numSamples; ++i) {
@@ -695,13 +897,13 @@ void WaveformFifo::copyDigitalData(Reader reader, uint16_t* dest, const uint16_t
 void WaveformFifo::copyDigitalDataArray(Reader reader, uint16_t* dest, const std::vector<uint16_t*>& waveforms, int timeIndex,
                                         int numSamples) const
 {
-    if (timeIndex + numSamples > numWordsToBeRead[reader] || timeIndex < -numWordsInMemory(reader)) {
+    if (timeIndex + numSamples > cursors[reader].numWordsToBeRead || timeIndex < -numWordsInMemory(reader)) {
         std::cerr << "Error: WaveformFifo::copyDigitalDataArray: timeIndex out of range." << '\n';
         return;
     }
 
     uint16_t* pWrite = dest;
-    int index = bufferReadIndex[reader] + timeIndex;
+    int index = cursors[reader].bufferReadIndex + timeIndex;
     if (index < 0) index += bufferSize;
     else if (index >= bufferSize) index -= bufferSize;
     for (int i = 0; i < numSamples; ++i) {
@@ -715,13 +917,13 @@ void WaveformFifo::copyDigitalDataArray(Reader reader, uint16_t* dest, const std
 
 void WaveformFifo::copyTimeStamps(Reader reader, uint32_t* dest, int timeIndex, int numSamples) const
 {
-    if (timeIndex + numSamples > numWordsToBeRead[reader] || timeIndex < -numWordsInMemory(reader)) {
+    if (timeIndex + numSamples > cursors[reader].numWordsToBeRead || timeIndex < -numWordsInMemory(reader)) {
         std::cerr << "Error: WaveformFifo::copyTimeStamps: timeIndex out of range." << '\n';
         return;
     }
 
     uint32_t* pWrite = dest;
-    int index = bufferReadIndex[reader] + timeIndex;
+    int index = cursors[reader].bufferReadIndex + timeIndex;
     if (index < 0) index += bufferSize;
     else if (index >= bufferSize) index -= bufferSize;
     for (int i = 0; i < numSamples; ++i) {
@@ -731,136 +933,368 @@ void WaveformFifo::copyTimeStamps(Reader reader, uint32_t* dest, int timeIndex,
     }
 }
 
-// Call once after all reading is complete.
+// Call once after all reading is complete.  This function must only be called from the reader's own thread.
 void WaveformFifo::freeOldData(Reader reader)
 {
-    std::lock_guard<std::mutex> lock(mtx);
-
-    int bufferWriteIndexFrozen = bufferWriteIndex;  // Save this value in case it changes from another thread.
-
-    // What is the minimum distance between the write index and the memory indexes, currently?
-    int minDistanceOld = bufferSize;
-    for (int r = 0; r < numReaders; ++r) {
-        int distance = bufferMemoryIndex[r] - bufferWriteIndexFrozen;
-        if (distance < 0) distance += bufferSize;
-        if (distance < minDistanceOld) {
-            minDistanceOld = distance;
-        }
-    }
-
-    bufferReadIndex[reader] += numWordsToBeRead[reader];
-    if (bufferReadIndex[reader] >= bufferSize) {
-        bufferReadIndex[reader] -= bufferSize;
+    ReaderCursor& cursor = cursors[reader];
+    if (cursor.status.load(std::memory_order_acquire) != ReaderRegistered) {
+        return;  // Unregistered or detached while reading.
     }
-    int excess = numWordsInMemory(reader) - memorySize;
-    if (excess > 0) {
-        bufferMemoryIndex[reader] += excess;
-        if (bufferMemoryIndex[reader] >= bufferSize) {
-            bufferMemoryIndex[reader] -= bufferSize;
-        }
+    if (latencyTracer && cursor.numWordsToBeRead > 0) {
+        int lastIndex = cursor.bufferReadIndex + cursor.numWordsToBeRead - 1;
+        if (lastIndex >= bufferSize) lastIndex -= bufferSize;
+        // Reader stages are in the same order as the Reader enum.
+        latencyTracer->stampStage((LatencyTracer::Stage) (LatencyTracer::StageDisplayRead + reader), timeStampBuffer[lastIndex]);
     }
 
-    // What is the minimum distance between the write index and the memory indexes after adjusting indexes?
-    int minDistanceNew = bufferSize;
-    int minIndex = 0;
-    for (int r = 0; r < numReaders; ++r) {
-        int distance = bufferMemoryIndex[r] - bufferWriteIndexFrozen;
-        if (distance < 0) distance += bufferSize;
-        if (distance < minDistanceNew) {
-            minDistanceNew = distance;
-            minIndex = r;
-        }
+    cursor.bufferReadIndex += cursor.numWordsToBeRead;
+    if (cursor.bufferReadIndex >= bufferSize) {
+        cursor.bufferReadIndex -= bufferSize;
     }
+    int64_t wordsRead = cursor.totalWordsRead.load(std::memory_order_relaxed) + cursor.numWordsToBeRead;
+    cursor.totalWordsRead.store(wordsRead, std::memory_order_release);
 
-    int maxWriteSize = maxWriteSizeInDataBlocks * RHXDataBlock::samplesPerDataBlock(signalSources->getControllerType());
-    if (minDistanceNew < maxWriteSize) {
-        std::cout << "WaveformFifo: Running out of space!  Consumer number " << minIndex << " is not reading data quickly enough." << '\n';
+    // Keep up to memorySize words of old data; anything older may now be overwritten.
+    if (wordsRead - cursor.totalWordsFreed.load(std::memory_order_relaxed) > memorySize) {
+        cursor.totalWordsFreed.store(wordsRead - memorySize, std::memory_order_release);
+        freeSpaceEvent.notify();
     }
 
-//    cout << reader << ": " << minDistanceNew - minDistanceOld << EndOfLine;
-    freeWords.release(minDistanceNew - minDistanceOld);
-//    cout << reader << ":freeWords.release(" << minDistanceNew - minDistanceOld << "); Waveform FIFO is " << percentFull() << "% full." << EndOfLine;
-//    cout << "freeWords.available() = " << freeWords.available() << EndOfLine;
+    int minIndex;
+    int64_t minWordsFreed = minTotalWordsFreed(&minIndex);
+    int64_t freeWords = bufferSize - (totalWordsWritten.load(std::memory_order_acquire) - minWordsFreed);
+    if (minIndex >= 0 && freeWords < maxWriteSizeInDataBlocks * samplesPerDataBlock) {
+        std::cout << "WaveformFifo: Running out of space!  " << readerName((Reader) minIndex) << " reader is not reading data quickly enough." << '\n';
+    }
 }
 
 // Returns number of 'old' words in memory, not including newly written words.
 int WaveformFifo::numWordsInMemory(Reader reader) const
 {
-    if (bufferReadIndex[reader] >= bufferMemoryIndex[reader]) {
-        return bufferReadIndex[reader] - bufferMemoryIndex[reader];
-    } else {
-        return bufferReadIndex[reader] - bufferMemoryIndex[reader] + bufferSize;
-    }
+    return (int) (cursors[reader].totalWordsRead.load(std::memory_order_relaxed) -
+                  cursors[reader].totalWordsFreed.load(std::memory_order_relaxed));
 }
 
 double WaveformFifo::percentFull() const
 {
-//    return 100.0 * (1.0 - ((double)freeWords.available() / (double)bufferSize));
-    return std::max(100.0 * (1.0 - ((double)freeWords.available() / (double)(bufferSize - memorySize))), 0.0);
+    // Load the freed counts first: they can only increase, so the difference can never exceed bufferSize.
+    int64_t minWordsFreed = minTotalWordsFreed();
+    int64_t wordsUsed = totalWordsWritten.load(std::memory_order_acquire) - minWordsFreed;
+    return std::max(100.0 * ((double)(wordsUsed - memorySize) / (double)(bufferSize - memorySize)), 0.0);
 }
 
+// Empty the buffer, and reattach any detached readers.  This function must not be called while the writer or any
+// reader thread is active.
 void WaveformFifo::resetBuffer()
 {
-    std::lock_guard<std::mutex> lock(mtx);
-
-    freeWords.acquire(freeWords.available());
     for (int reader = 0; reader < numReaders; ++reader) {
-        usedWordsNewData[reader].acquire(usedWordsNewData[reader].available());
-        bufferReadIndex[reader] = 0;
-        bufferMemoryIndex[reader] = 0;
-        numWordsToBeRead[reader] = 0;
+        if (cursors[reader].status.load(std::memory_order_relaxed) == ReaderDetached) {
+            cursors[reader].status.store(ReaderRegistered, std::memory_order_relaxed);
+        }
+        cursors[reader].wordsDropped.store(0, std::memory_order_relaxed);
+        cursors[reader].timesDetached.store(0, std::memory_order_relaxed);
+        lagStatistics[reader].peakLagWords.store(0, std::memory_order_relaxed);
+        lagStatistics[reader].wordsAsSlowest.store(0, std::memory_order_relaxed);
+        cursors[reader].bufferReadIndex = 0;
+        cursors[reader].numWordsToBeRead = 0;
+        cursors[reader].cachedTotalWordsWritten = 0;
+        cursors[reader].totalWordsRead.store(0, std::memory_order_relaxed);
+        cursors[reader].totalWordsFreed.store(0, std::memory_order_relaxed);
     }
     bufferWriteIndex = 0;
     numWordsToBeWritten = 0;
-    freeWords.release(bufferSize);
+    cachedMinTotalWordsFreed = 0;
+    currentSlowestReader.store(-1, std::memory_order_relaxed);
+    appliedBandDemandWord.store(0, std::memory_order_relaxed);
+    totalWordsWritten.store(0, std::memory_order_release);
 }
 
 void WaveformFifo::pauseBuffer()
 {
     for (int reader = 0; reader < numReaders; ++reader) {
-        requestReadNewData((Reader) reader, usedWordsNewData[reader].available() - samplesPerDataBlock);
+        int numWords = std::max((int) newWordsAvailable((Reader) reader) - samplesPerDataBlock, 0);
         // Subtract one data block to compensate for data block added for spike detection pipeline (see requestReadNewData()).
-        freeOldData((Reader) reader);
+        if (requestReadNewData((Reader) reader, numWords)) {
+            freeOldData((Reader) reader);
+        }
     }
 }
 
+// Register a reader, which then reads data starting from the next word written.  Call only when the reader's thread
+// is not reading from the buffer (e.g., before it starts, or from that thread itself).  If the reader was already
+// registered or detached, return the number of words it skips (which are also counted as dropped); otherwise return 0.
+int64_t WaveformFifo::registerReader(Reader reader, ReaderPolicy policy)
+{
+    ReaderCursor& cursor = cursors[reader];
+    int64_t wordsWritten = totalWordsWritten.load(std::memory_order_acquire);
+    int64_t wordsSkipped = 0;
+    if (cursor.status.load(std::memory_order_relaxed) == ReaderUnregistered) {
+        cursor.wordsDropped.store(0, std::memory_order_relaxed);
+        cursor.timesDetached.store(0, std::memory_order_relaxed);
+    } else {
+        wordsSkipped = std::max(wordsWritten - cursor.totalWordsRead.load(std::memory_order_relaxed), (int64_t) 0);
+        cursor.wordsDropped.fetch_add(wordsSkipped, std::memory_order_relaxed);
+    }
+    cursor.bufferReadIndex = (int) (wordsWritten % bufferSize);
+    cursor.numWordsToBeRead = 0;
+    cursor.cachedTotalWordsWritten = wordsWritten;
+    cursor.totalWordsRead.store(wordsWritten, std::memory_order_relaxed);
+    cursor.totalWordsFreed.store(wordsWritten, std::memory_order_relaxed);
+    cursor.policy.store(policy, std::memory_order_relaxed);
+    cursor.status.store(ReaderRegistered, std::memory_order_release);
+    freeSpaceEvent.notify();
+    return wordsSkipped;
+}
+
+// Stop keeping data for a reader.  Call only when the reader's thread is not reading from the buffer.
+void WaveformFifo::unregisterReader(Reader reader)
+{
+    cursors[reader].status.store(ReaderUnregistered, std::memory_order_release);
+    freeSpaceEvent.notify();
+}
+
+// Change a reader's slow-reader policy.  Call only while no data is being written (e.g., while the controller is
+// stopped), since a reader that was allowed to fall behind may already have had data overwritten.
+void WaveformFifo::setReaderPolicy(Reader reader, ReaderPolicy policy)
+{
+    cursors[reader].policy.store(policy, std::memory_order_release);
+    freeSpaceEvent.notify();
+}
+
+WaveformFifo::ReaderStatistics WaveformFifo::readerStatistics(Reader reader) const
+{
+    const ReaderCursor& cursor = cursors[reader];
+    ReaderStatistics statistics;
+    int status = cursor.status.load(std::memory_order_acquire);
+    statistics.registered = status != ReaderUnregistered;
+    statistics.detached = status == ReaderDetached;
+    statistics.policy = (ReaderPolicy) cursor.policy.load(std::memory_order_relaxed);
+    int64_t wordsRead = cursor.totalWordsRead.load(std::memory_order_acquire);
+    statistics.lagWords = (status == ReaderRegistered) ?
+                std::max(totalWordsWritten.load(std::memory_order_acquire) - wordsRead, (int64_t) 0) : 0;
+    statistics.peakLagWords = lagStatistics[reader].peakLagWords.load(std::memory_order_relaxed);
+    statistics.wordsAsSlowest = lagStatistics[reader].wordsAsSlowest.load(std::memory_order_relaxed);
+    statistics.wordsDropped = cursor.wordsDropped.load(std::memory_order_relaxed);
+    statistics.timesDetached = cursor.timesDetached.load(std::memory_order_relaxed);
+    return statistics;
+}
+
+// Return the registered reader that was furthest behind at the last write, or -1 if every reader had caught up.
+int WaveformFifo::slowestReader() const
+{
+    return currentSlowestReader.load(std::memory_order_relaxed);
+}
+
+// Return one line per reader giving its registration, policy, lag (current and peak), time spent as the slowest
+// reader, and drop counts.  Times are in seconds at the given sample rate.
+std::string WaveformFifo::readerStatusReport(double sampleRate) const
+{
+    const char* policyNames[3] = { "block writer", "drop oldest", "detach" };
+    std::ostringstream report;
+    report << std::fixed << std::setprecision(3);
+    for (int r = 0; r < numReaders; ++r) {
+        ReaderStatistics statistics = readerStatistics((Reader) r);
+        if (r > 0) report << '\n';
+        report << readerName((Reader) r) << ": ";
+        if (!statistics.registered) {
+            report << "unregistered";
+            continue;
+        }
+        report << (statistics.detached ? "detached" : "registered") << " (" << policyNames[statistics.policy] <<
+                  "), lag " << statistics.lagWords / sampleRate << " s, peak lag " << statistics.peakLagWords / sampleRate <<
+                  " s, slowest reader for " << statistics.wordsAsSlowest / sampleRate << " s, " <<
+                  statistics.wordsDropped << " samples dropped, " << statistics.timesDetached << " times detached";
+    }
+    return report.str();
+}
+
+const char* WaveformFifo::readerName(Reader reader)
+{
+    switch (reader) {
+    case ReaderDisplay:
+        return "Display";
+    case ReaderDisk:
+        return "Disk";
+    case ReaderAudio:
+        return "Audio";
+    case ReaderTCP:
+        return "TCP";
+    default:
+        return "Unknown";
+    }
+}
+
+// The disk, display and audio readers never lose data: the writer waits for them.  (Display and audio may instead
+// skip ahead with PolicyDropOldest if DropDisplayAudioDataWhenBehind is set.)  A stalled TCP client must not stall
+// acquisition, so the TCP reader is detached instead.
+WaveformFifo::ReaderPolicy WaveformFifo::defaultReaderPolicy(Reader reader)
+{
+    switch (reader) {
+    case ReaderTCP:
+        return PolicyDetach;
+    default:
+        return PolicyBlockWriter;
+    }
+}
+
+// Return the handle of a waveform, or InvalidWaveformHandle if no waveform has this name.
+WaveformHandle WaveformFifo::findWaveform(const std::string& waveName) const
+{
+    std::map<std::string, WaveformHandle>::const_iterator p = waveformHandles.find(waveName);
+    if (p == waveformHandles.end()) {
+        return InvalidWaveformHandle;
+    }
+    return p->second;
+}
+
 float* WaveformFifo::getAnalogWaveformPointer(const std::string& waveName) const
 {
-    std::map<std::string, float*>::const_iterator p = analogWaveformIndices.find(waveName);
-    if (p == analogWaveformIndices.end()) {
+    float* waveform = analogWaveformPointer(findWaveform(waveName));
+    if (!waveform) {
         std::cerr << "ERROR: WaveformFifo:getAnalogWaveformPointer: " << waveName << " not found." << '\n';
-        return nullptr;
     }
-    return p->second;
+    return waveform;
 }
 
 uint16_t* WaveformFifo::getDigitalWaveformPointer(const std::string& waveName) const
 {
-    std::map<std::string, uint16_t*>::const_iterator p = digitalWaveformIndices.find(waveName);
-    if (p == digitalWaveformIndices.end()) {
+    uint16_t* waveform = digitalWaveformPointer(findWaveform(waveName));
+    if (!waveform) {
         std::cerr << "ERROR: WaveformFifo:getDigitalWaveformPointer: " << waveName << " not found." << '\n';
-        return nullptr;
     }
-    return p->second;
+    return waveform;
 }
 
 GpuWaveformAddress WaveformFifo::getGpuWaveformAddress(const std::string& waveName) const
 {
-    std::map<std::string, GpuWaveformAddress>::const_iterator p = gpuWaveformAddresses.find(waveName);
-    if (p == gpuWaveformAddresses.end()) {
-        return GpuWaveformAddress{ GpuWaveformWideband, -1 };
-        std::cerr << "ERROR: WaveformFifo::getGpuWaveformAddress: " << waveName << " not found." << '\n';
-    }
-    return p->second;
+    return gpuWaveformAddress(findWaveform(waveName));
 }
 
 bool WaveformFifo::gpuWaveformPresent(const std::string& waveName) const
 {
-    std::map<std::string, GpuWaveformAddress>::const_iterator p = gpuWaveformAddresses.find(waveName);
-    if (p == gpuWaveformAddresses.end()) {
-        return false;
+    return gpuWaveformPresent(findWaveform(waveName));
+}
+
+// Compare the cost of resolving every amplifier band by name with the cost of resolving it by handle, and return a
+// report of the results.
+std::string WaveformFifo::lookupBenchmarkReport() const
+{
+    const char* bandSuffixes[4] = { "|WIDE", "|LOW", "|HIGH", "|SPK" };
+    const int Repetitions = 100;
+
+    std::vector<std::string> waveNames;
+    for (int group = 0; group < signalSources->numGroups(); group++) {
+        SignalGroup* signalGroup = signalSources->groupByIndex(group);
+        for (int signal = 0; signal < signalGroup->numChannels(); signal++) {
+            Channel* signalChannel = signalGroup->channelByIndex(signal);
+            if (signalChannel->getSignalType() != AmplifierSignal) continue;
+            for (const char* suffix : bandSuffixes) {
+                waveNames.push_back(signalChannel->getNativeNameString() + suffix);
+            }
+        }
     }
-    return true;
+    std::vector<WaveformHandle> handles(waveNames.size());
+    for (int i = 0; i < (int) waveNames.size(); ++i) {
+        handles[i] = findWaveform(waveNames[i]);
+    }
+
+    // Sum the results so the lookups can't be optimized away.
+    int checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int rep = 0; rep < Repetitions; ++rep) {
+        for (const std::string& waveName : waveNames) {
+            checksum += getGpuWaveformAddress(waveName).waveformIndex;
+        }
+    }
+    auto middle = std::chrono::steady_clock::now();
+    for (int rep = 0; rep < Repetitions; ++rep) {
+        for (WaveformHandle handle : handles) {
+            checksum -= gpuWaveformAddress(handle).waveformIndex;
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double nameLookupUs = std::chrono::duration<double, std::micro>(middle - start).count() / Repetitions;
+    double handleLookupUs = std::chrono::duration<double, std::micro>(end - middle).count() / Repetitions;
+    std::ostringstream out;
+    out << "Waveform lookup cost for " << waveNames.size() << " amplifier waveforms: by name " << nameLookupUs <<
+           " us, by handle " << handleLookupUs << " us" << (checksum == 0 ? "" : " (lookup mismatch)");
+    return out.str();
+}
+
+// Measure the cost of publishing cursors with each cursor on its own cache line (as in ReaderCursor) and with all
+// cursors packed onto one line.  A writer thread advances its cursor and checks the readers' cursors, as in
+// commitNewData(), while each reader thread checks the writer's cursor and advances its own, as in freeOldData().
+std::string WaveformFifo::cursorPaddingBenchmarkReport()
+{
+    const int Updates = 5000000;
+    const int MaxReaders = 4;
+
+    int numThreads = std::min((int) std::thread::hardware_concurrency(), MaxReaders + 1);
+    if (numThreads < 2) {
+        return "Cursor padding benchmark needs at least two processor cores";
+    }
+    int numCursorReaders = numThreads - 1;
+
+    struct alignas(CacheLineSize) PaddedCursor
+    {
+        std::atomic<int64_t> count;
+    };
+    struct alignas(CacheLineSize) PackedCursors
+    {
+        std::atomic<int64_t> count[MaxReaders + 1];
+    };
+    PaddedCursor padded[MaxReaders + 1];
+    PackedCursors packed;
+
+    // Return the mean time per cursor update in nanoseconds, with cursor[0] owned by the writer.
+    auto run = [&](std::atomic<int64_t>* cursor[]) {
+        for (int i = 0; i < numThreads; ++i) {
+            cursor[i]->store(0);
+        }
+        std::atomic<int> ready(0);
+        std::atomic<bool> go(false);
+        std::vector<std::thread> readers;
+        for (int i = 1; i < numThreads; ++i) {
+            readers.emplace_back([&, i]() {
+                ready.fetch_add(1);
+                while (!go.load(std::memory_order_acquire)) {}
+                for (int64_t n = 1; n <= Updates; ++n) {
+                    (void) cursor[0]->load(std::memory_order_acquire);
+                    cursor[i]->store(n, std::memory_order_release);
+                }
+            });
+        }
+        while (ready.load() < numCursorReaders) std::this_thread::yield();
+        auto start = std::chrono::steady_clock::now();
+        go.store(true, std::memory_order_release);
+        for (int64_t n = 1; n <= Updates; ++n) {
+            cursor[0]->store(n, std::memory_order_release);
+            for (int i = 1; i < numThreads; ++i) {
+                (void) cursor[i]->load(std::memory_order_acquire);
+            }
+        }
+        for (std::thread& reader : readers) {
+            reader.join();
+        }
+        auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::nano>(end - start).count() / Updates;
+    };
+
+    std::atomic<int64_t>* paddedCursors[MaxReaders + 1];
+    std::atomic<int64_t>* packedCursors[MaxReaders + 1];
+    for (int i = 0; i <= MaxReaders; ++i) {
+        paddedCursors[i] = &padded[i].count;
+        packedCursors[i] = &packed.count[i];
+    }
+    double paddedNs = run(paddedCursors);
+    double packedNs = run(packedCursors);
+
+    std::ostringstream out;
+    out << "Cursor update cost with a writer and " << numCursorReaders << " reader thread" <<
+           (numCursorReaders == 1 ? "" : "s") << ": one cursor per cache line " << paddedNs <<
+           " ns, all cursors on one cache line " << packedNs << " ns (" << packedNs / paddedNs << "x)";
+    return out.str();
 }
 
 void WaveformFifo::updateForRescan()
@@ -868,4 +1302,98 @@ void WaveformFifo::updateForRescan()
     numAmplifierChannels = signalSources->numUSBAmpChannels();
     allocateMemory();
     resetBuffer();
+
+    // Amplifier channel indices may have changed, so readers must register their band demand again.
+    std::lock_guard<std::mutex> lockDemand(bandDemandMutex);
+    readerBandDemand.resize(numReaders);
+    for (int reader = 0; reader < numReaders; ++reader) {
+        readerBandDemand[reader].assign(numAmplifierChannels, 0);
+    }
+    readerBandDemandRaised.assign(numReaders, 0);
+    bandDemandGeneration.fetch_add(1, std::memory_order_release);
+}
+
+// Record the amplifier bands that this reader consumes.  Names that are not filtered amplifier bands (e.g., "|SPK"
+// or non-amplifier channels) are ignored.  Each call replaces the reader's previous demand.
+void WaveformFifo::setBandDemand(Reader reader, const std::vector<std::string>& waveNames)
+{
+    std::vector<uint8_t> demand(numAmplifierChannels, 0);
+    for (const std::string& waveName : waveNames) {
+        GpuWaveformAddress address = getGpuWaveformAddress(waveName);
+        int index = address.waveformIndex;
+        if (index < 0 || index >= numAmplifierChannels) continue;
+        switch (address.waveformType) {
+        case GpuWaveformWideband:
+            demand[index] |= BandWide;
+            break;
+        case GpuWaveformLowpass:
+            demand[index] |= BandLow;
+            break;
+        case GpuWaveformHighpass:
+            demand[index] |= BandHigh;
+            break;
+        case GpuWaveformSpike:
+            break;
+        }
+    }
+
+    replaceBandDemand(reader, demand);
+}
+
+void WaveformFifo::setBandDemand(Reader reader, uint8_t bands)
+{
+    std::vector<uint8_t> demand(numAmplifierChannels, bands);
+    replaceBandDemand(reader, demand);
+}
+
+void WaveformFifo::replaceBandDemand(Reader reader, std::vector<uint8_t>& demand)
+{
+    std::lock_guard<std::mutex> lockDemand(bandDemandMutex);
+    if (readerBandDemand[reader] == demand) return;
+
+    bool raised = false;
+    for (int channel = 0; channel < numAmplifierChannels; ++channel) {
+        if (demand[channel] & ~readerBandDemand[reader][channel]) raised = true;
+    }
+    readerBandDemand[reader].swap(demand);
+    uint32_t generation = bandDemandGeneration.fetch_add(1, std::memory_order_release) + 1;
+    if (raised) readerBandDemandRaised[reader] = generation;
+}
+
+// If any reader's band demand has changed since 'generation', fill demand with the bands needed by any reader for
+// each amplifier channel, update generation, and return true.  This is cheap when nothing has changed, so it may be
+// called from the waveform processor before every write.
+bool WaveformFifo::updateBandDemand(std::vector<uint8_t>& demand, uint32_t& generation)
+{
+    if (bandDemandGeneration.load(std::memory_order_acquire) == generation) return false;
+
+    std::lock_guard<std::mutex> lockDemand(bandDemandMutex);
+    generation = bandDemandGeneration.load(std::memory_order_relaxed);
+    demand.assign(numAmplifierChannels, 0);
+    for (int reader = 0; reader < numReaders; ++reader) {
+        for (int channel = 0; channel < numAmplifierChannels; ++channel) {
+            demand[channel] |= readerBandDemand[reader][channel];
+        }
+    }
+
+    // The waveform processor calls this after requestWriteSpace(), so the new demand applies from the next word
+    // written onward.
+    appliedBandDemandWord.store(totalWordsWritten.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    appliedBandDemandGeneration.store(generation, std::memory_order_release);
+    return true;
+}
+
+// Return true if all data this reader is currently reading was processed with its latest raised band demand, i.e.,
+// the waveform processor has picked up the demand and the reader has moved past the data written before that.
+bool WaveformFifo::bandDemandInEffect(Reader reader)
+{
+    uint32_t raised;
+    {
+        std::lock_guard<std::mutex> lockDemand(bandDemandMutex);
+        raised = readerBandDemandRaised[reader];
+    }
+    uint32_t applied = appliedBandDemandGeneration.load(std::memory_order_acquire);
+    if ((int32_t) (applied - raised) < 0) return false;
+    return cursors[reader].totalWordsRead.load(std::memory_order_relaxed) >=
+            appliedBandDemandWord.load(std::memory_order_relaxed);
 }
@@ -31,22 +31,38 @@
 #ifndef WAVEFORMFIFO_H
 #define WAVEFORMFIFO_H
 
+#include <atomic>
 #include <iostream>
 #include <string>
 #include <map>
 #include <vector>
 #include <mutex>
-#include "semaphore.h"
+#include "dataevent.h"
+#include "latencytracer.h"
 #include "minmax.h"
 #include "signalsources.h"
 
 // Multi-waveform FIFO implemented as a circular buffer.  Additional buffer space is allocated
 // beyond the end of the buffer to permit continuous writes to the buffer up to a specified
 // length.  If data is written beyond the end of the buffer, the extra data is copied to the
-// beginning of the buffer after writing has completed.
+// beginning of the buffer after writing has completed.  Where the operating system supports it
+// (see StreamingMemory::allocateMirrored()), the space beyond the end of each buffer is instead a
+// second mapping of the buffer itself, so no copy is needed.
 //
 // The buffer also has a "memory" that maintains a specified number of old data words from
 // previous writes.
+//
+// One thread (WaveformProcessorThread) writes to the buffer, and each reader has its own thread.  These threads
+// coordinate without a shared lock: the writer publishes a monotonic count of words written, and each reader
+// publishes monotonic counts of words read and words freed (no longer needed as memory).  Free space is set by the
+// reader that has freed the fewest words, so a stalled reader can eventually stall the writer, but never blocks it
+// (or the other readers) while they update their own counts.
+//
+// Readers may be registered and unregistered at run time (e.g., when audio output is switched on or off), and each
+// has a policy that sets what happens if it falls so far behind that the writer runs out of space.  Only readers
+// with PolicyBlockWriter (by default, the disk, display and audio readers) can ever make the writer wait.  A
+// PolicyDropOldest reader that stalls partway through a read may find some of that read's data already overwritten,
+// so that policy is only used for the display and audio readers if it is requested (DropDisplayAudioDataWhenBehind).
 
 enum GpuWaveformType {
     GpuWaveformWideband,
@@ -61,6 +77,11 @@ struct GpuWaveformAddress
     int waveformIndex;
 };
 
+// Dense integer identifier for a named waveform (e.g., "A-000|WIDE").  Resolve a name once with findWaveform(), then
+// reach the waveform's buffers by array index in per-block code.  Handles remain valid until the next updateForRescan().
+typedef int WaveformHandle;
+const WaveformHandle InvalidWaveformHandle = -1;
+
 const uint8_t SpikeIdNoSpike = 0x00u;
 const uint8_t SpikeIdSpikeType1 = 0x01u;
 const uint8_t SpikeIdSpikeType2 = 0x02u;
@@ -81,6 +102,33 @@ public:
         NumberOfReaders   // Don't use this last enum; used only by constructor to count total number of readers.
     };
 
+    // Filtered amplifier bands, as bit flags for the band demand registry.
+    enum AmplifierBand : uint8_t {
+        BandWide = 0x01u,
+        BandLow = 0x02u,
+        BandHigh = 0x04u,
+        AllBands = 0x07u
+    };
+
+    // What happens when a reader falls so far behind that the writer would run out of space.
+    enum ReaderPolicy {
+        PolicyBlockWriter,  // The writer waits for this reader, so it never loses data.
+        PolicyDropOldest,   // The writer overwrites this reader's oldest data; the reader skips ahead to the newest data.
+        PolicyDetach        // The writer detaches this reader, which gets no more data until it is registered again.
+    };
+
+    struct ReaderStatistics
+    {
+        bool registered;
+        bool detached;
+        ReaderPolicy policy;
+        int64_t lagWords;       // words written that this reader has not yet released with freeOldData()
+        int64_t peakLagWords;   // largest lagWords seen by the writer since the last resetBuffer()
+        int64_t wordsAsSlowest; // words written while this was the registered reader furthest behind
+        int64_t wordsDropped;   // words skipped by a PolicyDropOldest reader since the last resetBuffer()
+        int timesDetached;      // times a PolicyDetach reader was detached since the last resetBuffer()
+    };
+
     WaveformFifo(SignalSources *signalSources_, int bufferSizeInDataBlocks_, int memorySizeInDataBlocks_, int maxWriteSizeInDataBlocks_, SystemState* state_);
     ~WaveformFifo();
 
@@ -88,6 +136,8 @@ public:
 
     // 1:.
     bool requestWriteSpace(int numDataBlocks);   // Call once before writing a block of data
+    bool waitForWriteSpace(int numDataBlocks, int timeoutMicroseconds,
+                           LatencyHistogram* wakeupLatency = nullptr);  // Optionally call to block until space is free.
 
     // 2:
     inline float* pointerToAnalogWriteSpace(const float* waveform) const  // Call for each waveform, then write data to location.
@@ -125,13 +175,16 @@ public:
         return &gpuSpikeIds[(bufferWriteIndex/samplesPerDataBlock) * numAmplifierChannels * maxSpikesPerDataBlock];
     }
 
-    bool extractGpuSpikeDataOneDataBlock(uint16_t* waveform, GpuWaveformAddress waveformAddress, bool firstTime) const;
+    bool extractGpuSpikeData(uint16_t* waveform, GpuWaveformAddress waveformAddress, int numDataBlocks, bool firstTime) const;
 
     inline uint32_t* pointerToTimeStampWriteSpace() const
     {
         return &timeStampBuffer[bufferWriteIndex];
     } 
 
+    // Index of the current write space within each waveform buffer, for writers that hold buffer base addresses.
+    inline int writeSpaceIndex() const { return bufferWriteIndex; }
+
     // 3:
     void commitNewData();   // Call once after all writing is complete.
 
@@ -140,6 +193,8 @@ public:
 
     // 1:
     bool requestReadNewData(Reader reader, int numWords, bool lastRead = false); // Call once before reading a block of data.
+    bool waitForNewData(Reader reader, int numWords, bool lastRead, int timeoutMicroseconds,
+                        LatencyHistogram* wakeupLatency = nullptr);  // Optionally call to block until data arrives.
 
     // 2:
 
@@ -148,12 +203,12 @@ public:
     // recently written data is found between timeIndex values of zero and numWordsToBeRead.
     inline float getAnalogData(Reader reader, const float* waveform, int timeIndex) const  // Call many times to read all data.
     {
-        if (timeIndex >= numWordsToBeRead[reader] || timeIndex < -numWordsInMemory(reader)) {
+        if (timeIndex >= cursors[reader].numWordsToBeRead || timeIndex < -numWordsInMemory(reader)) {
             std::cerr << "Error: WaveformFifo::getAnalogData: timeIndex " << timeIndex << " out of range.\n";
             return 0.0F;
         }
 
-        int index = bufferReadIndex[reader] + timeIndex;
+        int index = cursors[reader].bufferReadIndex + timeIndex;
         if (index < 0) index += bufferSize;
         else if (index >= bufferSize) index -= bufferSize;
         return waveform[index];
@@ -164,12 +219,12 @@ public:
     // recently written data is found between timeIndex values of zero and numWordsToBeRead.
     inline uint16_t getDigitalData(Reader reader, const uint16_t* waveform, int timeIndex) const  // Call many times to read all data.
     {
-        if (timeIndex >= numWordsToBeRead[reader] || timeIndex < -numWordsInMemory(reader)) {
+        if (timeIndex >= cursors[reader].numWordsToBeRead || timeIndex < -numWordsInMemory(reader)) {
             std::cerr << "Error: WaveformFifo::getDigitalData: timeIndex " << timeIndex << " out of range.\n";
             return 0;
         }
 
-        int index = bufferReadIndex[reader] + timeIndex;
+        int index = cursors[reader].bufferReadIndex + timeIndex;
         if (index < 0) index += bufferSize;
         else if (index >= bufferSize) index -= bufferSize;
         return waveform[index];
@@ -180,12 +235,12 @@ public:
     // requestReadNewData().  The most recently written data is found between timeIndex values of zero and numWordsToBeRead.
     inline uint16_t getAnalogDataAsDigital(Reader reader, const float* waveform, int timeIndex, float threshold) const
     {
-        if (timeIndex >= numWordsToBeRead[reader] || timeIndex < -numWordsInMemory(reader)) {
+        if (timeIndex >= cursors[reader].numWordsToBeRead || timeIndex < -numWordsInMemory(reader)) {
             std::cerr << "Error: WaveformFifo::getAnalogDataAsDigital: timeIndex " << timeIndex << " out of range.\n";
             return 0;
         }
 
-        int index = bufferReadIndex[reader] + timeIndex;
+        int index = cursors[reader].bufferReadIndex + timeIndex;
         if (index < 0) index += bufferSize;
         else if (index >= bufferSize) index -= bufferSize;
         return (waveform[index] >= threshold) ? 0x01u : 0;
@@ -193,12 +248,12 @@ public:
 
     inline uint32_t getTimeStamp(Reader reader, int timeIndex) const
     {
-        if (timeIndex >= numWordsToBeRead[reader] || timeIndex < -numWordsInMemory(reader)) {
+        if (timeIndex >= cursors[reader].numWordsToBeRead || timeIndex < -numWordsInMemory(reader)) {
             std::cerr << "Error: WaveformFifo::getTimeStamp: timeIndex " << timeIndex << " out of range.\n";
             return 0;
         }
 
-        int index = bufferReadIndex[reader] + timeIndex;
+        int index = cursors[reader].bufferReadIndex + timeIndex;
         if (index < 0) index += bufferSize;
         else if (index >= bufferSize) index -= bufferSize;
         return timeStampBuffer[index];
@@ -234,18 +289,66 @@ public:
     void resetBuffer();
     void pauseBuffer();
 
+    // Register a reader, which then reads data starting from the next word written.  Call only when the reader's
+    // thread is not reading from the buffer (e.g., before it starts, or from that thread itself).  Returns the number
+    // of words skipped if the reader was already registered or detached.
+    int64_t registerReader(Reader reader, ReaderPolicy policy);
+    void unregisterReader(Reader reader);
+    void setReaderPolicy(Reader reader, ReaderPolicy policy);
+    bool readerDetached(Reader reader) const { return cursors[reader].status.load(std::memory_order_acquire) == ReaderDetached; }
+    ReaderStatistics readerStatistics(Reader reader) const;
+    std::string readerStatusReport(double sampleRate) const;
+    int slowestReader() const;
+    static const char* readerName(Reader reader);
+    static ReaderPolicy defaultReaderPolicy(Reader reader);
+    void setLatencyTracer(LatencyTracer* latencyTracer_) { latencyTracer = latencyTracer_; }
+
+    WaveformHandle findWaveform(const std::string& waveName) const;
+
+    inline float* analogWaveformPointer(WaveformHandle handle) const
+    {
+        return (handle == InvalidWaveformHandle) ? nullptr : waveforms[handle].analog;
+    }
+
+    inline uint16_t* digitalWaveformPointer(WaveformHandle handle) const
+    {
+        return (handle == InvalidWaveformHandle) ? nullptr : waveforms[handle].digital;
+    }
+
+    inline GpuWaveformAddress gpuWaveformAddress(WaveformHandle handle) const
+    {
+        return (handle == InvalidWaveformHandle) ? GpuWaveformAddress{ GpuWaveformWideband, -1 } : waveforms[handle].gpuAddress;
+    }
+
+    inline bool gpuWaveformPresent(WaveformHandle handle) const
+    {
+        return handle != InvalidWaveformHandle && waveforms[handle].gpuAddress.waveformIndex >= 0;
+    }
+
+    // Name-based equivalents of the above, which look up the name on every call.
     float* getAnalogWaveformPointer(const std::string& waveName) const;
     uint16_t* getDigitalWaveformPointer(const std::string& waveName) const;
     GpuWaveformAddress getGpuWaveformAddress(const std::string& waveName) const;
     bool gpuWaveformPresent(const std::string& waveName) const;
 
+    std::string lookupBenchmarkReport() const;
+    static std::string cursorPaddingBenchmarkReport();
+
     void updateForRescan();
 
+    // Band demand registry: each reader records which filtered amplifier bands it consumes, so the waveform
+    // processor can skip computing and writing bands that no reader needs.  Data processed before the processor
+    // picked up a raised demand lacks the new bands, so a reader that raises its demand while running must not use
+    // them until bandDemandInEffect() returns true.
+    void setBandDemand(Reader reader, const std::vector<std::string>& waveNames);  // e.g., "A-000|LOW"
+    void setBandDemand(Reader reader, uint8_t bands);  // same bands for every amplifier channel
+    bool updateBandDemand(std::vector<uint8_t>& demand, uint32_t& generation);
+    bool bandDemandInEffect(Reader reader);
+
     bool memoryWasAllocated(double& memoryRequestedGB) const { memoryRequestedGB += memoryNeededGB; return memoryAllocated; }
 
 private:
     SystemState *state;
-    std::mutex mtx;
     SignalSources *signalSources;
     int numAmplifierChannels;
     int maxSpikesPerDataBlock;
@@ -253,11 +356,15 @@ private:
 
     // Buffer for timestamps
     uint32_t* timeStampBuffer;
+    bool timeStampBufferMirrored;
 
     // Buffers for GPU-processed amplifier waveforms
     uint16_t* gpuAmplifierWidebandBuffer;
     uint16_t* gpuAmplifierLowpassBuffer;
     uint16_t* gpuAmplifierHighpassBuffer;
+    bool gpuAmplifierBufferMirrored[3];  // wideband, lowpass, highpass
+
+    bool tryMirroredBuffers;
 
     // Buffers for GPU-processed spike detection data
     uint32_t* gpuSpikeTimestamps;
@@ -295,24 +402,80 @@ private:
     int bufferSize;
     int memorySize;
     int numReaders;
+    LatencyTracer* latencyTracer;
     int bufferAllocateSize;
     int bufferAllocateSizeInBlocks;
 
-    Semaphore freeWords;
-    Semaphore* usedWordsNewData;
+    // Written only by the writer thread.
+    alignas(CacheLineSize) std::atomic<int64_t> totalWordsWritten;
     int bufferWriteIndex;
-    std::vector<int> bufferReadIndex;
-    std::vector<int> bufferMemoryIndex;
     int numWordsToBeWritten;
-    std::vector<int> numWordsToBeRead;
+    int64_t cachedMinTotalWordsFreed;
+
+    enum ReaderStatus : int {
+        ReaderUnregistered,
+        ReaderRegistered,
+        ReaderDetached
+    };
+
+    // Written only by one reader thread (each on its own cache line), except that the writer may detach a reader,
+    // and registerReader() and unregisterReader() set up a reader before or after it runs.
+    struct alignas(CacheLineSize) ReaderCursor
+    {
+        std::atomic<int64_t> totalWordsRead;   // words released with freeOldData()
+        std::atomic<int64_t> totalWordsFreed;  // words no longer kept as memory, which the writer may overwrite
+        std::atomic<int> status;               // ReaderStatus
+        std::atomic<int> policy;               // ReaderPolicy
+        std::atomic<int64_t> wordsDropped;
+        std::atomic<int> timesDetached;
+        int bufferReadIndex;
+        int numWordsToBeRead;
+        int64_t cachedTotalWordsWritten;
+    };
+    ReaderCursor* cursors;
+
+    // Written only by the writer thread (in commitNewData()), to find which reader is holding up the buffer.
+    struct ReaderLagStatistics
+    {
+        std::atomic<int64_t> peakLagWords;
+        std::atomic<int64_t> wordsAsSlowest;
+    };
+    ReaderLagStatistics* lagStatistics;
+    std::atomic<int> currentSlowestReader;
+
+    DataEvent freeSpaceEvent;
+    DataEvent* newDataEvents;
+
+    // Buffers and GPU output location of each named waveform, indexed by WaveformHandle.  A name may have both a
+    // GPU address and a buffer (e.g., "A-000|SPK"); unused fields are nullptr, or have a waveformIndex of -1.
+    struct WaveformEntry
+    {
+        float* analog;
+        uint16_t* digital;
+        GpuWaveformAddress gpuAddress;
+        bool mirrored;  // analog or digital buffer wraps around by itself
+    };
+    std::vector<WaveformEntry> waveforms;
+    std::map<std::string, WaveformHandle> waveformHandles;
 
-    std::map<std::string, float*> analogWaveformIndices;
-    std::map<std::string, uint16_t*> digitalWaveformIndices;
-    std::map<std::string, GpuWaveformAddress> gpuWaveformAddresses;
+    std::mutex bandDemandMutex;
+    std::vector<std::vector<uint8_t> > readerBandDemand;  // [reader][amplifier channel]
+    std::vector<uint32_t> readerBandDemandRaised;  // [reader] generation at which the reader last added bands
+    std::atomic<uint32_t> bandDemandGeneration;
+    std::atomic<uint32_t> appliedBandDemandGeneration;  // latest generation picked up by the waveform processor
+    std::atomic<int64_t> appliedBandDemandWord;  // totalWordsWritten when it was picked up
+    void replaceBandDemand(Reader reader, std::vector<uint8_t>& demand);
 
     bool memoryAllocated;
     double memoryNeededGB;
 
+    WaveformHandle addWaveform(const std::string& waveName);
+    int64_t minTotalWordsFreed(int* slowestReader = nullptr) const;
+    bool detachSlowReaders(int64_t minWordsFreedNeeded);
+    void updateLagStatistics(int64_t wordsWritten, int numWordsWritten);
+    int64_t newWordsAvailable(Reader reader) const;
+    template <typename T>
+    T* allocateRingBuffer(std::size_t ringSize, std::size_t allocateSize, bool& mirrored);
     void allocateAnalogBuffer(std::vector<float*> &bufferArray, const std::string& waveName);
     void allocateDigitalBuffer(std::vector<uint16_t*> &bufferArray, const std::string& waveName);
     void allocateMemory();
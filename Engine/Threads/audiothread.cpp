@@ -45,7 +45,8 @@ AudioThread::AudioThread(SystemState *state_, WaveformFifo *waveformFifo_, const
     sampleRate(sampleRate_),
     keepGoing(false),
     running(false),
-    stopThread(false)
+    stopThread(false),
+    threadScheduler(nullptr)
 {
 }
 
@@ -58,6 +59,8 @@ void AudioThread::initialize()
     interpLength = 0;
     dataRatio = sampleRate / 44100.0;
     rawBlockSampleSize = ceil(dataRatio * NumSoundSamples);
+    demandedWaveName.clear();
+    waveformFifo->setBandDemand(WaveformFifo::ReaderAudio, (uint8_t) 0);
 
     // Initialize raw data array.
     rawData = new float[rawBlockSampleSize];
@@ -106,6 +109,8 @@ void AudioThread::run()
     while (!stopThread) {
         if (keepGoing) {
             running = true;
+            if (threadScheduler) threadScheduler->applyToCurrentThread(ThreadScheduler::ThreadAudio);
+            LatencyHistogram* wakeupJitter = threadScheduler ? &threadScheduler->wakeupJitter(ThreadScheduler::ThreadAudio) : nullptr;
 
             // Any 'start up' code goes here.
             initialize();
@@ -134,13 +139,15 @@ void AudioThread::run()
                     processAudioData();
 
                 } else {
-                    // Probably could sleep here for a while
+                    // Wait (briefly, so audio events are still processed) for more data to arrive.
+                    waveformFifo->waitForNewData(WaveformFifo::ReaderAudio, rawBlockSampleSize, false, EventLoopWaitMicroseconds, wakeupJitter);
                     qApp->processEvents();
                 }
            }
 
            // Any 'finish up' code goes here.
            mAudioSink->stop();
+           waveformFifo->setBandDemand(WaveformFifo::ReaderAudio, (uint8_t) 0);
 
            delete [] rawData;
            delete [] interpFloats;
@@ -148,7 +155,7 @@ void AudioThread::run()
 
            running = false;
         } else {
-            usleep(1000);
+            controlEvent.waitFor([this]() { return keepGoing || stopThread; }, IdleWaitMicroseconds);
         }
     }
 }
@@ -156,6 +163,7 @@ void AudioThread::run()
 void AudioThread::startRunning()
 {
     keepGoing = true;
+    controlEvent.notify();
 }
 
 void AudioThread::stopRunning()
@@ -167,6 +175,7 @@ void AudioThread::close()
 {
     keepGoing = false;
     stopThread = true;
+    controlEvent.notify();
 }
 
 bool AudioThread::fillBufferFromWaveformFifo()
@@ -184,18 +193,31 @@ bool AudioThread::fillBufferFromWaveformFifo()
     QString selectedChannelName = state->signalSources->singleSelectedAmplifierChannelName();
     if (selectedChannelName.isEmpty()) validAudioSource = false;
     QString selectedChannelFilterName = selectedChannelName + "|" + state->audioFilter->getDisplayValueString();
-    if (!waveformFifo->gpuWaveformPresent(selectedChannelFilterName.toStdString())) {
+    WaveformHandle waveformHandle = waveformFifo->findWaveform(selectedChannelFilterName.toStdString());
+    if (!waveformFifo->gpuWaveformPresent(waveformHandle)) {
         qDebug() << "Failure... channel name: " << selectedChannelFilterName;
         validAudioSource = false;
     }
-    GpuWaveformAddress waveformAddress = waveformFifo->getGpuWaveformAddress(selectedChannelFilterName.toStdString());
+    GpuWaveformAddress waveformAddress = waveformFifo->gpuWaveformAddress(waveformHandle);
     if (waveformAddress.waveformIndex < 0) validAudioSource = false;
 
+    // Tell the waveform processor which amplifier band is played.
+    QString waveName = validAudioSource ? selectedChannelFilterName : QString();
+    if (waveName != demandedWaveName) {
+        std::vector<std::string> waveNames;
+        if (!waveName.isEmpty()) waveNames.push_back(waveName.toStdString());
+        waveformFifo->setBandDemand(WaveformFifo::ReaderAudio, waveNames);
+        demandedWaveName = waveName;
+    }
+
     QString newChannelString;
     if (validAudioSource) {
         newChannelString = selectedChannelFilterName;
+        // Play silence until the waveform processor computes the newly selected band.
+        bool bandComputed = waveformFifo->bandDemandInEffect(WaveformFifo::ReaderAudio);
         for (int i = 0; i < rawBlockSampleSize; ++i) {
-            rawData[i] = waveformFifo->getGpuAmplifierData(WaveformFifo::ReaderAudio, waveformAddress, i);
+            rawData[i] = bandComputed ? waveformFifo->getGpuAmplifierData(WaveformFifo::ReaderAudio, waveformAddress, i) :
+                                        0.0F;
         }
     } else {
         newChannelString = "";
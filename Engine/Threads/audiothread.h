@@ -38,6 +38,7 @@
 #include <mutex>
 #include "systemstate.h"
 #include "waveformfifo.h"
+#include "threadscheduling.h"
 
 class AudioThread : public QThread
 {
@@ -50,6 +51,7 @@ public:
     void stopRunning();  // Exit run loop.
     bool isActive() const { return running; }  // Is this thread running?
     void close();  // Close thread.
+    void setThreadScheduler(ThreadScheduler* threadScheduler_) { threadScheduler = threadScheduler_; }
 
 signals:
     void newChannel(QString name);
@@ -96,6 +98,8 @@ private:
     std::atomic_bool keepGoing;
     std::atomic_bool running;
     std::atomic_bool stopThread;
+    DataEvent controlEvent;
+    ThreadScheduler* threadScheduler;
 
     float currentValue;
     float nextValue;
@@ -107,6 +111,7 @@ private:
     QDataStream* s;
 
     QString currentChannelString;
+    QString demandedWaveName;
 
     void initialize();
     bool fillBufferFromWaveformFifo();
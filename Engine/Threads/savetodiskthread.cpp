@@ -43,6 +43,7 @@ SaveToDiskThread::SaveToDiskThread(WaveformFifo* waveformFifo_, SystemState* sta
     keepGoing = false;
     running = false;
     stopThread = false;
+    threadScheduler = nullptr;
 }
 
 SaveToDiskThread::~SaveToDiskThread()
@@ -89,6 +90,8 @@ void SaveToDiskThread::run()
 
         if (keepGoing) {
             running = true;
+            if (threadScheduler) threadScheduler->applyToCurrentThread(ThreadScheduler::ThreadDisk);
+            LatencyHistogram* wakeupJitter = threadScheduler ? &threadScheduler->wakeupJitter(ThreadScheduler::ThreadDisk) : nullptr;
             int triggerBeginCounter = 0;    // used to ignore glitches shortly after trigger is activated
             int triggerEndCounter = 0;      // used to time postTriggerBuffer
             int triggerEndSamples = ceil(state->postTriggerBuffer->getValue() * state->sampleRate->getNumericValue());
@@ -256,7 +259,8 @@ void SaveToDiskThread::run()
 //                        reportTimer.restart();
 //                    }
                 } else {
-                    usleep(1000);    // If new data is not ready, wait 1000 microseconds and try again.
+                    // If new data is not ready, wait for it to arrive and try again.
+                    waveformFifo->waitForNewData(WaveformFifo::ReaderDisk, NumSamples, lastRead, DataWaitMicroseconds, wakeupJitter);
                 }
             }
 
@@ -275,7 +279,7 @@ void SaveToDiskThread::run()
                 delete saveManager;
                 saveManager = nullptr;
             }
-            usleep(1000);
+            controlEvent.waitFor([this]() { return keepGoing || stopThread; }, IdleWaitMicroseconds);
         }
     }
     if (saveManager) {
@@ -319,6 +323,7 @@ void SaveToDiskThread::startRunning()
     }
 
     keepGoing = true;
+    controlEvent.notify();
 }
 
 void SaveToDiskThread::stopRunning()
@@ -330,6 +335,7 @@ void SaveToDiskThread::close()
 {
     keepGoing = false;
     stopThread = true;
+    controlEvent.notify();
 }
 
 bool SaveToDiskThread::isActive() const
@@ -39,6 +39,7 @@
 #include "signalsources.h"
 #include "rhxdatablock.h"
 #include "savemanager.h"
+#include "threadscheduling.h"
 
 class SaveToDiskThread : public QThread
 {
@@ -52,6 +53,7 @@ public:
     void stopRunning();
     bool isActive() const;
     void close();
+    void setThreadScheduler(ThreadScheduler* threadScheduler_) { threadScheduler = threadScheduler_; }
 
     int64_t getTotalRecordedSamples() const { return totalRecordedSamples; }
 
@@ -76,9 +78,11 @@ private:
     SystemState* state;
     SaveManager* saveManager;
 
-    volatile bool keepGoing;
-    volatile bool running;
-    volatile bool stopThread;
+    std::atomic_bool keepGoing;
+    std::atomic_bool running;
+    std::atomic_bool stopThread;
+    DataEvent controlEvent;
+    ThreadScheduler* threadScheduler;
 
     std::vector<float*> boardAdcWaveform;
     uint16_t* boardDigitalInWaveform;
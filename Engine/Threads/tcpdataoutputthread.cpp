@@ -34,6 +34,8 @@ TCPDataOutputThread::TCPDataOutputThread(WaveformFifo *waveformFifo_, const doub
     QThread(parent),
     tcpWaveformDataCommunicator(state_->tcpWaveformDataCommunicator),
     tcpSpikeDataCommunicator(state_->tcpSpikeDataCommunicator),
+    digitalInWordWaveform(InvalidWaveformHandle),
+    digitalOutWordWaveform(InvalidWaveformHandle),
     previousSample(nullptr),
     waveformFifo(waveformFifo_),
     signalSources(state_->signalSources),
@@ -41,6 +43,7 @@ TCPDataOutputThread::TCPDataOutputThread(WaveformFifo *waveformFifo_, const doub
     keepGoing(false),
     running(false),
     stopThread(false),
+    threadScheduler(nullptr),
     parentObject(parent),
     connected(false),
     state(state_)
@@ -58,6 +61,8 @@ void TCPDataOutputThread::run()
     while (!stopThread) {
         if (keepGoing) {
             running = true;
+            if (threadScheduler) threadScheduler->applyToCurrentThread(ThreadScheduler::ThreadTCP);
+            LatencyHistogram* wakeupJitter = threadScheduler ? &threadScheduler->wakeupJitter(ThreadScheduler::ThreadTCP) : nullptr;
             std::cout << "TCP setup" << '\n';
 
             // Any 'start up' code goes here.
@@ -73,11 +78,26 @@ void TCPDataOutputThread::run()
                     closeCompleted = false;
                 }
 
+                if (waveformFifo->readerDetached(WaveformFifo::ReaderTCP)) {
+                    // We fell behind (e.g., a client stopped reading) and were detached.  Start again from the newest
+                    // data, and report the gap, which clients also see as a jump in timestamps.
+                    int64_t samplesLost = waveformFifo->registerReader(WaveformFifo::ReaderTCP,
+                                                                       WaveformFifo::defaultReaderPolicy(WaveformFifo::ReaderTCP));
+                    if (tcpWaveformDataCommunicator->status == TCPCommunicator::Connected ||
+                            tcpSpikeDataCommunicator->status == TCPCommunicator::Connected) {
+                        std::cerr << "TCPDataOutputThread: TCP data output fell behind; " << samplesLost <<
+                                     " samples were not sent." << '\n';
+                    }
+                }
+
                 // If neither waveform nor spike ports are connected, just do a dummy read of the WaveformFifo
                 if (tcpWaveformDataCommunicator->status != TCPCommunicator::Connected &&
                         tcpSpikeDataCommunicator->status != TCPCommunicator::Connected) {
                     if (waveformFifo->requestReadNewData(WaveformFifo::ReaderTCP, FramesPerBlock * state->tcpNumDataBlocksWrite->getValue())) {
                         waveformFifo->freeOldData(WaveformFifo::ReaderTCP);
+                    } else {
+                        waveformFifo->waitForNewData(WaveformFifo::ReaderTCP, FramesPerBlock * state->tcpNumDataBlocksWrite->getValue(),
+                                                     false, EventLoopWaitMicroseconds, wakeupJitter);
                     }
                 }
 
@@ -96,6 +116,13 @@ void TCPDataOutputThread::run()
                             continue;
                         }
 
+                        // Newly enabled bands are missing from data processed before the waveform processor picked
+                        // up our band demand, so skip that data rather than sending zeros.
+                        if (!waveformFifo->bandDemandInEffect(WaveformFifo::ReaderTCP)) {
+                            waveformFifo->freeOldData(WaveformFifo::ReaderTCP);
+                            continue;
+                        }
+
                         for (int i = 0; i < FramesPerBlock * state->tcpNumDataBlocksWrite->getValue(); ++i) {
                             if ((i % FramesPerBlock) == 0) {
                                 waveformArray.replace(waveformArrayIndex, sizeof(TCPWaveformMagicNumber), (const char*)(&TCPWaveformMagicNumber), sizeof(TCPWaveformMagicNumber));
@@ -112,10 +139,10 @@ void TCPDataOutputThread::run()
                             waveformArrayIndex += sizeof(timestamp);
 
                             // Grab digital in word and digital out word
-                            uint16_t* boardDigitalInWaveform = waveformFifo->getDigitalWaveformPointer("DIGITAL-IN-WORD");
+                            uint16_t* boardDigitalInWaveform = waveformFifo->digitalWaveformPointer(digitalInWordWaveform);
                             uint16_t digitalInWord = waveformFifo->getDigitalData(WaveformFifo::ReaderTCP, boardDigitalInWaveform, i);
                             bool digitalInWordSent = false;
-                            uint16_t* boardDigitalOutWaveform = waveformFifo->getDigitalWaveformPointer("DIGITAL-OUT-WORD");
+                            uint16_t* boardDigitalOutWaveform = waveformFifo->digitalWaveformPointer(digitalOutWordWaveform);
                             uint16_t digitalOutWord = waveformFifo->getDigitalData(WaveformFifo::ReaderTCP, boardDigitalOutWaveform, i);
                             bool digitalOutWordSent = false;
 
@@ -123,15 +150,15 @@ void TCPDataOutputThread::run()
 
                             for (int channel = 0; channel < enabledChannelNames.size(); ++channel) {
 
-                                Channel *thisChannel = signalSources->channelByName(enabledChannelNames[channel]);
+                                const TCPChannelWaveforms& waveforms = enabledChannelWaveforms[channel];
+                                Channel *thisChannel = waveforms.channel;
 
                                 // If this channel is an amplifier signal, read all enabled bands
                                 if (thisChannel->getSignalType() == AmplifierSignal) {
 
                                     if (thisChannel->getOutputToTcp()) {
-                                        std::string waveName = QString(enabledChannelNames[channel] + "|WIDE").toStdString();
-                                        if (!waveformFifo->gpuWaveformPresent(waveName)) continue; // Error happened here - we should flag that there was a problem.
-                                        GpuWaveformAddress waveformAddress = waveformFifo->getGpuWaveformAddress(waveName);
+                                        if (!waveformFifo->gpuWaveformPresent(waveforms.wide)) continue; // Error happened here - we should flag that there was a problem.
+                                        GpuWaveformAddress waveformAddress = waveformFifo->gpuWaveformAddress(waveforms.wide);
                                         if (waveformAddress.waveformIndex < 0) continue; // Error happened here - we should flag that there was a problem.
                                         uint16_t thisSample = waveformFifo->getGpuAmplifierDataRaw(WaveformFifo::ReaderTCP, waveformAddress, i);
                                         waveformArray.replace(waveformArrayIndex, sizeof(thisSample), (const char*)(&thisSample), sizeof(thisSample));
@@ -139,9 +166,8 @@ void TCPDataOutputThread::run()
                                     }
 
                                     if (thisChannel->getOutputToTcpLow()) {
-                                        std::string waveName = QString(enabledChannelNames[channel] + "|LOW").toStdString();
-                                        if (!waveformFifo->gpuWaveformPresent(waveName)) continue; // Error happened here - we should flag that there was a problem.
-                                        GpuWaveformAddress waveformAddress = waveformFifo->getGpuWaveformAddress(waveName);
+                                        if (!waveformFifo->gpuWaveformPresent(waveforms.low)) continue; // Error happened here - we should flag that there was a problem.
+                                        GpuWaveformAddress waveformAddress = waveformFifo->gpuWaveformAddress(waveforms.low);
                                         if (waveformAddress.waveformIndex < 0) continue; // Error happened here - we should flag that there was a problem.
                                         uint16_t thisSample = waveformFifo->getGpuAmplifierDataRaw(WaveformFifo::ReaderTCP, waveformAddress, i);
                                         waveformArray.replace(waveformArrayIndex, sizeof(thisSample), (const char*)(&thisSample), sizeof(thisSample));
@@ -149,9 +175,8 @@ void TCPDataOutputThread::run()
                                     }
 
                                     if (thisChannel->getOutputToTcpHigh()) {
-                                        std::string waveName = QString(enabledChannelNames[channel] + "|HIGH").toStdString();
-                                        if (!waveformFifo->gpuWaveformPresent(waveName)) continue; // Error happened here - we should flag that there was a problem.
-                                        GpuWaveformAddress waveformAddress = waveformFifo->getGpuWaveformAddress(waveName);
+                                        if (!waveformFifo->gpuWaveformPresent(waveforms.high)) continue; // Error happened here - we should flag that there was a problem.
+                                        GpuWaveformAddress waveformAddress = waveformFifo->gpuWaveformAddress(waveforms.high);
                                         if (waveformAddress.waveformIndex < 0) continue; // Error happened here - we should flag that there was a problem.
                                         uint16_t thisSample = waveformFifo->getGpuAmplifierDataRaw(WaveformFifo::ReaderTCP, waveformAddress, i);
                                         waveformArray.replace(waveformArrayIndex, sizeof(thisSample), (const char*)(&thisSample), sizeof(thisSample));
@@ -159,8 +184,7 @@ void TCPDataOutputThread::run()
                                     }
 
                                     if (thisChannel->getOutputToTcpSpike()) {
-                                        std::string waveName = QString(enabledChannelNames[channel] + "|SPK").toStdString();
-                                        uint16_t* spikeWaveform = waveformFifo->getDigitalWaveformPointer(waveName);
+                                        uint16_t* spikeWaveform = waveformFifo->digitalWaveformPointer(waveforms.spike);
                                         uint8_t spikeId = (uint8_t) waveformFifo->getDigitalData(WaveformFifo::ReaderTCP, spikeWaveform, i);
                                         if (spikeId != SpikeIdNoSpike) {
                                             // Create 14-byte chunk with magic num, native name, timestamp, and spike ID
@@ -183,8 +207,7 @@ void TCPDataOutputThread::run()
                                     }
 
                                     if (thisChannel->getOutputToTcpDc()) {
-                                        std::string waveName = QString(enabledChannelNames[channel] + "|DC").toStdString();
-                                        float *dcWaveform = waveformFifo->getAnalogWaveformPointer(waveName);
+                                        float *dcWaveform = waveformFifo->analogWaveformPointer(waveforms.dc);
                                         float thisSampleFloat = waveformFifo->getAnalogData(WaveformFifo::ReaderTCP, dcWaveform, i);
                                         uint16_t thisSample = round((thisSampleFloat / -0.01923) + 512);
                                         waveformArray.replace(waveformArrayIndex, sizeof(thisSample), (const char*)(&thisSample), sizeof(thisSample));
@@ -192,8 +215,7 @@ void TCPDataOutputThread::run()
                                     }
 
                                     if (thisChannel->getOutputToTcpStim()) {
-                                        std::string waveName = QString(enabledChannelNames[channel] + "|STIM").toStdString();
-                                        uint16_t *stimWaveform = waveformFifo->getDigitalWaveformPointer(waveName);
+                                        uint16_t *stimWaveform = waveformFifo->digitalWaveformPointer(waveforms.stim);
                                         uint16_t thisSampleUSB = waveformFifo->getDigitalData(WaveformFifo::ReaderTCP, stimWaveform, i);
                                         bool stimPolarityNegative = thisSampleUSB & (1 << 8);
                                         bool stimOn = thisSampleUSB & 1;
@@ -217,8 +239,7 @@ void TCPDataOutputThread::run()
                                     if (thisChannel->getOutputToTcp()) {
                                         // Once every 4 samples, aux input actually gets a sample.
                                         if (i % 4 == 0) {
-                                            std::string waveName = QString(enabledChannelNames[channel]).toStdString();
-                                            float *auxWaveform = waveformFifo->getAnalogWaveformPointer(waveName);
+                                            float *auxWaveform = waveformFifo->analogWaveformPointer(waveforms.analog);
                                             float thisSampleFloat = waveformFifo->getAnalogData(WaveformFifo::ReaderTCP, auxWaveform, i / 4);
                                             uint16_t thisSample = round((thisSampleFloat / 37.4e-6));
                                             waveformArray.replace(waveformArrayIndex, sizeof(thisSample), (const char*)(&thisSample), sizeof(thisSample));
@@ -239,8 +260,7 @@ void TCPDataOutputThread::run()
                                     if (thisChannel->getOutputToTcp()) {
                                         // Once every data block, supply voltage actually gets a sample
                                         if (i % FramesPerBlock == 0) {
-                                            std::string waveName = QString(enabledChannelNames[channel]).toStdString();
-                                            float *vddWaveform = waveformFifo->getAnalogWaveformPointer(waveName);
+                                            float *vddWaveform = waveformFifo->analogWaveformPointer(waveforms.analog);
                                             float thisSampleFloat = waveformFifo->getAnalogData(WaveformFifo::ReaderTCP, vddWaveform, i / FramesPerBlock);
                                             uint16_t thisSample = round((thisSampleFloat / 74.8e-6));
                                             waveformArray.replace(waveformArrayIndex, sizeof(thisSample), (const char*)(&thisSample), sizeof(thisSample));
@@ -259,8 +279,7 @@ void TCPDataOutputThread::run()
                                 if (thisChannel->getSignalType() == BoardAdcSignal) {
 
                                     if (thisChannel->getOutputToTcp()) {
-                                        std::string waveName = QString(enabledChannelNames[channel]).toStdString();
-                                        float *adcWaveform = waveformFifo->getAnalogWaveformPointer(waveName);
+                                        float *adcWaveform = waveformFifo->analogWaveformPointer(waveforms.analog);
                                         float thisSampleFloat = waveformFifo->getAnalogData(WaveformFifo::ReaderTCP, adcWaveform, i);
                                         uint16_t thisSample;
                                         if (state->getControllerTypeEnum() == ControllerRecordUSB2) {
@@ -277,8 +296,7 @@ void TCPDataOutputThread::run()
                                 if (thisChannel->getSignalType() == BoardDacSignal) {
 
                                     if (thisChannel->getOutputToTcp()) {
-                                        std::string waveName = QString(enabledChannelNames[channel]).toStdString();
-                                        float *dacWaveform = waveformFifo->getAnalogWaveformPointer(waveName);
+                                        float *dacWaveform = waveformFifo->analogWaveformPointer(waveforms.analog);
                                         float thisSampleFloat = waveformFifo->getAnalogData(WaveformFifo::ReaderTCP, dacWaveform, i);
                                         uint16_t thisSample = round(thisSampleFloat * 3200) + 32768;
                                         waveformArray.replace(waveformArrayIndex, sizeof(thisSample), (const char*)(&thisSample), sizeof(thisSample));
@@ -319,6 +337,10 @@ void TCPDataOutputThread::run()
                         waveformArrayIndex = 0;
                         spikeArrayIndex = 0;
                         waveformFifo->freeOldData(WaveformFifo::ReaderTCP);
+                    } else {
+                        // Wait (briefly, so socket events are still processed) for more data to arrive.
+                        waveformFifo->waitForNewData(WaveformFifo::ReaderTCP, FramesPerBlock * state->tcpNumDataBlocksWrite->getValue(),
+                                                     false, EventLoopWaitMicroseconds, wakeupJitter);
                     }
                 }
                 qApp->processEvents();
@@ -331,7 +353,7 @@ void TCPDataOutputThread::run()
             running = false;
         } else {
             qApp->processEvents();
-            usleep(1000);
+            controlEvent.waitFor([this]() { return keepGoing || stopThread; }, EventLoopWaitMicroseconds);
         }
     }
 }
@@ -447,6 +469,23 @@ void TCPDataOutputThread::updateEnabledChannels()
         previousSample[i] = 0;
     }
 
+    // Resolve each enabled channel's waveforms once, so the output loop doesn't look them up by name.
+    enabledChannelWaveforms.resize(enabledChannelNames.size());
+    for (int i = 0; i < enabledChannelNames.size(); ++i) {
+        std::string waveName = enabledChannelNames[i].toStdString();
+        TCPChannelWaveforms& waveforms = enabledChannelWaveforms[i];
+        waveforms.channel = signalSources->channelByName(enabledChannelNames[i]);
+        waveforms.wide = waveformFifo->findWaveform(waveName + "|WIDE");
+        waveforms.low = waveformFifo->findWaveform(waveName + "|LOW");
+        waveforms.high = waveformFifo->findWaveform(waveName + "|HIGH");
+        waveforms.spike = waveformFifo->findWaveform(waveName + "|SPK");
+        waveforms.dc = waveformFifo->findWaveform(waveName + "|DC");
+        waveforms.stim = waveformFifo->findWaveform(waveName + "|STIM");
+        waveforms.analog = waveformFifo->findWaveform(waveName);
+    }
+    digitalInWordWaveform = waveformFifo->findWaveform("DIGITAL-IN-WORD");
+    digitalOutWordWaveform = waveformFifo->findWaveform("DIGITAL-OUT-WORD");
+
     digInWordPresent = 0;
     if (numDigitalInChannels > 0) {
         digInWordPresent = 1;
@@ -479,6 +518,13 @@ void TCPDataOutputThread::updateEnabledChannels()
 
     previousEnabledBands = state->signalSources->getTcpFilterBands();
 
+    // Tell the waveform processor which amplifier bands are streamed.
+    std::vector<std::string> tcpBandNames;
+    for (const QString& bandName : previousEnabledBands) {
+        tcpBandNames.push_back(bandName.toStdString());
+    }
+    waveformFifo->setBandDemand(WaveformFifo::ReaderTCP, tcpBandNames);
+
     closeRequested = false;
     closeCompleted = false;
 }
@@ -496,6 +542,7 @@ bool TCPDataOutputThread::isReadyToClose()
 void TCPDataOutputThread::startRunning()
 {
     keepGoing = true;
+    controlEvent.notify();
 }
 
 void TCPDataOutputThread::stopRunning()
@@ -509,12 +556,14 @@ void TCPDataOutputThread::closeInternal()
     tcpSpikeDataCommunicator->moveToThread(parentObject->thread());
     keepGoing = false;
     stopThread = true;
+    controlEvent.notify();
 }
 
 void TCPDataOutputThread::closeExternal()
 {
     keepGoing = false;
     stopThread = true;
+    controlEvent.notify();
 }
 
 bool TCPDataOutputThread::isActive() const
@@ -33,10 +33,26 @@
 
 #include <QThread>
 #include <stdint.h>
+#include <atomic>
 
 #include "systemstate.h"
 #include "waveformfifo.h"
 #include "tcpcommunicator.h"
+#include "threadscheduling.h"
+
+// Channel and WaveformFifo handles for one channel streamed over TCP, resolved once when the list of enabled
+// channels changes rather than for every sample.
+struct TCPChannelWaveforms
+{
+    Channel* channel;
+    WaveformHandle wide;
+    WaveformHandle low;
+    WaveformHandle high;
+    WaveformHandle spike;
+    WaveformHandle dc;
+    WaveformHandle stim;
+    WaveformHandle analog;  // non-amplifier channels
+};
 
 class TCPDataOutputThread : public QThread
 {
@@ -50,6 +66,7 @@ public:
     void stopRunning(); // Exit run loop.
     bool isActive() const; // Is this thread running?
     void closeExternal(); // Close thread from outside this thread.
+    void setThreadScheduler(ThreadScheduler* threadScheduler_) { threadScheduler = threadScheduler_; }
 
     void prepareToClose();
     bool isReadyToClose();
@@ -67,6 +84,9 @@ private:
     std::vector<std::string> channelNames;
     QVector<QString> enabledChannelNames;
     QVector<QString> enabledStimChannelNames;
+    std::vector<TCPChannelWaveforms> enabledChannelWaveforms;  // same order as enabledChannelNames
+    WaveformHandle digitalInWordWaveform;
+    WaveformHandle digitalOutWordWaveform;
 
     QStringList previousEnabledBands;
 
@@ -106,9 +126,11 @@ private:
     bool closeRequested;
     bool closeCompleted;
 
-    volatile bool keepGoing;
-    volatile bool running;
-    volatile bool stopThread;
+    std::atomic_bool keepGoing;
+    std::atomic_bool running;
+    std::atomic_bool stopThread;
+    DataEvent controlEvent;
+    ThreadScheduler* threadScheduler;
 
     QObject *parentObject;
 
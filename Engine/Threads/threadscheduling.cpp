@@ -0,0 +1,332 @@
+//------------------------------------------------------------------------------
+//
+//  Intan Technologies RHX Data Acquisition Software
+//  Version 3.4.0
+//
+//  Copyright (c) 2020-2025 Intan Technologies
+//
+//  This file is part of the Intan Technologies RHX Data Acquisition Software.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published
+//  by the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//  This software is provided 'as-is', without any express or implied warranty.
+//  In no event will the authors be held liable for any damages arising from
+//  the use of this software.
+//
+//  See <http://www.intantech.com> for documentation and product information.
+//
+//------------------------------------------------------------------------------
+
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include "threadscheduling.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#endif
+
+ThreadScheduler::ThreadScheduler() :
+    policy(PolicyDefault)
+{
+    for (int thread = 0; thread < NumberOfPipelineThreads; ++thread) {
+        obtained[thread] = "not started";
+    }
+}
+
+// Set the scheduling policy and CPU affinity to be applied the next time each thread starts running.  The affinity
+// string lists the CPUs for each thread, e.g., "USB=2;Processor=3;Disk=4,5;Audio=6-7;TCP=6-7;Workers=8-11".  Threads that
+// aren't listed (or all threads, if the string is empty) may run on any CPU.
+void ThreadScheduler::setProfile(Policy policy_, const std::string& affinity)
+{
+    std::vector<int> newCpus[NumberOfPipelineThreads];
+    if (!parseAffinity(affinity, newCpus)) {
+        std::cerr << "ThreadScheduler::setProfile: could not parse ThreadAffinity '" << affinity << "'; CPU affinity not set." << '\n';
+        for (int thread = 0; thread < NumberOfPipelineThreads; ++thread) {
+            newCpus[thread].clear();
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(profileMutex);
+    policy = policy_;
+    for (int thread = 0; thread < NumberOfPipelineThreads; ++thread) {
+        cpus[thread] = newCpus[thread];
+    }
+}
+
+ThreadScheduler::Policy ThreadScheduler::requestedPolicy()
+{
+    std::lock_guard<std::mutex> lock(profileMutex);
+    return policy;
+}
+
+bool ThreadScheduler::parseAffinity(const std::string& affinity, std::vector<int> (&result)[NumberOfPipelineThreads])
+{
+    std::istringstream entries(affinity);
+    std::string entry;
+    while (std::getline(entries, entry, ';')) {
+        entry.erase(std::remove_if(entry.begin(), entry.end(), [](unsigned char c) { return std::isspace(c); }), entry.end());
+        if (entry.empty()) continue;
+        size_t equals = entry.find('=');
+        if (equals == std::string::npos) return false;
+
+        std::string name = entry.substr(0, equals);
+        std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return (char) std::tolower(c); });
+        int thread = -1;
+        for (int t = 0; t < NumberOfPipelineThreads; ++t) {
+            std::string threadNameLower = threadName((PipelineThread) t);
+            std::transform(threadNameLower.begin(), threadNameLower.end(), threadNameLower.begin(),
+                           [](unsigned char c) { return (char) std::tolower(c); });
+            if (name == threadNameLower) thread = t;
+        }
+        if (thread < 0) return false;
+
+        std::istringstream cpuList(entry.substr(equals + 1));
+        std::string range;
+        while (std::getline(cpuList, range, ',')) {
+            int first, last;
+            char dash;
+            std::istringstream rangeStream(range);
+            if (!(rangeStream >> first)) return false;
+            last = first;
+            if (rangeStream >> dash) {
+                if (dash != '-' || !(rangeStream >> last)) return false;
+            }
+            if (first < 0 || last < first || last > 1023) return false;
+            for (int cpu = first; cpu <= last; ++cpu) {
+                result[thread].push_back(cpu);
+            }
+        }
+    }
+    return true;
+}
+
+std::string ThreadScheduler::threadName(PipelineThread thread)
+{
+    switch (thread) {
+    case ThreadUSB:
+        return "USB";
+    case ThreadProcessor:
+        return "Processor";
+    case ThreadDisk:
+        return "Disk";
+    case ThreadAudio:
+        return "Audio";
+    case ThreadTCP:
+        return "TCP";
+    case ThreadWorker:
+        return "Workers";
+    default:
+        return "Unknown";
+    }
+}
+
+// Threads closest to the hardware get the highest priority, since the controller's FIFO is the smallest buffer.
+int ThreadScheduler::realTimePriority(PipelineThread thread)
+{
+    switch (thread) {
+    case ThreadUSB:
+        return 80;
+    case ThreadProcessor:
+    case ThreadWorker:
+        return 79;
+    case ThreadAudio:
+        return 78;
+    case ThreadTCP:
+        return 77;
+    default:
+        return 76;
+    }
+}
+
+int ThreadScheduler::niceLevel(PipelineThread thread)
+{
+    return (thread == ThreadUSB || thread == ThreadProcessor || thread == ThreadWorker) ? -10 : -5;
+}
+
+// Restrict the calling thread to the given CPUs (or allow all CPUs, if the list is empty).  Return a description
+// of the affinity obtained.
+std::string ThreadScheduler::setAffinity(const std::vector<int>& cpuList)
+{
+    std::ostringstream description;
+#if defined(_WIN32)
+    DWORD_PTR mask = 0;
+    if (cpuList.empty()) {
+        DWORD_PTR systemMask;
+        GetProcessAffinityMask(GetCurrentProcess(), &mask, &systemMask);
+    } else {
+        for (int cpu : cpuList) {
+            if (cpu < (int) (8 * sizeof(DWORD_PTR))) mask |= ((DWORD_PTR) 1) << cpu;
+        }
+    }
+    if (SetThreadAffinityMask(GetCurrentThread(), mask) == 0) {
+        description << "affinity not set (error " << GetLastError() << ")";
+        return description.str();
+    }
+#elif defined(__linux__)
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    if (cpuList.empty()) {
+        long numCpus = sysconf(_SC_NPROCESSORS_CONF);
+        for (long cpu = 0; cpu < numCpus && cpu < CPU_SETSIZE; ++cpu) CPU_SET(cpu, &cpuSet);
+    } else {
+        for (int cpu : cpuList) {
+            if (cpu < CPU_SETSIZE) CPU_SET(cpu, &cpuSet);
+        }
+    }
+    int error = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuSet);
+    if (error != 0) {
+        description << "affinity not set (" << std::strerror(error) << ")";
+        return description.str();
+    }
+#else
+    if (!cpuList.empty()) {
+        return "CPU affinity not supported on this platform";
+    }
+#endif
+    if (cpuList.empty()) {
+        description << "any CPU";
+    } else {
+        description << "CPUs ";
+        for (int i = 0; i < (int) cpuList.size(); ++i) {
+            if (i > 0) description << ',';
+            description << cpuList[i];
+        }
+    }
+    return description.str();
+}
+
+// Apply the scheduling policy to the calling thread, falling back to less demanding policies if necessary.  Return
+// a description of the policy obtained.
+std::string ThreadScheduler::setPolicy(Policy policy, PipelineThread thread)
+{
+    std::ostringstream description;
+#ifdef _WIN32
+    int priority = THREAD_PRIORITY_NORMAL;
+    if (policy == PolicyHighPriority) priority = THREAD_PRIORITY_HIGHEST;
+    else if (policy == PolicyRoundRobin || policy == PolicyFIFO) priority = THREAD_PRIORITY_TIME_CRITICAL;
+    if (!SetThreadPriority(GetCurrentThread(), priority)) {
+        description << "priority not set (error " << GetLastError() << "), ";
+    }
+    description << "thread priority " << GetThreadPriority(GetCurrentThread());
+#else
+    std::string note;
+    bool realTime = false;
+    sched_param param;
+    if (policy == PolicyRoundRobin || policy == PolicyFIFO) {
+        int realTimePolicy = (policy == PolicyFIFO) ? SCHED_FIFO : SCHED_RR;
+        param.sched_priority = (std::min)((std::max)(realTimePriority(thread), sched_get_priority_min(realTimePolicy)),
+                                          sched_get_priority_max(realTimePolicy));
+        realTime = pthread_setschedparam(pthread_self(), realTimePolicy, &param) == 0;
+        if (!realTime) {
+            note = " (real-time policy not permitted)";
+            policy = PolicyHighPriority;
+        }
+    }
+    if (!realTime) {
+        param.sched_priority = 0;
+#ifdef __linux__
+        pthread_setschedparam(pthread_self(), SCHED_OTHER, &param);
+        // On Linux, nice levels apply to individual threads.
+        pid_t tid = (pid_t) syscall(SYS_gettid);
+        int nice = (policy == PolicyHighPriority) ? niceLevel(thread) : 0;
+        if (setpriority(PRIO_PROCESS, tid, nice) != 0 && policy == PolicyHighPriority) {
+            note += " (nice level not permitted)";
+        }
+#else
+        if (policy == PolicyHighPriority) param.sched_priority = sched_get_priority_max(SCHED_OTHER);
+        if (pthread_setschedparam(pthread_self(), SCHED_OTHER, &param) != 0 && policy == PolicyHighPriority) {
+            note += " (priority not permitted)";
+        }
+#endif
+    }
+
+    // Read back what we actually obtained.
+    int schedPolicy = SCHED_OTHER;
+    if (pthread_getschedparam(pthread_self(), &schedPolicy, &param) == 0) {
+        if (schedPolicy == SCHED_FIFO) description << "SCHED_FIFO priority " << param.sched_priority;
+        else if (schedPolicy == SCHED_RR) description << "SCHED_RR priority " << param.sched_priority;
+        else description << "SCHED_OTHER priority " << param.sched_priority;
+    }
+#ifdef __linux__
+    if (schedPolicy != SCHED_FIFO && schedPolicy != SCHED_RR) {
+        errno = 0;
+        int nice = getpriority(PRIO_PROCESS, (id_t) syscall(SYS_gettid));
+        if (errno == 0) description << " nice " << nice;
+    }
+#endif
+    description << note;
+#endif
+    return description.str();
+}
+
+// Apply the current profile to the calling thread.  Call from each pipeline thread when it starts running.  If
+// cpuIndex is not negative (used for pools of identical worker threads), pin the thread to just one of the CPUs listed
+// for it, so that workers are spread across the list.
+void ThreadScheduler::applyToCurrentThread(PipelineThread thread, int cpuIndex)
+{
+    Policy threadPolicy;
+    std::vector<int> threadCpus;
+    {
+        std::lock_guard<std::mutex> lock(profileMutex);
+        threadPolicy = policy;
+        threadCpus = cpus[thread];
+    }
+    if (cpuIndex >= 0 && !threadCpus.empty()) {
+        threadCpus = std::vector<int>(1, threadCpus[cpuIndex % threadCpus.size()]);
+    }
+
+    std::string result = setPolicy(threadPolicy, thread) + ", " + setAffinity(threadCpus);
+    std::cout << "ThreadScheduler: " << threadName(thread) << " thread: " << result << '\n';
+
+    std::lock_guard<std::mutex> lock(profileMutex);
+    obtained[thread] = result;
+}
+
+void ThreadScheduler::resetJitter()
+{
+    for (int thread = 0; thread < NumberOfPipelineThreads; ++thread) {
+        jitter[thread].reset();
+    }
+}
+
+// Return the policy obtained by each thread, and its wakeup jitter percentiles (in microseconds), e.g.,
+// "USB: SCHED_FIFO priority 80, CPUs 2, jitter n=5000 p50=55us p99=120us max=300us; Processor: ..."
+std::string ThreadScheduler::report()
+{
+    std::lock_guard<std::mutex> lock(profileMutex);
+    std::ostringstream out;
+    for (int thread = 0; thread < NumberOfPipelineThreads; ++thread) {
+        const LatencyHistogram& h = jitter[thread];
+        if (thread > 0) out << "; ";
+        out << threadName((PipelineThread) thread) << ": " << obtained[thread] << ", jitter n=" << h.count();
+        if (h.count() > 0) {
+            out << " p50=" << h.percentileMicroseconds(50.0) << "us" <<
+                   " p99=" << h.percentileMicroseconds(99.0) << "us" <<
+                   " max=" << h.maxMicroseconds() << "us";
+        }
+    }
+    return out.str();
+}
@@ -0,0 +1,90 @@
+//------------------------------------------------------------------------------
+//
+//  Intan Technologies RHX Data Acquisition Software
+//  Version 3.4.0
+//
+//  Copyright (c) 2020-2025 Intan Technologies
+//
+//  This file is part of the Intan Technologies RHX Data Acquisition Software.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published
+//  by the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//  This software is provided 'as-is', without any express or implied warranty.
+//  In no event will the authors be held liable for any damages arising from
+//  the use of this software.
+//
+//  See <http://www.intantech.com> for documentation and product information.
+//
+//------------------------------------------------------------------------------
+#ifndef THREADSCHEDULING_H
+#define THREADSCHEDULING_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include "latencytracer.h"
+
+// Applies the CPU affinity and scheduling policy chosen by the user (ThreadSchedulingPolicy and ThreadAffinity
+// state items) to the data acquisition pipeline threads.  Each thread calls applyToCurrentThread() when it starts
+// running, since scheduling attributes can only be set reliably from the thread itself.  Requests that aren't
+// permitted (e.g., real-time policies without the necessary privileges) fall back to the next best policy, and the
+// policy actually obtained is recorded for reporting.  Each thread also records its wakeup jitter: how late it
+// resumed after a timed sleep, or after being notified that data was ready.
+class ThreadScheduler
+{
+public:
+    enum PipelineThread : int {
+        ThreadUSB = 0,
+        ThreadProcessor,
+        ThreadDisk,
+        ThreadAudio,
+        ThreadTCP,
+        ThreadWorker,  // CPU processing worker threads (see CPUWorkerPool)
+        NumberOfPipelineThreads
+    };
+
+    enum Policy : int {
+        PolicyDefault = 0,   // Operating system defaults.
+        PolicyHighPriority,  // Negative nice level (Linux/Mac) or above-normal priority (Windows).
+        PolicyRoundRobin,    // SCHED_RR real-time policy (time-critical priority on Windows).
+        PolicyFIFO           // SCHED_FIFO real-time policy (time-critical priority on Windows).
+    };
+
+    ThreadScheduler();
+
+    void setProfile(Policy policy_, const std::string& affinity);
+    Policy requestedPolicy();
+    void applyToCurrentThread(PipelineThread thread, int cpuIndex = -1);
+
+    void resetJitter();
+    LatencyHistogram& wakeupJitter(PipelineThread thread) { return jitter[thread]; }
+
+    static std::string threadName(PipelineThread thread);
+    std::string report();
+
+private:
+    std::mutex profileMutex;
+    Policy policy;
+    std::vector<int> cpus[NumberOfPipelineThreads];  // Empty to allow any CPU.
+    std::string obtained[NumberOfPipelineThreads];
+    LatencyHistogram jitter[NumberOfPipelineThreads];
+
+    static bool parseAffinity(const std::string& affinity, std::vector<int> (&result)[NumberOfPipelineThreads]);
+    static int realTimePriority(PipelineThread thread);
+    static int niceLevel(PipelineThread thread);
+    static std::string setAffinity(const std::vector<int>& cpuList);
+    static std::string setPolicy(Policy policy, PipelineThread thread);
+};
+
+#endif // THREADSCHEDULING_H
@@ -30,6 +30,9 @@
 
 #include <QElapsedTimer>
 #include <iostream>
+#include <cstring>
+#include <algorithm>
+#include "streamingmemory.h"
 #include "usbdatathread.h"
 
 USBDataThread::USBDataThread(AbstractRHXController* controller_, DataStreamFifo* usbFifo_, QObject *parent) :
@@ -41,19 +44,21 @@ USBDataThread::USBDataThread(AbstractRHXController* controller_, DataStreamFifo*
     running(false),
     stopThread(false),
     numUsbBlocksToRead(1),
-    usbBufferIndex(0)
+    lowLatencyMode(false),
+    lowLatencyTargetMsec(5.0),
+    lowLatencyTargetMisses(0),
+    usbBufferIndex(0),
+    frameScanner(controller_->getType()),
+    latencyTracer(nullptr),
+    threadScheduler(nullptr)
 {
     bufferSize = (BufferSizeInBlocks + 1) * BytesPerWord *
             RHXDataBlock::dataBlockSizeInWords(controller->getType(), controller->maxNumDataStreams());
     memoryNeededGB = sizeof(uint8_t) * bufferSize / (1024.0 * 1024.0 * 1024.0);
     std::cout << "USBDataThread: Allocating " << bufferSize / 1.0e6 << " MBytes for USB buffer." << std::endl;
-    usbBuffer = nullptr;
-
-    memoryAllocated = true;
-    try {
-        usbBuffer = new uint8_t [bufferSize];
-    } catch (std::bad_alloc&) {
-        memoryAllocated = false;
+    usbBuffer = StreamingMemory::allocateArray<uint8_t>(bufferSize);
+    memoryAllocated = usbBuffer != nullptr;
+    if (!usbBuffer) {
         std::cerr << "Error: USBDataThread constructor could not allocate " << memoryNeededGB << " GB of memory." << std::endl;
     }
 
@@ -62,24 +67,46 @@ USBDataThread::USBDataThread(AbstractRHXController* controller_, DataStreamFifo*
 
 USBDataThread::~USBDataThread()
 {
-    delete [] usbBuffer;
+    StreamingMemory::release(usbBuffer);
 }
 
 void USBDataThread::run()
 {
-    emit hardwareFifoReport(0.0);
+    emit hardwareFifoReport(0.0, 0, 0.0);
     while (!stopThread) {
         QElapsedTimer fifoReportTimer;
 //        QElapsedTimer workTimer, loopTimer, reportTimer;
         if (keepGoing) {
-            emit hardwareFifoReport(0.0);
+            emit hardwareFifoReport(0.0, 0, 0.0);
             running = true;
+            if (threadScheduler) threadScheduler->applyToCurrentThread(ThreadScheduler::ThreadUSB);
+            LatencyHistogram* wakeupJitter = threadScheduler ? &threadScheduler->wakeupJitter(ThreadScheduler::ThreadUSB) : nullptr;
+            QElapsedTimer pollTimer;
             int numBytesRead = 0;
             int bytesInBuffer = 0;
             ControllerType type = controller->getType();
             int numBytesPerDataFrame = BytesPerWord *
                     RHXDataBlock::dataBlockSizeInWords(type, controller->getNumEnabledDataStreams()) /
                     RHXDataBlock::samplesPerDataBlock(type);
+            int numBytesPerDataBlock = BytesPerWord * RHXDataBlock::dataBlockSizeInWords(type, controller->getNumEnabledDataStreams());
+            const bool zeroCopy = DataStreamFifo::zeroCopyWritesSupported();
+
+            // In low-latency mode, start by reading one block at a time.  The batch size doubles whenever data builds
+            // up in the controller's FIFO faster than we read it, and shrinks by one block after we have drained the
+            // FIFO on LowLatencyShrinkReads consecutive reads.  The batch size for the target latency is the upper
+            // limit, unless we are still falling behind at that size: then the batch size may grow up to the normal
+            // batch size rather than overflow the controller's FIFO, and each such read counts as a target miss.
+            const bool lowLatency = lowLatencyMode;
+            const int LowLatencyShrinkReads = 32;
+            double blockDurationMsec = 1000.0 * RHXDataBlock::samplesPerDataBlock(type) / controller->getSampleRate();
+            int maxBlocksToRead = numUsbBlocksToRead;
+            int targetBlocksToRead = (std::max)(1, (std::min)(maxBlocksToRead, (int) (lowLatencyTargetMsec / blockDurationMsec)));
+            int adaptiveBlocksToRead = 1;
+            int drainedReads = 0;
+            bool targetMissReported = false;
+            lowLatencyTargetMisses = 0;
+
+            frameScanner.reset(numBytesPerDataFrame);
             int ledArray[8] = {1, 0, 0, 0, 0, 0, 0, 0};
             int ledIndex = 0;
             if (type == ControllerRecordUSB2) {
@@ -91,6 +118,7 @@ void USBDataThread::run()
             controller->setContinuousRunMode(true);
             controller->run();
             fifoReportTimer.start();
+
 //            loopTimer.start();
 //            workTimer.start();
 //            reportTimer.start();
@@ -100,7 +128,20 @@ void USBDataThread::run()
                 // Performance note:  Executing the following command takes around 88% of the total time of this loop,
                 // with or without error checking enabled.
 
-                numBytesRead = (int) controller->readDataBlocksRaw(numUsbBlocksToRead, &usbBuffer[usbBufferIndex]);
+                // If possible, read USB data directly into free space in the FIFO buffer rather than into usbBuffer
+                // so it doesn't need to be copied again.  Any bytes left over from the previous read go first.
+                int numBlocksToRead = lowLatency ? adaptiveBlocksToRead : (int) numUsbBlocksToRead;
+                uint8_t* fifoWriteSpace = nullptr;
+                if (zeroCopy) {
+                    fifoWriteSpace = (uint8_t*) usbFifo->reserveWriteSpace((usbBufferIndex + numBlocksToRead * numBytesPerDataBlock) / BytesPerWord);
+                }
+                uint8_t* readBuffer = usbBuffer;
+                if (fifoWriteSpace) {
+                    std::memcpy(fifoWriteSpace, usbBuffer, usbBufferIndex);
+                    readBuffer = fifoWriteSpace;
+                }
+
+                numBytesRead = (int) controller->readDataBlocksRaw(numBlocksToRead, &readBuffer[usbBufferIndex]);
                 if (numBytesRead == -1) {
                     break;
                 }
@@ -109,34 +150,60 @@ void USBDataThread::run()
                 if (numBytesRead > 0) {
                     if (!errorChecking) {
                         // If not checking for USB data glitches, just write all the data to the FIFO buffer.
-                        if (!usbFifo->writeToBuffer(&usbBuffer[usbBufferIndex], (numBytesRead + usbBufferIndex) / BytesPerWord)) {
+                        // (Blocks are stamped for latency tracing before they become visible to the consumer.)
+                        if (latencyTracer && bytesInBuffer >= numBytesPerDataFrame) {
+                            latencyTracer->stampAcquired(USBFrameScanner::timeStamp(fifoWriteSpace ? fifoWriteSpace : usbBuffer,
+                                                                                    bytesInBuffer - numBytesPerDataFrame));
+                        }
+                        if (fifoWriteSpace) {
+                            usbFifo->commitWriteSpace(bytesInBuffer / BytesPerWord);
+                        } else if (!usbFifo->writeToBuffer(usbBuffer, bytesInBuffer / BytesPerWord)) {
                             std::cerr << "USBDataThread: USB FIFO overrun (1)." << '\n';
                         }
                         usbBufferIndex = 0;
                     } else {
+                        if (fifoWriteSpace && frameScanner.isSynchronized()) {
+                            // Commit the frames at the start of the read that are valid where they are.  Whatever
+                            // follows (normally just the last frame, whose successor hasn't arrived yet) is moved to
+                            // usbBuffer and checked below.
+                            int validBytes = 0;
+                            while (validBytes <= frameScanner.lastCheckableIndex(bytesInBuffer) &&
+                                   frameScanner.frameIsValid(fifoWriteSpace, validBytes)) {
+                                frameScanner.frameAccepted(fifoWriteSpace, validBytes);
+                                validBytes += numBytesPerDataFrame;
+                            }
+                            bytesInBuffer -= validBytes;
+                            std::memcpy(usbBuffer, &fifoWriteSpace[validBytes], bytesInBuffer);
+                            if (latencyTracer && validBytes > 0) {
+                                latencyTracer->stampAcquired(USBFrameScanner::timeStamp(fifoWriteSpace, validBytes - numBytesPerDataFrame));
+                            }
+                            usbFifo->commitWriteSpace(validBytes / BytesPerWord);
+                        } else if (fifoWriteSpace) {
+                            std::memcpy(usbBuffer, fifoWriteSpace, bytesInBuffer);
+                        }
                         usbBufferIndex = 0;
-                        // Otherwise, check each USB data block for the correct header bytes before writing.
-                        while (usbBufferIndex <= bytesInBuffer - numBytesPerDataFrame - USBHeaderSizeInBytes) {
-                            if (RHXDataBlock::checkUsbHeader(usbBuffer, usbBufferIndex, type) &&
-                                RHXDataBlock::checkUsbHeader(usbBuffer, usbBufferIndex + numBytesPerDataFrame, type)) {
-                                // If we find two correct headers, assume the data in between is a good data block,
-                                // and write it to the FIFO buffer.
+                        // Check each remaining USB data block for valid headers (and, after a glitch, consecutive
+                        // timestamps) before writing.
+                        while (usbBufferIndex <= frameScanner.lastCheckableIndex(bytesInBuffer)) {
+                            if (frameScanner.frameIsValid(usbBuffer, usbBufferIndex)) {
+                                frameScanner.frameAccepted(usbBuffer, usbBufferIndex);
+                                if (latencyTracer) {
+                                    latencyTracer->stampAcquired(USBFrameScanner::timeStamp(usbBuffer, usbBufferIndex));
+                                }
                                 if (!usbFifo->writeToBuffer(&usbBuffer[usbBufferIndex], numBytesPerDataFrame / BytesPerWord)) {
                                     std::cerr << "USBDataThread: USB FIFO overrun (2)." << '\n';
                                 }
                                 usbBufferIndex += numBytesPerDataFrame;
                             } else {
-                                // If headers are not found, advance word by word until we find them
-                                usbBufferIndex += 2;
+                                // If headers are not found, search ahead for the next one.
+                                usbBufferIndex = frameScanner.skipToNextHeader(usbBuffer, usbBufferIndex, bytesInBuffer);
                             }
                         }
                         // If any data remains in usbBuffer, shift it to the front.
                         if (usbBufferIndex > 0) {
-                            int j = 0;
-                            for (int i = usbBufferIndex; i < bytesInBuffer; ++i) {
-                                usbBuffer[j++] = usbBuffer[i];
-                            }
-                            usbBufferIndex = j;
+                            int bytesRemaining = (std::max)(bytesInBuffer - usbBufferIndex, 0);
+                            std::memmove(usbBuffer, &usbBuffer[usbBufferIndex], bytesRemaining);
+                            usbBufferIndex = bytesRemaining;
                         } else {
                             // If usbBufferIndex == 0, we didn't have enough data to work with; append more.
                             usbBufferIndex = bytesInBuffer;
@@ -148,9 +215,42 @@ void USBDataThread::run()
 
                     bool hasBeenUpdated = false;
                     unsigned int wordsInFifo = controller->getLastNumWordsInFifo(hasBeenUpdated);
-                    if (hasBeenUpdated || (fifoReportTimer.nsecsElapsed() > qint64(50e6))) {
+
+                    // wordsInFifo was measured just before this read, so whatever we didn't read is still waiting.
+                    int backlogBlocks = (std::max)(0, (int) (wordsInFifo / (numBytesPerDataBlock / BytesPerWord)) - numBlocksToRead);
+                    if (lowLatency && hasBeenUpdated) {
+                        if (backlogBlocks >= adaptiveBlocksToRead) {
+                            // Falling behind
+                            int ceiling = (adaptiveBlocksToRead >= targetBlocksToRead) ? maxBlocksToRead : targetBlocksToRead;
+                            adaptiveBlocksToRead = (std::min)(2 * adaptiveBlocksToRead, ceiling);
+                            drainedReads = 0;
+                        } else if (backlogBlocks == 0 && adaptiveBlocksToRead > 1) {
+                            if (++drainedReads >= LowLatencyShrinkReads) {
+                                --adaptiveBlocksToRead;
+                                drainedReads = 0;
+                            }
+                        } else {
+                            drainedReads = 0;
+                        }
+                        if (numBlocksToRead > targetBlocksToRead) {
+                            ++lowLatencyTargetMisses;
+                            if (!targetMissReported) {
+                                std::cerr << "USBDataThread: Unable to keep up with USB data at the low-latency target of " <<
+                                             lowLatencyTargetMsec << " ms; reading larger batches." << '\n';
+                                targetMissReported = true;
+                            }
+                        }
+                    }
+
+                    // Report the FIFO level along with the read size and the resulting latency (the time covered by
+                    // one read plus any backlog).  Reads per second (throughput) is 1000 / (blocks * block duration).
+                    // Low-latency mode reads much more often, so limit the report rate to that of normal mode.
+                    bool reportDue = lowLatency ? (fifoReportTimer.nsecsElapsed() > qint64(33e6)) :
+                                                  (hasBeenUpdated || (fifoReportTimer.nsecsElapsed() > qint64(50e6)));
+                    if (reportDue) {
                         double fifoPercentageFull = 100.0 * wordsInFifo / FIFOCapacityInWords;
-                        emit hardwareFifoReport(fifoPercentageFull);
+                        double readLatencyMsec = (numBlocksToRead + backlogBlocks) * blockDurationMsec;
+                        emit hardwareFifoReport(fifoPercentageFull, numBlocksToRead, readLatencyMsec);
                         fifoReportTimer.restart();
 //                        cout << "Opal Kelly FIFO is " << (int) fifoPercentageFull << "% full." << EndOfLine;
                     }
@@ -176,7 +276,11 @@ void USBDataThread::run()
 //                        reportTimer.restart();
 //                    }
                 } else {
-                    usleep(100);  // wait 100 microseconds
+                    // The controller can't notify us when data arrives, so wait 100 microseconds and poll again.
+                    // Any time spent asleep beyond the requested 100 microseconds is scheduling (wakeup) jitter.
+                    pollTimer.start();
+                    usleep(100);
+                    if (wakeupJitter) wakeupJitter->record(std::max(0.0, pollTimer.nsecsElapsed() / 1000.0 - 100.0));
                 }
             }
             controller->setContinuousRunMode(false);
@@ -193,7 +297,7 @@ void USBDataThread::run()
 
             running = false;
         } else {
-            usleep(100);
+            controlEvent.waitFor([this]() { return keepGoing || stopThread; }, IdleWaitMicroseconds);
         }
     }
 }
@@ -201,6 +305,7 @@ void USBDataThread::run()
 void USBDataThread::startRunning()
 {
     keepGoing = true;
+    controlEvent.notify();
 }
 
 void USBDataThread::stopRunning()
@@ -212,6 +317,7 @@ void USBDataThread::close()
 {
     keepGoing = false;
     stopThread = true;
+    controlEvent.notify();
 }
 
 bool USBDataThread::isActive() const
@@ -228,6 +334,14 @@ void USBDataThread::setNumUsbBlocksToRead(int numUsbBlocksToRead_)
     numUsbBlocksToRead = numUsbBlocksToRead_;
 }
 
+// In low-latency mode, the number of blocks per read adapts to keep up with the controller, starting from one block,
+// up to the limit set by setNumUsbBlocksToRead().  Settings take effect the next time the thread starts running.
+void USBDataThread::setLowLatencyMode(bool enabled, double targetLatencyMsec)
+{
+    lowLatencyMode = enabled;
+    lowLatencyTargetMsec = targetLatencyMsec;
+}
+
 void USBDataThread::setErrorCheckingEnabled(bool enabled)
 {
     errorChecking = enabled;
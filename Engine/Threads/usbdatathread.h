@@ -33,9 +33,13 @@
 
 #include <QObject>
 #include <QThread>
+#include <atomic>
 #include "rhxdatablock.h"
 #include "abstractrhxcontroller.h"
 #include "datastreamfifo.h"
+#include "usbframescanner.h"
+#include "latencytracer.h"
+#include "threadscheduling.h"
 
 const int BufferSizeInBlocks = 32;
 
@@ -54,25 +58,39 @@ public:
     bool isActive() const;
     void close();
     void setNumUsbBlocksToRead(int numUsbBlocksToRead_);
+    void setLowLatencyMode(bool enabled, double targetLatencyMsec);
     void setErrorCheckingEnabled(bool enabled);
+    void setLatencyTracer(LatencyTracer* latencyTracer_) { latencyTracer = latencyTracer_; }
+    void setThreadScheduler(ThreadScheduler* threadScheduler_) { threadScheduler = threadScheduler_; }
 
     bool memoryWasAllocated(double& memoryRequestedGB) const { memoryRequestedGB += memoryNeededGB; return memoryAllocated; }
 
+    USBFrameStatistics frameStatistics() const { return frameScanner.statistics(); }
+    int lowLatencyTargetMissCount() const { return lowLatencyTargetMisses; }  // reads larger than the target latency, this run
+
 signals:
-    void hardwareFifoReport(double percentFull);
+    void hardwareFifoReport(double percentFull, int numBlocksPerRead, double readLatencyMsec);
 
 private:
     AbstractRHXController* controller;
     DataStreamFifo* usbFifo;
-    volatile bool keepGoing;
-    volatile bool running;
-    volatile bool stopThread;
-    volatile int numUsbBlocksToRead;
+    std::atomic_bool keepGoing;
+    std::atomic_bool running;
+    std::atomic_bool stopThread;
+    std::atomic_int numUsbBlocksToRead;
+    std::atomic_bool lowLatencyMode;
+    std::atomic<double> lowLatencyTargetMsec;
+    std::atomic_int lowLatencyTargetMisses;
+    DataEvent controlEvent;
 
     uint8_t* usbBuffer;
     int bufferSize;
     int usbBufferIndex;
 
+    USBFrameScanner frameScanner;
+    LatencyTracer* latencyTracer;
+    ThreadScheduler* threadScheduler;
+
     bool memoryAllocated;
     double memoryNeededGB;
 };
@@ -30,6 +30,7 @@
 
 #include <QElapsedTimer>
 #include <iostream>
+#include <algorithm>
 #include "rhxdatablock.h"
 #include "softwarereferenceprocessor.h"
 #include "rhxdatareader.h"
@@ -48,32 +49,56 @@ WaveformProcessorThread::WaveformProcessorThread(SystemState* state_, int numDat
     waveformFifo(waveformFifo_),
     numDataStreams(numDataStreams_),
     xpuController(xpuController_),
+    demultiplexer(state_->getControllerTypeEnum(), numDataStreams_),
     keepGoing(false),
     running(false),
-    stopThread(false)
+    stopThread(false),
+    threadScheduler(nullptr)
 {
     cpuLoadHistory.resize(20, 0.0);
+    referenceLoadHistory.resize(20, 0.0);
+}
+
+// Add the newest load measurement to a history of recent measurements, and return their running average to smooth
+// out fluctuations.
+static double smoothedLoad(std::vector<double>& history, double newLoad)
+{
+    for (int i = 1; i < (int) history.size(); ++i) {
+        history[i - 1] = history[i];
+    }
+    history[history.size() - 1] = newLoad;
+    double total = 0.0;
+    for (int i = 0; i < (int) history.size(); ++i) {
+        total += history[i];
+    }
+    return total / (double)(history.size());
 }
 
 void WaveformProcessorThread::run()
 {
-    const int NumBlocks = 1;  // Note: GPU spike extraction works on single data blocks only; this value must be 1 if spikes are read.
-    const int NumSamples = NumBlocks * RHXDataBlock::samplesPerDataBlock(type);
+    const int SamplesPerBlock = RHXDataBlock::samplesPerDataBlock(type);
     uint16_t* usbData = nullptr;
     bool firstTime = true;
     bool softwareRefInfoUpdated = false;
-    SoftwareReferenceProcessor swRefProcessor(type, numDataStreams, NumSamples, state);
-    QElapsedTimer loopTimer, workTimer, reportTimer;
+    std::vector<uint8_t> bandDemand;
+    uint32_t bandDemandGeneration = 0;
+    SoftwareReferenceProcessor swRefProcessor(type, numDataStreams, SamplesPerBlock, state);
+    QElapsedTimer loopTimer, workTimer, reportTimer, referenceTimer;
+    double referenceTime = 0.0;
 
     while (!stopThread) {
         int numUsbWords = RHXDataBlock::dataBlockSizeInWords(type, numDataStreams);
 
         fill(cpuLoadHistory.begin(), cpuLoadHistory.end(), 0.0);
+        fill(referenceLoadHistory.begin(), referenceLoadHistory.end(), 0.0);
 
         if (keepGoing) {
             running = true;
+            if (threadScheduler) threadScheduler->applyToCurrentThread(ThreadScheduler::ThreadProcessor);
+            LatencyHistogram* wakeupJitter = threadScheduler ? &threadScheduler->wakeupJitter(ThreadScheduler::ThreadProcessor) : nullptr;
             firstTime = true;
             softwareRefInfoUpdated = false;
+            bandDemandGeneration = 0;  // Pass the current band demand on to the XPU before the first block.
 
             loopTimer.start();
             workTimer.start();
@@ -88,24 +113,35 @@ void WaveformProcessorThread::run()
                 // workTimer.restart();
 
                 if (!softwareRefInfoUpdated) {
-                    // Update software referencing information.
+                    // Update software referencing information, and resolve where each waveform is read from and written to.
+                    swRefProcessor.setThreadScheduler(threadScheduler);
                     swRefProcessor.updateReferenceInfo(signalSources);
+                    buildRoutingPlan();
                     softwareRefInfoUpdated = true;
                 }
 
-                usbData = usbFifo->pointerToData(numUsbWords);  // Get pointer to new USB data, if available.
+                // Process all complete data blocks that have accumulated since the last pass (up to MaxBlocksPerPass)
+                // together, so per-pass overhead is shared when we fall behind or USB data arrives in large reads.
+                int numBlocks = std::min(usbFifo->wordsAvailable() / numUsbWords, MaxBlocksPerPass);
+                usbData = numBlocks > 0 ? usbFifo->pointerToData(numBlocks * numUsbWords) : nullptr;  // Get pointer to new USB data, if available.
                 if (usbData) {
                     if (state->getReportSpikes()) {
-                        state->advanceSpikeTimer();
+                        for (int block = 0; block < numBlocks; ++block) {
+                            state->advanceSpikeTimer();
+                        }
                     }
                     workTimer.restart();
 
                     // Perform any software referencing prior to filtering.
-                    swRefProcessor.applySoftwareReferences(usbData);
+                    referenceTimer.start();
+                    for (int block = 0; block < numBlocks; ++block) {
+                        swRefProcessor.applySoftwareReferences(&usbData[block * numUsbWords]);
+                    }
+                    referenceTime += (double) referenceTimer.nsecsElapsed();
 
                     // Check for space to write the waveform data.
-                    while (!waveformFifo->requestWriteSpace(NumBlocks)) {
-                        usleep(100);
+                    while (!waveformFifo->requestWriteSpace(numBlocks)) {
+                        waveformFifo->waitForWriteSpace(numBlocks, DataWaitMicroseconds, wakeupJitter);
                     }
 
                     // Get wide, low, and high pointers from WaveformFifo.
@@ -116,10 +152,15 @@ void WaveformProcessorThread::run()
                     uint32_t* spike = waveformFifo->pointerToGpuSpikeTimestampsWriteSpace();
                     uint8_t* spikeID = waveformFifo->pointerToGpuSpikeIdsWriteSpace();
 
-                    // Process one data block through GPU, and write the results to WaveformFifo.
+                    // Only compute the amplifier bands that some WaveformFifo reader needs.
+                    if (waveformFifo->updateBandDemand(bandDemand, bandDemandGeneration)) {
+                        xpuController->setBandDemand(bandDemand);
+                    }
+
+                    // Process data blocks through GPU, and write the results to WaveformFifo.
 //                    auto start = chrono::steady_clock::now();
 
-                    xpuController->processDataBlock(usbData, low, wide, high, spike, spikeID);
+                    xpuController->processDataBlocks(usbData, numBlocks, low, wide, high, spike, spikeID);
 //                    auto end = chrono::steady_clock::now();
 
                     // Determine how long this processing took, and report if it's approaching real-time.
@@ -129,83 +170,40 @@ void WaveformProcessorThread::run()
 //                        qDebug() << "Warning: GPU process time approaching real-time. Real-time data block length: " << oneBlockus << " us. Processing time: " << elapsedus << " us. GPU is " << gpuAccel << "x faster";
 
                     // Read and process waveform data from USB buffer, and write data to waveform FIFO.
-                    RHXDataReader dataReader(type, numDataStreams, usbData, NumSamples);
+                    RHXDataReader dataReader(type, numDataStreams, usbData, numBlocks * SamplesPerBlock);
 
-                    float* analogWaveform = nullptr;
-                    uint16_t* digitalWaveform = nullptr;
-
-                    int lastTimestamp = dataReader.readTimeStampData(waveformFifo->pointerToTimeStampWriteSpace());
+                    // Copy timestamps and all other once-per-frame signals in a single pass through the raw data.
+                    int lastTimestamp = demultiplexer.demultiplex(usbData, numBlocks * SamplesPerBlock,
+                                                                  waveformFifo->pointerToTimeStampWriteSpace(),
+                                                                  waveformFifo->writeSpaceIndex());
                     state->setLastTimestamp(lastTimestamp);
 
+                    const bool reportSpikes = state->getReportSpikes();
                     QString spikingChannelNames("");
 
-                    for (int group = 0; group < signalSources->numGroups(); group++) {
-                        SignalGroup* signalGroup = signalSources->groupByIndex(group);
-                        for (int signal = 0; signal < signalGroup->numChannels(); signal++) {
-                            Channel* channel = signalGroup->channelByIndex(signal);
-                            std::string waveName = channel->getNativeNameString();
-                            if (channel->getSignalType() == AmplifierSignal) {
-                                GpuWaveformAddress gpuWaveformAddress = waveformFifo->getGpuWaveformAddress(waveName + "|SPK");
-                                digitalWaveform = waveformFifo->getDigitalWaveformPointer(waveName + "|SPK");
-                                // Note: GPU spike extraction only works on single data blocks.
-                                bool spikeFound = waveformFifo->extractGpuSpikeDataOneDataBlock(digitalWaveform, gpuWaveformAddress, firstTime);
-
-                                if (state->getReportSpikes()) {
-                                    if (spikeFound) {
-                                        spikingChannelNames.append(QString::fromStdString(waveName) + ",");
-                                        //state->spikeReport(QString::fromStdString(waveName));
-                                    }
-                                    // Find if a spike happened on this channel. If so, get its name
-                                    // If there's a name, send the spikeReport() signal.
-                                    // This signal should be ultimately received by ProbeMapWindow, which will then internally handle the time decay
-                                }
-
-                                if (signalSources->getControllerType() == ControllerStimRecord) {
-                                    // Load DC amplifier data and stimulation markers.
-                                    analogWaveform = waveformFifo->getAnalogWaveformPointer(waveName + "|DC");
-                                    dataReader.readDcAmplifierData(waveformFifo->pointerToAnalogWriteSpace(analogWaveform),
-                                                                   channel->getBoardStream(), channel->getChipChannel());
-                                    digitalWaveform = waveformFifo->getDigitalWaveformPointer(waveName + "|STIM");
-                                    dataReader.readStimParamData(waveformFifo->pointerToDigitalWriteSpace(digitalWaveform),
-                                                              channel->getBoardStream(), channel->getChipChannel());
-                                }
-                            } else if (channel->getSignalType() == AuxInputSignal) {
-                                analogWaveform = waveformFifo->getAnalogWaveformPointer(waveName);
-                                dataReader.readAuxInData(waveformFifo->pointerToAnalogWriteSpace(analogWaveform),
-                                                         channel->getBoardStream(), channel->getChipChannel());
-                            } else if (channel->getSignalType() == SupplyVoltageSignal) {
-                                analogWaveform = waveformFifo->getAnalogWaveformPointer(waveName);
-                                dataReader.readSupplyVoltageData(waveformFifo->pointerToAnalogWriteSpace(analogWaveform),
-                                                                 channel->getBoardStream());
-                            } else if (channel->getSignalType() == BoardAdcSignal) {
-                                analogWaveform = waveformFifo->getAnalogWaveformPointer(waveName);
-                                dataReader.readBoardAdcData(waveformFifo->pointerToAnalogWriteSpace(analogWaveform),
-                                                            channel->getNativeChannelNumber());
-                            } else if (channel->getSignalType() == BoardDacSignal) {
-                                analogWaveform = waveformFifo->getAnalogWaveformPointer(waveName);
-                                dataReader.readBoardDacData(waveformFifo->pointerToAnalogWriteSpace(analogWaveform),
-                                                            channel->getNativeChannelNumber());
-                            } else if (channel->getSignalType() == BoardDigitalInSignal) {
-                                analogWaveform = waveformFifo->getAnalogWaveformPointer(waveName);
-                                dataReader.readDigInData(waveformFifo->pointerToAnalogWriteSpace(analogWaveform),
-                                                         channel->getNativeChannelNumber());
-                            } else if (channel->getSignalType() == BoardDigitalOutSignal) {
-                                analogWaveform = waveformFifo->getAnalogWaveformPointer(waveName);
-                                dataReader.readDigOutData(waveformFifo->pointerToAnalogWriteSpace(analogWaveform),
-                                                         channel->getNativeChannelNumber());
+                    for (const WaveformRoute& route : routingPlan) {
+                        switch (route.kind) {
+                        case WaveformRoute::Spike:
+                            if (waveformFifo->extractGpuSpikeData(route.digitalWaveform, route.gpuWaveformAddress, numBlocks, firstTime) &&
+                                    reportSpikes) {
+                                spikingChannelNames.append(route.spikeName);
                             }
+                            break;
+                        case WaveformRoute::AuxIn:
+                            dataReader.readAuxInData(waveformFifo->pointerToAnalogWriteSpace(route.analogWaveform),
+                                                     route.stream, route.channel);
+                            break;
+                        case WaveformRoute::SupplyVoltage:
+                            dataReader.readSupplyVoltageData(waveformFifo->pointerToAnalogWriteSpace(route.analogWaveform),
+                                                             route.stream);
+                            break;
                         }
                     }
 
-                    if (state->getReportSpikes()) {
+                    if (reportSpikes) {
                         state->spikeReport(spikingChannelNames);
                     }
 
-                    digitalWaveform = waveformFifo->getDigitalWaveformPointer("DIGITAL-IN-WORD");
-                    dataReader.readDigInData(waveformFifo->pointerToDigitalWriteSpace(digitalWaveform));
-                    digitalWaveform = waveformFifo->getDigitalWaveformPointer("DIGITAL-OUT-WORD");
-                    dataReader.readDigOutData(waveformFifo->pointerToDigitalWriteSpace(digitalWaveform));
-
                     // Done reading and processing all waveforms.
                     waveformFifo->commitNewData();  // Commit waveform data we have just written.
                     usbFifo->freeData();  // Free raw data we just read from the USB buffer.
@@ -218,18 +216,10 @@ void WaveformProcessorThread::run()
                     if (reportTimer.elapsed() >= 50) {
                         double cpuUsage = 100.0 * workTime / loopTime;
 
-                        // Calculate running average of CPU usage to smooth out fluctuations.
-                        for (int i = 1; i < (int) cpuLoadHistory.size(); ++i) {
-                            cpuLoadHistory[i - 1] = cpuLoadHistory[i];
-                        }
-                        cpuLoadHistory[cpuLoadHistory.size() - 1] = cpuUsage;
-                        double total = 0.0;
-                        for (int i = 0; i < (int) cpuLoadHistory.size(); ++i) {
-                            total += cpuLoadHistory[i];
-                        }
-                        double averageCpuLoad = total / (double)(cpuLoadHistory.size());
-
-                        emit cpuLoadPercent(averageCpuLoad);
+                        // Calculate running average of CPU usage to smooth out fluctuations.  Software referencing
+                        // is included in the total, and also reported on its own.
+                        emit cpuLoadPercent(smoothedLoad(cpuLoadHistory, cpuUsage));
+                        emit softwareReferenceLoadPercent(smoothedLoad(referenceLoadHistory, 100.0 * referenceTime / loopTime));
 
 //                        cout << "                   WaveformProcessorThread CPU usage: " << (int) averageCpuLoad << "%" << EndOfLine;
 //                        cout << "USB FIFO " << (int) usbFifo->percentFull() << "% full.  ";
@@ -238,24 +228,105 @@ void WaveformProcessorThread::run()
                     }
                     workTimer.restart();
                     loopTimer.restart();
+                    referenceTime = 0.0;
                 } else {
-                    usleep(100);    // Wait 100 microseconds.
+                    usbFifo->waitForData(numUsbWords, DataWaitMicroseconds, wakeupJitter);  // Wait for USB data to arrive.
                 }
             }
             running = false;
 
             fill(cpuLoadHistory.begin(), cpuLoadHistory.end(), 0.0);
+            fill(referenceLoadHistory.begin(), referenceLoadHistory.end(), 0.0);
             emit cpuLoadPercent(0.0);
+            emit softwareReferenceLoadPercent(0.0);
         } else {
-            usleep(100);
+            controlEvent.waitFor([this]() { return keepGoing || stopThread; }, IdleWaitMicroseconds);
         }
     }
 }
 
+// Compile the current SignalSources configuration into a flat list of waveforms to read on each pass, so that the
+// processing loop does not need to build waveform names or search WaveformFifo's maps.  SignalSources and WaveformFifo
+// buffers only change between runs (e.g., after a port rescan), so this is rebuilt each time a run starts.
+void WaveformProcessorThread::buildRoutingPlan()
+{
+    routingPlan.clear();
+    demultiplexer.setNumDataStreams(numDataStreams);  // also removes all previous destinations
+
+    WaveformRoute route;
+    route.analogWaveform = nullptr;
+    route.digitalWaveform = nullptr;
+    route.gpuWaveformAddress = GpuWaveformAddress{ GpuWaveformSpike, 0 };
+    route.stream = 0;
+    route.channel = 0;
+
+    auto addRoute = [&](WaveformRoute::Kind kind) {
+        route.kind = kind;
+        routingPlan.push_back(route);
+    };
+
+    for (int group = 0; group < signalSources->numGroups(); group++) {
+        SignalGroup* signalGroup = signalSources->groupByIndex(group);
+        for (int signal = 0; signal < signalGroup->numChannels(); signal++) {
+            Channel* channel = signalGroup->channelByIndex(signal);
+            std::string waveName = channel->getNativeNameString();
+            route.analogWaveform = nullptr;
+            route.digitalWaveform = nullptr;
+            route.spikeName.clear();
+            switch (channel->getSignalType()) {
+            case AmplifierSignal:
+                route.gpuWaveformAddress = waveformFifo->getGpuWaveformAddress(waveName + "|SPK");
+                route.digitalWaveform = waveformFifo->getDigitalWaveformPointer(waveName + "|SPK");
+                route.spikeName = QString::fromStdString(waveName) + ",";
+                addRoute(WaveformRoute::Spike);
+                route.spikeName.clear();
+
+                if (signalSources->getControllerType() == ControllerStimRecord) {
+                    // Load DC amplifier data and stimulation markers.
+                    demultiplexer.addDcAmplifier(waveformFifo->getAnalogWaveformPointer(waveName + "|DC"),
+                                                 channel->getBoardStream(), channel->getChipChannel());
+                    demultiplexer.addStimParam(waveformFifo->getDigitalWaveformPointer(waveName + "|STIM"),
+                                               channel->getBoardStream(), channel->getChipChannel());
+                }
+                break;
+            case AuxInputSignal:
+                route.stream = channel->getBoardStream();
+                route.channel = channel->getChipChannel();
+                route.analogWaveform = waveformFifo->getAnalogWaveformPointer(waveName);
+                addRoute(WaveformRoute::AuxIn);
+                break;
+            case SupplyVoltageSignal:
+                route.stream = channel->getBoardStream();
+                route.analogWaveform = waveformFifo->getAnalogWaveformPointer(waveName);
+                addRoute(WaveformRoute::SupplyVoltage);
+                break;
+            case BoardAdcSignal:
+                demultiplexer.addBoardAdc(waveformFifo->getAnalogWaveformPointer(waveName), channel->getNativeChannelNumber());
+                break;
+            case BoardDacSignal:
+                demultiplexer.addBoardDac(waveformFifo->getAnalogWaveformPointer(waveName), channel->getNativeChannelNumber());
+                break;
+            case BoardDigitalInSignal:
+                demultiplexer.addDigIn(waveformFifo->getAnalogWaveformPointer(waveName), channel->getNativeChannelNumber());
+                break;
+            case BoardDigitalOutSignal:
+                demultiplexer.addDigOut(waveformFifo->getAnalogWaveformPointer(waveName), channel->getNativeChannelNumber());
+                break;
+            default:
+                break;
+            }
+        }
+    }
+
+    demultiplexer.addDigInWord(waveformFifo->getDigitalWaveformPointer("DIGITAL-IN-WORD"));
+    demultiplexer.addDigOutWord(waveformFifo->getDigitalWaveformPointer("DIGITAL-OUT-WORD"));
+}
+
 void WaveformProcessorThread::startRunning(int numDataStreams_)
 {
     numDataStreams = numDataStreams_;
     keepGoing = true;
+    controlEvent.notify();
 }
 
 void WaveformProcessorThread::stopRunning()
@@ -267,6 +338,7 @@ void WaveformProcessorThread::close()
 {
     keepGoing = false;
     stopThread = true;
+    controlEvent.notify();
 }
 
 bool WaveformProcessorThread::isActive() const
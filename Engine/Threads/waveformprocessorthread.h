@@ -33,10 +33,32 @@
 #include <QObject>
 #include <QThread>
 #include <vector>
+#include <atomic>
 #include "datastreamfifo.h"
 #include "waveformfifo.h"
 #include "systemstate.h"
 #include "xpucontroller.h"
+#include "threadscheduling.h"
+#include "rhxdatademultiplexer.h"
+
+// One waveform written by WaveformProcessorThread on every pass, with its WaveformFifo buffer and raw data
+// address resolved in advance.  (Signals sampled once per frame are handled by RHXDataDemultiplexer instead.)
+struct WaveformRoute
+{
+    enum Kind {
+        Spike,
+        AuxIn,
+        SupplyVoltage
+    };
+
+    Kind kind;
+    float* analogWaveform;
+    uint16_t* digitalWaveform;
+    GpuWaveformAddress gpuWaveformAddress;
+    int stream;         // Board stream (amplifier, AuxIn and supply voltage signals)
+    int channel;        // Chip channel, or native channel number for board signals
+    QString spikeName;  // Name appended to spike reports (Spike routes only)
+};
 
 class WaveformProcessorThread : public QThread
 {
@@ -51,11 +73,18 @@ public:
     void stopRunning();
     bool isActive() const;
     void close();
+    void setThreadScheduler(ThreadScheduler* threadScheduler_) { threadScheduler = threadScheduler_; }
+
+    // Largest number of data blocks processed in one pass; WaveformFifo must accept writes of this many blocks.
+    static const int MaxBlocksPerPass = 16;
 
 signals:
     void cpuLoadPercent(double percent);
+    void softwareReferenceLoadPercent(double percent);
 
 private:
+    void buildRoutingPlan();
+
     SystemState* state;
     SignalSources* signalSources;
     ControllerType type;
@@ -65,12 +94,18 @@ private:
     int numDataStreams;
 
     std::vector<double> cpuLoadHistory;
+    std::vector<double> referenceLoadHistory;
 
     XPUController* xpuController;
 
-    volatile bool keepGoing;
-    volatile bool running;
-    volatile bool stopThread;
+    std::vector<WaveformRoute> routingPlan;
+    RHXDataDemultiplexer demultiplexer;
+
+    std::atomic_bool keepGoing;
+    std::atomic_bool running;
+    std::atomic_bool stopThread;
+    DataEvent controlEvent;
+    ThreadScheduler* threadScheduler;
 };
 
 #endif // WAVEFORMPROCESSORTHREAD_H
@@ -56,14 +56,21 @@ ReferenceSelectDialog::ReferenceSelectDialog(QString refString, SignalSources* s
         QString portName = "PORT " + QString(QChar('A' + port));
         QStringList nameList = signalSources->amplifierNameListUserOrder(portName);
         if (!nameList.isEmpty()) {
-            portNameList.append("Average of All Enabled Channels on Port " + QString(QChar('A' + port)));
+            portNameList.append(portName);
             channelList.append(nameList);
         }
     }
 
+    // Each item holds the reference string it selects.
     portComboBox = new QComboBox(this);
-    portComboBox->addItem("Average of All Enabled Channels on All Ports");
-    portComboBox->addItems(portNameList);
+    portComboBox->addItem("Average of All Enabled Channels on All Ports", "ALL");
+    for (int i = 0; i < portNameList.size(); ++i) {
+        portComboBox->addItem("Average of All Enabled Channels on Port " + portNameList[i].right(1), portNameList[i]);
+    }
+    portComboBox->addItem("Median of All Enabled Channels on All Ports", "MEDIAN");
+    for (int i = 0; i < portNameList.size(); ++i) {
+        portComboBox->addItem("Median of All Enabled Channels on Port " + portNameList[i].right(1), "MEDIAN " + portNameList[i]);
+    }
     if (!portNameList.isEmpty()) portComboBox->setCurrentIndex(1);
 
     QHBoxLayout* portLayout = new QHBoxLayout;
@@ -90,13 +97,15 @@ ReferenceSelectDialog::ReferenceSelectDialog(QString refString, SignalSources* s
     channelListLayout->addWidget(channelListWidget);
     channelListLayout->addStretch();
 
+    customMedianCheckBox = new QCheckBox(tr("Use median of selected channels instead of average."), this);
+
     setWindowTitle(tr("Select Reference"));
 
     QVBoxLayout *boxLayout1 = new QVBoxLayout;
     boxLayout1->addWidget(hardwareReferenceRadioButton);
     boxLayout1->addWidget(new QLabel(tr("Use REF input on headstage as reference."), this));
 
-    QLabel* label1 = new QLabel(tr("Use average of all enabled channels on a headstage port as reference."), this);
+    QLabel* label1 = new QLabel(tr("Use average or median of all enabled channels on a headstage port as reference."), this);
     label1->setWordWrap(true);
 
     QVBoxLayout *boxLayout2 = new QVBoxLayout;
@@ -104,7 +113,7 @@ ReferenceSelectDialog::ReferenceSelectDialog(QString refString, SignalSources* s
     boxLayout2->addWidget(label1);
     boxLayout2->addLayout(portLayout);
 
-    QLabel* label2 = new QLabel(tr("Use single channel or average of multiple channels as reference.  "
+    QLabel* label2 = new QLabel(tr("Use single channel or average or median of multiple channels as reference.  "
                                    "Use Shift and Ctrl to select multiple channels.  "
                                    "Designated channels will be used even if disabled."), this);
     label2->setWordWrap(true);
@@ -113,6 +122,7 @@ ReferenceSelectDialog::ReferenceSelectDialog(QString refString, SignalSources* s
     boxLayout3->addWidget(customReferenceRadioButton);
     boxLayout3->addWidget(label2);
     boxLayout3->addLayout(channelListLayout);
+    boxLayout3->addWidget(customMedianCheckBox);
 
     QGroupBox *mainGroupBox1 = new QGroupBox();
     mainGroupBox1->setLayout(boxLayout1);
@@ -148,27 +158,24 @@ ReferenceSelectDialog::ReferenceSelectDialog(QString refString, SignalSources* s
 
     setLayout(mainLayout);
 
-    int numRefs = refString.count(QChar(',')) + 1;
+    // Only "MEDIAN" and "MEDIAN PORT X" are port references; "MEDIAN A-001,A-002,..." is a custom channel list.
+    bool medianPortRef = refString == "MEDIAN" || (refString.left(12) == "MEDIAN PORT " && refString.length() == 13);
     if (refString.toLower() == "hardware") {
         hardwareReferenceRadioButton->setChecked(true);
         hardwareButtonSelected();
-    } else if (refString == "ALL" || refString.left(4) == "PORT") {
+    } else if (refString == "ALL" || refString.left(4) == "PORT" || medianPortRef) {
         portReferenceRadioButton->setChecked(true);
         portReferenceButtonSelected();
-        if (refString == "ALL") {
-            portComboBox->setCurrentIndex(0);
-        } else {
-            char portLetter = refString.back().toLatin1();
-            for (int index = 1; index < portComboBox->count(); ++index) {
-                if (portLetter == portComboBox->itemText(index).back().toLatin1()) {
-                    portComboBox->setCurrentIndex(index);
-                    break;
-                }
-            }
-        }
+        int index = portComboBox->findData(refString);
+        if (index >= 0) portComboBox->setCurrentIndex(index);
     } else {
         customReferenceRadioButton->setChecked(true);
         customReferenceButtonSelected();
+        if (refString.left(7) == "MEDIAN ") {
+            customMedianCheckBox->setChecked(true);
+            refString = refString.mid(7).trimmed();
+        }
+        int numRefs = refString.count(QChar(',')) + 1;
         for (int i = 0; i < numRefs; ++i) {
             QString ref = refString.section(',', i, i);
             QList<QListWidgetItem*> items = channelListWidget->findItems(ref, Qt::MatchContains);
@@ -183,15 +190,7 @@ QString ReferenceSelectDialog::referenceString() const
     if (referenceButtonGroup->checkedId() == 0) {
         return QString("Hardware");
     } else if (referenceButtonGroup->checkedId() == 1) {
-        int index = 0;
-        if (portComboBox->currentIndex() > 0) {
-            index = (int) (portComboBox->currentText().back().toLatin1() - 'A' + 1);
-        }
-        if (index == 0) {
-            refString = "ALL";
-        } else {
-            refString = "PORT " + QString(QChar('A' + index - 1));
-        }
+        refString = portComboBox->currentData().toString();
     } else {
         QList<QListWidgetItem*> selected = channelListWidget->selectedItems();
         for (int i = 0; i < selected.size(); ++i) {
@@ -203,6 +202,7 @@ QString ReferenceSelectDialog::referenceString() const
             refString += channelName + ",";
         }
         refString.chop(1);  // Trim off last comma.
+        if (customMedianCheckBox->isChecked()) refString.prepend("MEDIAN ");
     }
     return refString;
 }
@@ -223,6 +223,7 @@ void ReferenceSelectDialog::hardwareButtonSelected()
     okButton->setEnabled(true);
     portComboBox->setEnabled(false);
     channelListWidget->setEnabled(false);
+    customMedianCheckBox->setEnabled(false);
     medianCheckBox->setEnabled(false);
 }
 
@@ -231,6 +232,7 @@ void ReferenceSelectDialog::portReferenceButtonSelected()
     okButton->setEnabled(true);
     portComboBox->setEnabled(true);
     channelListWidget->setEnabled(false);
+    customMedianCheckBox->setEnabled(false);
     medianCheckBox->setEnabled(true);
 }
 
@@ -239,6 +241,7 @@ void ReferenceSelectDialog::customReferenceButtonSelected()
     okButton->setEnabled(numSelectedChannels() > 0);
     portComboBox->setEnabled(false);
     channelListWidget->setEnabled(true);
+    customMedianCheckBox->setEnabled(true);
     medianCheckBox->setEnabled(true);
 }
 
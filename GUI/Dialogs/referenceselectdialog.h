@@ -59,6 +59,7 @@ private:
 
     QComboBox* portComboBox;
     QListWidget* channelListWidget;
+    QCheckBox* customMedianCheckBox;
 
     QCheckBox* medianCheckBox;
     QPushButton* okButton;
@@ -131,6 +131,7 @@ ControlWindow::ControlWindow(SystemState* state_, CommandParser* parser_, Contro
     timeLabel(nullptr),
     topStatusLabel(nullptr),
     statusBarLabel(nullptr),
+    readerLagLabel(nullptr),
     statusBars(nullptr),
     controlPanel(nullptr),
     multiColumnDisplay(nullptr),
@@ -783,9 +784,29 @@ void ControlWindow::createStatusBar()
 {
     statusBarLabel = new QLabel(tr(""));
     statusBar()->addWidget(statusBarLabel, 1);
+    readerLagLabel = new QLabel(tr(""));
+    statusBar()->addPermanentWidget(readerLagLabel);
     statusBar()->setSizeGripEnabled(false); // Fixed window size
 }
 
+// Show which consumer of the software waveform buffer is furthest behind, and by how much.
+void ControlWindow::updateReaderLagStatus()
+{
+    if (!readerLagLabel) return;
+
+    int slowestReader = controllerInterface->slowestWaveformReader();
+    if (!state->running || slowestReader < 0) {
+        readerLagLabel->setText(tr(""));
+        readerLagLabel->setToolTip(tr(""));
+        return;
+    }
+    WaveformFifo::ReaderStatistics statistics = controllerInterface->waveformReaderStatistics((WaveformFifo::Reader) slowestReader);
+    double lagInSeconds = statistics.lagWords / state->sampleRate->getNumericValue();
+    readerLagLabel->setText(tr("Slowest: ") + WaveformFifo::readerName((WaveformFifo::Reader) slowestReader) + " (" +
+                            QString::number(lagInSeconds, 'f', 2) + " s)");
+    readerLagLabel->setToolTip(QString::fromStdString(controllerInterface->waveformReaderStatusReport()));
+}
+
 void ControlWindow::updateFromState()
 {
     // Update menus.
@@ -2226,8 +2247,12 @@ void ControlWindow::updateHardwareFifoStatus(double percentFull)
         hwFifoNearlyFull = 0;
     }
 
+    updateReaderLagStatus();
+
     double swBuffer = controllerInterface->swBufferPercentFull();
     if (swBuffer > 98.0) {
+        int slowestReader = controllerInterface->slowestWaveformReader();
+        QString slowestReaderName = slowestReader < 0 ? tr("none") : WaveformFifo::readerName((WaveformFifo::Reader) slowestReader);
         stopControllerSlot();
         queueErrorMessage(tr("<b>Software Buffer Overrun Error</b>"
                              "<p>Recording was stopped because the software waveform buffer "
@@ -2239,10 +2264,15 @@ void ControlWindow::updateHardwareFifoStatus(double percentFull)
                              "to enable the high-efficiency method of plotting. If the "
                              "workload of plotting (for example, with multiple high-resolution monitors) "
                              "was the cause of this buffer overrun, we recommend trying this mode. "
-                             "Performance will likely be significantly improved."));
+                             "Performance will likely be significantly improved."
+                             "<p>Slowest consumer of the buffer: ") + slowestReaderName);
     }
 
     double cpuLoad = (std::max)(mainCpuLoad, controllerInterface->latestWaveformProcessorCpuLoad());
 
-    if (statusBars) statusBars->updateBars(percentFull, swBuffer, cpuLoad);
+    if (statusBars) {
+        statusBars->updateBars(percentFull, swBuffer, cpuLoad);
+        statusBars->setToolTip(tr("CPU load: ") + QString::number(cpuLoad, 'f', 0) + "% (software referencing: " +
+                               QString::number(controllerInterface->latestSoftwareReferenceCpuLoad(), 'f', 0) + "%)");
+    }
 }
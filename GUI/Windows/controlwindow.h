@@ -303,6 +303,7 @@ private:
     QLabel *timeLabel;
     QLabel *topStatusLabel;
     QLabel *statusBarLabel;
+    QLabel *readerLagLabel;
     QString queuedErrorMessage;
 
     StatusBars* statusBars;
@@ -339,6 +340,7 @@ private:
     void updateMenus();
 
     void createStatusBar();
+    void updateReaderLagStatus();
     void setStatusBarReady();
     void setStatusBarRunning();
     void setStatusBarLoading();
@@ -46,31 +46,41 @@ SOURCES += main.cpp \
     Engine/Processing/SaveManagers/savefile.cpp \
     Engine/Processing/SaveManagers/savemanager.cpp \
     Engine/Processing/XPUInterfaces/abstractxpuinterface.cpp \
+    Engine/Processing/XPUInterfaces/channellanefilter.cpp \
     Engine/Processing/XPUInterfaces/cpuinterface.cpp \
+    Engine/Processing/XPUInterfaces/cpuworkerpool.cpp \
     Engine/Processing/XPUInterfaces/gpuinterface.cpp \
+    Engine/Processing/XPUInterfaces/hoopclassifier.cpp \
     Engine/Processing/XPUInterfaces/xpucontroller.cpp \
     Engine/Processing/channel.cpp \
     Engine/Processing/commandparser.cpp \
     Engine/Processing/controllerinterface.cpp \
+    Engine/Processing/dataevent.cpp \
     Engine/Processing/datastreamfifo.cpp \
     Engine/Processing/displayundomanager.cpp \
     Engine/Processing/fastfouriertransform.cpp \
     Engine/Processing/filter.cpp \
+    Engine/Processing/latencytracer.cpp \
     Engine/Processing/matfilewriter.cpp \
+    Engine/Processing/rhxdatademultiplexer.cpp \
     Engine/Processing/rhxdatareader.cpp \
     Engine/Processing/signalsources.cpp \
+    Engine/Processing/simdsupport.cpp \
     Engine/Processing/softwarereferenceprocessor.cpp \
     Engine/Processing/stateitem.cpp \
     Engine/Processing/stimparameters.cpp \
     Engine/Processing/stimparametersclipboard.cpp \
+    Engine/Processing/streamingmemory.cpp \
     Engine/Processing/systemstate.cpp \
     Engine/Processing/tcpcommunicator.cpp \
+    Engine/Processing/usbframescanner.cpp \
     Engine/Processing/waveformfifo.cpp \
     Engine/Processing/impedancereader.cpp \
     Engine/Processing/xmlinterface.cpp \
     Engine/Threads/audiothread.cpp \
     Engine/Threads/savetodiskthread.cpp \
     Engine/Threads/tcpdataoutputthread.cpp \
+    Engine/Threads/threadscheduling.cpp \
     Engine/Threads/usbdatathread.cpp \
     Engine/Threads/waveformprocessorthread.cpp \
     GUI/Dialogs/advancedstartupdialog.cpp \
@@ -163,34 +173,45 @@ HEADERS += \
     Engine/Processing/SaveManagers/savefile.h \
     Engine/Processing/SaveManagers/savemanager.h \
     Engine/Processing/XPUInterfaces/abstractxpuinterface.h \
+    Engine/Processing/XPUInterfaces/channellanefilter.h \
     Engine/Processing/XPUInterfaces/cpuinterface.h \
+    Engine/Processing/XPUInterfaces/cpuworkerpool.h \
     Engine/Processing/XPUInterfaces/gpuinterface.h \
+    Engine/Processing/XPUInterfaces/hoopclassifier.h \
+    Engine/Processing/XPUInterfaces/simdlanes.h \
     Engine/Processing/XPUInterfaces/xpucontroller.h \
     Engine/Processing/channel.h \
     Engine/Processing/commandparser.h \
     Engine/Processing/controllerinterface.h \
+    Engine/Processing/dataevent.h \
     Engine/Processing/datastreamfifo.h \
     Engine/Processing/displayundomanager.h \
     Engine/Processing/fastfouriertransform.h \
     Engine/Processing/filter.h \
+    Engine/Processing/latencytracer.h \
     Engine/Processing/matfilewriter.h \
     Engine/Processing/minmax.h \
     Engine/Processing/probemapdatastructures.h \
+    Engine/Processing/rhxdatademultiplexer.h \
     Engine/Processing/rhxdatareader.h \
     Engine/Processing/semaphore.h \
     Engine/Processing/signalsources.h \
+    Engine/Processing/simdsupport.h \
     Engine/Processing/softwarereferenceprocessor.h \
     Engine/Processing/stateitem.h \
     Engine/Processing/stimparameters.h \
     Engine/Processing/stimparametersclipboard.h \
+    Engine/Processing/streamingmemory.h \
     Engine/Processing/systemstate.h \
     Engine/Processing/tcpcommunicator.h \
+    Engine/Processing/usbframescanner.h \
     Engine/Processing/waveformfifo.h \
     Engine/Processing/impedancereader.h \
     Engine/Processing/xmlinterface.h \
     Engine/Threads/audiothread.h \
     Engine/Threads/savetodiskthread.h \
     Engine/Threads/tcpdataoutputthread.h \
+    Engine/Threads/threadscheduling.h \
     Engine/Threads/usbdatathread.h \
     Engine/Threads/waveformprocessorthread.h \
     GUI/Dialogs/advancedstartupdialog.h \
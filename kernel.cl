@@ -102,7 +102,8 @@ __kernel void process_block(__global global_param_struct* restrict global_parame
                             __global channel_hoops_struct* restrict hoops,
                             __global ushort* raw_block, __global float* prev_last_2, __global ushort* prev_high,
                             __global ushort* low, __global ushort* wide, __global ushort* high, __global uint* spike,
-                            __global uchar* spikeIDs, __global ushort* start_search_pos)
+                            __global uchar* spikeIDs, __global ushort* start_search_pos,
+                            __global ushort* active_channels, const uint num_channels)
 {
     ushort words_per_frame = global_parameters->words_per_frame;
     char type = global_parameters->type;
@@ -151,7 +152,8 @@ __kernel void process_block(__global global_param_struct* restrict global_parame
         high_a1[filter_index] = filter_parameters->high_params[filter_index].a1;
     }
 
-    uint channel_index = get_global_id(0);
+    // One work item per enabled amplifier channel; outputs are still indexed by the full channel count.
+    uint channel_index = active_channels[get_global_id(0)];
     const int snippets_per_block = (int) ceil((float) ((float) samples_per_block / (float) snippet_size) + 1.0f);
 
     float in_float[samples_per_block];
@@ -206,12 +208,12 @@ __kernel void process_block(__global global_param_struct* restrict global_parame
     bool use_hoops = (hoops[channel_index].use_hoops == 1) ? true : false;
 
     for (s = 0; s < snippets_per_block; ++s) {
-        spike[s * get_global_size(0) + channel_index] = 0;
-        spikeIDs[s * get_global_size(0) + channel_index] = 0;
+        spike[s * num_channels + channel_index] = 0;
+        spikeIDs[s * num_channels + channel_index] = 0;
     }
 
     for (s = 0; s < snippet_size; ++s) {
-        prev_high_float[s] = (float) (0.195f * (((float)prev_high[s * get_global_size(0) + channel_index]) - 32768));
+        prev_high_float[s] = (float) (0.195f * (((float)prev_high[s * num_channels + channel_index]) - 32768));
     }
 
     int in_index_stream;
@@ -541,10 +543,10 @@ __kernel void process_block(__global global_param_struct* restrict global_parame
             timestamp += thresh_s;
 
             // Write spike detection at this timestamp.
-            spike[snippet_index * get_global_size(0) + channel_index] = timestamp;
+            spike[snippet_index * num_channels + channel_index] = timestamp;
 
             // Populate spikeID with correct ID.
-            spikeIDs[snippet_index * get_global_size(0) + channel_index] = ID;
+            spikeIDs[snippet_index * num_channels + channel_index] = ID;
 
             // Advance by snippet_size samples since activity up until then will already be flagged as a spike.
             thresh_s += snippet_size;
@@ -575,7 +577,7 @@ __kernel void process_block(__global global_param_struct* restrict global_parame
         else if (filtered_high[s] < -6389.0f) filtered_high[s] = -6389.0f;
 
         // (4) Convert outputs to uint16_t.
-        out_index = s * get_global_size(0) + channel_index;
+        out_index = s * num_channels + channel_index;
 
         //  = round((low_float[s] / 0.195f) + 32768) with optimizations for speed
         low[out_index] = (ushort)(fma(filtered_low[s], 5.1282f, 32768.5f)); // TEMP disable low to use for debugging